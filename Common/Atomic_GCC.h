@@ -68,9 +68,13 @@ inline u32 AtomicLoadAcquire(volatile u32& src) {
 #else
 	//keep the compiler from caching any memory references
 	u32 result = src; // 32-bit reads are always atomic.
-	//__sync_synchronize(); // TODO: May not be necessary.
+#if defined(ARM) || defined(MIPS)
+	// Loads can be reordered on these, so this needs a real barrier.
+	__sync_synchronize();
+#else
 	// Compiler instruction only. x86 loads always have acquire semantics.
 	__asm__ __volatile__ ( "":::"memory" );
+#endif
 	return result;
 #endif
 }
@@ -88,7 +92,9 @@ inline void AtomicStoreRelease(volatile u32& dest, u32 value) {
 #elif defined(__SYMBIAN32__)
     __e32_atomic_store_rel32(&dest, value);
 #else
-	__sync_lock_test_and_set(&dest, value); // TODO: Wrong! This function has acquire semantics.
+	// __sync_lock_test_and_set only has acquire semantics, so use a full barrier.
+	__sync_synchronize();
+	dest = value; // 32-bit writes are always atomic.
 #endif
 }
 
@@ -68,7 +68,11 @@ inline u32 AtomicLoad(volatile u32& src) {
 }
 inline u32 AtomicLoadAcquire(volatile u32& src) {
 	u32 result = src; // 32-bit reads are always atomic.
+#ifdef _XBOX
+	__lwsync(); // PowerPC reorders loads, so this needs a real barrier.
+#else
 	_ReadBarrier(); // Compiler instruction only. x86 loads always have acquire semantics.
+#endif
 	return result;
 }
 
@@ -80,7 +84,11 @@ inline void AtomicStore(volatile u32& dest, u32 value) {
 	dest = value; // 32-bit writes are always atomic.
 }
 inline void AtomicStoreRelease(volatile u32& dest, u32 value) {
+#ifdef _XBOX
+	__lwsync(); // PowerPC reorders stores, so this needs a real barrier.
+#else
 	_WriteBarrier(); // Compiler instruction only. x86 stores always have release semantics.
+#endif
 	dest = value; // 32-bit writes are always atomic.
 }
 
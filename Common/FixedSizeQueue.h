@@ -18,9 +18,11 @@
 #ifndef _FIXED_SIZE_QUEUE_H_
 #define _FIXED_SIZE_QUEUE_H_
 
+#include <algorithm>
 #include <cstring>
 #include "ChunkFile.h"
 #include "MemoryUtil.h"
+#include "Atomics.h"
 
 // STL-look-a-like interface, but name is mixed case to distinguish it clearly from the
 // real STL classes.
@@ -170,59 +172,108 @@ private:
 };
 
 
-// I'm not sure this is 100% safe but it might be "Good Enough" :)
-// TODO: Use this, maybe make it safer first by using proper atomics
-// instead of volatile
-template<class T, int blockSize, int numBlocks>
-class LockFreeBlockQueue {
+// Single producer, single consumer ring. One thread may push while another pops, without
+// locks. The positions count up forever and wrap, so N must be a power of 2.
+// Each position gets its own cache line, so the two threads don't keep taking it from each other.
+template <class T, int N>
+class LockFreeRingBuffer {
 public:
-	LockFreeBlockQueue() {
-		curReadBlock = 0;
-		curWriteBlock = 0;
-		for (size_t i = 0; i < numBlocks; i++) {
-			blocks[i] = new T[blockSize];
-		}
+	LockFreeRingBuffer() : head_(0), tail_(0) {
+		storage_ = new T[N];
 	}
-	~LockFreeBlockQueue() {
-		for (size_t i = 0; i < numBlocks; i++) {
-			delete [] blocks[i];
-		}
+
+	~LockFreeRingBuffer() {
+		delete [] storage_;
+	}
+
+	// Either side. Only a snapshot, since the other side may be moving.
+	size_t size() {
+		return Common::AtomicLoadAcquire(tail_) - Common::AtomicLoadAcquire(head_);
+	}
+
+	size_t capacity() const {
+		return N;
+	}
+
+	// Producer side.
+	size_t room() {
+		return N - (tail_ - Common::AtomicLoadAcquire(head_));
+	}
+
+	// Gets up to size elements to write to directly, split in two where the ring wraps.
+	// Returns how many there were room for. Call EndPush with that count once written.
+	size_t BeginPush(size_t size, T **dest1, size_t *sz1, T **dest2, size_t *sz2) {
+		size = std::min(size, room());
+		const u32 pos = tail_ & (N - 1);
+		*dest1 = &storage_[pos];
+		*sz1 = std::min(size, (size_t)(N - pos));
+		*sz2 = size - *sz1;
+		*dest2 = *sz2 != 0 ? &storage_[0] : 0;
+		return size;
 	}
 
-	// Write to the returned pointer then call EndPush to finish the push.
-	T *BeginPush() {
-		return blocks[curWriteBlock];
+	void EndPush(size_t size) {
+		Common::AtomicStoreRelease(tail_, tail_ + (u32)size);
 	}
-	void EndPush() {
-		curWriteBlock++;
-		if (curWriteBlock == NUM_BLOCKS)
-			curWriteBlock = 0;
+
+	// Returns how many were pushed.
+	size_t Push(const T *src, size_t size) {
+		T *dest1, *dest2;
+		size_t sz1, sz2;
+		size = BeginPush(size, &dest1, &sz1, &dest2, &sz2);
+		memcpy(dest1, src, sz1 * sizeof(T));
+		if (sz2 != 0)
+			memcpy(dest2, src + sz1, sz2 * sizeof(T));
+		EndPush(size);
+		return size;
 	}
 
-	bool CanPush() { 
-		int nextBlock = curWriteBlock + 1;
-		if (nextBlock == NUM_BLOCKS) nextBlock = 0;
-		return nextBlock != curReadBlock;
+	// Consumer side. Same as BeginPush, but for reading.
+	size_t BeginPop(size_t size, const T **src1, size_t *sz1, const T **src2, size_t *sz2) {
+		size = std::min(size, (size_t)(Common::AtomicLoadAcquire(tail_) - head_));
+		const u32 pos = head_ & (N - 1);
+		*src1 = &storage_[pos];
+		*sz1 = std::min(size, (size_t)(N - pos));
+		*sz2 = size - *sz1;
+		*src2 = *sz2 != 0 ? &storage_[0] : 0;
+		return size;
 	}
 
-	bool CanPop() { return curReadBlock != curWriteBlock; }
+	void EndPop(size_t size) {
+		Common::AtomicStoreRelease(head_, head_ + (u32)size);
+	}
 
-	// Read from the returned pointer then call EndPush to finish the pop.
-	T *BeginPop() {
-		return blocks[curReadBlock];
+	// Returns how many were popped.
+	size_t Pop(T *dest, size_t size) {
+		const T *src1, *src2;
+		size_t sz1, sz2;
+		size = BeginPop(size, &src1, &sz1, &src2, &sz2);
+		memcpy(dest, src1, sz1 * sizeof(T));
+		if (sz2 != 0)
+			memcpy(dest + sz1, src2, sz2 * sizeof(T));
+		EndPop(size);
+		return size;
 	}
-	T *EndPop() {
-		curReadBlock++;
-		if (curReadBlock == NUM_BLOCKS)
-			curReadBlock = 0;
+
+	// Drops everything queued so far.
+	void Discard() {
+		Common::AtomicStoreRelease(head_, Common::AtomicLoadAcquire(tail_));
 	}
 
 private:
-	enum { NUM_BLOCKS = 16 };
-	T **blocks[NUM_BLOCKS];
+	enum { CACHE_LINE_SIZE = 64 };
 
-	volatile int curReadBlock;
-	volatile int curWriteBlock;
+	T *storage_;
+	u8 padStart_[CACHE_LINE_SIZE];
+	// Only written by the consumer.
+	volatile u32 head_;
+	u8 padHead_[CACHE_LINE_SIZE - sizeof(u32)];
+	// Only written by the producer.
+	volatile u32 tail_;
+	u8 padTail_[CACHE_LINE_SIZE - sizeof(u32)];
+
+	LockFreeRingBuffer(const LockFreeRingBuffer &other);
+	void operator =(const LockFreeRingBuffer &other);
 };
 
 #endif // _FIXED_SIZE_QUEUE_H_
@@ -93,6 +93,8 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 	general->Get("ScreenshotsAsPNG", &bScreenshotsAsPNG, false);
 	general->Get("StateSlot", &iCurrentStateSlot, 0);
 	general->Get("RewindFlipFrequency", &iRewindFlipFrequency, 0);
+	general->Get("RewindSnapshotLimit", &iRewindSnapshotLimit, 300);
+	general->Get("RewindMemoryBudget", &iRewindMemoryBudget, 64);
 	general->Get("GridView1", &bGridView1, true);
 	general->Get("GridView2", &bGridView2, true);
 	general->Get("GridView3", &bGridView3, false);
@@ -139,10 +141,11 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 	cpu->Get("Jit", &bJit, true);
 #endif
 	cpu->Get("SeparateCPUThread", &bSeparateCPUThread, false);
-	cpu->Get("AtomicAudioLocks", &bAtomicAudioLocks, false);
 
 	cpu->Get("SeparateIOThread", &bSeparateIOThread, true);
 	cpu->Get("FastMemoryAccess", &bFastMemory, true);
+	cpu->Get("FuncReplacements", &bFuncReplacements, true);
+	cpu->Get("DisabledFuncReplacements", vDisabledFuncReplacements);
 	cpu->Get("CPUSpeed", &iLockedCPUSpeed, 0);
 
 	IniFile::Section *graphics = iniFile.GetOrCreateSection("Graphics");
@@ -182,6 +185,7 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 		iAnisotropyLevel = 4;
 	}
 	graphics->Get("VertexCache", &bVertexCache, true);
+	graphics->Get("VertexCacheSampledHash", &bVertexCacheSampledHash, false);
 #ifdef IOS
 	graphics->Get("VertexDecJit", &bVertexDecoderJit, iosCanUseJit);
 #else
@@ -204,6 +208,8 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 	graphics->Get("TexScalingLevel", &iTexScalingLevel, 1);
 	graphics->Get("TexScalingType", &iTexScalingType, 0);
 	graphics->Get("TexDeposterize", &bTexDeposterize, false);
+	graphics->Get("TexScalingAsync", &bTexScalingAsync, false);
+	graphics->Get("TextureDiskCache", &bTextureDiskCache, false);
 	graphics->Get("VSyncInterval", &bVSync, false);
 	graphics->Get("DisableStencilTest", &bDisableStencilTest, false);
 	graphics->Get("AlwaysDepthWrite", &bAlwaysDepthWrite, false);
@@ -220,7 +226,10 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 	sound->Get("Enable", &bEnableSound, true);
 	sound->Get("VolumeBGM", &iBGMVolume, 7);
 	sound->Get("VolumeSFX", &iSFXVolume, 7);
-	sound->Get("LowLatency", &bLowLatencyAudio, false);
+	// Replaces the old LowLatency on/off setting.
+	bool lowLatencyAudio;
+	sound->Get("LowLatency", &lowLatencyAudio, false);
+	sound->Get("AudioLatency", &iAudioLatency, lowLatencyAudio ? 0 : 1);
 
 	IniFile::Section *control = iniFile.GetOrCreateSection("Control");
 	control->Get("HapticFeedback", &bHapticFeedback, true);
@@ -364,6 +373,7 @@ void Config::Load(const char *iniFileName, const char *controllerIniFilename) {
 
 	IniFile::Section *jitConfig = iniFile.GetOrCreateSection("JIT");
 	jitConfig->Get("DiscardRegsOnJRRA", &bDiscardRegsOnJRRA, false);
+	jitConfig->Get("BlockProfile", &bJitBlockProfile, false);
 
 	IniFile::Section *upgrade = iniFile.GetOrCreateSection("Upgrade");
 	upgrade->Get("UpgradeMessage", &upgradeMessage, "");
@@ -435,6 +445,8 @@ void Config::Save() {
 		general->Set("ScreenshotsAsPNG", bScreenshotsAsPNG);
 		general->Set("StateSlot", iCurrentStateSlot);
 		general->Set("RewindFlipFrequency", iRewindFlipFrequency);
+		general->Set("RewindSnapshotLimit", iRewindSnapshotLimit);
+		general->Set("RewindMemoryBudget", iRewindMemoryBudget);
 		general->Set("GridView1", bGridView1);
 		general->Set("GridView2", bGridView2);
 		general->Set("GridView3", bGridView3);
@@ -455,9 +467,10 @@ void Config::Save() {
 		IniFile::Section *cpu = iniFile.GetOrCreateSection("CPU");
 		cpu->Set("Jit", bJit);
 		cpu->Set("SeparateCPUThread", bSeparateCPUThread);
-		cpu->Set("AtomicAudioLocks", bAtomicAudioLocks);
 		cpu->Set("SeparateIOThread", bSeparateIOThread);
 		cpu->Set("FastMemoryAccess", bFastMemory);
+		cpu->Set("FuncReplacements", bFuncReplacements);
+		cpu->Set("DisabledFuncReplacements", vDisabledFuncReplacements);
 		cpu->Set("CPUSpeed", iLockedCPUSpeed);
 
 		IniFile::Section *graphics = iniFile.GetOrCreateSection("Graphics");
@@ -474,6 +487,7 @@ void Config::Save() {
 		graphics->Set("ForceMaxEmulatedFPS", iForceMaxEmulatedFPS);
 		graphics->Set("AnisotropyLevel", iAnisotropyLevel);
 		graphics->Set("VertexCache", bVertexCache);
+		graphics->Set("VertexCacheSampledHash", bVertexCacheSampledHash);
 #ifdef _WIN32
 		graphics->Set("FullScreen", bFullScreen);
 #endif
@@ -484,6 +498,8 @@ void Config::Save() {
 		graphics->Set("TexScalingLevel", iTexScalingLevel);
 		graphics->Set("TexScalingType", iTexScalingType);
 		graphics->Set("TexDeposterize", bTexDeposterize);
+		graphics->Set("TexScalingAsync", bTexScalingAsync);
+		graphics->Set("TextureDiskCache", bTextureDiskCache);
 		graphics->Set("VSyncInterval", bVSync);
 		graphics->Set("DisableStencilTest", bDisableStencilTest);
 		graphics->Set("AlwaysDepthWrite", bAlwaysDepthWrite);
@@ -495,7 +511,7 @@ void Config::Save() {
 		sound->Set("Enable", bEnableSound);
 		sound->Set("VolumeBGM", iBGMVolume);
 		sound->Set("VolumeSFX", iSFXVolume);
-		sound->Set("LowLatency", bLowLatencyAudio);
+		sound->Set("AudioLatency", iAudioLatency);
 
 		IniFile::Section *control = iniFile.GetOrCreateSection("Control");
 		control->Set("HapticFeedback", bHapticFeedback);
@@ -63,10 +63,12 @@ public:
 	bool bIgnoreBadMemAccess;
 	bool bFastMemory;
 	bool bJit;
+	// Native versions of memcpy etc, see ReplaceTables.cpp.
+	bool bFuncReplacements;
+	std::vector<std::string> vDisabledFuncReplacements;
 	// Definitely cannot be changed while game is running.
 	bool bSeparateCPUThread;
 	bool bSeparateIOThread;
-	bool bAtomicAudioLocks;
 	int iLockedCPUSpeed;
 	bool bAutoSaveSymbolMap;
 	std::string sReportHost;
@@ -93,6 +95,7 @@ public:
 	int iWindowHeight;
 
 	bool bVertexCache;
+	bool bVertexCacheSampledHash;
 	bool bVertexDecoderJit;
 	bool bFullScreen;
 	int iInternalResolution;  // 0 = Auto (native), 1 = 1x (480x272), 2 = 2x, 3 = 3x, 4 = 4x and so on.
@@ -102,11 +105,16 @@ public:
 	int iTexScalingLevel; // 1 = off, 2 = 2x, ..., 5 = 5x
 	int iTexScalingType; // 0 = xBRZ, 1 = Hybrid
 	bool bTexDeposterize;
+	bool bTexScalingAsync;
+	// Keep scaled textures on disk per game, so they needn't be decoded and scaled again.
+	bool bTextureDiskCache;
 	int iFpsLimit;
 	int iForceMaxEmulatedFPS;
 	int iMaxRecent;
 	int iCurrentStateSlot;
 	int iRewindFlipFrequency;
+	int iRewindSnapshotLimit;
+	int iRewindMemoryBudget; // MB
 	bool bEnableAutoLoad;
 	bool bEnableCheats;
 	bool bReloadCheats;
@@ -118,7 +126,8 @@ public:
 
 	// Sound
 	bool bEnableSound;
-	bool bLowLatencyAudio;
+	// 0 = low, 1 = medium, 2 = high. Lower means smaller output blocks and less queued sound.
+	int iAudioLatency;
 	int iSFXVolume;
 	int iBGMVolume;
 
@@ -215,6 +224,8 @@ public:
 
 	// Risky JIT optimizations
 	bool bDiscardRegsOnJRRA;
+	// Save the list of compiled blocks per game and precompile them at the next boot.
+	bool bJitBlockProfile;
 
 	// SystemParam
 	std::string sNickName;
@@ -17,6 +17,8 @@
 
 
 #include <vector>
+#include <map>
+#include <algorithm>
 #include <cstdio>
 
 #include "MsgHandler.h"
@@ -61,7 +63,171 @@ struct BaseEvent
 
 typedef LinkedListItem<BaseEvent> Event;
 
-Event *first;
+// The main queue is a binary min-heap on (time, order), so events due on the same tick
+// still fire in the order they were scheduled, exactly like the old sorted list did.
+// Every queued event is also indexed by (type, userdata), which makes unscheduling,
+// removal by type and IsScheduled O(log n) instead of a walk over the whole queue.
+class EventQueue
+{
+public:
+	EventQueue() : nextOrder_(0) {}
+
+	bool empty() const { return heap_.empty(); }
+	size_t size() const { return heap_.size(); }
+	const BaseEvent &top() const { return slots_[heap_[0]].ev; }
+
+	void push(const BaseEvent &ev) {
+		int slot;
+		if (freeSlots_.empty()) {
+			slot = (int)slots_.size();
+			slots_.push_back(QueuedEvent());
+		} else {
+			slot = freeSlots_.back();
+			freeSlots_.pop_back();
+		}
+		QueuedEvent &q = slots_[slot];
+		q.ev = ev;
+		q.order = nextOrder_++;
+		q.heapPos = (int)heap_.size();
+		q.indexIt = index_.insert(std::make_pair(EventKey(ev.type, ev.userdata), slot));
+		heap_.push_back(slot);
+		SiftUp(q.heapPos);
+	}
+
+	BaseEvent pop() {
+		BaseEvent ev = top();
+		RemoveSlot(heap_[0]);
+		return ev;
+	}
+
+	// Returns how many were removed, and the latest time among them in lastTime.
+	int remove(int type, u64 userdata, s64 *lastTime) {
+		int count = 0;
+		EventIndex::iterator it = index_.lower_bound(EventKey(type, userdata));
+		while (it != index_.end() && it->first.first == type && it->first.second == userdata) {
+			const int slot = (it++)->second;
+			if (count == 0 || slots_[slot].ev.time > *lastTime)
+				*lastTime = slots_[slot].ev.time;
+			RemoveSlot(slot);
+			++count;
+		}
+		return count;
+	}
+
+	void removeType(int type) {
+		EventIndex::iterator it = index_.lower_bound(EventKey(type, 0));
+		while (it != index_.end() && it->first.first == type)
+			RemoveSlot((it++)->second);
+	}
+
+	bool hasType(int type) const {
+		EventIndex::const_iterator it = index_.lower_bound(EventKey(type, 0));
+		return it != index_.end() && it->first.first == type;
+	}
+
+	void clear() {
+		heap_.clear();
+		slots_.clear();
+		freeSlots_.clear();
+		index_.clear();
+		nextOrder_ = 0;
+	}
+
+	// In firing order.
+	void GetSorted(std::vector<BaseEvent> &out) const {
+		std::vector<int> sorted = heap_;
+		std::sort(sorted.begin(), sorted.end(), Before(this));
+		out.clear();
+		out.reserve(sorted.size());
+		for (size_t i = 0; i < sorted.size(); ++i)
+			out.push_back(slots_[sorted[i]].ev);
+	}
+
+private:
+	typedef std::pair<int, u64> EventKey;
+	typedef std::multimap<EventKey, int> EventIndex;
+
+	struct QueuedEvent {
+		BaseEvent ev;
+		u64 order;
+		int heapPos;
+		EventIndex::iterator indexIt;
+	};
+
+	struct Before {
+		Before(const EventQueue *q) : q_(q) {}
+		bool operator ()(int a, int b) const {
+			return q_->Less(a, b);
+		}
+		const EventQueue *q_;
+	};
+
+	bool Less(int a, int b) const {
+		const QueuedEvent &qa = slots_[a], &qb = slots_[b];
+		if (qa.ev.time != qb.ev.time)
+			return qa.ev.time < qb.ev.time;
+		return qa.order < qb.order;
+	}
+
+	void Place(int pos, int slot) {
+		heap_[pos] = slot;
+		slots_[slot].heapPos = pos;
+	}
+
+	void SiftUp(int pos) {
+		const int slot = heap_[pos];
+		while (pos > 0) {
+			const int parent = (pos - 1) / 2;
+			if (!Less(slot, heap_[parent]))
+				break;
+			Place(pos, heap_[parent]);
+			pos = parent;
+		}
+		Place(pos, slot);
+	}
+
+	void SiftDown(int pos) {
+		const int slot = heap_[pos];
+		const int n = (int)heap_.size();
+		while (true) {
+			int child = pos * 2 + 1;
+			if (child >= n)
+				break;
+			if (child + 1 < n && Less(heap_[child + 1], heap_[child]))
+				++child;
+			if (!Less(heap_[child], slot))
+				break;
+			Place(pos, heap_[child]);
+			pos = child;
+		}
+		Place(pos, slot);
+	}
+
+	void RemoveSlot(int slot) {
+		QueuedEvent &q = slots_[slot];
+		const int pos = q.heapPos;
+		index_.erase(q.indexIt);
+		freeSlots_.push_back(slot);
+
+		const int last = heap_.back();
+		heap_.pop_back();
+		if (last == slot)
+			return;
+		Place(pos, last);
+		if (pos > 0 && Less(last, heap_[(pos - 1) / 2]))
+			SiftUp(pos);
+		else
+			SiftDown(pos);
+	}
+
+	std::vector<QueuedEvent> slots_;
+	std::vector<int> freeSlots_;
+	std::vector<int> heap_;
+	EventIndex index_;
+	u64 nextOrder_;
+};
+
+EventQueue eventQueue;
 Event *tsFirst;
 Event *tsLast;
 
@@ -182,7 +348,7 @@ void RestoreRegisterEvent(int event_type, const char *name, TimedCallback callba
 
 void UnregisterAllEvents()
 {
-	if (first)
+	if (!eventQueue.empty())
 		PanicAlert("Cannot unregister events with events pending");
 	event_types.clear();
 }
@@ -265,30 +431,7 @@ void ScheduleEvent_Threadsafe_Immediate(int event_type, u64 userdata)
 
 void ClearPendingEvents()
 {
-	while (first)
-	{
-		Event *e = first->next;
-		FreeEvent(first);
-		first = e;
-	}
-}
-
-void AddEventToQueue(Event* ne)
-{
-	Event* prev = NULL;
-	Event** pNext = &first;
-	for(;;)
-	{
-		Event*& next = *pNext;
-		if(!next || ne->time < next->time)
-		{
-			ne->next = next;
-			next = ne;
-			break;
-		}
-		prev = next;
-		pNext = &prev->next;
-	}
+	eventQueue.clear();
 }
 
 // This must be run ONLY from within the cpu thread
@@ -296,56 +439,20 @@ void AddEventToQueue(Event* ne)
 // than Advance 
 void ScheduleEvent(s64 cyclesIntoFuture, int event_type, u64 userdata)
 {
-	Event *ne = GetNewEvent();
-	ne->userdata = userdata;
-	ne->type = event_type;
-	ne->time = GetTicks() + cyclesIntoFuture;
-	AddEventToQueue(ne);
+	BaseEvent ne;
+	ne.userdata = userdata;
+	ne.type = event_type;
+	ne.time = GetTicks() + cyclesIntoFuture;
+	eventQueue.push(ne);
 }
 
 // Returns cycles left in timer.
 s64 UnscheduleEvent(int event_type, u64 userdata)
 {
-	s64 result = 0;
-	if (!first)
-		return result;
-	while(first)
-	{
-		if (first->type == event_type && first->userdata == userdata)
-		{
-			result = first->time - globalTimer;
-
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return result;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type && ptr->userdata == userdata)
-		{
-			result = ptr->time - globalTimer;
-
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
-
-	return result;
+	s64 lastTime = 0;
+	if (eventQueue.remove(event_type, userdata, &lastTime) == 0)
+		return 0;
+	return lastTime - globalTimer;
 }
 
 s64 UnscheduleThreadsafeEvent(int event_type, u64 userdata)
@@ -407,52 +514,12 @@ void RegisterAdvanceCallback(void (*callback)(int cyclesExecuted))
 
 bool IsScheduled(int event_type) 
 {
-	if (!first)
-		return false;
-	Event *e = first;
-	while (e) {
-		if (e->type == event_type)
-			return true;
-		e = e->next;
-	}
-	return false;
+	return eventQueue.hasType(event_type);
 }
 
 void RemoveEvent(int event_type)
 {
-	if (!first)
-		return;
-	while(first)
-	{
-		if (first->type == event_type)
-		{
-			Event *next = first->next;
-			FreeEvent(first);
-			first = next;
-		}
-		else
-		{
-			break;
-		}
-	}
-	if (!first)
-		return;
-	Event *prev = first;
-	Event *ptr = prev->next;
-	while (ptr)
-	{
-		if (ptr->type == event_type)
-		{
-			prev->next = ptr->next;
-			FreeEvent(ptr);
-			ptr = prev->next;
-		}
-		else
-		{
-			prev = ptr;
-			ptr = ptr->next;
-		}
-	}
+	eventQueue.removeType(event_type);
 }
 
 void RemoveThreadsafeEvent(int event_type)
@@ -509,16 +576,14 @@ void RemoveAllEvents(int event_type)
 //This raise only the events required while the fifo is processing data
 void ProcessFifoWaitEvents()
 {
-	while (first)
+	while (!eventQueue.empty())
 	{
-		if (first->time <= globalTimer)
+		if (eventQueue.top().time <= globalTimer)
 		{
 //			LOG(TIMER, "[Scheduler] %s		 (%lld, %lld) ", 
 //				first->name ? first->name : "?", (u64)globalTimer, (u64)first->time);
-			Event* evt = first;
-			first = first->next;
-			event_types[evt->type].callback(evt->userdata, (int)(globalTimer - evt->time));
-			FreeEvent(evt);
+			BaseEvent evt = eventQueue.pop();
+			event_types[evt.type].callback(evt.userdata, (int)(globalTimer - evt.time));
 		}
 		else
 		{
@@ -536,7 +601,8 @@ void MoveEvents()
 	while (tsFirst)
 	{
 		Event *next = tsFirst->next;
-		AddEventToQueue(tsFirst);
+		eventQueue.push(*tsFirst);
+		FreeEvent(tsFirst);
 		tsFirst = next;
 	}
 	tsLast = NULL;
@@ -572,7 +638,7 @@ void Advance()
 		MoveEvents();
 	ProcessFifoWaitEvents();
 
-	if (!first)
+	if (eventQueue.empty())
 	{
 		// WARN_LOG(TIMER, "WARNING - no events in queue. Setting currentMIPS->downcount to 10000");
 		currentMIPS->downcount += 10000;
@@ -580,7 +646,7 @@ void Advance()
 	}
 	else
 	{
-		slicelength = (int)(first->time - globalTimer);
+		slicelength = (int)(eventQueue.top().time - globalTimer);
 		if (slicelength > MAX_SLICE_LENGTH)
 			slicelength = MAX_SLICE_LENGTH;
 		currentMIPS->downcount = slicelength;
@@ -591,11 +657,11 @@ void Advance()
 
 void LogPendingEvents()
 {
-	Event *ptr = first;
-	while (ptr)
+	std::vector<BaseEvent> events;
+	eventQueue.GetSorted(events);
+	for (size_t i = 0; i < events.size(); ++i)
 	{
-		//INFO_LOG(TIMER, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, ptr->time, ptr->type);
-		ptr = ptr->next;
+		//INFO_LOG(TIMER, "PENDING: Now: %lld Pending: %lld Type: %d", globalTimer, events[i].time, events[i].type);
 	}
 }
 
@@ -605,10 +671,10 @@ void Idle(int maxIdle)
 	if (maxIdle != 0 && cyclesDown > maxIdle)
 		cyclesDown = maxIdle;
 
-	if (first && cyclesDown > 0)
+	if (!eventQueue.empty() && cyclesDown > 0)
 	{
 		int cyclesExecuted = slicelength - currentMIPS->downcount;
-		int cyclesNextEvent = (int) (first->time - globalTimer);
+		int cyclesNextEvent = (int) (eventQueue.top().time - globalTimer);
 
 		if (cyclesNextEvent < cyclesExecuted + cyclesDown)
 		{
@@ -629,11 +695,13 @@ void Idle(int maxIdle)
 
 std::string GetScheduledEventsSummary()
 {
-	Event *ptr = first;
+	std::vector<BaseEvent> events;
+	eventQueue.GetSorted(events);
 	std::string text = "Scheduled events\n";
 	text.reserve(1000);
-	while (ptr)
+	for (size_t i = 0; i < events.size(); ++i)
 	{
+		const BaseEvent *ptr = &events[i];
 		unsigned int t = ptr->type;
 		if (t >= event_types.size())
 			PanicAlert("Invalid event type"); // %i", t);
@@ -643,7 +711,6 @@ std::string GetScheduledEventsSummary()
 		char temp[512];
 		sprintf(temp, "%s : %i %08x%08x\n", name, (int)ptr->time, (u32)(ptr->userdata >> 32), (u32)(ptr->userdata));
 		text += temp;
-		ptr = ptr->next;
 	}
 	return text;
 }
@@ -666,7 +733,31 @@ void DoState(PointerWrap &p)
 	// These (should) be filled in later by the modules.
 	event_types.resize(n, EventType(AntiCrashCallback, "INVALID EVENT"));
 
+	// The format is still the sorted linked list the queue used to be.
+	Event *first = NULL;
+	if (p.mode != p.MODE_READ)
+	{
+		std::vector<BaseEvent> events;
+		eventQueue.GetSorted(events);
+		for (size_t i = events.size(); i > 0; --i)
+		{
+			Event *ev = GetNewEvent();
+			*(BaseEvent *)ev = events[i - 1];
+			ev->next = first;
+			first = ev;
+		}
+	}
 	p.DoLinkedList<BaseEvent, GetNewEvent, FreeEvent, Event_DoState>(first, (Event **) NULL);
+	if (p.mode == p.MODE_READ)
+		eventQueue.clear();
+	while (first)
+	{
+		if (p.mode == p.MODE_READ)
+			eventQueue.push(*first);
+		Event *next = first->next;
+		FreeEvent(first);
+		first = next;
+	}
 	p.DoLinkedList<BaseEvent, GetNewTsEvent, FreeTsEvent, Event_DoState>(tsFirst, &tsLast);
 
 	p.Do(CPU_HZ);
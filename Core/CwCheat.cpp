@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+
 #include "CwCheat.h"
 #include "../Core/CoreTiming.h"
 #include "../Core/CoreParameter.h"
@@ -12,6 +15,8 @@ std::string gameTitle;
 std::string activeCheatFile;
 static CWCheatEngine *cheatEngine;
 static bool cheatsEnabled;
+// Runs since the cheat file was last checked for changes.
+static int cheatFileCheckCounter;
 void hleCheat(u64 userdata, int cyclesLate);
 void trim2(std::string& str);
 
@@ -91,6 +96,12 @@ void hleCheat(u64 userdata, int cyclesLate) {
 	if (!cheatEngine || !cheatsEnabled)
 		return;
 	
+	// Codes are only parsed again when the file changes, checked about once a second.
+	if (++cheatFileCheckCounter >= 13) {
+		cheatFileCheckCounter = 0;
+		if (cheatEngine->HasCheatFileChanged())
+			g_Config.bReloadCheats = true;
+	}
 	if (g_Config.bReloadCheats) { //Checks if the "reload cheats" button has been pressed.
 		cheatEngine->CreateCodeList();
 		g_Config.bReloadCheats = false;
@@ -98,117 +109,273 @@ void hleCheat(u64 userdata, int cyclesLate) {
 	cheatEngine->Run();
 }
 
-CWCheatEngine::CWCheatEngine() {
+enum CheatOp {
+	CHEAT_WRITE,
+	CHEAT_ADD,
+	CHEAT_PATCH32,
+	CHEAT_PATCH,
+	CHEAT_MEMCPY,
+	CHEAT_POINTER,
+	CHEAT_OR,
+	CHEAT_AND,
+	CHEAT_XOR,
+	CHEAT_STOP_IF_NOT_EQUAL,
+	CHEAT_SKIP_UNLESS,
+};
+
+enum CheatCondition {
+	CHEAT_COND_EQUAL,
+	CHEAT_COND_NOT_EQUAL,
+	CHEAT_COND_LESS,
+	CHEAT_COND_GREATER,
+	// Anything else never passes.
+	CHEAT_COND_NEVER,
+};
+
+// Only for addresses that passed Memory::IsValidAddress.
+static inline u32 CheatRead(u32 addr, int size) {
+	switch (size) {
+	case 1: return *Memory::GetPointerUnchecked(addr);
+	case 2: return *(u16_le *)Memory::GetPointerUnchecked(addr);
+	default: return *(u32_le *)Memory::GetPointerUnchecked(addr);
+	}
+}
+
+static inline void CheatWrite(u32 addr, int size, u32 value) {
+	switch (size) {
+	case 1: *Memory::GetPointerUnchecked(addr) = (u8)value; break;
+	case 2: *(u16_le *)Memory::GetPointerUnchecked(addr) = (u16)value; break;
+	default: *(u32_le *)Memory::GetPointerUnchecked(addr) = value; break;
+	}
+}
+
+CWCheatEngine::CWCheatEngine() : fileTime(0), fileSize(0) {
 
 }
 
 void CWCheatEngine::Exit() {
-	exit2 = true;
+	operations.clear();
+	pointerLines.clear();
 }
-void CWCheatEngine::CreateCodeList() { //Creates code list to be used in function GetNextCode
-	initialCodesList = GetCodesList();
-	std::string currentcode, codename;
-	std::vector<std::string> codelist;
-	for (size_t i = 0; i < initialCodesList.size(); i ++) {
-		if (initialCodesList[i].substr(0,2) == "_S") {
+
+void CWCheatEngine::CreateCodeList() {
+	// Before reading, so that a change while reading isn't missed.
+	tm modif = File::GetModifTime(activeCheatFile);
+	fileTime = mktime(&modif);
+	fileSize = File::GetSize(activeCheatFile);
+	CreateCodeList(GetCodesList());
+}
+
+bool CWCheatEngine::HasCheatFileChanged() {
+	tm modif = File::GetModifTime(activeCheatFile);
+	return mktime(&modif) != fileTime || File::GetSize(activeCheatFile) != fileSize;
+}
+
+void CWCheatEngine::CreateCodeList(const std::vector<std::string> &cheatLines) {
+	bool cheatEnabled = false;
+	codeNameList.clear();
+	std::vector<u32> words;
+	for (size_t i = 0; i < cheatLines.size(); i ++) {
+		const std::string &line = cheatLines[i];
+		if (line.substr(0,2) == "_S") {
 			continue; //Line indicates Disc ID, not needed for cheats
 		}
-		if (initialCodesList[i].substr(0,2) == "_G") {
+		if (line.substr(0,2) == "_G") {
 			continue; //Line indicates game Title, also not needed for cheats
 		}
-		if (initialCodesList[i].substr(0,2) == "//") {
+		if (line.substr(0,2) == "//") {
 			continue; //Line indicates comment, also not needed for cheats.
 		}
-		if (initialCodesList[i].substr(0,3) == "_C1") {
-			cheatEnabled = true;
-			codename = initialCodesList[i];
-			codename.erase (codename.begin(), codename.begin()+4);
-			codeNameList.push_back(codename); //Import names for GUI, will be implemented later.
+		if (line.substr(0,3) == "_C1" || line.substr(0,3) == "_C0") {
+			cheatEnabled = line[2] == '1';
+			codeNameList.push_back(line.size() > 4 ? line.substr(4) : ""); //Import names for GUI, will be implemented later.
 			continue;
 		}
-		if (initialCodesList[i].substr(0,2) == "_L") {
-			if (cheatEnabled == true) {
-				currentcode = initialCodesList[i];
-				currentcode.erase(currentcode.begin(), currentcode.begin() + 3);
-				codelist.push_back(currentcode);
+		if (line.substr(0,2) == "_L" && cheatEnabled) {
+			std::istringstream iss(line.substr(2));
+			std::string each;
+			while (iss >> each) {
+				words.push_back((u32)parseHexLong(each));
 			}
-			continue;
-		}
-		if (initialCodesList[i].substr(0,3) == "_C0") {
-			cheatEnabled = false;
-			codename = initialCodesList[i];
-			codename.erase (codename.begin(), codename.begin()+4);
-			codeNameList.push_back(codename); //Import names for GUI, will be implemented later.
-			continue;
 		}
 	}
-	parts = makeCodeParts(codelist);
+	// An odd word out is an incomplete line, drop it.
+	words.resize(words.size() & ~1);
+	CompileCodes(words);
 }
-inline std::vector<std::string> makeCodeParts(std::vector<std::string> CodesList) { //Takes a single code line and creates a two-part vector for each code. Feeds to CreateCodeList
-	std::string currentcode;
-	std::vector<std::string> finalList;
-	char split_char = '\n';
-	char empty = ' ';
-	for (size_t i = 0; i < CodesList.size(); i++) {
-		currentcode = CodesList[i];
-		for (size_t j=0; j < currentcode.length(); j++) {
-			if (currentcode[j] == empty) {
-				currentcode[j] = '\n';
+
+// Decodes the (comm, arg) pairs of all enabled codes. Addresses that can't change between
+// runs are resolved and checked here, codes that could never do anything are dropped.
+void CWCheatEngine::CompileCodes(const std::vector<u32> &words) {
+	operations.clear();
+	pointerLines.clear();
+
+	const size_t numLines = words.size() / 2;
+	// First line of each operation, to turn line based skips into operation indices.
+	std::vector<size_t> opLines;
+	size_t line = 0;
+	while (line < numLines) {
+		const size_t first = line;
+		const u32 comm = words[line * 2];
+		const u32 arg = words[line * 2 + 1];
+		line++;
+		// The second line of two line codes, zero if missing.
+		u32 next[2] = {0, 0};
+
+		CheatOperation op;
+		memset(&op, 0, sizeof(op));
+		op.addr = GetAddress(comm & 0x0FFFFFFF);
+		op.value = arg;
+		bool direct = Memory::IsValidAddress(op.addr);
+		bool valid = false;
+
+		switch (comm >> 28) {
+		case 0x0: // 8-bit write.
+		case 0x1: // 16-bit write
+		case 0x2: // 32-bit write
+			op.op = CHEAT_WRITE;
+			op.size = 1 << (comm >> 28);
+			valid = direct;
+			break;
+
+		case 0x3: // Increment/Decrement
+			{
+				const int mode = (comm >> 20) & 0xF;
+				op.op = CHEAT_ADD;
+				op.addr = GetAddress(arg & 0x0FFFFFFF);
+				direct = Memory::IsValidAddress(op.addr);
+				valid = direct && mode >= 1 && mode <= 6;
+				if (mode == 5 || mode == 6) {
+					op.size = 4;
+					op.value = line < numLines ? words[line * 2] : 0;
+					line++;
+				} else {
+					op.size = mode <= 2 ? 1 : 2;
+					op.value = comm & (op.size == 1 ? 0xFF : 0xFFFF);
+				}
+				// Decrements are just negative increments.
+				if ((mode & 1) == 0)
+					op.value = 0 - op.value;
 			}
-		}
-		trim2(currentcode);
-		std::istringstream iss(currentcode);
-		std::string each;
-		while (std::getline(iss, each, split_char)) {
-			finalList.push_back(each);
-		}
-	}
-	return finalList;
-}
-std::vector<int> CWCheatEngine::GetNextCode() { // Feeds a size-2 vector of ints to Run() which contains the address and value of one cheat.
-	std::string code1;
-	std::string code2;
-	std::vector<std::string> splitCode;
-	std::vector<int> finalCode;
-	std::string modifier2 = "0";
-	while (true)  {
-		if (currentCode >= parts.size()) {
-			code1.clear();
-			code2.clear();
 			break;
-		}
-		code1 = parts[currentCode++];
-		trim2(code1);
-		code2 = parts[currentCode++];
-		trim2(code2);
-		splitCode.push_back(code1);
-		splitCode.push_back(code2);
-
-		int var1 = (int) parseHexLong(splitCode[0]);
-		int var2 = (int) parseHexLong(splitCode[1]);
-		finalCode.push_back(var1);
-		finalCode.push_back(var2);
-		if (splitCode[0].substr(0,1) == modifier2) {
+
+		case 0x4: // 32-bit patch code
+		case 0x8: // 8-bit and 16-bit patch code
+			if (line < numLines) {
+				next[0] = words[line * 2];
+				next[1] = words[line * 2 + 1];
+			}
+			line++;
+			op.op = (comm >> 28) == 0x4 ? CHEAT_PATCH32 : CHEAT_PATCH;
+			op.size = (comm >> 28) == 0x4 ? 4 : ((next[0] >> 16) == 0 ? 1 : 2);
+			op.data = next[0];
+			op.dataAdd = next[1];
+			op.count = (arg >> 16) & 0xFFFF;
+			valid = op.count != 0;
+			break;
+
+		case 0x5: // Memcpy command
+			if (line < numLines)
+				next[0] = words[line * 2];
+			line++;
+			op.op = CHEAT_MEMCPY;
+			op.data = GetAddress(next[0]);
+			valid = direct && Memory::IsValidAddress(op.data);
 			break;
-		}
-	}
-	return finalCode;
-}
 
-void CWCheatEngine::SkipCodes(int count) {
-	for (int i = 0; i < count; i ++) {
-		if (GetNextCode()[0] == 0) {
+		case 0x6: // Pointer commands
+			{
+				if (line < numLines) {
+					next[0] = words[line * 2];
+					next[1] = words[line * 2 + 1];
+				}
+				line++;
+				op.op = CHEAT_POINTER;
+				op.data = next[0];
+				op.dataAdd = next[1];
+				op.target = (u32)pointerLines.size();
+				// All but the last of count - 1 further steps have a line of their own.
+				const u32 steps = next[0] & 0xFFFF;
+				op.count = steps > 2 ? steps - 2 : 0;
+				for (u32 i = 0; i < op.count; ++i, ++line) {
+					pointerLines.push_back(line < numLines ? words[line * 2] : 0);
+					pointerLines.push_back(line < numLines ? words[line * 2 + 1] : 0);
+				}
+				valid = true;
+			}
+			break;
+
+		case 0x7: // Boolean commands.
+			valid = direct;
+			switch (arg >> 16) {
+			case 0x0000: op.op = CHEAT_OR; op.size = 1; break;
+			case 0x0002: op.op = CHEAT_AND; op.size = 1; break;
+			case 0x0004: op.op = CHEAT_XOR; op.size = 1; break;
+			case 0x0001: op.op = CHEAT_OR; op.size = 2; break;
+			case 0x0003: op.op = CHEAT_AND; op.size = 2; break;
+			case 0x0005: op.op = CHEAT_XOR; op.size = 2; break;
+			default: valid = false; break;
+			}
+			op.value = arg & (op.size == 1 ? 0xFF : 0xFFFF);
+			break;
+
+		case 0xB: // Time command (not sure what to do?)
+			break;
+
+		case 0xC: // Code stopper
+			op.op = CHEAT_STOP_IF_NOT_EQUAL;
+			op.size = 4;
+			valid = direct;
+			break;
+
+		case 0xD: // Test commands & Jocker codes ( Someone will have to help me with these)
+			break;
+
+		case 0xE: // Test commands, multiple skip
+			{
+				const bool is8Bit = (comm >> 24) == 0xE1;
+				op.op = CHEAT_SKIP_UNLESS;
+				op.size = is8Bit ? 1 : 2;
+				op.addr = GetAddress(arg & 0x0FFFFFFF);
+				direct = Memory::IsValidAddress(op.addr);
+				op.value = comm & (is8Bit ? 0xFF : 0xFFFF);
+				op.cond = (arg >> 28) < CHEAT_COND_NEVER ? (u8)(arg >> 28) : (u8)CHEAT_COND_NEVER;
+				valid = direct;
+
+				// Skipping stops early after a line starting with 0x00000000.
+				const u32 skip = (comm >> 16) & (is8Bit ? 0xFF : 0xFFF);
+				size_t skipTo = line;
+				for (u32 i = 0; i < skip && skipTo < numLines; ++i) {
+					if (words[skipTo++ * 2] == 0)
+						break;
+				}
+				// Resolved to an operation index below.
+				op.target = (u32)skipTo;
+			}
 			break;
 		}
+
+		if (valid) {
+			operations.push_back(op);
+			opLines.push_back(first);
+		}
 	}
-}
 
-void CWCheatEngine::SkipAllCodes() {
-	currentCode = codes.size();
+	// Skips that land on a continuation line or a dropped code go to the next operation.
+	std::vector<u32> lineToOp(numLines + 1, (u32)operations.size());
+	for (size_t i = operations.size(); i-- > 0; ) {
+		const size_t from = i == 0 ? 0 : opLines[i - 1] + 1;
+		for (size_t l = from; l <= opLines[i]; ++l)
+			lineToOp[l] = (u32)i;
+	}
+	for (size_t i = 0; i < operations.size(); ++i) {
+		if (operations[i].op == CHEAT_SKIP_UNLESS)
+			operations[i].target = lineToOp[std::min((size_t)operations[i].target, numLines)];
+	}
 }
 
-int CWCheatEngine::GetAddress(int value) { //Returns static address used by ppsspp. Some games may not like this, and causes cheats to not work without offset
-	int address = (value + 0x08800000) & 0x3FFFFFFF;
+u32 CWCheatEngine::GetAddress(u32 value) { //Returns static address used by ppsspp. Some games may not like this, and causes cheats to not work without offset
+	u32 address = (value + 0x08800000) & 0x3FFFFFFF;
 	if (gameTitle == "ULUS10563" || gameTitle == "ULJS-00351" || gameTitle == "NPJH50352" ) //Offset to make God Eater Burst codes work
 		address -= 0x7EF00;
 	return address;
@@ -245,318 +412,155 @@ std::vector<std::string> CWCheatEngine::GetCodesList() { //Reads the entire chea
 }
 
 void CWCheatEngine::Run() {
-	exit2 = false;
-	while (!exit2) {
-		currentCode = 0;
-
-		while (true) {
-			std::vector<int> code = GetNextCode();
-			if (code.size() < 2) {
-				Exit();
-				break;
-			}
+	size_t i = 0;
+	while (i < operations.size()) {
+		const CheatOperation &op = operations[i++];
+		switch (op.op) {
+		case CHEAT_WRITE:
+			CheatWrite(op.addr, op.size, op.value);
+			break;
 
-			int value;
-			unsigned int comm = code[0];
-			int arg = code[1];
-			int addr = GetAddress(comm & 0x0FFFFFFF);
+		case CHEAT_ADD:
+			CheatWrite(op.addr, op.size, CheatRead(op.addr, op.size) + op.value);
+			break;
 
-			switch (comm >> 28) {
-			case 0: // 8-bit write.
-				if (Memory::IsValidAddress(addr)){
-					Memory::Write_U8((u8) arg, addr);
-				}
-				break;
-			case 0x1: // 16-bit write
-				if (Memory::IsValidAddress(addr)){
-					Memory::Write_U16((u16) arg, addr);
+		case CHEAT_PATCH32:
+		case CHEAT_PATCH:
+			{
+				u32 addr = op.addr;
+				u32 data = op.data;
+				const u32 step = (op.value & 0xFFFF) * op.size;
+				for (u32 a = 0; a < op.count; a++) {
+					if (Memory::IsValidAddress(addr))
+						CheatWrite(addr, op.size, data);
+					addr += step;
+					data += op.dataAdd;
 				}
-				break;
-			case 0x2: // 32-bit write
-				if (Memory::IsValidAddress(addr)){
-					Memory::Write_U32((u32) arg, addr);
-				}
-				break;
-			case 0x3: // Increment/Decrement
-				{
-					addr = GetAddress(arg & 0x0FFFFFFF);
-					value = 0;
-					int increment = 0;
-					// Read value from memory
-					switch ((comm >> 20) & 0xF) {
-					case 1:
-					case 2: // 8-bit
-						value = Memory::Read_U8(addr);
-						increment = comm & 0xFF;
-						break;
-					case 3:
-					case 4: // 16-bit
-						value = Memory::Read_U16(addr);
-						increment = comm & 0xFFFF;
-						break;
-					case 5:
-					case 6: // 32-bit
-						value = Memory::Read_U32(addr);
-						code = GetNextCode();
-						if (code[0] != 0) {
-							increment = code[0];
-						}
-						break;
-					}
-					// Increment/Decrement value
-					switch ((comm >> 20) & 0xF) {
-					case 1:
-					case 3:
-					case 5: // increment
-						value += increment;
-						break;
-					case 2:
-					case 4:
-					case 6: // Decrement
-						value -= increment;
-						break;
-					}
-					// Write value back to memory
-					switch ((comm >> 20) & 0xF) {
-					case 1:
-					case 2: // 8-bit
-						Memory::Write_U8((u8) value, addr);
-						break;
-					case 3:
-					case 4: // 16-bit
-						Memory::Write_U16((u16) value, addr);
-						break;
-					case 5:
-					case 6: // 32-bit
-						Memory::Write_U32((u32) value, addr);
-						break;
-					}
-					break;
-				}
-			case 0x4: // 32-bit patch code
-				code = GetNextCode();
-				if (true) {
-					int data = code[0];
-					int dataAdd = code[1];
-
-					int maxAddr = (arg >> 16) & 0xFFFF;
-					int stepAddr = (arg & 0xFFFF) * 4;
-					for (int a  = 0; a < maxAddr; a++) {
-						if (Memory::IsValidAddress(addr)) {
-							Memory::Write_U32((u32) data, addr);
-						}
-						addr += stepAddr;
-						data += dataAdd;
-					}
-				}
-				break;
-			case 0x5: // Memcpy command
-				code = GetNextCode();
-				if (true) {
-					int destAddr = GetAddress(code[0]);
-					if (Memory::IsValidAddress(addr) && Memory::IsValidAddress(destAddr)) {
-						Memory::Memcpy(destAddr, Memory::GetPointer(addr), arg);
-					}
-				}
-				break;
-			case 0x6: // Pointer commands
-				code = GetNextCode();
-				if (true) {
-					int arg2 = code[0];
-					int offset = code[1];
-					int baseOffset = (arg2 >> 20) * 4;
-					int base = Memory::Read_U32(addr + baseOffset);
-					int count = arg2 & 0xFFFF;
-					int type = (arg2 >> 16) & 0xF;
-					for (int i = 1; i < count; i ++ ) {
-						if (i+1 < count) {
-							code = GetNextCode();
-							int arg3 = code[0];
-							int arg4 = code[1];
-							int comm3 = arg3 >> 28;
-							switch (comm3) {
-							case 0x1: // type copy byte
-								{
-									int srcAddr = Memory::Read_U32(addr) + offset;
-									int dstAddr = Memory::Read_U16(addr + baseOffset) + (arg3 & 0x0FFFFFFF);
-									Memory::Memcpy(dstAddr, Memory::GetPointer(srcAddr), arg);
-									type = -1; //Done
-									break; }
-							case 0x2:
-							case 0x3: // type pointer walk
-								{
-									int walkOffset = arg3 & 0x0FFFFFFF;
-									if (comm3 == 0x3) {
-										walkOffset = -walkOffset;
-									}
-									base = Memory::Read_U32(base + walkOffset);
-									int comm4 = arg4 >> 28;
-									switch (comm4) {
-									case 0x2:
-									case 0x3: // type pointer walk
-										walkOffset = arg4 & 0x0FFFFFFF;
-										if (comm4 == 0x3) {
-											walkOffset = -walkOffset;
-										}
-										base = Memory::Read_U32(base + walkOffset);
-										break;
-									}
-									break; }
-							case 0x9: // type multi address write
-								base += arg3 & 0x0FFFFFFF;
-								arg += arg4;
-								break;
-							default:
-								break;
-
-							}
-						}
-					}
+			}
+			break;
 
-					switch (type) {
-					case 0: // 8 bit write
-						Memory::Write_U8((u8) arg, base + offset);
-						break;
-					case 1: // 16-bit write
-						Memory::Write_U16((u16) arg, base + offset);
-						break;
-					case 2: // 32-bit write
-						Memory::Write_U32((u32) arg, base + offset);
-						break;
-					case 3: // 8 bit inverse write
-						Memory::Write_U8((u8) arg, base - offset);
-						break;
-					case 4: // 16-bit inverse write
-						Memory::Write_U16((u16) arg, base - offset);
-						break;
-					case 5: // 32-bit inverse write
-						Memory::Write_U32((u32) arg, base - offset);
-						break;
-					case -1: // Operation already performed, nothing to do
-						break;
-					}
-				}
-				break;
-			case 0x7: // Boolean commands.
-				switch (arg >> 16) {
-				case 0x0000: // 8-bit OR.
-					if (Memory::IsValidAddress(addr)) {
-						int val1 = (int) (arg & 0xFF);
-						int val2 = (int) Memory::Read_U8(addr);
-						Memory::Write_U8((u8) (val1 | val2), addr);
-					}
-					break;
-				case 0x0002: // 8-bit AND.
-					if (Memory::IsValidAddress(addr)) {
-						int val1 = (int) (arg & 0xFF);
-						int val2 = (int) Memory::Read_U8(addr);
-						Memory::Write_U8((u8) (val1 & val2), addr);
-					}
-					break;
-				case 0x0004: // 8-bit XOR.
-					if (Memory::IsValidAddress(addr)) {
-						int val1 = (int) (arg & 0xFF);
-						int val2 = (int) Memory::Read_U8(addr);
-						Memory::Write_U8((u8) (val1 ^ val2), addr);
-					}
+		case CHEAT_MEMCPY:
+			Memory::Memcpy(op.data, Memory::GetPointerUnchecked(op.addr), op.value);
+			break;
+
+		case CHEAT_POINTER:
+			RunPointerCode(op);
+			break;
+
+		case CHEAT_OR:
+			CheatWrite(op.addr, op.size, CheatRead(op.addr, op.size) | op.value);
+			break;
+
+		case CHEAT_AND:
+			CheatWrite(op.addr, op.size, CheatRead(op.addr, op.size) & op.value);
+			break;
+
+		case CHEAT_XOR:
+			CheatWrite(op.addr, op.size, CheatRead(op.addr, op.size) ^ op.value);
+			break;
+
+		case CHEAT_STOP_IF_NOT_EQUAL:
+			if (CheatRead(op.addr, 4) != op.value)
+				return;
+			break;
+
+		case CHEAT_SKIP_UNLESS:
+			{
+				const u32 memoryValue = CheatRead(op.addr, op.size);
+				bool executeNextLines = false;
+				switch (op.cond) {
+				case CHEAT_COND_EQUAL:
+					executeNextLines = memoryValue == op.value;
 					break;
-				case 0x0001: // 16-bit OR.
-					if (Memory::IsValidAddress(addr)) {
-						short val1 = (short) (arg & 0xFFFF);
-						short val2 = (short) Memory::Read_U16(addr);
-						Memory::Write_U16((u16) (val1 | val2), addr);
-					}
+				case CHEAT_COND_NOT_EQUAL:
+					executeNextLines = memoryValue != op.value;
 					break;
-				case 0x0003: // 16-bit AND.
-					if (Memory::IsValidAddress(addr)) {
-						short val1 = (short) (arg & 0xFFFF);
-						short val2 = (short) Memory::Read_U16(addr);
-						Memory::Write_U16((u16) (val1 & val2), addr);
-					}
+				case CHEAT_COND_LESS:
+					executeNextLines = memoryValue < op.value;
 					break;
-				case 0x0005: // 16-bit OR.
-					if (Memory::IsValidAddress(addr)) {
-						short val1 = (short) (arg & 0xFFFF);
-						short val2 = (short) Memory::Read_U16(addr);
-						Memory::Write_U16((u16) (val1 ^ val2), addr);
-					}
+				case CHEAT_COND_GREATER:
+					executeNextLines = memoryValue > op.value;
 					break;
 				}
-				break;
-			case 0x8: // 8-bit and 16-bit patch code
-				code = GetNextCode();
-				if (true) {
-					int data = code[0];
-					int dataAdd = code[1];
-
-					bool is8Bit = (data >> 16) == 0x0000;
-					int maxAddr = (arg >> 16) & 0xFFFF;
-					int stepAddr = (arg & 0xFFFF) * (is8Bit ? 1 : 2);
-					for (int a = 0; a < maxAddr; a++) {
-						if (Memory::IsValidAddress(addr)) {
-							if (is8Bit) {
-								Memory::Write_U8((u8) (data & 0xFF), addr);
-							}
-							else {
-								Memory::Write_U16((u16) (data & 0xFFFF), addr);
-							}
-						}
-						addr += stepAddr;
-						data += dataAdd;
-					}
-				}
-				break;
-			case 0xB: // Time command (not sure what to do?)
-				break;
-			case 0xC: // Code stopper
-				if (Memory::IsValidAddress(addr)) { 
-					value = Memory::Read_U32(addr);
-					if (value != arg) {
-						SkipAllCodes();
-					}
+				if (!executeNextLines)
+					i = op.target;
+			}
+			break;
+		}
+	}
+}
+
+// Pointer codes read their addresses from game memory, so they can't be resolved ahead.
+void CWCheatEngine::RunPointerCode(const CheatOperation &op) {
+	const u32 addr = op.addr;
+	u32 arg = op.value;
+	const u32 offset = op.dataAdd;
+	const u32 baseOffset = (op.data >> 20) * 4;
+	u32 base = Memory::Read_U32(addr + baseOffset);
+	int type = (op.data >> 16) & 0xF;
+
+	const u32 *lines = op.count != 0 ? &pointerLines[op.target] : NULL;
+	for (u32 i = 0; i < op.count; i++) {
+		const u32 arg3 = lines[i * 2];
+		const u32 arg4 = lines[i * 2 + 1];
+		const u32 comm3 = arg3 >> 28;
+		switch (comm3) {
+		case 0x1: // type copy byte
+			{
+				u32 srcAddr = Memory::Read_U32(addr) + offset;
+				u32 dstAddr = Memory::Read_U16(addr + baseOffset) + (arg3 & 0x0FFFFFFF);
+				Memory::Memcpy(dstAddr, Memory::GetPointer(srcAddr), arg);
+				type = -1; //Done
+				break; }
+		case 0x2:
+		case 0x3: // type pointer walk
+			{
+				u32 walkOffset = arg3 & 0x0FFFFFFF;
+				if (comm3 == 0x3) {
+					walkOffset = 0 - walkOffset;
 				}
-				break;
-			case 0xD: // Test commands & Jocker codes ( Someone will have to help me with these)
-				break;
-			case 0xE: // Test commands, multiple skip
-				{
-					bool is8Bit = (comm >> 24) == 0xE1;
-					addr = GetAddress(arg & 0x0FFFFFFF);
-					if (Memory::IsValidAddress(addr)) {
-						int memoryValue = is8Bit ? Memory::Read_U8(addr) : Memory::Read_U16(addr);
-						int testValue = comm & (is8Bit ? 0xFF : 0xFFFF);
-						bool executeNextLines = false;
-						switch ( arg >> 28) {
-						case 0x0: // Equal
-							executeNextLines = memoryValue == testValue;
-							break;
-						case 0x1: // Not Equal
-							executeNextLines = memoryValue != testValue;
-							break;
-						case 0x2: // Less Than
-							executeNextLines = memoryValue < testValue;
-							break;
-						case 0x3: // Greater Than
-							executeNextLines = memoryValue > testValue;
-							break;
-						}
-						if (!executeNextLines) {
-							int skip = (comm >> 16) & (is8Bit ? 0xFF : 0xFFF);
-							SkipCodes(skip);
-						}
+				base = Memory::Read_U32(base + walkOffset);
+				const u32 comm4 = arg4 >> 28;
+				switch (comm4) {
+				case 0x2:
+				case 0x3: // type pointer walk
+					walkOffset = arg4 & 0x0FFFFFFF;
+					if (comm4 == 0x3) {
+						walkOffset = 0 - walkOffset;
 					}
+					base = Memory::Read_U32(base + walkOffset);
 					break;
 				}
-			default:
-				{
-					break;
-				}
-			}
+				break; }
+		case 0x9: // type multi address write
+			base += arg3 & 0x0FFFFFFF;
+			arg += arg4;
+			break;
+		default:
+			break;
 		}
 	}
-	// exiting...
-	Exit();
-}
-
-
 
+	switch (type) {
+	case 0: // 8 bit write
+		Memory::Write_U8((u8) arg, base + offset);
+		break;
+	case 1: // 16-bit write
+		Memory::Write_U16((u16) arg, base + offset);
+		break;
+	case 2: // 32-bit write
+		Memory::Write_U32((u32) arg, base + offset);
+		break;
+	case 3: // 8 bit inverse write
+		Memory::Write_U8((u8) arg, base - offset);
+		break;
+	case 4: // 16-bit inverse write
+		Memory::Write_U16((u16) arg, base - offset);
+		break;
+	case 5: // 32-bit inverse write
+		Memory::Write_U32((u32) arg, base - offset);
+		break;
+	case -1: // Operation already performed, nothing to do
+		break;
+	}
+}
@@ -5,6 +5,7 @@
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <ctime>
 
 #include "base/basictypes.h"
 #include "Core/MemMap.h"
@@ -15,7 +16,25 @@ void __CheatInit();
 void __CheatShutdown();
 void __CheatDoState(PointerWrap &p);
 
-std::vector<std::string> makeCodeParts(std::vector<std::string> CodesList);
+// One cheat code, possibly spanning several lines, decoded by CreateCodeList() so that
+// Run() doesn't have to parse any text.
+struct CheatOperation {
+	u8 op;
+	// Read size, 1, 2 or 4, for tests and read-modify-write codes.
+	u8 size;
+	// Comparison for conditional codes.
+	u8 cond;
+	// Resolved and, except for patch and pointer codes, validated when compiled.
+	u32 addr;
+	u32 value;
+	// Second line of two line codes.
+	u32 data;
+	u32 dataAdd;
+	// Operation to continue at when a test fails, or the first pointerLines entry of a
+	// pointer code.
+	u32 target;
+	u32 count;
+};
 
 class CWCheatEngine {
 public:
@@ -24,18 +43,25 @@ public:
 	void AddCheatLine(std::string& line);
 	std::vector<std::string> GetCodesList();
 	void CreateCodeList();
+	// Compiles the code lines of a cheat file (as returned by GetCodesList.)
+	void CreateCodeList(const std::vector<std::string> &cheatLines);
+	// True if the cheat file was modified since the last CreateCodeList().
+	bool HasCheatFileChanged();
+	size_t GetOperationCount() const {
+		return operations.size();
+	}
 	void Exit();
 	void Run();
-	std::vector<int> GetNextCode();
-	
 
 private:
-	void SkipCodes(int count);
-	void SkipAllCodes();
-	bool cheatsOn, exit2, cheatEnabled;
-	int GetAddress(int value);
+	void CompileCodes(const std::vector<u32> &words);
+	void RunPointerCode(const CheatOperation &op);
+	u32 GetAddress(u32 value);
 	std::vector<std::string> codeNameList;
 
-	std::vector<std::string> codes, initialCodesList, parts;
-	size_t currentCode;
+	std::vector<CheatOperation> operations;
+	// Pairs of extra lines of pointer codes.
+	std::vector<u32> pointerLines;
+	time_t fileTime;
+	u64 fileSize;
 };
@@ -16,11 +16,20 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 
-#include "Common/FileUtil.h"
-#include "Core/FileSystems/BlockDevices.h"
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 
+#if !defined(_WIN32)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "base/timeutil.h"
+#include "thread/threadutil.h"
+#include "Common/FileUtil.h"
+#include "Core/FileSystems/BlockDevices.h"
+
 extern "C"
 {
 #include "zlib.h"
@@ -44,24 +53,76 @@ BlockDevice *constructBlockDevice(const char *filename) {
 		return new FileBlockDevice(f);
 }
 
+bool BlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr)
+{
+	bool success = true;
+	for (int i = 0; i < count; ++i)
+		success = ReadBlock(minBlock + i, outPtr + i * 2048) && success;
+	return success;
+}
+
 FileBlockDevice::FileBlockDevice(FILE *file)
-	: f(file)
+	: f(file), mapped(NULL)
 {
 	fseek(f,0,SEEK_END);
 	filesize = ftell(f);
 	fseek(f,0,SEEK_SET);
+
+#if !defined(_WIN32)
+	if (filesize != 0)
+	{
+		void *ptr = mmap(NULL, filesize, PROT_READ, MAP_SHARED, fileno(f), 0);
+		if (ptr != MAP_FAILED)
+			mapped = (u8 *)ptr;
+		else
+			WARN_LOG(LOADER, "Could not map ISO, reading through the file instead");
+	}
+#endif
 }
 
 FileBlockDevice::~FileBlockDevice()
 {
+#if !defined(_WIN32)
+	if (mapped)
+		munmap(mapped, filesize);
+#endif
 	fclose(f);
 }
 
 bool FileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr) 
 {
-	fseek(f, blockNumber * GetBlockSize(), SEEK_SET);
-	if(fread(outPtr, 1, 2048, f) != 2048)
-		DEBUG_LOG(LOADER, "Could not read 2048 bytes from block");
+	return ReadBlocks(blockNumber, 1, outPtr);
+}
+
+bool FileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr)
+{
+	const u64 offset = (u64)minBlock * GetBlockSize();
+	const size_t size = count * GetBlockSize();
+
+	if (mapped)
+	{
+		size_t avail = offset < filesize ? std::min(size, (size_t)(filesize - offset)) : 0;
+#if !defined(_WIN32)
+		// Bigger reads are usually streaming, let the kernel start fetching the whole range.
+		if (count > 1 && avail != 0)
+		{
+			const size_t pageMask = (size_t)sysconf(_SC_PAGESIZE) - 1;
+			const size_t start = (size_t)offset & ~pageMask;
+			madvise(mapped + start, (size_t)offset + avail - start, MADV_WILLNEED);
+		}
+#endif
+		memcpy(outPtr, mapped + offset, avail);
+		if (avail != size)
+		{
+			DEBUG_LOG(LOADER, "Could not read %d bytes from block", (int)size);
+			memset(outPtr + avail, 0, size - avail);
+		}
+		return true;
+	}
+
+	fseek(f, offset, SEEK_SET);
+	if (fread(outPtr, 1, size, f) != size)
+		DEBUG_LOG(LOADER, "Could not read %d bytes from block", (int)size);
 
 	return true;
 }
@@ -95,7 +156,8 @@ typedef struct ciso_header
 // TODO: Need much better error handling.
 
 CISOFileBlockDevice::CISOFileBlockDevice(FILE *file)
-	: f(file)
+	: f(file), cacheTick_(0), readAheadThread_(NULL), lastBlock_(0xFFFFFFFF), sequentialRun_(0),
+	  readAheadNext_(0), readAheadStart_(0), readAheadCount_(0), readAheadExit_(false), readAheadBusy_(false)
 {
 	// CISO format is EXTREMELY crappy and incomplete. All tools make broken CISO.
 
@@ -149,14 +211,58 @@ CISOFileBlockDevice::CISOFileBlockDevice(FILE *file)
 
 	delete[] indexTemp;
 #endif
+
+	z_ = new z_stream;
+	memset(z_, 0, sizeof(z_stream));
+	if (inflateInit2(z_, -15) != Z_OK)
+		ERROR_LOG(LOADER, "inflateInit ERROR : %s\n", (z_->msg) ? z_->msg : "???");
+
+	cacheBlock_.resize(CACHE_BLOCKS, 0xFFFFFFFF);
+	cacheUsed_.resize(CACHE_BLOCKS, 0);
+	cacheData_.resize(CACHE_BLOCKS * 2048);
+	memset(&stats_, 0, sizeof(stats_));
 }
 
 CISOFileBlockDevice::~CISOFileBlockDevice()
 {
+	if (readAheadThread_)
+	{
+		{
+			lock_guard guard(readAheadLock_);
+			readAheadExit_ = true;
+			readAheadCond_.notify_one();
+		}
+		readAheadThread_->join();
+		delete readAheadThread_;
+	}
+
+	if (stats_.reads != 0)
+	{
+		INFO_LOG(LOADER, "CSO: %lld reads, %lld cache hits, %lld blocks read ahead, inflated %0.1f MB/s",
+			stats_.reads, stats_.cacheHits, stats_.readAheadBlocks,
+			stats_.inflateSeconds > 0.0 ? stats_.bytesInflated / stats_.inflateSeconds / (1024.0 * 1024.0) : 0.0);
+	}
+
+	inflateEnd(z_);
+	delete z_;
 	fclose(f);
 	delete [] index;
 }
 
+void CISOFileBlockDevice::GetStats(Stats *stats)
+{
+	lock_guard guard(cacheLock_);
+	*stats = stats_;
+}
+
+void CISOFileBlockDevice::WaitForReadAhead()
+{
+	lock_guard guard(readAheadLock_);
+	// The thread stops taking work once it exits, so there's nothing to wait for then.
+	while (readAheadThread_ && !readAheadExit_ && (readAheadBusy_ || readAheadCount_ != 0))
+		readAheadIdleCond_.wait(readAheadLock_);
+}
+
 bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr) 
 {
 	if ((u32)blockNumber >= numBlocks)
@@ -165,61 +271,256 @@ bool CISOFileBlockDevice::ReadBlock(int blockNumber, u8 *outPtr)
 		return false;
 	}
 
-	u32 idx = index[blockNumber];
-	u32 idx2 = index[blockNumber+1];
-	u8 inbuffer[4096]; //too big
-	z_stream z;
+	RequestReadAhead(blockNumber, 1);
+	if (CopyFromCache(blockNumber, outPtr))
+		return true;
 
-	int plain = idx & 0x80000000;
+	{
+		lock_guard guard(inflateLock_);
+		if (!ReadAndInflate(z_, blockNumber, 1, compressed_, outPtr))
+			return false;
+	}
+	AddToCache(blockNumber, outPtr);
+	return true;
+}
 
-	idx = (idx & 0x7FFFFFFF) << indexShift;
-	idx2 = (idx2 & 0x7FFFFFFF) << indexShift;
+bool CISOFileBlockDevice::ReadBlocks(u32 minBlock, int count, u8 *outPtr)
+{
+	if (count <= 0)
+		return true;
+	if (minBlock >= numBlocks || (u32)count > numBlocks - minBlock)
+	{
+		// Read what exists, the rest reads as zeros like in ReadBlock().
+		const int valid = minBlock >= numBlocks ? 0 : (int)(numBlocks - minBlock);
+		memset(outPtr + valid * 2048, 0, (count - valid) * 2048);
+		if (valid != 0)
+			ReadBlocks(minBlock, valid, outPtr);
+		return false;
+	}
 
-	u32 compressedReadPos = idx;
-	u32 compressedReadSize = idx2 - idx;
+	RequestReadAhead(minBlock, count);
 
-	fseek(f, compressedReadPos, SEEK_SET);
-	u32 readSize = (u32)fread(inbuffer, 1, compressedReadSize, f);
+	// Take what we can from the cache, and inflate each run of misses in one go.
+	bool success = true;
+	u32 missStart = 0;
+	int missCount = 0;
+	for (int i = 0; i <= count; ++i)
+	{
+		const u32 blockNumber = minBlock + i;
+		if (i < count)
+		{
+			if (!CopyFromCache(blockNumber, outPtr + i * 2048))
+			{
+				if (missCount++ == 0)
+					missStart = blockNumber;
+				continue;
+			}
+		}
 
+		if (missCount != 0)
+		{
+			u8 *missPtr = outPtr + (missStart - minBlock) * 2048;
+			{
+				lock_guard guard(inflateLock_);
+				success = ReadAndInflate(z_, missStart, missCount, compressed_, missPtr) && success;
+			}
+			for (int j = 0; j < missCount; ++j)
+				AddToCache(missStart + j, missPtr + j * 2048);
+			missCount = 0;
+		}
+	}
+	return success;
+}
+
+// Reads the compressed data for a run of blocks in one go and inflates each into outPtr.
+bool CISOFileBlockDevice::ReadAndInflate(z_stream *z, u32 firstBlock, u32 count, std::vector<u8> &compressed, u8 *outPtr)
+{
+	const u32 start = (index[firstBlock] & 0x7FFFFFFF) << indexShift;
+	const u32 end = (index[firstBlock + count] & 0x7FFFFFFF) << indexShift;
+	if (end < start)
+	{
+		ERROR_LOG(LOADER, "block %d : bad index", firstBlock);
+		memset(outPtr, 0, 2048 * count);
+		return false;
+	}
+
+	if (compressed.size() < end - start)
+		compressed.resize(end - start);
+	u32 readSize;
+	{
+		lock_guard guard(fileLock_);
+		fseek(f, start, SEEK_SET);
+		readSize = (u32)fread(&compressed[0], 1, end - start, f);
+	}
+
+	double startTime = real_time_now();
+	bool success = true;
+	for (u32 i = 0; i < count; ++i)
+	{
+		const u32 blockNumber = firstBlock + i;
+		u32 blockStart = ((index[blockNumber] & 0x7FFFFFFF) << indexShift) - start;
+		u32 blockEnd = ((index[blockNumber + 1] & 0x7FFFFFFF) << indexShift) - start;
+		blockStart = std::min(blockStart, readSize);
+		blockEnd = std::max(blockStart, std::min(blockEnd, readSize));
+
+		const bool plain = (index[blockNumber] & 0x80000000) != 0;
+		success = InflateBlock(z, &compressed[0] + blockStart, blockEnd - blockStart, plain, blockNumber, outPtr + i * 2048) && success;
+	}
+
+	lock_guard guard(cacheLock_);
+	stats_.bytesInflated += 2048 * count;
+	stats_.inflateSeconds += real_time_now() - startTime;
+	return success;
+}
+
+bool CISOFileBlockDevice::InflateBlock(z_stream *z, const u8 *in, u32 inSize, bool plain, u32 blockNumber, u8 *outPtr)
+{
+	memset(outPtr, 0, 2048);
 	if (plain)
 	{
-		memset(outPtr, 0, 2048);
-		memcpy(outPtr, inbuffer, readSize);
+		memcpy(outPtr, in, std::min(inSize, (u32)2048));
+		return true;
 	}
-	else
+
+	inflateReset(z);
+	z->avail_in = inSize;
+	z->next_in = (Bytef *)in;
+	z->next_out = outPtr;
+	z->avail_out = blockSize;
+
+	int status = inflate(z, Z_FULL_FLUSH);
+	if (status != Z_STREAM_END)
 	{
-		memset(outPtr, 0, 2048);
-		z.zalloc = Z_NULL;
-		z.zfree = Z_NULL;
-		z.opaque = Z_NULL;
-		if(inflateInit2(&z, -15) != Z_OK)
-		{
-			ERROR_LOG(LOADER, "deflateInit ERROR : %s\n", (z.msg) ? z.msg : "???");
-			return false;
-		}
-		z.avail_in = readSize;
-		z.next_out = outPtr;
-		z.avail_out = blockSize;
-		z.next_in = inbuffer;
-
-		int status = inflate(&z, Z_FULL_FLUSH);
-		if(status != Z_STREAM_END)
-			//if (status != Z_OK)
+		ERROR_LOG(LOADER, "block %d:inflate : %s[%d]\n", blockNumber, (z->msg) ? z->msg : "error", status);
+		return false;
+	}
+	int cmp_size = blockSize - z->avail_out;
+	if (cmp_size != (int)blockSize)
+	{
+		ERROR_LOG(LOADER, "block %d : block size error %d != %d\n", blockNumber, cmp_size, blockSize);
+		return false;
+	}
+	return true;
+}
+
+bool CISOFileBlockDevice::CopyFromCache(u32 blockNumber, u8 *outPtr)
+{
+	lock_guard guard(cacheLock_);
+	++stats_.reads;
+	auto it = cacheIndex_.find(blockNumber);
+	if (it == cacheIndex_.end())
+		return false;
+
+	++stats_.cacheHits;
+	cacheUsed_[it->second] = ++cacheTick_;
+	memcpy(outPtr, &cacheData_[it->second * 2048], 2048);
+	return true;
+}
+
+void CISOFileBlockDevice::AddToCache(u32 blockNumber, const u8 *data)
+{
+	lock_guard guard(cacheLock_);
+	if (cacheIndex_.find(blockNumber) != cacheIndex_.end())
+		return;
+
+	// Evict the least recently used (or any empty) slot.
+	int slot = 0;
+	for (int i = 1; i < CACHE_BLOCKS; ++i)
+	{
+		if (cacheUsed_[i] < cacheUsed_[slot])
+			slot = i;
+	}
+	if (cacheBlock_[slot] != 0xFFFFFFFF)
+		cacheIndex_.erase(cacheBlock_[slot]);
+
+	cacheBlock_[slot] = blockNumber;
+	cacheUsed_[slot] = ++cacheTick_;
+	cacheIndex_[blockNumber] = slot;
+	memcpy(&cacheData_[slot * 2048], data, 2048);
+}
+
+// Called with each read of [firstBlock, firstBlock + count).
+void CISOFileBlockDevice::RequestReadAhead(u32 firstBlock, u32 count)
+{
+	lock_guard guard(readAheadLock_);
+	if (firstBlock == lastBlock_ + 1)
+		sequentialRun_ += count;
+	else if (firstBlock != lastBlock_)
+		sequentialRun_ = count - 1;
+	lastBlock_ = firstBlock + count - 1;
+	const u32 blockNumber = lastBlock_;
+
+	// After a seek back, start over from here rather than waiting to pass the old batch.
+	if (blockNumber + READAHEAD_BLOCKS < readAheadNext_)
+		readAheadNext_ = blockNumber + 1;
+
+	// Directory lookups and such hop around, only stream once it's clearly sequential.
+	// Ask for more when half of the last batch has been consumed.
+	if (sequentialRun_ < 4)
+		return;
+	if (blockNumber + READAHEAD_BLOCKS / 2 < readAheadNext_)
+		return;
+
+	const u32 start = std::max(blockNumber + 1, readAheadNext_);
+	if (start >= numBlocks)
+		return;
+	const u32 aheadCount = std::min((u32)READAHEAD_BLOCKS, numBlocks - start);
+	readAheadNext_ = start + aheadCount;
+
+	if (!readAheadThread_)
+		readAheadThread_ = new std::thread(std::bind(&CISOFileBlockDevice::ReadAheadFunc, this));
+	readAheadStart_ = start;
+	readAheadCount_ = aheadCount;
+	readAheadCond_.notify_one();
+}
+
+void CISOFileBlockDevice::ReadAheadFunc()
+{
+	setCurrentThreadName("CSOReadAhead");
+
+	z_stream z;
+	memset(&z, 0, sizeof(z));
+	if (inflateInit2(&z, -15) != Z_OK)
+	{
+		ERROR_LOG(LOADER, "inflateInit ERROR : %s\n", (z.msg) ? z.msg : "???");
+		lock_guard guard(readAheadLock_);
+		readAheadExit_ = true;
+		readAheadIdleCond_.notify_one();
+		return;
+	}
+
+	std::vector<u8> compressed;
+	std::vector<u8> decompressed(READAHEAD_BLOCKS * 2048);
+
+	lock_guard guard(readAheadLock_);
+	while (!readAheadExit_)
+	{
+		if (readAheadCount_ == 0)
 		{
-			ERROR_LOG(LOADER, "block %d:inflate : %s[%d]\n", blockNumber, (z.msg) ? z.msg : "error", status);
-			inflateEnd(&z);
-			return 1;
+			readAheadCond_.wait(readAheadLock_);
+			continue;
 		}
-		int cmp_size = blockSize - z.avail_out;
-		if (cmp_size != (int)blockSize)
+
+		const u32 start = readAheadStart_;
+		const u32 count = readAheadCount_;
+		readAheadCount_ = 0;
+		readAheadBusy_ = true;
+
+		readAheadLock_.unlock();
+		ReadAndInflate(&z, start, count, compressed, &decompressed[0]);
+		for (u32 i = 0; i < count; ++i)
+			AddToCache(start + i, &decompressed[i * 2048]);
 		{
-			ERROR_LOG(LOADER, "block %d : block size error %d != %d\n", blockNumber, cmp_size, blockSize);
-			inflateEnd(&z);
-			return false;
+			lock_guard cacheGuard(cacheLock_);
+			stats_.readAheadBlocks += count;
 		}
-		inflateEnd(&z);
+		readAheadLock_.lock();
+		readAheadBusy_ = false;
+		if (readAheadCount_ == 0)
+			readAheadIdleCond_.notify_one();
 	}
-	return true;
+
+	inflateEnd(&z);
 }
 
 
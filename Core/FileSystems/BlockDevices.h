@@ -18,11 +18,18 @@
 #pragma once
 
 // Abstractions around read-only blockdevices, such as PSP UMD discs.
-// CISOFileBlockDevice implements compressed iso images, CISO format.
+// CISOFileBlockDevice implements compressed iso images, CISO format. It caches
+// decompressed sectors and inflates ahead on a thread when reads are sequential.
 //
 // The ISOFileSystemReader reads from a BlockDevice, so it automatically works
 // with CISO images.
 
+#include <map>
+#include <vector>
+
+#include "base/mutex.h"
+#include "thread/thread.h"
+
 #include "../../Globals.h"
 #include "Core/ELF/PBPReader.h"
 
@@ -31,25 +38,90 @@ class BlockDevice
 public:
 	virtual ~BlockDevice() {}
 	virtual bool ReadBlock(int blockNumber, u8 *outPtr) = 0;
+	// Reads count consecutive blocks into outPtr. By default just loops over ReadBlock,
+	// devices that can do better (one seek, one copy) override it.
+	virtual bool ReadBlocks(u32 minBlock, int count, u8 *outPtr);
 	int GetBlockSize() const { return 2048;}  // forced, it cannot be changed by subclasses
 	virtual u32 GetNumBlocks() = 0;
 };
 
 
+struct z_stream_s;
+
 class CISOFileBlockDevice : public BlockDevice
 {
 public:
 	CISOFileBlockDevice(FILE *file);
 	~CISOFileBlockDevice();
 	bool ReadBlock(int blockNumber, u8 *outPtr);
+	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr);
 	u32 GetNumBlocks() { return numBlocks;}
 
+	struct Stats
+	{
+		u64 reads;
+		u64 cacheHits;
+		u64 readAheadBlocks;
+		u64 bytesInflated;
+		double inflateSeconds;
+	};
+	void GetStats(Stats *stats);
+	// Blocks until the read-ahead thread has finished everything requested so far.
+	void WaitForReadAhead();
+
 private:
+	enum {
+		// Decompressed sectors kept around, 1 MB worth.
+		CACHE_BLOCKS = 512,
+		// How far ahead to decompress once reads look sequential.
+		READAHEAD_BLOCKS = 32,
+	};
+
+	bool ReadAndInflate(z_stream_s *z, u32 firstBlock, u32 count, std::vector<u8> &compressed, u8 *outPtr);
+	bool InflateBlock(z_stream_s *z, const u8 *in, u32 inSize, bool plain, u32 blockNumber, u8 *outPtr);
+	bool CopyFromCache(u32 blockNumber, u8 *outPtr);
+	void AddToCache(u32 blockNumber, const u8 *data);
+	void RequestReadAhead(u32 firstBlock, u32 count);
+	void ReadAheadFunc();
+
 	FILE *f;
 	u32 *index;
 	int indexShift;
 	u32 blockSize;
 	u32 numBlocks;
+
+	// Reads on the caller's thread share this stream, reset between blocks rather than
+	// reallocated. Guarded by inflateLock_, since the emu and IO threads can both read.
+	// The read-ahead thread has its own.
+	z_stream_s *z_;
+	std::vector<u8> compressed_;
+	recursive_mutex inflateLock_;
+	// Guards f, since the read-ahead thread seeks it too.
+	recursive_mutex fileLock_;
+
+	// LRU by last use tick. Guarded by cacheLock_, along with stats_.
+	recursive_mutex cacheLock_;
+	std::map<u32, int> cacheIndex_;
+	std::vector<u32> cacheBlock_;
+	std::vector<u32> cacheUsed_;
+	std::vector<u8> cacheData_;
+	u32 cacheTick_;
+	Stats stats_;
+
+	// Started on the first sequential run. Guarded by readAheadLock_, along with the
+	// sequential read detection, since reads can come from any thread.
+	std::thread *readAheadThread_;
+	recursive_mutex readAheadLock_;
+	u32 lastBlock_;
+	int sequentialRun_;
+	u32 readAheadNext_;
+	condition_variable readAheadCond_;
+	u32 readAheadStart_;
+	u32 readAheadCount_;
+	bool readAheadExit_;
+	// Set while a batch is being inflated, signalled through readAheadIdleCond_ once nothing is left.
+	bool readAheadBusy_;
+	condition_variable readAheadIdleCond_;
 };
 
 
@@ -59,11 +131,15 @@ public:
 	FileBlockDevice(FILE *file);
 	~FileBlockDevice();
 	bool ReadBlock(int blockNumber, u8 *outPtr);
+	bool ReadBlocks(u32 minBlock, int count, u8 *outPtr);
 	u32 GetNumBlocks() {return (u32)(filesize / GetBlockSize());}
 
 private:
 	FILE *f;
 	size_t filesize;
+	// The whole image mapped read-only where possible, so reads are a plain memcpy.
+	// NULL if mapping failed or isn't supported, then we fall back to fread.
+	u8 *mapped;
 };
 
 
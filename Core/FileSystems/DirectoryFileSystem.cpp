@@ -31,55 +31,219 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <ctype.h>
+#include <time.h>
 #endif
 
 #if HOST_IS_CASE_SENSITIVE
-static bool FixFilenameCase(const std::string &path, std::string &filename)
+#include "base/mutex.h"
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/inotify.h>
+#endif
+#endif
+
+#if HOST_IS_CASE_SENSITIVE
+struct PathCaseDir {
+	// Case folded name -> name on disk. Empty if several names fold the same way.
+	std::map<std::string, std::string> names;
+	time_t mtime;
+	time_t scanTime;
+	int watch;
+};
+
+enum {
+	// Beyond these, listings are all dropped / directories are checked by mtime instead.
+	MAX_CACHED_DIRS = 1024,
+	MAX_WATCHED_DIRS = 256,
+};
+
+typedef std::map<std::string, PathCaseDir> PathCaseDirMap;
+
+static recursive_mutex pathCaseLock;
+// Keyed by the directory path with a trailing slash, as FixPathCase builds it.
+static PathCaseDirMap pathCaseDirs;
+static PathCaseCacheStats pathCaseStats;
+
+#if defined(__linux__)
+static int inotifyFd = -2;
+static std::map<int, std::string> watchedDirs;
+#endif
+
+static void FoldCase(std::string &name)
 {
-	// Are we lucky?
-	if (File::Exists(path + filename))
-		return true;
+	for (size_t i = 0; i < name.size(); i++)
+		name[i] = tolower(name[i]);
+}
+
+static void ForgetPathCaseDir(const std::string &dirPath)
+{
+	PathCaseDirMap::iterator it = pathCaseDirs.find(dirPath);
+	// Any inotify watch stays, a rescan gets the same descriptor back.
+	if (it != pathCaseDirs.end())
+		pathCaseDirs.erase(it);
+}
+
+#if defined(__linux__)
+static void WatchPathCaseDir(const std::string &dirPath, PathCaseDir &dir)
+{
+	dir.watch = -1;
+	if (inotifyFd == -2)
+		inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotifyFd < 0 || watchedDirs.size() >= MAX_WATCHED_DIRS)
+		return;
+
+	dir.watch = inotify_add_watch(inotifyFd, dirPath.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR);
+	if (dir.watch >= 0)
+		watchedDirs[dir.watch] = dirPath;
+}
+
+// Drops the listings of every watched directory that changed since the last call.
+static void ReadPathCaseEvents()
+{
+	if (inotifyFd < 0)
+		return;
 
-	size_t filenameSize = filename.size();  // size in bytes, not characters
-	for (size_t i = 0; i < filenameSize; i++)
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	while ((len = read(inotifyFd, buffer, sizeof(buffer))) > 0)
 	{
-		filename[i] = tolower(filename[i]);
+		for (char *ptr = buffer; ptr < buffer + len; )
+		{
+			const struct inotify_event *event = (const struct inotify_event *)ptr;
+			std::map<int, std::string>::iterator it = watchedDirs.find(event->wd);
+			if (it != watchedDirs.end())
+			{
+				ForgetPathCaseDir(it->second);
+				if (event->mask & IN_IGNORED)
+					watchedDirs.erase(it);
+			}
+			ptr += sizeof(struct inotify_event) + event->len;
+		}
 	}
+}
+#endif
 
-	//TODO: lookup filename in cache for "path"
-
+// Lists path into the cache. Returns NULL if it can't be opened.
+static PathCaseDir *ScanPathCaseDir(const std::string &path)
+{
 	struct dirent_large { struct dirent entry; char padding[FILENAME_MAX+1]; } diren;
-	struct dirent_large;
 	struct dirent *result = NULL;
 
 	DIR *dirp = opendir(path.c_str());
 	if (!dirp)
-		return false;
-
-	bool retValue = false;
+		return NULL;
+
+	if (pathCaseDirs.size() >= MAX_CACHED_DIRS)
+		pathCaseDirs.clear();
+
+	PathCaseDir &dir = pathCaseDirs[path];
+	dir.names.clear();
+	dir.scanTime = time(NULL);
+	struct stat st;
+	dir.mtime = fstat(dirfd(dirp), &st) == 0 ? st.st_mtime : 0;
+#if defined(__linux__)
+	WatchPathCaseDir(path, dir);
+#else
+	dir.watch = -1;
+#endif
 
 	while (!readdir_r(dirp, (dirent*) &diren, &result) && result)
 	{
-		if (strlen(result->d_name) != filenameSize)
-			continue;
+		std::string folded = result->d_name;
+		FoldCase(folded);
+		std::map<std::string, std::string>::iterator it = dir.names.find(folded);
+		if (it == dir.names.end())
+			dir.names[folded] = result->d_name;
+		else
+			it->second.clear();
+	}
+
+	closedir(dirp);
+	pathCaseStats.dirScans++;
+	return &dir;
+}
+
+// True if a cached miss can't be trusted, because the directory may have changed since.
+static bool PathCaseDirMayBeStale(const std::string &path, const PathCaseDir &dir)
+{
+	if (dir.watch >= 0)
+		return false;
+
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0)
+		return true;
+	// Timestamps may only have second resolution, so a change in the same second as the scan can hide.
+	return st.st_mtime != dir.mtime || st.st_mtime >= dir.scanTime;
+}
+
+static bool FixFilenameCase(const std::string &path, std::string &filename)
+{
+	lock_guard guard(pathCaseLock);
+
+	std::string folded = filename;
+	FoldCase(folded);
 
-		size_t i;
-		for (i = 0; i < filenameSize; i++)
+	PathCaseDir *dir = NULL;
+	PathCaseDirMap::iterator it = pathCaseDirs.find(path);
+	if (it != pathCaseDirs.end())
+	{
+		dir = &it->second;
+		std::map<std::string, std::string>::const_iterator name = dir->names.find(folded);
+		if (name != dir->names.end() && !name->second.empty())
 		{
-			if (filename[i] != tolower(result->d_name[i]))
-				break;
+			pathCaseStats.hits++;
+			pathCaseStats.syscallsAvoided += name->second == filename ? 1 : 4;
+			filename = name->second;
+			return true;
 		}
+		if (name == dir->names.end() && !PathCaseDirMayBeStale(path, *dir))
+		{
+			pathCaseStats.hits++;
+			pathCaseStats.syscallsAvoided += 4;
+			return false;
+		}
+	}
 
-		if (i < filenameSize)
-			continue;
-
-		filename = result->d_name;
-		retValue = true;
+	pathCaseStats.misses++;
+	dir = ScanPathCaseDir(path);
+	if (dir)
+	{
+		std::map<std::string, std::string>::const_iterator name = dir->names.find(folded);
+		if (name == dir->names.end())
+			return false;
+		if (!name->second.empty())
+		{
+			filename = name->second;
+			return true;
+		}
 	}
 
-	closedir(dirp);
+	// Can't list it, or several names match. Only an exact match will do then.
+	return File::Exists(path + filename);
+}
 
-	return retValue;
+void GetPathCaseCacheStats(PathCaseCacheStats *stats)
+{
+	lock_guard guard(pathCaseLock);
+	*stats = pathCaseStats;
+}
+
+void ForgetPathCase(const std::string &fullPath)
+{
+	lock_guard guard(pathCaseLock);
+
+	size_t end = fullPath.find_last_not_of('/');
+	if (end == fullPath.npos)
+		return;
+	const std::string path = fullPath.substr(0, end + 1) + "/";
+
+	// The directory it's in, and anything under it if it was a directory.
+	const size_t parentEnd = fullPath.find_last_of('/', end);
+	if (parentEnd != fullPath.npos)
+		ForgetPathCaseDir(fullPath.substr(0, parentEnd + 1));
+	PathCaseDirMap::iterator it = pathCaseDirs.lower_bound(path);
+	while (it != pathCaseDirs.end() && it->first.compare(0, path.size(), path) == 0)
+		pathCaseDirs.erase(it++);
 }
 
 bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior)
@@ -101,6 +265,13 @@ bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior b
 	fullPath.reserve(basePath.size() + len + 1);
 	fullPath.append(basePath); 
 
+#if defined(__linux__)
+	{
+		lock_guard guard(pathCaseLock);
+		ReadPathCaseEvents();
+	}
+#endif
+
 	size_t start = 0;
 	while (start < len)
 	{
@@ -220,6 +391,9 @@ bool DirectoryFileHandle::Open(std::string& basePath, std::string& fileName, Fil
 #endif
 
 #if HOST_IS_CASE_SENSITIVE
+	if (success && (access & (FILEACCESS_APPEND|FILEACCESS_CREATE|FILEACCESS_WRITE)))
+		ForgetPathCase(fullName);
+
 	if (!success &&
 	    !(access & FILEACCESS_APPEND) &&
 	    !(access & FILEACCESS_CREATE) &&
@@ -311,6 +485,13 @@ DirectoryFileSystem::~DirectoryFileSystem() {
 	for (auto iter = entries.begin(); iter != entries.end(); ++iter) {
 		iter->second.hFile.Close();
 	}
+
+#if HOST_IS_CASE_SENSITIVE
+	PathCaseCacheStats stats;
+	GetPathCaseCacheStats(&stats);
+	INFO_LOG(FILESYS, "Path case cache: %llu hits, %llu misses, %llu directory scans, about %llu syscalls avoided",
+		(unsigned long long)stats.hits, (unsigned long long)stats.misses, (unsigned long long)stats.dirScans, (unsigned long long)stats.syscallsAvoided);
+#endif
 }
 
 std::string DirectoryFileSystem::GetLocalPath(std::string localpath) {
@@ -338,7 +519,20 @@ bool DirectoryFileSystem::MkDir(const std::string &dirname) {
 	if ( ! FixPathCase(basePath,fixedCase, FPC_PARTIAL_ALLOWED) )
 		return false;
 
-	return File::CreateFullPath(GetLocalPath(fixedCase));
+	// Every missing level gets created, so forget from the first one we didn't have.
+	std::string fullPath = GetLocalPath(fixedCase);
+	for (size_t pos = basePath.size(); pos < fullPath.size(); ++pos)
+	{
+		pos = fullPath.find('/', pos);
+		if (pos == fullPath.npos)
+			pos = fullPath.size();
+		if (!File::Exists(fullPath.substr(0, pos)))
+		{
+			ForgetPathCase(fullPath.substr(0, pos));
+			break;
+		}
+	}
+	return File::CreateFullPath(fullPath);
 #else
 	return File::CreateFullPath(GetLocalPath(dirname));
 #endif
@@ -350,7 +544,10 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 #if HOST_IS_CASE_SENSITIVE
 	// Maybe we're lucky?
 	if (File::DeleteDirRecursively(fullName))
+	{
+		ForgetPathCase(fullName);
 		return true;
+	}
 
 	// Nope, fix case and try again
 	fullName = dirname;
@@ -365,7 +562,11 @@ bool DirectoryFileSystem::RmDir(const std::string &dirname) {
 #else
 	return 0 == rmdir(fullName.c_str());
 #endif*/
-	return File::DeleteDirRecursively(fullName);
+	bool retValue = File::DeleteDirRecursively(fullName);
+#if HOST_IS_CASE_SENSITIVE
+	ForgetPathCase(fullName);
+#endif
+	return retValue;
 }
 
 int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &to) {
@@ -423,6 +624,14 @@ int DirectoryFileSystem::RenameFile(const std::string &from, const std::string &
 	}
 #endif
 
+#if HOST_IS_CASE_SENSITIVE
+	if (retValue)
+	{
+		ForgetPathCase(fullFrom);
+		ForgetPathCase(fullTo);
+	}
+#endif
+
 	// TODO: Better error codes.
 	return retValue ? 0 : (int)SCE_KERNEL_ERROR_ERRNO_FILE_ALREADY_EXISTS;
 }
@@ -452,6 +661,11 @@ bool DirectoryFileSystem::RemoveFile(const std::string &filename) {
 	}
 #endif
 
+#if HOST_IS_CASE_SENSITIVE
+	if (retValue)
+		ForgetPathCase(fullName);
+#endif
+
 	return retValue;
 }
 
@@ -55,6 +55,22 @@ enum FixPathCaseBehavior {
 };
 
 bool FixPathCase(std::string& basePath, std::string &path, FixPathCaseBehavior behavior);
+
+// FixPathCase keeps the case folded names of each host directory it has listed, so that only
+// the first lookup in a directory costs a scan. Listings are dropped when we change the
+// directory ourselves, when inotify says it changed (Linux), or rescanned on a miss once the
+// directory's mtime has moved.
+struct PathCaseCacheStats {
+	u64 hits;
+	u64 misses;
+	u64 dirScans;
+	// Roughly: the stat() per component, plus opendir/readdir/closedir when the case was wrong.
+	u64 syscallsAvoided;
+};
+
+void GetPathCaseCacheStats(PathCaseCacheStats *stats);
+// Call after creating, removing or renaming fullPath (a host path) behind FixPathCase's back.
+void ForgetPathCase(const std::string &fullPath);
 #endif
 
 struct DirectoryFileHandle
@@ -26,6 +26,14 @@
 
 const int sectorSize = 2048;
 
+// FNV-1a, case folded. Paths on the disc are matched case insensitively.
+static const u32 PATH_HASH_BASIS = 2166136261U;
+
+static inline u32 HashPathChar(u32 hash, char c)
+{
+	return (hash ^ (u8)tolower(c)) * 16777619U;
+}
+
 bool parseLBN(std::string filename, u32 *sectorStart, u32 *readSize)
 {
 	// The format of this is: "/sce_lbn" "0x"? HEX* ANY* "_size" "0x"? HEX* ANY*
@@ -197,8 +205,12 @@ ISOFileSystem::ISOFileSystem(IHandleAllocator *_hAlloc, BlockDevice *_blockDevic
 	treeroot->startingPosition = 0;
 	treeroot->size = 0;
 	treeroot->flags = 0;
+	treeroot->pathHash = PATH_HASH_BASIS;
 	treeroot->parent = NULL;
 
+	pathIndex.resize(1024, NULL);
+	pathIndexCount = 0;
+
 	if (memcmp(desc.cd001, "CD001", 5)) {
 		ERROR_LOG(FILESYS, "ISO looks bogus? Giving up...");
 		return;
@@ -267,6 +279,10 @@ void ISOFileSystem::ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root,
 			e->flags = dir.flags;
 			e->parent = root;
 
+			e->pathHash = root == treeroot ? root->pathHash : HashPathChar(root->pathHash, '/');
+			for (size_t i = 0; i < e->name.size(); ++i)
+				e->pathHash = HashPathChar(e->pathHash, e->name[i]);
+
 			// Let's not excessively spam the log - I commented this line out.
 			//DEBUG_LOG(FILESYS, "%s: %s %08x %08x %i", e->isDirectory?"D":"F", e->name.c_str(), dir.firstDataSectorLE, e->startingPosition, e->startingPosition);
 
@@ -289,6 +305,7 @@ void ISOFileSystem::ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root,
 				}
 			}
 			root->children.push_back(e);
+			AddToPathIndex(e);
 		}
 	}
 }
@@ -310,58 +327,107 @@ ISOFileSystem::TreeEntry *ISOFileSystem::GetFromPath(std::string path, bool catc
 	if (path == "umd0")
 		return &entireISO;
 
-	TreeEntry *e = treeroot;
 	if (path.length() == 0)
-		return e;
+		return treeroot;
 
-	while (true)
+	TreeEntry *e = FindInPathIndex(path);
+	if (!e && catchError)
 	{
-		TreeEntry *ne = 0;
-		std::string name = "";
-		if (path.length()>0)
-		{
-			for (size_t i=0; i<e->children.size(); i++)
-			{
-				std::string n = (e->children[i]->name);
-				for (size_t j = 0; j < n.size(); j++) {
-					n[j] = tolower(n[j]);
-				}
-				std::string curPath = path.substr(0, path.find_first_of('/'));
-				for (size_t j = 0; j < curPath.size(); j++) {
-					curPath[j] = tolower(curPath[j]);
-				}
+		ERROR_LOG(FILESYS,"File %s not found", path.c_str());
+	}
+	return e;
+}
 
-				if (curPath == n)
-				{
-					//yay we got it
-					ne = e->children[i];
-					name = n;
-					break;
-				}
-			}
+void ISOFileSystem::AddToPathIndex(TreeEntry *e)
+{
+	if ((pathIndexCount + 1) * 2 > pathIndex.size())
+	{
+		std::vector<TreeEntry *> old;
+		old.swap(pathIndex);
+		pathIndex.resize(old.size() * 2, NULL);
+		pathIndexCount = 0;
+		for (size_t i = 0; i < old.size(); ++i)
+		{
+			if (old[i])
+				AddToPathIndex(old[i]);
 		}
-		if (ne)
+	}
+
+	const size_t mask = pathIndex.size() - 1;
+	std::string fullPath;
+	for (size_t slot = e->pathHash & mask; ; slot = (slot + 1) & mask)
+	{
+		TreeEntry *other = pathIndex[slot];
+		if (!other)
 		{
-			e = ne;
-			size_t l = name.length();
-			path.erase(0, l);
-			if (path.length() == 0 || (path.length()==1 && path[0] == '/'))
-				return e;
-			path.erase(0, 1);
-			while (path[0] == '/')
-				path.erase(0, 1);
+			pathIndex[slot] = e;
+			++pathIndexCount;
+			return;
 		}
-		else
+
+		// Only the first entry with a given path can be found, like a directory scan would.
+		if (other->pathHash == e->pathHash)
 		{
-			if (catchError)
-			{
-				ERROR_LOG(FILESYS,"File %s not found", path.c_str());
-			}
-			return 0;
+			if (fullPath.empty())
+				fullPath = EntryFullPath(e);
+			if (EntryMatchesPath(other, fullPath))
+				return;
 		}
 	}
 }
 
+ISOFileSystem::TreeEntry *ISOFileSystem::FindInPathIndex(const std::string &path)
+{
+	u32 hash = PATH_HASH_BASIS;
+	size_t pos = 0;
+	while (pos < path.size())
+	{
+		size_t end = path.find('/', pos);
+		if (end == path.npos)
+			end = path.size();
+		// An empty name doesn't match anything.
+		if (end == pos)
+			return NULL;
+
+		if (pos != 0)
+			hash = HashPathChar(hash, '/');
+		for (size_t i = pos; i < end; ++i)
+			hash = HashPathChar(hash, path[i]);
+
+		pos = path.find_first_not_of('/', end);
+	}
+
+	const size_t mask = pathIndex.size() - 1;
+	for (size_t slot = hash & mask; pathIndex[slot] != NULL; slot = (slot + 1) & mask)
+	{
+		TreeEntry *e = pathIndex[slot];
+		if (e->pathHash == hash && EntryMatchesPath(e, path))
+			return e;
+	}
+	return NULL;
+}
+
+// Compares names from the end of the path up through the parents, ignoring case and extra slashes.
+bool ISOFileSystem::EntryMatchesPath(const TreeEntry *e, const std::string &path)
+{
+	size_t end = path.find_last_not_of('/');
+	while (e != NULL && e != treeroot)
+	{
+		if (end == path.npos)
+			return false;
+
+		size_t start = path.find_last_of('/', end);
+		start = start == path.npos ? 0 : start + 1;
+		const size_t len = end + 1 - start;
+		if (len != e->name.size() || strncasecmp(path.c_str() + start, e->name.c_str(), len) != 0)
+			return false;
+
+		e = e->parent;
+		end = start == 0 ? path.npos : path.find_last_not_of('/', start - 1);
+	}
+	return e == treeroot && end == path.npos;
+}
+
 u32 ISOFileSystem::OpenFile(std::string filename, FileAccess access, const char *devicename)
 {
 	// LBN unittest
@@ -462,11 +528,8 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 		if (e.isBlockSectorMode)
 		{
 			// Whole sectors! Shortcut to this simple code.
-			for (int i = 0; i < size; i++)
-			{
-				blockDevice->ReadBlock(e.seekPos, pointer + i * 2048);
-				e.seekPos++;
-			}
+			blockDevice->ReadBlocks(e.seekPos, (int)size, pointer);
+			e.seekPos += (unsigned int)size;
 			return (size_t)size;
 		}
 
@@ -503,6 +566,18 @@ size_t ISOFileSystem::ReadFile(u32 handle, u8 *pointer, s64 size)
 
 		while (remain > 0)
 		{
+			// Whole sectors in the middle go straight to the destination.
+			if (posInSector == 0 && remain >= 2048)
+			{
+				int sectors = (int)(remain / 2048);
+				blockDevice->ReadBlocks(secNum, sectors, pointer);
+				totalRead += sectors * 2048;
+				pointer += sectors * 2048;
+				remain -= sectors * 2048;
+				secNum += sectors;
+				continue;
+			}
+
 			blockDevice->ReadBlock(secNum, theSector);
 			size_t bytesToCopy = 2048 - posInSector;
 			if ((s64)bytesToCopy > remain)
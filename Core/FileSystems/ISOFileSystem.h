@@ -63,6 +63,8 @@ private:
 		u32 startingPosition;
 		s64 size;
 		bool isDirectory;
+		// Hash of the case folded path from the root, see AddToPathIndex.
+		u32 pathHash;
 
 		TreeEntry *parent;
 		std::vector<TreeEntry*> children;
@@ -90,7 +92,16 @@ private:
 	// Don't use this in the emu, not savestated.
 	std::vector<std::string> restrictTree;
 
+	// Every entry in the tree, open addressed by pathHash, so that resolving a path costs
+	// one pass over it instead of a scan of each directory on the way. Built by ReadDirectory.
+	std::vector<TreeEntry *> pathIndex;
+	size_t pathIndexCount;
+
 	void ReadDirectory(u32 startsector, u32 dirsize, TreeEntry *root, size_t level);
 	TreeEntry *GetFromPath(std::string path, bool catchError=true);
 	std::string EntryFullPath(TreeEntry *e);
+
+	void AddToPathIndex(TreeEntry *e);
+	TreeEntry *FindInPathIndex(const std::string &path);
+	bool EntryMatchesPath(const TreeEntry *e, const std::string &path);
 };
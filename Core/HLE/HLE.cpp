@@ -26,6 +26,7 @@
 #include "Core/Reporting.h"
 
 #include "HLETables.h"
+#include "ReplaceTables.h"
 #include "../System.h"
 #include "sceDisplay.h"
 #include "sceIo.h"
@@ -60,6 +61,21 @@ typedef std::vector<Syscall> SyscallVector;
 typedef std::map<std::string, SyscallVector> SyscallVectorByModule;
 
 static std::vector<HLEModule> moduleDB;
+
+// Open addressed hash tables over moduleDB, filled in by RegisterModule, so that resolving
+// imports doesn't have to scan every module and function table.
+struct HLEFuncLookup
+{
+	u32 hash;
+	u32 nid;
+	int moduleIndex;
+	int funcIndex;
+};
+// Module index + 1, 0 is empty.
+static std::vector<int> moduleLookup;
+// Empty if moduleIndex is -1.
+static std::vector<HLEFuncLookup> funcLookup;
+static size_t funcLookupCount;
 static int delayedResultEvent = -1;
 static int hleAfterSyscall = HLE_AFTER_NOTHING;
 static const char *hleAfterSyscallReschedReason;
@@ -87,48 +103,154 @@ void HLEInit()
 
 void HLEDoState(PointerWrap &p)
 {
-	auto s = p.Section("HLE", 1);
+	auto s = p.Section("HLE", 1, 2);
 	if (!s)
 		return;
 
 	p.Do(delayedResultEvent);
 	CoreTiming::RestoreRegisterEvent(delayedResultEvent, "HLEDelayedResult", hleDelayResultFinish);
+
+	if (s >= 2)
+		ReplacementDoState(p);
+	else if (p.mode == p.MODE_READ)
+		ReplacementForgetSites();
 }
 
 void HLEShutdown()
 {
 	hleAfterSyscall = HLE_AFTER_NOTHING;
 	moduleDB.clear();
+	moduleLookup.clear();
+	funcLookup.clear();
+	funcLookupCount = 0;
+}
+
+// FNV-1a.
+static u32 HashModuleName(const char *name)
+{
+	u32 hash = 2166136261U;
+	for (; *name != '\0'; ++name)
+		hash = (hash ^ (u8)*name) * 16777619U;
+	return hash;
+}
+
+static inline u32 HashFunc(int moduleIndex, u32 nid)
+{
+	return (nid ^ ((u32)moduleIndex * 0x9E3779B1U)) * 0x85EBCA6BU;
+}
+
+static void InsertModuleLookup(int moduleIndex)
+{
+	const size_t mask = moduleLookup.size() - 1;
+	size_t i = HashModuleName(moduleDB[moduleIndex].name) & mask;
+	while (moduleLookup[i] != 0)
+	{
+		// Like the old linear search, the first one registered wins.
+		if (strcmp(moduleDB[moduleLookup[i] - 1].name, moduleDB[moduleIndex].name) == 0)
+			return;
+		i = (i + 1) & mask;
+	}
+	moduleLookup[i] = moduleIndex + 1;
+}
+
+static void InsertFuncLookup(const HLEFuncLookup &entry)
+{
+	const size_t mask = funcLookup.size() - 1;
+	size_t i = entry.hash & mask;
+	while (funcLookup[i].moduleIndex != -1)
+	{
+		if (funcLookup[i].nid == entry.nid && funcLookup[i].moduleIndex == entry.moduleIndex)
+			return;
+		i = (i + 1) & mask;
+	}
+	funcLookup[i] = entry;
+	++funcLookupCount;
 }
 
 void RegisterModule(const char *name, int numFunctions, const HLEFunction *funcTable)
 {
 	HLEModule module = {name, numFunctions, funcTable};
 	moduleDB.push_back(module);
+	const int moduleIndex = (int)moduleDB.size() - 1;
+
+	// Keep both tables at most half full.
+	if (moduleDB.size() * 2 > moduleLookup.size())
+	{
+		moduleLookup.assign(moduleLookup.empty() ? 64 : moduleLookup.size() * 2, 0);
+		for (int i = 0; i < moduleIndex; ++i)
+			InsertModuleLookup(i);
+	}
+	InsertModuleLookup(moduleIndex);
+
+	if ((funcLookupCount + numFunctions) * 2 > funcLookup.size())
+	{
+		size_t size = funcLookup.empty() ? 1024 : funcLookup.size();
+		while ((funcLookupCount + numFunctions) * 2 > size)
+			size *= 2;
+		HLEFuncLookup empty = {0, 0, -1, -1};
+		std::vector<HLEFuncLookup> old(size, empty);
+		funcLookup.swap(old);
+		funcLookupCount = 0;
+		for (size_t i = 0; i < old.size(); ++i)
+		{
+			if (old[i].moduleIndex != -1)
+				InsertFuncLookup(old[i]);
+		}
+	}
+	for (int i = 0; i < numFunctions; ++i)
+	{
+		HLEFuncLookup entry = {HashFunc(moduleIndex, funcTable[i].ID), funcTable[i].ID, moduleIndex, i};
+		InsertFuncLookup(entry);
+	}
 }
 
 int GetModuleIndex(const char *moduleName)
 {
-	for (size_t i = 0; i < moduleDB.size(); i++)
-		if (strcmp(moduleName, moduleDB[i].name) == 0)
-			return (int)i;
+	if (moduleLookup.empty())
+		return -1;
+
+	const size_t mask = moduleLookup.size() - 1;
+	for (size_t i = HashModuleName(moduleName) & mask; moduleLookup[i] != 0; i = (i + 1) & mask)
+	{
+		const int moduleIndex = moduleLookup[i] - 1;
+		if (strcmp(moduleName, moduleDB[moduleIndex].name) == 0)
+			return moduleIndex;
+	}
 	return -1;
 }
 
 int GetFuncIndex(int moduleIndex, u32 nib)
 {
-	const HLEModule &module = moduleDB[moduleIndex];
-	for (int i = 0; i < module.numFunctions; i++)
+	if (funcLookup.empty())
+		return -1;
+
+	const u32 hash = HashFunc(moduleIndex, nib);
+	const size_t mask = funcLookup.size() - 1;
+	for (size_t i = hash & mask; funcLookup[i].moduleIndex != -1; i = (i + 1) & mask)
 	{
-		if (module.funcTable[i].ID == nib)
-			return i;
+		const HLEFuncLookup &entry = funcLookup[i];
+		if (entry.hash == hash && entry.nid == nib && entry.moduleIndex == moduleIndex)
+			return entry.funcIndex;
 	}
 	return -1;
 }
 
+int GetNumRegisteredModules()
+{
+	return (int)moduleDB.size();
+}
+
+const HLEModule *GetModuleByIndex(int index)
+{
+	return &moduleDB[index];
+}
+
 u32 GetNibByName(const char *moduleName, const char *function)
 {
 	int moduleIndex = GetModuleIndex(moduleName);
+	if (moduleIndex == -1)
+		return -1;
+	// Only used for a few stubs of our own, so a scan of the one module is fine.
 	const HLEModule &module = moduleDB[moduleIndex];
 	for (int i = 0; i < module.numFunctions; i++)
 	{
@@ -76,6 +76,8 @@ const char *GetFuncName(int module, int func);
 const HLEFunction *GetFunc(const char *module, u32 nib);
 int GetFuncIndex(int moduleIndex, u32 nib);
 int GetModuleIndex(const char *modulename);
+int GetNumRegisteredModules();
+const HLEModule *GetModuleByIndex(int index);
 
 void RegisterModule(const char *name, int numFunctions, const HLEFunction *funcTable);
 
@@ -0,0 +1,30 @@
+// Generated by Tools/knownfuncs/knownfuncs.py, do not edit.
+// Hash (XXH32, jump targets masked), size in bytes, and the replacement in ReplaceTables.cpp.
+
+#pragma once
+
+#define KNOWN_FUNCTION_HASHES_VERSION 1
+
+static const KnownFunctionHash knownFunctionHashes[] = {
+	{ 0xa157b38e, 336, "memcpy" },
+	{ 0x5170eab6, 496, "memcpy" },
+	{ 0xc925c35a, 560, "memcpy" },
+	{ 0x50e6f5f3, 620, "memcpy" },
+	{ 0x74313d5b, 320, "memmove" },
+	{ 0xd291edf9, 324, "memmove" },
+	{ 0xe110b5a0, 388, "memmove" },
+	{ 0xc3d4afe2, 588, "memmove" },
+	{ 0xc537b877, 204, "memset" },
+	{ 0x848a73a5, 220, "memset" },
+	{ 0xa06964dd, 220, "memset" },
+	{ 0x48d67a2e, 240, "memset" },
+	{ 0x9ad78c43, 244, "memset" },
+	{ 0x0d0f163e, 100, "strcmp" },
+	{ 0x23c0322c, 108, "strcmp" },
+	{ 0xdfceab31, 124, "strcmp" },
+	{ 0xd2a83c9d, 156, "strcpy" },
+	{ 0x04c8054e, 164, "strcpy" },
+	{ 0xf36f1d1c, 164, "strcpy" },
+	{ 0x8d9af7fa, 40, "strlen" },
+	{ 0x17a9a434, 304, "strncmp" },
+};
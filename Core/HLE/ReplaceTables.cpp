@@ -0,0 +1,406 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <map>
+#include <set>
+#include <string.h>
+#include <vector>
+
+#include "Common/ChunkFile.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/MIPSCodeUtils.h"
+#include "Core/HLE/HLE.h"
+#include "Core/HLE/FunctionWrappers.h"
+#include "Core/HLE/ReplaceTables.h"
+#include "Core/HLE/KnownFunctionHashes.h"
+#include "ext/xxhash.h"
+
+// Must match the names the generator uses. Only append, the index is saved in states.
+enum {
+	REPLACE_MEMCPY,
+	REPLACE_MEMMOVE,
+	REPLACE_MEMSET,
+	REPLACE_STRLEN,
+	REPLACE_STRCMP,
+	REPLACE_STRNCMP,
+	REPLACE_STRCPY,
+
+	REPLACE_COUNT,
+};
+
+static const char *const replacementNames[REPLACE_COUNT] = {
+	"memcpy",
+	"memmove",
+	"memset",
+	"strlen",
+	"strcmp",
+	"strncmp",
+	"strcpy",
+};
+
+// Fake NIDs in the "ReplacedFunctions" module, in the same order.
+static const u32 NID_REPLACE_BASE = 0x4e5f0000;
+
+struct ReplacedSite {
+	u32 original[2];
+	int replacement;
+};
+
+static std::map<u32, ReplacedSite> replacedSites;
+static bool replacementEnabled[REPLACE_COUNT];
+static bool replacementConfigLoaded = false;
+static int replacementSites[REPLACE_COUNT];
+static u32 replacementHits[REPLACE_COUNT];
+static u32 replacementHitsThisFrame = 0;
+static u32 replacementHitsLastFrame = 0;
+
+// Hash and size of the function, to index into replacementNames.
+static std::map<u64, int> knownHashes;
+static std::vector<u32> knownSizes;
+
+static inline void CountHit(int replacement) {
+	++replacementHits[replacement];
+	++replacementHitsThisFrame;
+}
+
+// Both ends valid and contiguous in host memory.
+static bool IsValidRange(u32 addr, u32 size) {
+	if (size == 0)
+		return true;
+	const u32 last = addr + size - 1;
+	if (last < addr || !Memory::IsValidAddress(addr) || !Memory::IsValidAddress(last))
+		return false;
+	return Memory::GetPointer(addr) + (size - 1) == Memory::GetPointer(last);
+}
+
+// Roughly what a decent guest loop would have taken.
+static void EatCopyCycles(u32 bytes) {
+	hleEatCycles(20 + bytes / 2);
+}
+
+static void EatStringCycles(u32 bytes) {
+	hleEatCycles(10 + bytes * 3);
+}
+
+static u32 Replace_memcpy(u32 dst, u32 src, u32 size) {
+	CountHit(REPLACE_MEMCPY);
+	EatCopyCycles(size);
+	// An overlapping forward copy is sometimes used on purpose, so do it the slow way then.
+	const bool overlaps = dst > src && dst - src < size;
+	if (!overlaps && IsValidRange(dst, size) && IsValidRange(src, size)) {
+		if (size != 0)
+			memcpy(Memory::GetPointer(dst), Memory::GetPointer(src), size);
+	} else {
+		for (u32 i = 0; i < size; ++i)
+			Memory::Write_U8(Memory::Read_U8(src + i), dst + i);
+	}
+	return dst;
+}
+
+static u32 Replace_memmove(u32 dst, u32 src, u32 size) {
+	CountHit(REPLACE_MEMMOVE);
+	EatCopyCycles(size);
+	if (IsValidRange(dst, size) && IsValidRange(src, size)) {
+		if (size != 0)
+			memmove(Memory::GetPointer(dst), Memory::GetPointer(src), size);
+	} else if (dst < src) {
+		for (u32 i = 0; i < size; ++i)
+			Memory::Write_U8(Memory::Read_U8(src + i), dst + i);
+	} else {
+		for (u32 i = size; i > 0; --i)
+			Memory::Write_U8(Memory::Read_U8(src + i - 1), dst + i - 1);
+	}
+	return dst;
+}
+
+static u32 Replace_memset(u32 dst, u32 value, u32 size) {
+	CountHit(REPLACE_MEMSET);
+	EatCopyCycles(size);
+	if (IsValidRange(dst, size)) {
+		if (size != 0)
+			memset(Memory::GetPointer(dst), (u8)value, size);
+	} else {
+		for (u32 i = 0; i < size; ++i)
+			Memory::Write_U8((u8)value, dst + i);
+	}
+	return dst;
+}
+
+// Stops at an invalid address, after letting Read_U8 report it.
+static inline bool ReadStringChar(u32 addr, u8 *c) {
+	if (Memory::IsValidAddress(addr)) {
+		*c = Memory::ReadUnchecked_U8(addr);
+		return true;
+	}
+	*c = Memory::Read_U8(addr);
+	return false;
+}
+
+static u32 Replace_strlen(u32 str) {
+	CountHit(REPLACE_STRLEN);
+	u32 len = 0;
+	u8 c;
+	while (ReadStringChar(str + len, &c) && c != 0)
+		++len;
+	EatStringCycles(len);
+	return len;
+}
+
+static int CompareStrings(u32 str1, u32 str2, u32 limit) {
+	u32 i = 0;
+	int result = 0;
+	for (; i < limit; ++i) {
+		u8 c1, c2;
+		if (!ReadStringChar(str1 + i, &c1) || !ReadStringChar(str2 + i, &c2))
+			break;
+		if (c1 != c2 || c1 == 0) {
+			result = (int)c1 - (int)c2;
+			break;
+		}
+	}
+	EatStringCycles(i);
+	return result;
+}
+
+static int Replace_strcmp(u32 str1, u32 str2) {
+	CountHit(REPLACE_STRCMP);
+	return CompareStrings(str1, str2, 0xFFFFFFFF);
+}
+
+static int Replace_strncmp(u32 str1, u32 str2, u32 size) {
+	CountHit(REPLACE_STRNCMP);
+	return CompareStrings(str1, str2, size);
+}
+
+static u32 Replace_strcpy(u32 dst, u32 src) {
+	CountHit(REPLACE_STRCPY);
+	u32 i = 0;
+	u8 c;
+	do {
+		if (!ReadStringChar(src + i, &c))
+			break;
+		Memory::Write_U8(c, dst + i);
+		++i;
+	} while (c != 0);
+	EatStringCycles(i);
+	return dst;
+}
+
+const HLEFunction ReplacedFunctions[] = {
+	{NID_REPLACE_BASE + REPLACE_MEMCPY, WrapU_UUU<Replace_memcpy>, "memcpy"},
+	{NID_REPLACE_BASE + REPLACE_MEMMOVE, WrapU_UUU<Replace_memmove>, "memmove"},
+	{NID_REPLACE_BASE + REPLACE_MEMSET, WrapU_UUU<Replace_memset>, "memset"},
+	{NID_REPLACE_BASE + REPLACE_STRLEN, WrapU_U<Replace_strlen>, "strlen"},
+	{NID_REPLACE_BASE + REPLACE_STRCMP, WrapI_UU<Replace_strcmp>, "strcmp"},
+	{NID_REPLACE_BASE + REPLACE_STRNCMP, WrapI_UUU<Replace_strncmp>, "strncmp"},
+	{NID_REPLACE_BASE + REPLACE_STRCPY, WrapU_UU<Replace_strcpy>, "strcpy"},
+};
+
+void Register_ReplacedFunctions() {
+	RegisterModule("ReplacedFunctions", ARRAY_SIZE(ReplacedFunctions), ReplacedFunctions);
+}
+
+static int GetReplacementIndex(const char *name) {
+	for (int i = 0; i < REPLACE_COUNT; ++i) {
+		if (!strcmp(replacementNames[i], name))
+			return i;
+	}
+	return -1;
+}
+
+static void LoadKnownHashes() {
+	if (!knownHashes.empty())
+		return;
+
+	std::set<u32> sizes;
+	for (size_t i = 0; i < ARRAY_SIZE(knownFunctionHashes); ++i) {
+		const KnownFunctionHash &known = knownFunctionHashes[i];
+		const int replacement = GetReplacementIndex(known.name);
+		if (replacement == -1) {
+			WARN_LOG(HLE, "Unknown replacement %s in function hashes", known.name);
+			continue;
+		}
+		knownHashes[((u64)known.size << 32) | known.hash] = replacement;
+		sizes.insert(known.size);
+	}
+	knownSizes.assign(sizes.begin(), sizes.end());
+	DEBUG_LOG(HLE, "Loaded %d known function hashes, version %d", (int)knownHashes.size(), KNOWN_FUNCTION_HASHES_VERSION);
+}
+
+static void LoadReplacementConfig() {
+	if (replacementConfigLoaded)
+		return;
+	for (int i = 0; i < REPLACE_COUNT; ++i)
+		replacementEnabled[i] = true;
+	for (size_t i = 0; i < g_Config.vDisabledFuncReplacements.size(); ++i) {
+		const int replacement = GetReplacementIndex(g_Config.vDisabledFuncReplacements[i].c_str());
+		if (replacement != -1)
+			replacementEnabled[replacement] = false;
+	}
+	replacementConfigLoaded = true;
+}
+
+static u32 GetReplacementOp(int replacement) {
+	return GetSyscallOp("ReplacedFunctions", NID_REPLACE_BASE + replacement);
+}
+
+// Only touches memory that still looks like we left it, in case the module went away.
+static void PatchSite(u32 addr, const ReplacedSite &site, bool patch) {
+	const u32 patched[2] = { MIPS_MAKE_JR_RA(), GetReplacementOp(site.replacement) };
+	const u32 *from = patch ? site.original : patched;
+	const u32 *to = patch ? patched : site.original;
+	// Drop any compiled code first, this also takes the block's emuhack back out.
+	currentMIPS->InvalidateICache(addr, 8);
+	if (Memory::Read_Instruction(addr).encoding != from[0] || Memory::Read_Instruction(addr + 4).encoding != from[1])
+		return;
+	Memory::Write_U32(to[0], addr);
+	Memory::Write_U32(to[1], addr + 4);
+}
+
+// Same as hash_function() in knownfuncs.py: jump targets are relocated, so they're masked out.
+static u32 HashFunction(u32 addr, u32 size, std::vector<u32> &buffer) {
+	buffer.resize(size / 4);
+	for (u32 i = 0; i < size / 4; ++i) {
+		u32 op = Memory::Read_Instruction(addr + i * 4).encoding;
+		const u32 opcode = op >> 26;
+		if (opcode == 2 || opcode == 3)
+			op &= 0xFC000000;
+		buffer[i] = op;
+	}
+	return XXH32(&buffer[0], (int)size, 0);
+}
+
+void ReplaceKnownFunctions(u32 startAddr, u32 endAddr) {
+	if (!g_Config.bFuncReplacements || endAddr <= startAddr)
+		return;
+	LoadKnownHashes();
+	LoadReplacementConfig();
+
+	// Anything from a module that used to be here is gone.
+	replacedSites.erase(replacedSites.lower_bound(startAddr), replacedSites.lower_bound(endAddr));
+
+	// Only functions something calls, which is where ScanForFunctions would start, too.
+	std::set<u32> entries;
+	for (u32 addr = startAddr; addr < endAddr; addr += 4) {
+		const u32 op = Memory::Read_Instruction(addr).encoding;
+		if ((op >> 26) == 3) {
+			const u32 target = (addr & 0xF0000000) | ((op & 0x03FFFFFF) << 2);
+			if (target >= startAddr && target < endAddr)
+				entries.insert(target);
+		}
+	}
+
+	std::vector<u32> buffer;
+	int found = 0;
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		const u32 entry = *it;
+		for (size_t i = 0; i < knownSizes.size(); ++i) {
+			const u32 size = knownSizes[i];
+			if (entry + size > endAddr)
+				break;
+			auto known = knownHashes.find(((u64)size << 32) | HashFunction(entry, size, buffer));
+			if (known == knownHashes.end())
+				continue;
+
+			ReplacedSite &site = replacedSites[entry];
+			site.original[0] = Memory::Read_Instruction(entry).encoding;
+			site.original[1] = Memory::Read_Instruction(entry + 4).encoding;
+			site.replacement = known->second;
+			replacementSites[site.replacement]++;
+			if (replacementEnabled[site.replacement])
+				PatchSite(entry, site, true);
+			++found;
+			break;
+		}
+	}
+
+	if (found != 0)
+		INFO_LOG(HLE, "Replaced %d known functions in %08x-%08x", found, startAddr, endAddr);
+}
+
+void ReplacementDoState(PointerWrap &p) {
+	p.Do(replacedSites);
+
+	if (p.mode == p.MODE_READ) {
+		// The state has whatever was enabled when it was saved, go with the current settings.
+		LoadReplacementConfig();
+		for (int i = 0; i < REPLACE_COUNT; ++i)
+			replacementSites[i] = 0;
+		for (auto it = replacedSites.begin(); it != replacedSites.end(); ++it) {
+			if (it->second.replacement < 0 || it->second.replacement >= REPLACE_COUNT)
+				continue;
+			replacementSites[it->second.replacement]++;
+			PatchSite(it->first, it->second, false);
+			if (replacementEnabled[it->second.replacement])
+				PatchSite(it->first, it->second, true);
+		}
+	}
+}
+
+void ReplacementForgetSites() {
+	replacedSites.clear();
+	for (int i = 0; i < REPLACE_COUNT; ++i)
+		replacementSites[i] = 0;
+}
+
+void ReplacementShutdown() {
+	ReplacementForgetSites();
+	replacementConfigLoaded = false;
+	for (int i = 0; i < REPLACE_COUNT; ++i)
+		replacementHits[i] = 0;
+	replacementHitsThisFrame = 0;
+	replacementHitsLastFrame = 0;
+}
+
+int GetNumReplacements() {
+	return REPLACE_COUNT;
+}
+
+bool GetReplacementInfo(int index, ReplacementInfo *info) {
+	if (index < 0 || index >= REPLACE_COUNT)
+		return false;
+	LoadReplacementConfig();
+	info->name = replacementNames[index];
+	info->enabled = replacementEnabled[index];
+	info->sites = replacementSites[index];
+	info->hits = replacementHits[index];
+	return true;
+}
+
+void SetReplacementEnabled(int index, bool enabled) {
+	if (index < 0 || index >= REPLACE_COUNT)
+		return;
+	LoadReplacementConfig();
+	if (replacementEnabled[index] == enabled)
+		return;
+	replacementEnabled[index] = enabled;
+	for (auto it = replacedSites.begin(); it != replacedSites.end(); ++it) {
+		if (it->second.replacement == index)
+			PatchSite(it->first, it->second, enabled);
+	}
+}
+
+void ReplacementEndFrame() {
+	replacementHitsLastFrame = replacementHitsThisFrame;
+	replacementHitsThisFrame = 0;
+}
+
+u32 GetReplacementHitsLastFrame() {
+	return replacementHitsLastFrame;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include "Common/CommonTypes.h"
+
+class PointerWrap;
+
+// Statically linked library functions (memcpy, strlen, etc.) are recognized at module load by
+// hashing them, and their first two instructions are replaced with "jr ra; syscall" to a native
+// version. The hashes come from KnownFunctionHashes.h, see Tools/knownfuncs/knownfuncs.py.
+
+struct KnownFunctionHash {
+	u32 hash;
+	u32 size;
+	const char *name;
+};
+
+struct ReplacementInfo {
+	const char *name;
+	bool enabled;
+	// Number of functions in loaded modules that were replaced.
+	int sites;
+	u32 hits;
+};
+
+void Register_ReplacedFunctions();
+
+// Called for each loaded module, after MIPSAnalyst::ScanForFunctions.
+void ReplaceKnownFunctions(u32 startAddr, u32 endAddr);
+void ReplacementDoState(PointerWrap &p);
+// For states saved before replacements existed, whose memory has nothing patched.
+void ReplacementForgetSites();
+void ReplacementShutdown();
+
+int GetNumReplacements();
+bool GetReplacementInfo(int index, ReplacementInfo *info);
+// Puts the original code back (or patches it again) everywhere, and remembers it until shutdown.
+void SetReplacementEnabled(int index, bool enabled);
+// Called on each flip.
+void ReplacementEndFrame();
+// Total hits during the last complete frame, for the debug stats.
+u32 GetReplacementHitsLastFrame();
@@ -15,6 +15,8 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+
 #include "__sceAudio.h"
 #include "sceAudio.h"
 #include "sceKernel.h"
@@ -28,12 +30,10 @@
 #include "ChunkFile.h"
 #include "FixedSizeQueue.h"
 #include "Common/Atomics.h"
-#include "../../native/base/mutex.h"
 
-// Should be used to lock anything related to the outAudioQueue.
-//atomic locks are used on the lock. TODO: make this lock-free
-atomic_flag atomicLock_;
-recursive_mutex mutex_;
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
 
 int eventAudioUpdate = -1;
 int eventHostAudioUpdate = -1; 
@@ -54,13 +54,31 @@ static s32 *mixBuffer;
 static int chanQueueMaxSizeFactor;
 static int chanQueueMinSizeFactor;
 
-// TODO: Need to replace this with something lockless. Mutexes in the audio pipeline
-// is bad mojo.
-FixedSizeQueue<s16, 512 * 16> outAudioQueue;
+struct AudioLatencyParams {
+	int hwBlockSize;
+	int hostAttemptBlockSize;
+	// Mixed output waiting for the host is capped here, in stereo frames.
+	int maxQueuedFrames;
+};
+
+// Indexed by g_Config.iAudioLatency.
+static const AudioLatencyParams audioLatencyParams[] = {
+	{ 16, 256, 2048 },
+	{ 64, 512, 4096 },
+	{ 64, 1024, 8192 },
+};
 
-bool __gainAudioQueueLock();
-void __releaseAcquiredLock();
-void __blockForAudioQueueLock();
+static int maxQueuedSamples;
+
+// Written by __AudioUpdate on the emu thread, read by __AudioMix on the host's audio thread.
+static LockFreeRingBuffer<s16, 8192 * 2> outAudioQueue;
+// Only the consumer can drop queued samples, so the emu thread asks for it through this.
+static volatile u32 outAudioQueueDiscards;
+
+// Written by one side each, read by __AudioGetDebugStats.
+static volatile u32 underrunCount;
+static volatile u32 underrunFrames;
+static volatile u32 droppedFrames;
 
 static inline s16 adjustvolume(s16 sample, int vol) {
 #ifdef ARM
@@ -90,17 +108,13 @@ void hleHostAudioUpdate(u64 userdata, int cyclesLate) {
 void __AudioInit() {
 	mixFrequency = 44100;
 
-	if (g_Config.bLowLatencyAudio) {
-		chanQueueMaxSizeFactor = 1;
-		chanQueueMinSizeFactor = 1;
-		hwBlockSize = 16;
-		hostAttemptBlockSize = 256;
-	} else {
-		chanQueueMaxSizeFactor = 2;
-		chanQueueMinSizeFactor = 1;
-		hwBlockSize = 64;
-		hostAttemptBlockSize = 512;
-	}
+	const int latency = std::max(0, std::min(g_Config.iAudioLatency, (int)ARRAY_SIZE(audioLatencyParams) - 1));
+	const AudioLatencyParams &params = audioLatencyParams[latency];
+	chanQueueMaxSizeFactor = latency == 0 ? 1 : 2;
+	chanQueueMinSizeFactor = 1;
+	hwBlockSize = params.hwBlockSize;
+	hostAttemptBlockSize = params.hostAttemptBlockSize;
+	maxQueuedSamples = std::min(params.maxQueuedFrames * 2, (int)outAudioQueue.capacity());
 
 	audioIntervalUs = (int)(1000000ULL * hwBlockSize / hwSampleRate);
 	audioHostIntervalUs = (int)(1000000ULL * hostAttemptBlockSize / hwSampleRate);
@@ -116,13 +130,14 @@ void __AudioInit() {
 	mixBuffer = new s32[hwBlockSize * 2];
 	memset(mixBuffer, 0, hwBlockSize * 2 * sizeof(s32));
 
-	__blockForAudioQueueLock();
-	outAudioQueue.clear();
-	__releaseAcquiredLock();
+	Common::AtomicIncrement(outAudioQueueDiscards);
+	underrunCount = 0;
+	underrunFrames = 0;
+	droppedFrames = 0;
 }
 
 void __AudioDoState(PointerWrap &p) {
-	auto s = p.Section("sceAudio", 1);
+	auto s = p.Section("sceAudio", 1, 2);
 	if (!s)
 		return;
 
@@ -133,17 +148,14 @@ void __AudioDoState(PointerWrap &p) {
 
 	p.Do(mixFrequency);
 
-	{	
-		//block until a lock is achieved. Not a good idea at all, but
-		//can't think of a better one...
-		__blockForAudioQueueLock();
-
-		outAudioQueue.DoState(p);
-
-		//release the atomic lock
-		__releaseAcquiredLock();
-		
+	if (s < 2) {
+		// Older states included the mixed output waiting for the host. It's a few ms at most,
+		// and the host may be playing from it right now, so it's just skipped.
+		FixedSizeQueue<s16, 512 * 16> oldOutQueue;
+		oldOutQueue.DoState(p);
 	}
+	if (p.mode == PointerWrap::MODE_READ)
+		Common::AtomicIncrement(outAudioQueueDiscards);
 
 	int chanCount = ARRAY_SIZE(chans);
 	p.Do(chanCount);
@@ -252,11 +264,27 @@ u32 __AudioEnqueue(AudioChannel &chan, int chanNum, bool blocking) {
 				}
 			}
 		} else if (chan.format == PSP_AUDIO_FORMAT_MONO) {
-			for (u32 i = 0; i < chan.sampleCount; i++) {
-				// Expand to stereo
-				s16 sample = (s16)Memory::Read_U16(chan.sampleAddress + 2 * i);
-				chan.sampleQueue.push(adjustvolume(sample, leftVol));
-				chan.sampleQueue.push(adjustvolume(sample, rightVol));
+			const s16_le *sampleData = (const s16_le *) Memory::GetPointer(chan.sampleAddress);
+
+			if (Memory::IsValidAddress(chan.sampleAddress + (chan.sampleCount - 1) * sizeof(s16_le))) {
+				s16 *buf1 = 0, *buf2 = 0;
+				size_t sz1, sz2;
+				// Expand to stereo. The queue only ever moves by whole frames, so sz1 is even.
+				chan.sampleQueue.pushPointers(chan.sampleCount * 2, &buf1, &sz1, &buf2, &sz2);
+
+				for (u32 i = 0; i < sz1; i += 2) {
+					const s16 sample = sampleData[i / 2];
+					buf1[i] = adjustvolume(sample, leftVol);
+					buf1[i + 1] = adjustvolume(sample, rightVol);
+				}
+				if (buf2) {
+					sampleData += sz1 / 2;
+					for (u32 i = 0; i < sz2; i += 2) {
+						const s16 sample = sampleData[i / 2];
+						buf2[i] = adjustvolume(sample, leftVol);
+						buf2[i + 1] = adjustvolume(sample, rightVol);
+					}
+				}
 			}
 		}
 	}
@@ -293,6 +321,38 @@ void __AudioSetOutputFrequency(int freq) {
 	mixFrequency = freq;
 }
 
+// Adds count samples from src into mix.
+static void MixSamples(s32 *mix, const s16 *src, size_t count) {
+	size_t i = 0;
+#ifdef _M_SSE
+	for (; i + 8 <= count; i += 8) {
+		const __m128i samples = _mm_loadu_si128((const __m128i *)(src + i));
+		// Sign extend by putting each sample in the top half and shifting down.
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+		__m128i *dest = (__m128i *)(mix + i);
+		_mm_storeu_si128(dest, _mm_add_epi32(_mm_loadu_si128(dest), lo));
+		_mm_storeu_si128(dest + 1, _mm_add_epi32(_mm_loadu_si128(dest + 1), hi));
+	}
+#endif
+	for (; i < count; i++)
+		mix[i] += src[i];
+}
+
+static void ClampSamples(s16 *dest, const s32 *mix, size_t count) {
+	size_t i = 0;
+#ifdef _M_SSE
+	for (; i + 8 <= count; i += 8) {
+		const __m128i lo = _mm_loadu_si128((const __m128i *)(mix + i));
+		const __m128i hi = _mm_loadu_si128((const __m128i *)(mix + i + 4));
+		// Saturates to s16, which is exactly clamp_s16.
+		_mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(lo, hi));
+	}
+#endif
+	for (; i < count; i++)
+		dest[i] = clamp_s16(mix[i]);
+}
+
 // Mix samples from the various audio channels into a single sample queue.
 // This single sample queue is where __AudioMix should read from. If the sample queue is full, we should
 // just sleep the main emulator thread a little.
@@ -300,7 +360,7 @@ void __AudioUpdate() {
 	// Audio throttle doesn't really work on the PSP since the mixing intervals are so closely tied
 	// to the CPU. Much better to throttle the frame rate on frame display and just throw away audio
 	// if the buffer somehow gets full.
-	bool firstChannel = true;
+	memset(mixBuffer, 0, hwBlockSize * 2 * sizeof(s32));
 
 	for (u32 i = 0; i < PSP_AUDIO_CHANNEL_MAX + 1; i++)	{
 		if (!chans[i].reserved)
@@ -321,54 +381,26 @@ void __AudioUpdate() {
 
 		chans[i].sampleQueue.popPointers(hwBlockSize * 2, &buf1, &sz1, &buf2, &sz2);
 
-		if (firstChannel) {
-			for (size_t s = 0; s < sz1; s++)
-				mixBuffer[s] = buf1[s];
-			if (buf2) {
-				for (size_t s = 0; s < sz2; s++)
-					mixBuffer[s + sz1] = buf2[s];
-			}
-			firstChannel = false;
-		} else {
-			for (size_t s = 0; s < sz1; s++)
-				mixBuffer[s] += buf1[s];
-			if (buf2) {
-				for (size_t s = 0; s < sz2; s++)
-					mixBuffer[s + sz1] += buf2[s];
-			}
-		}
-	}
-
-	if (firstChannel) {
-		memset(mixBuffer, 0, hwBlockSize * 2 * sizeof(s32));
+		MixSamples(mixBuffer, buf1, sz1);
+		if (buf2)
+			MixSamples(mixBuffer + sz1, buf2, sz2);
 	}
 
 	if (g_Config.bEnableSound) {
-
-		__blockForAudioQueueLock();
-		/*
-		if (!__gainAudioQueueLock()){
-			return;
-		}
-		*/
-
-		if (outAudioQueue.room() >= hwBlockSize * 2) {
-			s16 *buf1 = 0, *buf2 = 0;
-			size_t sz1, sz2;
-			outAudioQueue.pushPointers(hwBlockSize * 2, &buf1, &sz1, &buf2, &sz2);
-			
-			for (size_t s = 0; s < sz1; s++)
-				buf1[s] = clamp_s16(mixBuffer[s]);
-			if (buf2) {
-				for (size_t s = 0; s < sz2; s++)
-					buf2[s] = clamp_s16(mixBuffer[s + sz1]);
-			}
+		const size_t blockSamples = hwBlockSize * 2;
+		s16 *buf1 = 0, *buf2 = 0;
+		size_t sz1, sz2;
+		// Keep the whole block or none of it.
+		if (outAudioQueue.size() + blockSamples <= (size_t)maxQueuedSamples && outAudioQueue.BeginPush(blockSamples, &buf1, &sz1, &buf2, &sz2) == blockSamples) {
+			ClampSamples(buf1, mixBuffer, sz1);
+			if (buf2)
+				ClampSamples(buf2, mixBuffer + sz1, sz2);
+			outAudioQueue.EndPush(blockSamples);
 		} else {
 			// This happens quite a lot. There's still something slightly off
 			// about the amount of audio we produce.
+			Common::AtomicAdd(droppedFrames, hwBlockSize);
 		}
-		//release the atomic lock
-		__releaseAcquiredLock();
 	}
 }
 
@@ -376,76 +408,29 @@ void __AudioUpdate() {
 // This is called from *outside* the emulator thread.
 int __AudioMix(short *outstereo, int numFrames)
 {
-
-	// TODO: if mixFrequency != the actual output frequency, resample!
-	int underrun = -1;
-	s16 sampleL = 0;
-	s16 sampleR = 0;
-
-	const s16 *buf1 = 0, *buf2 = 0;
-	size_t sz1, sz2;
-	{
-		
-		//TODO: do rigorous testing to see whether just blind locking will improve speed.
-		if (!__gainAudioQueueLock()){
-			 memset(outstereo, 0, numFrames * 2 * sizeof(short)); 
-			 return 0;
-		}
-		
-		outAudioQueue.popPointers(numFrames * 2, &buf1, &sz1, &buf2, &sz2);
-
-		memcpy(outstereo, buf1, sz1 * sizeof(s16));
-		if (buf2) {
-			memcpy(outstereo + sz1, buf2, sz2 * sizeof(s16));
-		}
-
-		//release the atomic lock
-		__releaseAcquiredLock();
-	}
-
-	int remains = (int)(numFrames * 2 - sz1 - sz2);
-	if (remains > 0)
-		memset(outstereo + numFrames * 2 - remains, 0, remains*sizeof(s16));
-
-	if (sz1 + sz2 < (size_t)numFrames) {
-		underrun = (int)(sz1 + sz2) / 2;
-		VERBOSE_LOG(SCEAUDIO, "Audio out buffer UNDERRUN at %i of %i", underrun, numFrames);
-	}
-	return underrun >= 0 ? underrun : numFrames;
-}
-
-
-
-/*returns whether the lock was successfully gained or not.
-i.e - whether the lock belongs to you 
-*/
-inline bool __gainAudioQueueLock(){
-	if (g_Config.bAtomicAudioLocks){
-		/*if the previous state was 0, that means the lock was "unlocked". So,
-		we return !0, which is true thanks to C's int to bool conversion
-
-		One the other hand, if it was locked, then the lock would return 1.
-		so, !1 = 0 = false.
-		*/		
-		return atomicLock_.test_and_set() == 0;
-	} else {
-		mutex_.lock();
-		return true;
+	// Only touched here, so only by the host's audio thread.
+	static u32 discardsDone = 0;
+	const u32 discards = Common::AtomicLoadAcquire(outAudioQueueDiscards);
+	if (discards != discardsDone) {
+		outAudioQueue.Discard();
+		discardsDone = discards;
 	}
-};
 
-inline void __releaseAcquiredLock(){
-	if (g_Config.bAtomicAudioLocks){
-		atomicLock_.clear();
-	} else {
-		mutex_.unlock();
+	// TODO: if mixFrequency != the actual output frequency, resample!
+	const size_t wanted = numFrames * 2;
+	const size_t popped = outAudioQueue.Pop(outstereo, wanted);
+	if (popped < wanted) {
+		memset(outstereo + popped, 0, (wanted - popped) * sizeof(s16));
+		Common::AtomicIncrement(underrunCount);
+		Common::AtomicAdd(underrunFrames, (u32)(wanted - popped) / 2);
+		VERBOSE_LOG(SCEAUDIO, "Audio out buffer UNDERRUN at %i of %i", (int)popped / 2, numFrames);
 	}
+	return (int)popped / 2;
 }
 
-inline void __blockForAudioQueueLock(){
-	if (g_Config.bAtomicAudioLocks){
-		while ((atomicLock_.test_and_set() == 0)){ }
-	} else {
-		mutex_.lock();
-	}
+void __AudioGetDebugStats(AudioDebugStats *stats) {
+	stats->queuedFrames = (int)outAudioQueue.size() / 2;
+	stats->underruns = Common::AtomicLoad(underrunCount);
+	stats->underrunFrames = Common::AtomicLoad(underrunFrames);
+	stats->droppedFrames = Common::AtomicLoad(droppedFrames);
 }
@@ -32,4 +32,17 @@ u32 __AudioEnqueue(AudioChannel &chan, int chanNum, bool blocking);
 void __AudioWakeThreads(AudioChannel &chan, int result, int step);
 void __AudioWakeThreads(AudioChannel &chan, int result);
 
+// Fills outstereo completely and returns how many of the frames were actual sound.
 int __AudioMix(short *outstereo, int numSamples);
+
+struct AudioDebugStats {
+	// Mixed and waiting for the host.
+	int queuedFrames;
+	// Times the host asked for more than there was, and how much it went without.
+	int underruns;
+	int underrunFrames;
+	// Mixed but thrown away, since too much was already queued.
+	int droppedFrames;
+};
+
+void __AudioGetDebugStats(AudioDebugStats *stats);
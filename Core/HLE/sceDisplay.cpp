@@ -36,13 +36,16 @@
 #include "Core/Config.h"
 #include "Core/System.h"
 #include "Core/HLE/HLE.h"
+#include "Core/HLE/__sceAudio.h"
 #include "Core/HLE/sceDisplay.h"
 #include "Core/HLE/sceKernel.h"
 #include "Core/HLE/sceKernelThread.h"
 #include "Core/HLE/sceKernelInterrupt.h"
+#include "Core/HLE/ReplaceTables.h"
 
 #include "GPU/GPUState.h"
 #include "GPU/GPUInterface.h"
+#include "GPU/Debugger/Record.h"
 
 struct FrameBufferState {
 	u32 topaddr;
@@ -361,6 +364,8 @@ void __DisplayGetDebugStats(char stats[2048]) {
 	gpu->UpdateStats();
 
 	float vertexAverageCycles = gpuStats.numVertsSubmitted > 0 ? (float)gpuStats.vertexGPUCycles / (float)gpuStats.numVertsSubmitted : 0.0f;
+	AudioDebugStats audioStats;
+	__AudioGetDebugStats(&audioStats);
 
 	sprintf(stats,
 		"Frames: %i\n"
@@ -368,8 +373,10 @@ void __DisplayGetDebugStats(char stats[2048]) {
 		"Kernel processing time: %0.2f ms\n"
 		"Slowest syscall: %s : %0.2f ms\n"
 		"Most active syscall: %s : %0.2f ms\n"
+		"Replaced function calls: %i\n"
 		"Draw calls: %i, flushes %i\n"
-		"Cached Draw calls: %i\n"
+		"Cached Draw calls: %i (%i%% of vertex cache lookups)\n"
+		"Vertex data hashed: %i KB\n"
 		"Alpha Tested draws: %i\n"
 		"Non Alpha Tested draws: %i\n"
 		"Num Tracked Vertex Arrays: %i\n"
@@ -383,7 +390,8 @@ void __DisplayGetDebugStats(char stats[2048]) {
 		"Texture invalidations: %i\n"
 		"Vertex shaders loaded: %i\n"
 		"Fragment shaders loaded: %i\n"
-		"Combined shaders loaded: %i\n",
+		"Combined shaders loaded: %i\n"
+		"Audio queued: %i ms, underruns: %i (%i ms), dropped: %i ms\n",
 		gpuStats.numVBlanks,
 		gpuStats.msProcessingDisplayLists * 1000.0f,
 		kernelStats.msInSyscalls * 1000.0f,
@@ -391,9 +399,12 @@ void __DisplayGetDebugStats(char stats[2048]) {
 		kernelStats.slowestSyscallTime * 1000.0f,
 		kernelStats.summedSlowestSyscallName ? kernelStats.summedSlowestSyscallName : "(none)",
 		kernelStats.summedSlowestSyscallTime * 1000.0f,
+		GetReplacementHitsLastFrame(),
 		gpuStats.numDrawCalls,
 		gpuStats.numFlushes,
 		gpuStats.numCachedDrawCalls,
+		gpuStats.numVertexCacheLookups ? gpuStats.numCachedDrawCalls * 100 / gpuStats.numVertexCacheLookups : 0,
+		gpuStats.numVertexBytesHashed / 1024,
 		gpuStats.numAlphaTestedDraws,
 		gpuStats.numNonAlphaTestedDraws,
 		gpuStats.numTrackedVertexArrays,
@@ -409,7 +420,11 @@ void __DisplayGetDebugStats(char stats[2048]) {
 		gpuStats.numTextureInvalidations,
 		gpuStats.numVertexShaders,
 		gpuStats.numFragmentShaders,
-		gpuStats.numShaders
+		gpuStats.numShaders,
+		(int)(audioStats.queuedFrames / 44.1f),
+		audioStats.underruns,
+		(int)(audioStats.underrunFrames / 44.1f),
+		(int)(audioStats.droppedFrames / 44.1f)
 		);
 
 	gpuStats.ResetFrame();
@@ -588,6 +603,8 @@ void hleEnterVblank(u64 userdata, int cyclesLate) {
 
 void hleAfterFlip(u64 userdata, int cyclesLate)
 {
+	GPURecord::NotifyFrame();
+	ReplacementEndFrame();
 	gpu->BeginFrame();  // doesn't really matter if begin or end of frame.
 }
 
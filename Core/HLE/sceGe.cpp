@@ -31,6 +31,7 @@
 #include "Core/HLE/KernelWaitHelpers.h"
 #include "GPU/GPUState.h"
 #include "GPU/GPUInterface.h"
+#include "GPU/Debugger/Record.h"
 
 static PspGeCallbackData ge_callback_data[16];
 static bool ge_used_callbacks[16] = {0};
@@ -532,6 +533,7 @@ u32 sceGeRestoreContext(u32 ctxAddr)
 		gstate.Restore((u32_le *)Memory::GetPointer(ctxAddr));
 	}
 	ReapplyGfxState();
+	GPURecord::NotifyRegisters();
 
 	return 0;
 }
@@ -23,6 +23,7 @@
 #include "Common/FileUtil.h"
 #include "Core/HLE/HLE.h"
 #include "Core/HLE/HLETables.h"
+#include "Core/HLE/ReplaceTables.h"
 #include "Core/Reporting.h"
 #include "Core/Host.h"
 #include "Core/MIPS/MIPS.h"
@@ -406,6 +407,7 @@ void __KernelModuleShutdown()
 {
 	loadedModules.clear();
 	MIPSAnalyst::Shutdown();
+	ReplacementShutdown();
 }
 
 // Sometimes there are multiple LO16's or HI16's per pair, even though the ABI says nothing of this.
@@ -798,6 +800,7 @@ Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, std::string *erro
 		if (!reader.LoadSymbols())
 			MIPSAnalyst::ScanForFunctions(textStart, textStart+textSize);
 #endif
+		ReplaceKnownFunctions(textStart, textStart + textSize);
 	}
 
 	INFO_LOG(LOADER,"Module %s: %08x %08x %08x", modinfo->name, modinfo->gp, modinfo->libent,modinfo->libstub);
@@ -955,6 +958,7 @@ Module *__KernelLoadELFFromPtr(const u8 *ptr, u32 loadAddress, std::string *erro
 		if (!reader.LoadSymbols())
 			MIPSAnalyst::ScanForFunctions(textStart, textEnd);
 #endif
+		ReplaceKnownFunctions(textStart, textEnd);
 	}
 
 	// Look at the exports, too.
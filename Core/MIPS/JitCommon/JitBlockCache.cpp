@@ -22,7 +22,11 @@
 // performance hit, it's not enabled by default, but it's useful for
 // locating performance issues.
 
+#include <algorithm>
+
 #include "Common.h"
+#include "Common/FileUtil.h"
+#include "ext/xxhash.h"
 
 #ifdef _WIN32
 #include "Common/CommonWindows.h"
@@ -72,6 +76,20 @@ op_agent_t agent;
 
 
 const u32 INVALID_EXIT = 0xFFFFFFFF;
+const u32 BLOCK_PROFILE_MAGIC = 0x4B4C424A;  // JBLK
+const u32 BLOCK_PROFILE_VERSION = 1;
+
+struct BlockProfileHeader {
+	u32 magic;
+	u32 version;
+	u32 count;
+};
+
+struct BlockProfileEntry {
+	u32 address;
+	u32 size;
+	u32 hash;
+};
 const MIPSOpcode INVALID_ORIGINAL_OP = MIPSOpcode(0x00000001);
 
 JitBlockCache::JitBlockCache(MIPSState *mips_, CodeBlock *codeBlock) :
@@ -122,8 +140,8 @@ void JitBlockCache::Clear()
 {
 	for (int i = 0; i < num_blocks; i++)
 		DestroyBlock(i, false);
-	links_to.clear();
-	block_map.clear();
+	links_to.Clear();
+	block_map.Clear();
 	num_blocks = 0;
 }
 
@@ -166,13 +184,13 @@ void JitBlockCache::FinalizeBlock(int block_num, bool block_link)
 	// Yeah, this'll work fine for PSP too I think.
 	u32 pAddr = b.originalAddress & 0x1FFFFFFF;
 
-	block_map[std::make_pair(pAddr + 4 * b.originalSize - 1, pAddr)] = block_num;
+	block_map.Add(pAddr, 4 * b.originalSize, block_num);
 	if (block_link)
 	{
 		for (int i = 0; i < MAX_JIT_BLOCK_EXITS; i++)
 		{
 			if (b.exitAddress[i] != INVALID_EXIT) 
-				links_to.insert(std::pair<u32, int>(b.exitAddress[i], block_num));
+				links_to.BucketFor(b.exitAddress[i] & 0x1FFFFFFF).push_back(std::make_pair(b.exitAddress[i], block_num));
 		}
 			
 		LinkBlock(block_num);
@@ -314,33 +332,34 @@ void JitBlockCache::LinkBlockExits(int i)
 	}
 }
 
-using namespace std;
-
 void JitBlockCache::LinkBlock(int i)
 {
 	LinkBlockExits(i);
 	JitBlock &b = blocks[i];
-	pair<multimap<u32, int>::iterator, multimap<u32, int>::iterator> ppp;
-	// equal_range(b) returns pair<iterator,iterator> representing the range
-	// of element with key b
-	ppp = links_to.equal_range(b.originalAddress);
-	if (ppp.first == ppp.second)
-		return;
-	for (multimap<u32, int>::iterator iter = ppp.first; iter != ppp.second; ++iter) {
-		// PanicAlert("Linking block %i to block %i", iter->second, i);
-		LinkBlockExits(iter->second);
+	std::vector<std::pair<u32, int> > &bucket = links_to.BucketFor(b.originalAddress & 0x1FFFFFFF);
+	for (size_t j = 0; j < bucket.size(); ) {
+		// Sources that have since been destroyed can't be relinked, so drop them here.
+		if (blocks[bucket[j].second].invalid) {
+			bucket[j] = bucket.back();
+			bucket.pop_back();
+			continue;
+		}
+		if (bucket[j].first == b.originalAddress) {
+			// PanicAlert("Linking block %i to block %i", bucket[j].second, i);
+			LinkBlockExits(bucket[j].second);
+		}
+		++j;
 	}
 }
 
 void JitBlockCache::UnlinkBlock(int i)
 {
 	JitBlock &b = blocks[i];
-	pair<multimap<u32, int>::iterator, multimap<u32, int>::iterator> ppp;
-	ppp = links_to.equal_range(b.originalAddress);
-	if (ppp.first == ppp.second)
-		return;
-	for (multimap<u32, int>::iterator iter = ppp.first; iter != ppp.second; ++iter) {
-		JitBlock &sourceBlock = blocks[iter->second];
+	std::vector<std::pair<u32, int> > &bucket = links_to.BucketFor(b.originalAddress & 0x1FFFFFFF);
+	for (size_t j = 0; j < bucket.size(); ++j) {
+		if (bucket[j].first != b.originalAddress)
+			continue;
+		JitBlock &sourceBlock = blocks[bucket[j].second];
 		for (int e = 0; e < MAX_JIT_BLOCK_EXITS; e++)
 		{
 			if (sourceBlock.exitAddress[e] == b.originalAddress)
@@ -441,19 +460,109 @@ void JitBlockCache::DestroyBlock(int block_num, bool invalidate)
 #endif
 }
 
+void JitBlockCache::InvalidateBucket(std::vector<int> &bucket, u32 pAddr, u32 pEnd)
+{
+	for (size_t i = 0; i < bucket.size(); ) {
+		const JitBlock &b = blocks[bucket[i]];
+		const u32 blockStart = b.originalAddress & 0x1FFFFFFF;
+		const u32 blockEnd = blockStart + 4 * b.originalSize;
+		// Blocks spanning several pages are listed in each, so some may already be gone.
+		if (b.invalid || (blockStart < pEnd && blockEnd > pAddr)) {
+			if (!b.invalid)
+				DestroyBlock(bucket[i], true);
+			bucket[i] = bucket.back();
+			bucket.pop_back();
+			continue;
+		}
+		++i;
+	}
+}
+
 void JitBlockCache::InvalidateICache(u32 address, const u32 length)
 {
 	// Convert the logical address to a physical address for the block map
 	u32 pAddr = address & 0x1FFFFFFF;
+	u32 pEnd = pAddr + length;
 
 	// destroy JIT blocks
-	// !! this works correctly under assumption that any two overlapping blocks end at the same address
-	// TODO: This may not be a safe assumption with jit continuing enabled.
-	std::map<pair<u32,u32>, u32>::iterator it1 = block_map.lower_bound(std::make_pair(pAddr, 0)), it2 = it1;
-	while (it2 != block_map.end() && it2->first.second < pAddr + length) {
-		DestroyBlock(it2->second, true);
-		it2++;
+	// Only the pages touched by the range are scanned, and any block overlapping it is
+	// destroyed, no matter where it starts or ends.
+	block_map.GetBuckets(pAddr, length, invalidateBuckets_);
+	for (size_t i = 0; i < invalidateBuckets_.size(); ++i)
+		InvalidateBucket(*invalidateBuckets_[i], pAddr, pEnd);
+}
+
+u32 JitBlockCache::HashGuestCode(u32 em_address, u32 size)
+{
+	// Read_Instruction sees through emuhacks, so this is the code as the game wrote it.
+	u32 code[256];
+	u32 hash = 0;
+	for (u32 i = 0; i < size; i += ARRAY_SIZE(code)) {
+		const u32 n = std::min(size - i, (u32)ARRAY_SIZE(code));
+		for (u32 j = 0; j < n; ++j)
+			code[j] = Memory::Read_Instruction(em_address + 4 * (i + j)).encoding;
+		hash = XXH32(code, n * sizeof(u32), hash ^ 0x4A49540F);
+	}
+	return hash;
+}
+
+bool JitBlockCache::SaveBlockProfile(const std::string &filename)
+{
+	std::vector<BlockProfileEntry> entries;
+	entries.reserve(num_blocks);
+	for (int block_num = 0; block_num < num_blocks; ++block_num)
+	{
+		const JitBlock &b = blocks[block_num];
+		if (b.invalid || b.originalSize == 0)
+			continue;
+		BlockProfileEntry entry = { b.originalAddress, b.originalSize, HashGuestCode(b.originalAddress, b.originalSize) };
+		entries.push_back(entry);
+	}
+	// Don't clobber a good profile with an empty one, e.g. after a failed boot.
+	if (entries.empty())
+		return false;
+
+	File::IOFile f(filename, "wb");
+	BlockProfileHeader header = { BLOCK_PROFILE_MAGIC, BLOCK_PROFILE_VERSION, (u32)entries.size() };
+	f.WriteArray(&header, 1);
+	if (!entries.empty())
+		f.WriteArray(&entries[0], entries.size());
+	if (!f.IsGood()) {
+		ERROR_LOG(JIT, "Unable to write block profile %s", filename.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool JitBlockCache::LoadBlockProfile(const std::string &filename, std::vector<u32> *addresses, int *mismatches)
+{
+	*mismatches = 0;
+	File::IOFile f(filename, "rb");
+	if (!f.IsOpen())
+		return false;
+
+	BlockProfileHeader header;
+	if (!f.ReadArray(&header, 1) || header.magic != BLOCK_PROFILE_MAGIC || header.version != BLOCK_PROFILE_VERSION || header.count > MAX_NUM_BLOCKS) {
+		WARN_LOG(JIT, "Ignoring invalid or outdated block profile %s", filename.c_str());
+		return false;
+	}
+
+	std::vector<BlockProfileEntry> entries(header.count);
+	if (header.count != 0 && !f.ReadArray(&entries[0], entries.size())) {
+		WARN_LOG(JIT, "Truncated block profile %s", filename.c_str());
+		return false;
+	}
+
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		const BlockProfileEntry &entry = entries[i];
+		// The code might not be loaded yet (PRXs loaded later), or the game patched itself.
+		if (entry.size == 0 || !Memory::IsValidAddress(entry.address) || !Memory::IsValidAddress(entry.address + 4 * entry.size - 1)
+			|| HashGuestCode(entry.address, entry.size) != entry.hash) {
+			++*mismatches;
+			continue;
+		}
+		addresses->push_back(entry.address);
 	}
-	if (it1 != it2)
-		block_map.erase(it1, it2);
+	return true;
 }
@@ -17,7 +17,6 @@
 
 #pragma once
 
-#include <map>
 #include <vector>
 #include <string>
 
@@ -80,6 +79,68 @@ struct JitBlock {
 
 typedef void (*CompiledCode)();
 
+// Flat page-bucketed index over guest memory, used instead of ordered maps so that
+// range invalidation and exit linking are a short bucket scan with no tree walk and
+// no per-insert node allocation. Main RAM (including the extended range) gets one
+// bucket per page; anything else (scratchpad, kernel) shares one overflow bucket,
+// which is rarely used for code. Buckets keep their capacity across Clear().
+// Callers are expected to prune stale entries while scanning.
+template <typename T>
+class JitPageIndex
+{
+public:
+	typedef std::vector<T> Bucket;
+
+	enum {
+		PAGE_SHIFT = 12,
+		RAM_BASE = 0x08000000,
+		RAM_END = 0x0C000000,
+		NUM_PAGES = (RAM_END - RAM_BASE) >> PAGE_SHIFT,
+	};
+
+	JitPageIndex() : buckets_(NUM_PAGES + 1) {}
+
+	void Clear() {
+		for (size_t i = 0; i < buckets_.size(); ++i)
+			buckets_[i].clear();
+	}
+
+	// Physical address only (already masked with 0x1FFFFFFF.)
+	Bucket &BucketFor(u32 pAddr) {
+		if (pAddr >= RAM_BASE && pAddr < RAM_END)
+			return buckets_[(pAddr - RAM_BASE) >> PAGE_SHIFT];
+		return buckets_[NUM_PAGES];
+	}
+
+	// Adds the entry to every bucket touched by [pAddr, pAddr + length).
+	void Add(u32 pAddr, u32 length, const T &entry) {
+		GetBuckets(pAddr, length, scratch_);
+		for (size_t i = 0; i < scratch_.size(); ++i)
+			scratch_[i]->push_back(entry);
+	}
+
+	// Collects each bucket touched by [pAddr, pAddr + length) exactly once.
+	void GetBuckets(u32 pAddr, u32 length, std::vector<Bucket *> &out) {
+		out.clear();
+		if (length == 0)
+			length = 1;
+		const u32 pEnd = pAddr + length < pAddr ? 0xFFFFFFFF : pAddr + length;
+		if (pAddr < RAM_BASE || pEnd > RAM_END)
+			out.push_back(&buckets_[NUM_PAGES]);
+		const u32 start = pAddr < RAM_BASE ? (u32)RAM_BASE : pAddr;
+		const u32 end = pEnd > RAM_END ? (u32)RAM_END : pEnd;
+		if (start >= end)
+			return;
+		const u32 lastPage = (end - 1 - RAM_BASE) >> PAGE_SHIFT;
+		for (u32 page = (start - RAM_BASE) >> PAGE_SHIFT; page <= lastPage; ++page)
+			out.push_back(&buckets_[page]);
+	}
+
+private:
+	std::vector<Bucket> buckets_;
+	std::vector<Bucket *> scratch_;
+};
+
 class JitBlockCache
 {
 public:
@@ -124,20 +185,31 @@ public:
 
 	int GetNumBlocks() const { return num_blocks; }
 
+	// Block profile: start address, size and guest code hash of each live block, so the
+	// next boot of the same game can compile them up front instead of on first visit.
+	bool SaveBlockProfile(const std::string &filename);
+	// Only returns blocks whose guest code in Memory still hashes the same.
+	bool LoadBlockProfile(const std::string &filename, std::vector<u32> *addresses, int *mismatches);
+
 private:
 	void LinkBlockExits(int i);
 	void LinkBlock(int i);
 	void UnlinkBlock(int i);
+	void InvalidateBucket(std::vector<int> &bucket, u32 pAddr, u32 pEnd);
 
 	MIPSOpcode GetEmuHackOpForBlock(int block_num) const;
+	static u32 HashGuestCode(u32 em_address, u32 size);
 
 	MIPSState *mips;
 	CodeBlock *codeBlock_;
 	JitBlock *blocks;
 
 	int num_blocks;
-	std::multimap<u32, int> links_to;
-	std::map<std::pair<u32,u32>, u32> block_map; // (end_addr, start_addr) -> number
+	// (exit address, source block number), bucketed by the page of the exit address.
+	JitPageIndex<std::pair<u32, int> > links_to;
+	// Block numbers, bucketed by every page each block's guest code covers.
+	JitPageIndex<int> block_map;
+	std::vector<std::vector<int> *> invalidateBuckets_;
 
 	enum {
 		MAX_NUM_BLOCKS = 65536*2
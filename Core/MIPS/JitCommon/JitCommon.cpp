@@ -15,8 +15,46 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "base/timeutil.h"
+
+#include "Core/MIPS/MIPS.h"
 #include "JitCommon.h"
 
 namespace MIPSComp {
 	Jit *jit;
+
+	void LoadBlockProfile(const std::string &filename) {
+		if (!jit)
+			return;
+
+		JitBlockCache *blocks = jit->GetBlockCache();
+		std::vector<u32> addresses;
+		int mismatches = 0;
+		if (!blocks->LoadBlockProfile(filename, &addresses, &mismatches))
+			return;
+
+		// Compile() works on the current PC, so borrow it.
+		const u32 savedPC = currentMIPS->pc;
+		const double start = real_time_now();
+		int compiled = 0;
+		for (size_t i = 0; i < addresses.size() && !blocks->IsFull(); ++i) {
+			if (blocks->GetBlockNumberFromStartAddress(addresses[i]) >= 0)
+				continue;
+			currentMIPS->pc = addresses[i];
+			jit->Compile(addresses[i]);
+			++compiled;
+		}
+		currentMIPS->pc = savedPC;
+		const double elapsed = real_time_now() - start;
+
+		const int total = (int)addresses.size() + mismatches;
+		INFO_LOG(JIT, "Block profile: %d/%d blocks matched (%d%%), precompiled %d in %0.1f ms that would otherwise compile during play",
+			(int)addresses.size(), total, total == 0 ? 0 : (int)(addresses.size() * 100 / total), compiled, elapsed * 1000.0);
+	}
+
+	void SaveBlockProfile(const std::string &filename) {
+		if (!jit)
+			return;
+		jit->GetBlockCache()->SaveBlockProfile(filename);
+	}
 }
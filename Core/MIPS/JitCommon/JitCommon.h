@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include <string>
+
 #include "Common/Common.h"
 
 struct JitBlock;
@@ -50,4 +52,8 @@ struct JitBlock;
 
 namespace MIPSComp {
 	extern Jit *jit;
+
+	// Compiles the blocks a previous session of this game saved, if their code still matches.
+	void LoadBlockProfile(const std::string &filename);
+	void SaveBlockProfile(const std::string &filename);
 }
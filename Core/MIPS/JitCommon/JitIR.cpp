@@ -0,0 +1,192 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "Core/Debugger/Breakpoints.h"
+#include "Core/MIPS/MIPSAnalyst.h"
+#include "Core/MIPS/MIPSCodeUtils.h"
+#include "Core/MIPS/JitCommon/JitIR.h"
+
+namespace MIPSComp {
+
+// Anything outside these flags makes an op with a GPR output a barrier instead of IR_ALU.
+static const u32 ALU_ALLOWED_FLAGS = IN_RS | IN_RS_SHIFT | IN_RT | IN_SA | IN_IMM16 | OUT_RT | OUT_RD;
+static const u32 MEM_ALLOWED_FLAGS = IN_MEM | IN_IMM16 | IN_RS_ADDR | IN_RT | OUT_RT | OUT_MEM | MEMTYPE_MASK;
+
+enum {
+	OP_SB = 40,
+	OP_SH = 41,
+	OP_SW = 43,
+};
+
+IRInstKind IRBlock::Classify(MIPSOpcode op, MIPSInfo info) {
+	if (info.value == 0 || (info & (IS_VFPU | DELAYSLOT | BAD_INSTRUCTION)) != 0)
+		return IR_BARRIER;
+
+	if ((info & (IN_MEM | OUT_MEM)) != 0) {
+		if ((info.value & ~MEM_ALLOWED_FLAGS) != 0)
+			return IR_BARRIER;
+		const u32 memType = info & MEMTYPE_MASK;
+		if (memType != MEMTYPE_BYTE && memType != MEMTYPE_HWORD && memType != MEMTYPE_WORD)
+			return IR_BARRIER;
+		return (info & OUT_MEM) != 0 ? IR_STORE : IR_LOAD;
+	}
+
+	// Needs at least one real input, so that odd coprocessor reads (mfc0, etc.) stay barriers.
+	if ((info & (OUT_RT | OUT_RD)) != 0 && (info & (IN_RS | IN_RT | IN_IMM16)) != 0 && (info.value & ~ALU_ALLOWED_FLAGS) == 0)
+		return IR_ALU;
+
+	return IR_BARRIER;
+}
+
+void IRBlock::Build(u32 address, int maxInstructions) {
+	insts_.clear();
+	deadCount_ = 0;
+	startPC_ = address;
+
+	u32 pc = address;
+	for (int i = 0; i < maxInstructions; ++i, pc += 4) {
+		MIPSOpcode op = Memory::Read_Instruction(pc);
+		MIPSInfo info = MIPSGetInfo(op);
+		// The backend ends the block (or leaves straight-line code) at these.
+		if ((info & DELAYSLOT) != 0 || MIPSAnalyst::IsSyscall(op))
+			break;
+
+		IRInst inst;
+		inst.pc = pc;
+		inst.op = op;
+		inst.info = info;
+		inst.kind = Classify(op, info);
+		inst.flags = 0;
+		insts_.push_back(inst);
+	}
+	endPC_ = pc;
+}
+
+void IRBlock::RunPasses(const IROptions &options) {
+	// Stores first, since removing a store also removes its register reads.
+	if (options.deadStores && CBreakPoints::GetMemCheckRanges().empty())
+		EliminateDeadStores();
+	if (options.deadRegWrites)
+		EliminateDeadRegWrites();
+}
+
+// A plain store is dead if the same address is stored again, at the same width, with
+// nothing in between that could read it or change the base register.
+void IRBlock::EliminateDeadStores() {
+	struct PendingStore {
+		MIPSGPReg rs;
+		u32 encodingMask;
+	};
+	PendingStore pending[8];
+	int numPending = 0;
+
+	for (int i = (int)insts_.size() - 1; i >= 0; --i) {
+		IRInst &inst = insts_[i];
+		switch (inst.kind) {
+		case IR_STORE:
+			{
+				const int opcode = MIPS_GET_OP(inst.op);
+				if (opcode != OP_SB && opcode != OP_SH && opcode != OP_SW)
+					break;
+				// Same opcode, base and offset; rt doesn't matter.
+				const u32 key = inst.op & 0xFFE0FFFF;
+				bool overwritten = false;
+				for (int j = 0; j < numPending; ++j) {
+					if (pending[j].encodingMask == key) {
+						overwritten = true;
+						break;
+					}
+				}
+				if (overwritten) {
+					inst.flags |= IR_FLAG_DEAD;
+					++deadCount_;
+				} else if (numPending < (int)ARRAY_SIZE(pending)) {
+					pending[numPending].rs = MIPS_GET_RS(inst.op);
+					pending[numPending].encodingMask = key;
+					++numPending;
+				}
+			}
+			break;
+
+		case IR_LOAD:
+		case IR_BARRIER:
+			numPending = 0;
+			break;
+
+		case IR_ALU:
+			{
+				// Changing the base makes later stores refer to something else.
+				const MIPSGPReg out = MIPSAnalyst::GetOutGPReg(inst.op);
+				for (int j = 0; j < numPending; ) {
+					if (pending[j].rs == out)
+						pending[j] = pending[--numPending];
+					else
+						++j;
+				}
+			}
+			break;
+		}
+	}
+}
+
+// Backwards liveness over the run. Everything is live at the end, since we don't look past it.
+void IRBlock::EliminateDeadRegWrites() {
+	u32 live = 0xFFFFFFFF;
+
+	for (int i = (int)insts_.size() - 1; i >= 0; --i) {
+		IRInst &inst = insts_[i];
+		if (inst.flags & IR_FLAG_DEAD)
+			continue;
+
+		u32 reads = 0;
+		if (inst.info & IN_RS)
+			reads |= 1U << MIPS_GET_RS(inst.op);
+		if (inst.info & IN_RT)
+			reads |= 1U << MIPS_GET_RT(inst.op);
+
+		switch (inst.kind) {
+		case IR_ALU:
+			{
+				const MIPSGPReg out = MIPSAnalyst::GetOutGPReg(inst.op);
+				// Keep anything the debugger might stop on.
+				if (out != MIPS_REG_ZERO && (live & (1U << out)) == 0 && !CBreakPoints::IsAddressBreakPoint(inst.pc)) {
+					inst.flags |= IR_FLAG_DEAD;
+					++deadCount_;
+					continue;
+				}
+				live &= ~(1U << out);
+				live |= reads;
+			}
+			break;
+
+		case IR_LOAD:
+			// lwl/lwr merge into rt without flagging it as an input, so count it as read.
+			live |= reads | (1U << MIPS_GET_RT(inst.op));
+			break;
+
+		case IR_STORE:
+			live |= reads;
+			break;
+
+		case IR_BARRIER:
+			live = 0xFFFFFFFF;
+			break;
+		}
+	}
+}
+
+}  // namespace MIPSComp
@@ -0,0 +1,92 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPSTables.h"
+
+namespace MIPSComp {
+
+// Block-level view of the straight-line code at the start of a block, decoded once so that
+// passes can look at more than one instruction at a time before the backend emits anything.
+// The backend still compiles from MIPS opcodes; it just asks the IR which ones it can skip.
+// Constant propagation and VFPU prefix folding already happen in the backends' register
+// caches and JitState, so the passes here are the ones that need to see the whole run.
+
+enum IRInstKind {
+	// Writes one GPR from GPR/immediate inputs, no other side effects.
+	IR_ALU,
+	// Plain GPR load or store. Memory access can't be removed, but the register flow is known.
+	IR_LOAD,
+	IR_STORE,
+	// Anything else. All registers and memory are assumed read.
+	IR_BARRIER,
+};
+
+enum IRInstFlags {
+	// The result is never observed, so the instruction needn't be emitted.
+	IR_FLAG_DEAD = 0x01,
+};
+
+struct IRInst {
+	u32 pc;
+	MIPSOpcode op;
+	MIPSInfo info;
+	IRInstKind kind;
+	u32 flags;
+};
+
+struct IROptions {
+	IROptions() : deadRegWrites(true), deadStores(true) {}
+
+	bool deadRegWrites;
+	bool deadStores;
+};
+
+class IRBlock {
+public:
+	IRBlock() : startPC_(0), endPC_(0), deadCount_(0) {}
+
+	// Decodes from address up to (not including) the first branch or syscall.
+	void Build(u32 address, int maxInstructions = 128);
+	void RunPasses(const IROptions &options);
+
+	bool IsDead(u32 pc) const {
+		if (pc < startPC_ || pc >= endPC_)
+			return false;
+		return (insts_[(pc - startPC_) / 4].flags & IR_FLAG_DEAD) != 0;
+	}
+	int NumDead() const { return deadCount_; }
+	int NumInstructions() const { return (int)insts_.size(); }
+
+private:
+	void EliminateDeadStores();
+	void EliminateDeadRegWrites();
+
+	static IRInstKind Classify(MIPSOpcode op, MIPSInfo info);
+
+	std::vector<IRInst> insts_;
+	u32 startPC_;
+	u32 endPC_;
+	int deadCount_;
+};
+
+}  // namespace MIPSComp
@@ -177,6 +177,7 @@ void MIPSState::Reset()
 		
 	if (PSP_CoreParameter().cpuCore == CPU_JIT)
 		MIPSComp::jit = new MIPSComp::Jit(this);
+	MIPSInterpret_ClearCache();
 
 	memset(r, 0, sizeof(r));
 	memset(f, 0, sizeof(f));
@@ -314,9 +315,10 @@ u32 MIPSState::ReadFCR(int reg)
 
 void MIPSState::InvalidateICache(u32 address, int length)
 {
-	// Only really applies to jit.
 	if (MIPSComp::jit)
 		MIPSComp::jit->ClearCacheAt(address, length);
+	else
+		MIPSInterpret_InvalidateCache(address, length);
 }
 
 
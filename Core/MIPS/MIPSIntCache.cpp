@@ -0,0 +1,122 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <string.h>
+
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPSIntCache.h"
+
+MIPSIntCache::MIPSIntCache() : numOps_(0), generation_(0) {
+	memset(fast_, 0, sizeof(fast_));
+}
+
+const MIPSIntBlock *MIPSIntCache::LookupBlock(u32 pc) {
+	MIPSIntBlock *block;
+	auto iter = blocks_.find(pc);
+	if (iter != blocks_.end()) {
+		block = &iter->second;
+	} else {
+		block = BuildBlock(pc);
+		if (block == NULL)
+			return NULL;
+	}
+
+	FastEntry &entry = fast_[(pc >> 2) & (FAST_SIZE - 1)];
+	entry.pc = pc;
+	entry.block = block;
+	return block;
+}
+
+const MIPSIntBlock *MIPSIntCache::RebuildBlock(u32 pc) {
+	Invalidate(pc, 4);
+	return LookupBlock(pc);
+}
+
+MIPSIntBlock *MIPSIntCache::BuildBlock(u32 pc) {
+	if ((pc & 3) != 0 || !Memory::IsValidAddress(pc))
+		return NULL;
+	if (numOps_ >= MAX_TOTAL_OPS)
+		Clear();
+
+	MIPSIntBlock &block = blocks_[pc];
+	block.startPC = pc;
+	block.ops.clear();
+	block.ops.reserve(16);
+
+	bool endAfterDelaySlot = false;
+	for (u32 addr = pc; block.ops.size() < MAX_BLOCK_OPS; addr += 4) {
+		if (!Memory::IsValidAddress(addr))
+			break;
+
+		MIPSIntDecodedOp decoded;
+		decoded.op = MIPSOpcode(Memory::ReadUnchecked_U32(addr));
+		decoded.func = MIPSGetInterpretFunc(decoded.op);
+		// MIPSInterpret reports the bad instruction, if it's ever reached.
+		if (decoded.func == NULL)
+			decoded.func = &MIPSInterpret;
+		block.ops.push_back(decoded);
+
+		if (endAfterDelaySlot)
+			break;
+		if ((MIPSGetInfo(decoded.op) & IS_JUMP) != 0)
+			endAfterDelaySlot = true;
+	}
+
+	block.size = (u32)block.ops.size() * 4;
+	numOps_ += block.ops.size();
+	return &block;
+}
+
+void MIPSIntCache::EraseBlock(std::map<u32, MIPSIntBlock>::iterator iter) {
+	FastEntry &entry = fast_[(iter->first >> 2) & (FAST_SIZE - 1)];
+	if (entry.block == &iter->second)
+		entry.block = NULL;
+	numOps_ -= iter->second.ops.size();
+	blocks_.erase(iter);
+}
+
+void MIPSIntCache::Invalidate(u32 address, u32 length) {
+	if (blocks_.empty() || length == 0)
+		return;
+
+	// Blocks that start up to a full block before the range can still reach into it.
+	const u32 maxBlockBytes = MAX_BLOCK_OPS * 4;
+	const u32 searchStart = address > maxBlockBytes ? address - maxBlockBytes : 0;
+	const u32 end = address + length;
+
+	bool erased = false;
+	auto iter = blocks_.lower_bound(searchStart);
+	while (iter != blocks_.end() && iter->first < end) {
+		auto next = iter;
+		++next;
+		if (iter->first + iter->second.size > address) {
+			EraseBlock(iter);
+			erased = true;
+		}
+		iter = next;
+	}
+
+	if (erased)
+		++generation_;
+}
+
+void MIPSIntCache::Clear() {
+	blocks_.clear();
+	memset(fast_, 0, sizeof(fast_));
+	numOps_ = 0;
+	++generation_;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Core/MIPS/MIPSTables.h"
+
+struct MIPSIntDecodedOp {
+	MIPSInterpretFunc func;
+	MIPSOpcode op;
+};
+
+// A run of straight-line code, up to and including the delay slot of an unconditional jump.
+// Conditional branches don't end it, so small loops usually stay inside one block.
+struct MIPSIntBlock {
+	u32 startPC;
+	u32 size;
+	std::vector<MIPSIntDecodedOp> ops;
+};
+
+// Pre-decoded code for MIPSInterpret_RunUntil, so that it doesn't walk the instruction
+// tables for every op it runs. Blocks are dropped by InvalidateICache like jit blocks.
+// Since the interpreter has no emuhacks to notice other writes with, it also compares
+// each op to memory before running it, and rebuilds from there on a mismatch.
+class MIPSIntCache {
+public:
+	MIPSIntCache();
+
+	// Returns NULL if the address can't hold code.
+	const MIPSIntBlock *GetBlock(u32 pc) {
+		const FastEntry &entry = fast_[(pc >> 2) & (FAST_SIZE - 1)];
+		if (entry.block != NULL && entry.pc == pc)
+			return entry.block;
+		return LookupBlock(pc);
+	}
+	// Drops any block covering pc, and builds a new one starting there.
+	const MIPSIntBlock *RebuildBlock(u32 pc);
+
+	void Invalidate(u32 address, u32 length);
+	void Clear();
+
+	// Changes whenever blocks are dropped, so pointers from GetBlock must be fetched again.
+	u32 GetGeneration() const {
+		return generation_;
+	}
+	int GetNumBlocks() const {
+		return (int)blocks_.size();
+	}
+
+private:
+	enum {
+		FAST_SIZE = 4096,
+		MAX_BLOCK_OPS = 256,
+		// About 16 MB of decoded ops on 64-bit, after that everything is thrown away.
+		MAX_TOTAL_OPS = 1024 * 1024,
+	};
+
+	struct FastEntry {
+		u32 pc;
+		MIPSIntBlock *block;
+	};
+
+	const MIPSIntBlock *LookupBlock(u32 pc);
+	MIPSIntBlock *BuildBlock(u32 pc);
+	void EraseBlock(std::map<u32, MIPSIntBlock>::iterator iter);
+
+	std::map<u32, MIPSIntBlock> blocks_;
+	FastEntry fast_[FAST_SIZE];
+	size_t numOps_;
+	u32 generation_;
+};
@@ -23,6 +23,7 @@
 #include "Core/MIPS/MIPSIntVFPU.h"
 #include "Core/MIPS/MIPSCodeUtils.h"
 #include "Core/MIPS/MIPSTables.h"
+#include "Core/MIPS/MIPSIntCache.h"
 #include "Core/CoreTiming.h"
 #include "Core/Reporting.h"
 #include "Core/Debugger/Breakpoints.h"
@@ -1002,9 +1003,23 @@ void MIPSInterpret(MIPSOpcode op) //only for those rare ones
 #define R(i)   (curMips->r[i])
 
 
+static MIPSIntCache intCache;
+
+void MIPSInterpret_InvalidateCache(u32 address, int length)
+{
+	intCache.Invalidate(address, length);
+}
+
+void MIPSInterpret_ClearCache()
+{
+	intCache.Clear();
+}
+
 int MIPSInterpret_RunUntil(u64 globalTicks)
 {
 	MIPSState *curMips = currentMIPS;
+	const MIPSIntBlock *block = 0;
+	u32 generation = intCache.GetGeneration();
 	while (coreState == CORE_RUNNING)
 	{
 		CoreTiming::Advance();
@@ -1015,19 +1030,35 @@ int MIPSInterpret_RunUntil(u64 globalTicks)
 			// int cycles = 0;
 			{
 				again:
-				MIPSOpcode op = MIPSOpcode(Memory::Read_U32(curMips->pc));
-				//MIPSOpcode op = Memory::Read_Opcode_JIT(mipsr4k.pc);
-				/*
-				// Choke on VFPU
-				MIPSInfo info = MIPSGetInfo(op);
-				if (info & IS_VFPU)
+				// Anything run since the last op (a syscall loading a module, say) may have dropped blocks.
+				if (generation != intCache.GetGeneration())
+					block = 0;
+				const u32 pc = curMips->pc;
+				u32 offset = block ? pc - block->startPC : 0;
+				if (!block || offset >= block->size || (offset & 3) != 0)
 				{
-					if (!Core_IsStepping() && !GetAsyncKeyState(VK_LSHIFT))
+					block = intCache.GetBlock(pc);
+					offset = 0;
+				}
+
+				MIPSIntDecodedOp decoded;
+				if (block)
+				{
+					decoded = block->ops[offset >> 2];
+					// Written without an InvalidateICache, decode it again from here.
+					if (Memory::ReadUnchecked_U32(pc) != decoded.op.encoding)
 					{
-						Core_EnableStepping(true);
-						return;
+						block = intCache.RebuildBlock(pc);
+						if (block)
+							decoded = block->ops[0];
 					}
-				}*/
+				}
+				if (!block)
+				{
+					decoded.op = MIPSOpcode(Memory::Read_U32(pc));
+					decoded.func = &MIPSInterpret;
+				}
+				generation = intCache.GetGeneration();
 
 		//2: check for breakpoint (VERY SLOW)
 #if defined(_DEBUG)
@@ -1046,7 +1077,7 @@ int MIPSInterpret_RunUntil(u64 globalTicks)
 
 				bool wasInDelaySlot = curMips->inDelaySlot;
 
-				MIPSInterpret(op);
+				decoded.func(decoded.op);
 
 				if (curMips->inDelaySlot)
 				{
@@ -1103,7 +1134,7 @@ MIPSInfo MIPSGetInfo(MIPSOpcode op)
 MIPSInterpretFunc MIPSGetInterpretFunc(MIPSOpcode op)
 {
 	const MIPSInstruction *instr = MIPSGetInstruction(op);
-	if (instr->interpret)
+	if (instr && instr->interpret)
 		return instr->interpret;
 	else
 		return 0;
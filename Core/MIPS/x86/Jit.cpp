@@ -320,6 +320,8 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b)
 	b->normalEntry = GetCodePtr();
 
 	MIPSAnalyst::AnalysisResults analysis = MIPSAnalyst::Analyze(em_address);
+	ir_.Build(js.blockStart);
+	ir_.RunPasses(jo.ir);
 
 	gpr.Start(mips_, analysis);
 	fpr.Start(mips_, analysis);
@@ -332,7 +334,9 @@ const u8 *Jit::DoJit(u32 em_address, JitBlock *b)
 		MIPSOpcode inst = Memory::Read_Instruction(js.compilerPC);
 		js.downcountAmount += MIPSGetInstructionCycleEstimate(inst);
 
-		MIPSCompileOp(inst);
+		// Still counts for timing, but nothing observes its result.
+		if (!ir_.IsDead(js.compilerPC))
+			MIPSCompileOp(inst);
 
 		if (js.afterOp & JitState::AFTER_CORE_STATE) {
 			// TODO: Save/restore?
@@ -27,6 +27,7 @@
 
 #include "Common/x64Emitter.h"
 #include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitIR.h"
 #include "Core/MIPS/JitCommon/JitState.h"
 #include "RegCache.h"
 #include "RegCacheFPU.h"
@@ -46,6 +47,8 @@ struct JitOptions
 	bool continueBranches;
 	bool continueJumps;
 	int continueMaxInstructions;
+	// Block-level IR passes, run before emission. Turn both off to compile op by op as before.
+	IROptions ir;
 };
 
 // TODO: Hmm, humongous.
@@ -226,6 +229,7 @@ private:
 	JitBlockCache blocks;
 	JitOptions jo;
 	JitState js;
+	IRBlock ir_;
 
 	GPRRegCache gpr;
 	FPURegCache fpr;
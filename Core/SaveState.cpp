@@ -15,10 +15,14 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include <algorithm>
+#include <deque>
+#include <functional>
 #include <vector>
 
 #include "Common/StdMutex.h"
 #include "Common/FileUtil.h"
+#include "ext/snappy/snappy-c.h"
 
 #include "Core/SaveState.h"
 #include "Core/Config.h"
@@ -35,6 +39,7 @@
 #include "GPU/GPUState.h"
 #include "UI/OnScreenDisplay.h"
 #include "base/timeutil.h"
+#include "thread/thread.h"
 #include "i18n/i18n.h"
 
 namespace SaveState
@@ -68,8 +73,7 @@ namespace SaveState
 	CChunkFileReader::Error SaveToRam(std::vector<u8> &data) {
 		SaveStart state;
 		size_t sz = CChunkFileReader::MeasurePtr(state);
-		if (data.size() < sz)
-			data.resize(sz);
+		data.resize(sz);
 		return CChunkFileReader::SavePtr(&data[0], state);
 	}
 
@@ -78,60 +82,226 @@ namespace SaveState
 		return CChunkFileReader::LoadPtr(&data[0], state);
 	}
 
-	struct StateRingbuffer
+	// Deltas are chained from a keyframe, so this bounds the work to restore one snapshot.
+	static const int REWIND_KEYFRAME_INTERVAL = 16;
+
+	// Rewind history. Every snapshot is serialized on the emu thread, but only keyframes are
+	// kept whole; the others are stored as the XOR against the previous snapshot, which is
+	// mostly zeros. Both are snappy compressed on a worker thread while emulation continues.
+	// When over the snapshot limit or memory budget, the oldest keyframe and its deltas go.
+	class StateRingbuffer
 	{
-		StateRingbuffer(int size) : first_(0), next_(0), size_(size)
+	public:
+		StateRingbuffer() : compressThread_(NULL), baseValid_(false), deltasSinceKeyframe_(0), usedBytes_(0), count_(0)
+		{
+		}
+
+		~StateRingbuffer()
 		{
-			states_.resize(size);
+			WaitForCompression();
 		}
 
 		CChunkFileReader::Error Save()
 		{
-			int n = next_++ % size_;
-			if ((next_ % size_) == first_)
-				++first_;
+			WaitForCompression();
+
+			CChunkFileReader::Error err = SaveToRam(pending_);
+			if (err != CChunkFileReader::ERROR_NONE)
+				return err;
 
-			return SaveToRam(states_[n]);
+			compressThread_ = new std::thread(std::bind(&StateRingbuffer::Compress, this));
+			count_ = (int)states_.size() + 1;
+			return err;
 		}
 
 		CChunkFileReader::Error Restore()
 		{
+			WaitForCompression();
+
 			// No valid states left.
-			if (Empty())
+			if (states_.empty())
 				return CChunkFileReader::ERROR_BAD_FILE;
 
-			int n = (next_-- + size_) % size_;
-			if (states_[n].empty())
-				return CChunkFileReader::ERROR_BAD_FILE;
+			// Rebuild from the keyframe the newest snapshot depends on.
+			const size_t last = states_.size() - 1;
+			size_t first = last;
+			while (first > 0 && !states_[first].keyframe)
+				--first;
+
+			bool valid = states_[first].keyframe;
+			baseValid_ = false;
+			for (size_t i = first; valid && i <= last; ++i)
+			{
+				if (i == first)
+					valid = Decompress(states_[i], pending_);
+				else
+				{
+					valid = Decompress(states_[i], scratch_);
+					if (valid)
+						XorInto(pending_, scratch_);
+				}
 
-			return LoadFromRam(states_[n]);
+				// The one before the newest becomes the base for the next delta.
+				if (valid && i + 1 == last)
+				{
+					base_ = pending_;
+					baseValid_ = true;
+					deltasSinceKeyframe_ = (int)(i - first);
+				}
+			}
+
+			usedBytes_ -= states_.back().data.size();
+			states_.pop_back();
+			count_ = (int)states_.size();
+
+			if (!valid)
+			{
+				ERROR_LOG(COMMON, "Rewind state could not be decompressed");
+				return CChunkFileReader::ERROR_BROKEN_STATE;
+			}
+			return LoadFromRam(pending_);
 		}
 
 		void Clear()
 		{
-			first_ = 0;
-			next_ = 0;
+			WaitForCompression();
+
+			states_.clear();
+			usedBytes_ = 0;
+			count_ = 0;
+			baseValid_ = false;
+			deltasSinceKeyframe_ = 0;
+			// These are full size states, don't hold onto them.
+			std::vector<u8>().swap(base_);
+			std::vector<u8>().swap(pending_);
+			std::vector<u8>().swap(scratch_);
+			std::vector<u8>().swap(compressBuffer_);
 		}
 
 		bool Empty()
 		{
-			return next_ == first_;
+			return count_ == 0;
 		}
 
-		typedef std::vector<u8> StateBuffer;
-		int first_;
-		int next_;
-		int size_;
-		std::vector<StateBuffer> states_;
+	private:
+		struct Snapshot
+		{
+			bool keyframe;
+			u32 size;
+			std::vector<u8> data;
+		};
+
+		void WaitForCompression()
+		{
+			if (!compressThread_)
+				return;
+
+			compressThread_->join();
+			delete compressThread_;
+			compressThread_ = NULL;
+
+			usedBytes_ += finished_.data.size();
+			states_.push_back(Snapshot());
+			states_.back().keyframe = finished_.keyframe;
+			states_.back().size = finished_.size;
+			states_.back().data.swap(finished_.data);
+			Trim();
+			count_ = (int)states_.size();
+		}
+
+		// Runs on the worker. Only touches pending_, base_ and the scratch buffers, which the
+		// emu thread leaves alone until WaitForCompression().
+		void Compress()
+		{
+			const u32 size = (u32)pending_.size();
+			finished_.size = size;
+			finished_.keyframe = !baseValid_ || base_.size() != size || deltasSinceKeyframe_ + 1 >= REWIND_KEYFRAME_INTERVAL;
+
+			const u8 *src = &pending_[0];
+			if (!finished_.keyframe)
+			{
+				scratch_ = pending_;
+				XorInto(scratch_, base_);
+				src = &scratch_[0];
+			}
+
+			size_t compressedSize = snappy_max_compressed_length(size);
+			if (compressBuffer_.size() < compressedSize)
+				compressBuffer_.resize(compressedSize);
+			snappy_compress((const char *)src, size, (char *)&compressBuffer_[0], &compressedSize);
+			finished_.data.assign(compressBuffer_.begin(), compressBuffer_.begin() + compressedSize);
+
+			deltasSinceKeyframe_ = finished_.keyframe ? 0 : deltasSinceKeyframe_ + 1;
+			base_.swap(pending_);
+			baseValid_ = true;
+		}
+
+		static bool Decompress(const Snapshot &snap, std::vector<u8> &out)
+		{
+			size_t size;
+			if (snappy_uncompressed_length((const char *)&snap.data[0], snap.data.size(), &size) != SNAPPY_OK || size != snap.size)
+				return false;
+			out.resize(size);
+			return snappy_uncompress((const char *)&snap.data[0], snap.data.size(), (char *)&out[0], &size) == SNAPPY_OK;
+		}
+
+		static void XorInto(std::vector<u8> &dest, const std::vector<u8> &src)
+		{
+			const size_t size = std::min(dest.size(), src.size());
+			const size_t words = size / sizeof(u32);
+			u32 *d32 = (u32 *)&dest[0];
+			const u32 *s32 = (const u32 *)&src[0];
+			for (size_t i = 0; i < words; ++i)
+				d32[i] ^= s32[i];
+			for (size_t i = words * sizeof(u32); i < size; ++i)
+				dest[i] ^= src[i];
+		}
+
+		// Drops whole keyframe groups from the front, but always keeps the newest one.
+		void Trim()
+		{
+			const size_t maxStates = g_Config.iRewindSnapshotLimit > 0 ? (size_t)g_Config.iRewindSnapshotLimit : 1;
+			const size_t budget = (size_t)std::max(g_Config.iRewindMemoryBudget, 1) * 1024 * 1024;
+
+			while (states_.size() > maxStates || usedBytes_ > budget)
+			{
+				size_t nextKeyframe = 1;
+				while (nextKeyframe < states_.size() && !states_[nextKeyframe].keyframe)
+					++nextKeyframe;
+				if (nextKeyframe >= states_.size())
+					break;
+
+				for (size_t i = 0; i < nextKeyframe; ++i)
+				{
+					usedBytes_ -= states_.front().data.size();
+					states_.pop_front();
+				}
+			}
+		}
+
+		std::deque<Snapshot> states_;
+		std::thread *compressThread_;
+		Snapshot finished_;
+
+		// The newest snapshot, uncompressed, which the next one is a delta against.
+		std::vector<u8> base_;
+		bool baseValid_;
+		int deltasSinceKeyframe_;
+
+		std::vector<u8> pending_;
+		std::vector<u8> scratch_;
+		std::vector<u8> compressBuffer_;
+
+		size_t usedBytes_;
+		// Read from the UI thread by CanRewind(), includes a snapshot still being compressed.
+		volatile int count_;
 	};
 
 	static bool needsProcess = false;
 	static std::vector<Operation> pending;
 	static std::recursive_mutex mutex;
 
-	// TODO: Should this be configurable?
-	static const int REWIND_NUM_STATES = 5;
-	static StateRingbuffer rewindStates(REWIND_NUM_STATES);
+	static StateRingbuffer rewindStates;
 	// TODO: Any reason for this to be configurable?
 	const static float rewindMaxWallFrequency = 1.0f;
 	static float rewindLastTime = 0.0f;
@@ -148,6 +148,13 @@ void CPU_WaitStatus(condition_variable &cond, bool (*pred)()) {
 
 void CPU_Shutdown();
 
+static std::string GetJitBlockProfileFilename() {
+	const std::string discID = g_paramSFO.GetValueString("DISC_ID");
+	if (discID.empty())
+		return "";
+	return GetSysDirectory(DIRECTORY_SYSTEM) + "CACHE/" + discID + ".jitblocks";
+}
+
 void CPU_Init() {
 	coreState = CORE_POWERUP;
 	currentCPU = &mipsr4k;
@@ -206,6 +213,12 @@ void CPU_Init() {
 		g_Config.AddRecent(filename);
 	}
 
+	if (g_Config.bJitBlockProfile && MIPSComp::jit) {
+		std::string profileFilename = GetJitBlockProfileFilename();
+		if (!profileFilename.empty())
+			MIPSComp::LoadBlockProfile(profileFilename);
+	}
+
 	coreState = coreParameter.startPaused ? CORE_STEPPING : CORE_RUNNING;
 }
 
@@ -214,6 +227,14 @@ void CPU_Shutdown() {
 		host->SaveSymbolMap();
 	}
 
+	if (g_Config.bJitBlockProfile && MIPSComp::jit) {
+		std::string profileFilename = GetJitBlockProfileFilename();
+		if (!profileFilename.empty()) {
+			File::CreateFullPath(GetSysDirectory(DIRECTORY_SYSTEM) + "CACHE/");
+			MIPSComp::SaveBlockProfile(profileFilename);
+		}
+	}
+
 	CoreTiming::Shutdown();
 	__KernelShutdown();
 	HLEShutdown();
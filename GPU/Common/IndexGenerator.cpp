@@ -19,6 +19,10 @@
 
 #include "Common/Common.h"
 
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
+
 // Points don't need indexing...
 static const u8 indexedPrimitiveType[7] = {
 	GE_PRIM_POINTS,
@@ -30,6 +34,123 @@ static const u8 indexedPrimitiveType[7] = {
 	GE_PRIM_RECTANGLES,
 };
 
+// The kernels below do the bulk of each primitive eight indices at a time and leave the
+// rest to the scalar loops, which are also what every other platform runs.
+// Index math wraps at 16 bits either way, same as storing an int into a u16.
+
+// Writes start, start + 1, ..., start + count - 1.
+static u16 *WriteIndexRamp(u16 *outInds, int start, int count) {
+	if (count <= 0)
+		return outInds;
+	int i = 0;
+#ifdef _M_SSE
+	__m128i ramp = _mm_add_epi16(_mm_set1_epi16((s16)start), _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+	const __m128i step = _mm_set1_epi16(8);
+	for (; i + 8 <= count; i += 8) {
+		_mm_storeu_si128((__m128i *)(outInds + i), ramp);
+		ramp = _mm_add_epi16(ramp, step);
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = start + i;
+	return outInds + count;
+}
+
+// Writes the (i, i + 1) pairs of numLines connected lines starting at start.
+static u16 *WriteLineStripRamp(u16 *outInds, int start, int numLines) {
+	if (numLines <= 0)
+		return outInds;
+	int i = 0;
+#ifdef _M_SSE
+	__m128i lines = _mm_add_epi16(_mm_set1_epi16((s16)start), _mm_setr_epi16(0, 1, 1, 2, 2, 3, 3, 4));
+	const __m128i step = _mm_set1_epi16(4);
+	for (; i + 4 <= numLines; i += 4) {
+		_mm_storeu_si128((__m128i *)(outInds + i * 2), lines);
+		lines = _mm_add_epi16(lines, step);
+	}
+#endif
+	for (; i < numLines; i++) {
+		outInds[i * 2] = start + i;
+		outInds[i * 2 + 1] = start + i + 1;
+	}
+	return outInds + numLines * 2;
+}
+
+// Writes out[i] = indexOffset + inds[i].
+static u16 *TranslateIndexRun(u16 *outInds, const u8 *inds, int indexOffset, int count) {
+	if (count <= 0)
+		return outInds;
+	int i = 0;
+#ifdef _M_SSE
+	const __m128i offset = _mm_set1_epi16((s16)indexOffset);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8) {
+		const __m128i bytes = _mm_loadl_epi64((const __m128i *)(inds + i));
+		_mm_storeu_si128((__m128i *)(outInds + i), _mm_add_epi16(_mm_unpacklo_epi8(bytes, zero), offset));
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = indexOffset + inds[i];
+	return outInds + count;
+}
+
+static u16 *TranslateIndexRun(u16 *outInds, const u16_le *inds, int indexOffset, int count) {
+	if (count <= 0)
+		return outInds;
+	int i = 0;
+#ifdef _M_SSE
+	const __m128i offset = _mm_set1_epi16((s16)indexOffset);
+	for (; i + 8 <= count; i += 8) {
+		const __m128i words = _mm_loadu_si128((const __m128i *)(inds + i));
+		_mm_storeu_si128((__m128i *)(outInds + i), _mm_add_epi16(words, offset));
+	}
+#endif
+	for (; i < count; i++)
+		outInds[i] = indexOffset + inds[i];
+	return outInds + count;
+}
+
+// Writes the (inds[i], inds[i + 1]) pairs of numLines connected lines.
+static u16 *TranslateLineStripRun(u16 *outInds, const u8 *inds, int indexOffset, int numLines) {
+	if (numLines <= 0)
+		return outInds;
+	int i = 0;
+#ifdef _M_SSE
+	const __m128i offset = _mm_set1_epi16((s16)indexOffset);
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= numLines; i += 4) {
+		// Only reads inds[i] through inds[i + 4], all part of these lines.
+		const __m128i first = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const u32_le *)(inds + i)), zero);
+		const __m128i second = _mm_unpacklo_epi8(_mm_cvtsi32_si128(*(const u32_le *)(inds + i + 1)), zero);
+		_mm_storeu_si128((__m128i *)(outInds + i * 2), _mm_add_epi16(_mm_unpacklo_epi16(first, second), offset));
+	}
+#endif
+	for (; i < numLines; i++) {
+		outInds[i * 2] = indexOffset + inds[i];
+		outInds[i * 2 + 1] = indexOffset + inds[i + 1];
+	}
+	return outInds + numLines * 2;
+}
+
+static u16 *TranslateLineStripRun(u16 *outInds, const u16_le *inds, int indexOffset, int numLines) {
+	if (numLines <= 0)
+		return outInds;
+	int i = 0;
+#ifdef _M_SSE
+	const __m128i offset = _mm_set1_epi16((s16)indexOffset);
+	for (; i + 4 <= numLines; i += 4) {
+		const __m128i first = _mm_loadl_epi64((const __m128i *)(inds + i));
+		const __m128i second = _mm_loadl_epi64((const __m128i *)(inds + i + 1));
+		_mm_storeu_si128((__m128i *)(outInds + i * 2), _mm_add_epi16(_mm_unpacklo_epi16(first, second), offset));
+	}
+#endif
+	for (; i < numLines; i++) {
+		outInds[i * 2] = indexOffset + inds[i];
+		outInds[i * 2 + 1] = indexOffset + inds[i + 1];
+	}
+	return outInds + numLines * 2;
+}
+
 void IndexGenerator::Reset() {
 	prim_ = GE_PRIM_INVALID;
 	count_ = 0;
@@ -69,11 +190,7 @@ void IndexGenerator::AddPrim(int prim, int vertexCount) {
 }
 
 void IndexGenerator::AddPoints(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i++)
-		*outInds++ = startIndex + i;
-	inds_ = outInds;
+	inds_ = WriteIndexRamp(inds_, index_, numVerts);
 	// ignore overflow verts
 	index_ += numVerts;
 	count_ += numVerts;
@@ -82,14 +199,8 @@ void IndexGenerator::AddPoints(int numVerts) {
 }
 
 void IndexGenerator::AddList(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i += 3) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-		*outInds++ = startIndex + i + 2;
-	}
-	inds_ = outInds;
+	// Whole triangles, even if that runs past numVerts.
+	inds_ = WriteIndexRamp(inds_, index_, (numVerts + 2) / 3 * 3);
 	// ignore overflow verts
 	index_ += numVerts;
 	count_ += numVerts;
@@ -102,7 +213,26 @@ void IndexGenerator::AddStrip(int numVerts) {
 	const int numTris = numVerts - 2;
 	u16 *outInds = inds_;
 	int ibase = index_;
-	for (int i = 0; i < numTris; i++) {
+	int i = 0;
+#ifdef _M_SSE
+	// Eight triangles at a time. The winding alternates, so it's the same again after each block.
+	const __m128i base = _mm_set1_epi16((s16)ibase);
+	__m128i tris0 = _mm_add_epi16(base, _mm_setr_epi16(0, 1, 2, 1, 3, 2, 2, 3));
+	__m128i tris1 = _mm_add_epi16(base, _mm_setr_epi16(4, 3, 5, 4, 4, 5, 6, 5));
+	__m128i tris2 = _mm_add_epi16(base, _mm_setr_epi16(7, 6, 6, 7, 8, 7, 9, 8));
+	const __m128i step = _mm_set1_epi16(8);
+	for (; i + 8 <= numTris; i += 8) {
+		_mm_storeu_si128((__m128i *)outInds, tris0);
+		_mm_storeu_si128((__m128i *)(outInds + 8), tris1);
+		_mm_storeu_si128((__m128i *)(outInds + 16), tris2);
+		tris0 = _mm_add_epi16(tris0, step);
+		tris1 = _mm_add_epi16(tris1, step);
+		tris2 = _mm_add_epi16(tris2, step);
+		outInds += 24;
+	}
+	ibase += i;
+#endif
+	for (; i < numTris; i++) {
 		*outInds++ = ibase;
 		*outInds++ = ibase + wind;
 		wind ^= 3;  // toggle between 1 and 2
@@ -130,7 +260,27 @@ void IndexGenerator::AddFan(int numVerts) {
 	const int numTris = numVerts - 2;
 	u16 *outInds = inds_;
 	const int startIndex = index_;
-	for (int i = 0; i < numTris; i++) {
+	int i = 0;
+#ifdef _M_SSE
+	// Eight triangles at a time. Every third index is the center, which doesn't move.
+	const __m128i base = _mm_set1_epi16((s16)startIndex);
+	__m128i tris0 = _mm_add_epi16(base, _mm_setr_epi16(0, 1, 2, 0, 2, 3, 0, 3));
+	__m128i tris1 = _mm_add_epi16(base, _mm_setr_epi16(4, 0, 4, 5, 0, 5, 6, 0));
+	__m128i tris2 = _mm_add_epi16(base, _mm_setr_epi16(6, 7, 0, 7, 8, 0, 8, 9));
+	const __m128i step0 = _mm_setr_epi16(0, 8, 8, 0, 8, 8, 0, 8);
+	const __m128i step1 = _mm_setr_epi16(8, 0, 8, 8, 0, 8, 8, 0);
+	const __m128i step2 = _mm_setr_epi16(8, 8, 0, 8, 8, 0, 8, 8);
+	for (; i + 8 <= numTris; i += 8) {
+		_mm_storeu_si128((__m128i *)outInds, tris0);
+		_mm_storeu_si128((__m128i *)(outInds + 8), tris1);
+		_mm_storeu_si128((__m128i *)(outInds + 16), tris2);
+		tris0 = _mm_add_epi16(tris0, step0);
+		tris1 = _mm_add_epi16(tris1, step1);
+		tris2 = _mm_add_epi16(tris2, step2);
+		outInds += 24;
+	}
+#endif
+	for (; i < numTris; i++) {
 		*outInds++ = startIndex;
 		*outInds++ = startIndex + i + 1;
 		*outInds++ = startIndex + i + 2;
@@ -144,13 +294,7 @@ void IndexGenerator::AddFan(int numVerts) {
 
 //Lines
 void IndexGenerator::AddLineList(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i += 2) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-	}
-	inds_ = outInds;
+	inds_ = WriteIndexRamp(inds_, index_, (numVerts + 1) / 2 * 2);
 	index_ += numVerts;
 	count_ += numVerts;
 	prim_ = GE_PRIM_LINES;
@@ -159,13 +303,7 @@ void IndexGenerator::AddLineList(int numVerts) {
 
 void IndexGenerator::AddLineStrip(int numVerts) {
 	const int numLines = numVerts - 1;
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numLines; i++) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-	}
-	inds_ = outInds;
+	inds_ = WriteLineStripRamp(inds_, index_, numLines);
 	index_ += numVerts;
 	count_ += numLines * 2;
 	prim_ = GE_PRIM_LINES;
@@ -173,13 +311,7 @@ void IndexGenerator::AddLineStrip(int numVerts) {
 }
 
 void IndexGenerator::AddRectangles(int numVerts) {
-	u16 *outInds = inds_;
-	const int startIndex = index_;
-	for (int i = 0; i < numVerts; i += 2) {
-		*outInds++ = startIndex + i;
-		*outInds++ = startIndex + i + 1;
-	}
-	inds_ = outInds;
+	inds_ = WriteIndexRamp(inds_, index_, (numVerts + 1) / 2 * 2);
 	index_ += numVerts;
 	count_ += numVerts;
 	prim_ = GE_PRIM_RECTANGLES;
@@ -212,10 +344,7 @@ void IndexGenerator::TranslatePrim(int prim, int numInds, const u16 *inds, int i
 
 void IndexGenerator::TranslatePoints(int numInds, const u8 *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i++)
-		*outInds++ = indexOffset + inds[i];
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, numInds);
 	count_ += numInds;
 	prim_ = GE_PRIM_POINTS;
 	seenPrims_ |= (1 << GE_PRIM_POINTS) | SEEN_INDEX8;
@@ -224,10 +353,7 @@ void IndexGenerator::TranslatePoints(int numInds, const u8 *inds, int indexOffse
 void IndexGenerator::TranslatePoints(int numInds, const u16 *_inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
 	const u16_le *inds = (u16_le*)_inds;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i++)
-		*outInds++ = indexOffset + inds[i];
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, numInds);
 	count_ += numInds;
 	prim_ = GE_PRIM_POINTS;
 	seenPrims_ |= (1 << GE_PRIM_POINTS) | SEEN_INDEX16;
@@ -235,13 +361,8 @@ void IndexGenerator::TranslatePoints(int numInds, const u16 *_inds, int indexOff
 
 void IndexGenerator::TranslateList(int numInds, const u8 *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i += 3) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i + 1];
-		*outInds++ = indexOffset + inds[i + 2];
-	}
-	inds_ = outInds;
+	// Whole triangles, even if that runs past numInds.
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, (numInds + 2) / 3 * 3);
 	count_ += numInds;
 	prim_ = GE_PRIM_TRIANGLES;
 	seenPrims_ |= (1 << GE_PRIM_TRIANGLES) | SEEN_INDEX8;
@@ -283,13 +404,7 @@ void IndexGenerator::TranslateFan(int numInds, const u8 *inds, int indexOffset)
 void IndexGenerator::TranslateList(int numInds, const u16 *_inds, int indexOffset) {
 	const u16_le *inds = (u16_le*)_inds;
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i += 3) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i + 1];
-		*outInds++ = indexOffset + inds[i + 2];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, (numInds + 2) / 3 * 3);
 	count_ += numInds;
 	prim_ = GE_PRIM_TRIANGLES;
 	seenPrims_ |= (1 << GE_PRIM_TRIANGLES) | SEEN_INDEX16;
@@ -332,12 +447,7 @@ void IndexGenerator::TranslateFan(int numInds, const u16 *_inds, int indexOffset
 
 void IndexGenerator::TranslateLineList(int numInds, const u8 *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i+1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, (numInds + 1) / 2 * 2);
 	prim_ = GE_PRIM_LINES;
 	seenPrims_ |= (1 << GE_PRIM_LINES) | SEEN_INDEX8;
 }
@@ -345,12 +455,7 @@ void IndexGenerator::TranslateLineList(int numInds, const u8 *inds, int indexOff
 void IndexGenerator::TranslateLineStrip(int numInds, const u8 *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
 	int numLines = numInds - 1;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numLines; i++) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i + 1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateLineStripRun(inds_, inds, indexOffset, numLines);
 	count_ += numLines * 2;
 	prim_ = GE_PRIM_LINES;
 	seenPrims_ |= (1 << GE_PRIM_LINE_STRIP) | SEEN_INDEX8;
@@ -359,12 +464,7 @@ void IndexGenerator::TranslateLineStrip(int numInds, const u8 *inds, int indexOf
 void IndexGenerator::TranslateLineList(int numInds, const u16 *_inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
 	const u16_le *inds = (u16_le*)_inds;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i+1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, (numInds + 1) / 2 * 2);
 	count_ += numInds;
 	prim_ = GE_PRIM_LINES;
 	seenPrims_ |= (1 << GE_PRIM_LINES) | SEEN_INDEX16;
@@ -374,12 +474,7 @@ void IndexGenerator::TranslateLineStrip(int numInds, const u16 *_inds, int index
 	indexOffset = index_ - indexOffset;
 	const u16_le *inds = (u16_le*)_inds;
 	int numLines = numInds - 1;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numLines; i++) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i + 1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateLineStripRun(inds_, inds, indexOffset, numLines);
 	count_ += numLines * 2;
 	prim_ = GE_PRIM_LINES;
 	seenPrims_ |= (1 << GE_PRIM_LINE_STRIP) | SEEN_INDEX16;
@@ -387,12 +482,7 @@ void IndexGenerator::TranslateLineStrip(int numInds, const u16 *_inds, int index
 
 void IndexGenerator::TranslateRectangles(int numInds, const u8 *inds, int indexOffset) {
 	indexOffset = index_ - indexOffset;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i+1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, (numInds + 1) / 2 * 2);
 	count_ += numInds;
 	prim_ = GE_PRIM_RECTANGLES;
 	seenPrims_ |= (1 << GE_PRIM_RECTANGLES) | SEEN_INDEX8;
@@ -401,12 +491,7 @@ void IndexGenerator::TranslateRectangles(int numInds, const u8 *inds, int indexO
 void IndexGenerator::TranslateRectangles(int numInds, const u16 *_inds, int indexOffset) {	
 	indexOffset = index_ - indexOffset;
 	const u16_le *inds = (u16_le*)_inds;
-	u16 *outInds = inds_;
-	for (int i = 0; i < numInds; i += 2) {
-		*outInds++ = indexOffset + inds[i];
-		*outInds++ = indexOffset + inds[i+1];
-	}
-	inds_ = outInds;
+	inds_ = TranslateIndexRun(inds_, inds, indexOffset, (numInds + 1) / 2 * 2);
 	count_ += numInds * 2;
 	prim_ = GE_PRIM_RECTANGLES;
 	seenPrims_ |= (1 << GE_PRIM_RECTANGLES) | SEEN_INDEX16;
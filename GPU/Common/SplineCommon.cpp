@@ -0,0 +1,861 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <map>
+#include <vector>
+
+#include "base/functional.h"
+#include "Common/ThreadPools.h"
+#include "Core/Config.h"
+#include "GPU/GPUState.h"
+#include "GPU/Math3D.h"
+#include "GPU/Common/SplineCommon.h"
+#include "ext/xxhash.h"
+
+// Here's how to evaluate them fast:
+// http://and-what-happened.blogspot.se/2012/07/evaluating-b-splines-aka-basis-splines.html
+
+u32 NormalizeDecodedVertices(SimpleVertex *sverts, u8 *decoded, const DecVtxFormat &decFmt, int lowerBound, int upperBound, u32 vertType) {
+	// Morphing is eliminated by the decoder, but bones still remain to be taken care of.
+	// Let's do a partial software transform where we only do skinning.
+	VertexReader reader(decoded, decFmt, vertType);
+
+	const u8 defaultColor[4] = {
+		(u8)gstate.getMaterialAmbientR(),
+		(u8)gstate.getMaterialAmbientG(),
+		(u8)gstate.getMaterialAmbientB(),
+		(u8)gstate.getMaterialAmbientA(),
+	};
+
+	// Let's have two separate loops, one for non skinning and one for skinning.
+	if (!g_Config.bSoftwareSkinning && (vertType & GE_VTYPE_WEIGHT_MASK) != GE_VTYPE_WEIGHT_NONE) {
+		int numBoneWeights = vertTypeGetNumBoneWeights(vertType);
+		for (int i = lowerBound; i <= upperBound; i++) {
+			// The decoder wrote lowerBound first.
+			reader.Goto(i - lowerBound);
+			SimpleVertex &sv = sverts[i];
+			if (vertType & GE_VTYPE_TC_MASK) {
+				reader.ReadUV(sv.uv);
+			} else {
+				sv.uv[0] = 0;  // This will get filled in during tesselation
+				sv.uv[1] = 0;
+			}
+
+			if (vertType & GE_VTYPE_COL_MASK) {
+				reader.ReadColor0_8888(sv.color);
+			} else {
+				memcpy(sv.color, defaultColor, 4);
+			}
+
+			float nrm[3], pos[3];
+			float bnrm[3], bpos[3];
+
+			if (vertType & GE_VTYPE_NRM_MASK) {
+				// Normals are generated during tesselation anyway, not sure if any need to supply
+				reader.ReadNrm(nrm);
+			} else {
+				nrm[0] = 0;
+				nrm[1] = 0;
+				nrm[2] = 1.0f;
+			}
+			reader.ReadPos(pos);
+
+			// Apply skinning transform directly
+			float weights[8];
+			reader.ReadWeights(weights);
+			// Skinning
+			Vec3f psum(0,0,0);
+			Vec3f nsum(0,0,0);
+			for (int w = 0; w < numBoneWeights; w++) {
+				if (weights[w] != 0.0f) {
+					Vec3ByMatrix43(bpos, pos, gstate.boneMatrix+w*12);
+					Vec3f tpos(bpos);
+					psum += tpos * weights[w];
+
+					Norm3ByMatrix43(bnrm, nrm, gstate.boneMatrix+w*12);
+					Vec3f tnorm(bnrm);
+					nsum += tnorm * weights[w];
+				}
+			}
+			sv.pos = psum;
+			sv.nrm = nsum;
+		}
+	} else {
+		for (int i = lowerBound; i <= upperBound; i++) {
+			reader.Goto(i - lowerBound);
+			SimpleVertex &sv = sverts[i];
+			if (vertType & GE_VTYPE_TC_MASK) {
+				reader.ReadUV(sv.uv);
+			} else {
+				sv.uv[0] = 0;  // This will get filled in during tesselation
+				sv.uv[1] = 0;
+			}
+			if (vertType & GE_VTYPE_COL_MASK) {
+				reader.ReadColor0_8888(sv.color);
+			} else {
+				memcpy(sv.color, defaultColor, 4);
+			}
+			if (vertType & GE_VTYPE_NRM_MASK) {
+				// Normals are generated during tesselation anyway, not sure if any need to supply
+				reader.ReadNrm((float *)&sv.nrm);
+			} else {
+				sv.nrm.x = 0;
+				sv.nrm.y = 0;
+				sv.nrm.z = 1.0f;
+			}
+			reader.ReadPos((float *)&sv.pos);
+		}
+	}
+
+	// Okay, there we are! Return the new type (but keep the index bits)
+	return GE_VTYPE_TC_FLOAT | GE_VTYPE_COL_8888 | GE_VTYPE_NRM_FLOAT | GE_VTYPE_POS_FLOAT | (vertType & GE_VTYPE_IDX_MASK);
+}
+
+#define START_OPEN 1
+#define END_OPEN 2
+
+enum {
+	// Below this many tesselated vertices, handing out the work costs more than it saves.
+	MIN_PARALLEL_TESS_VERTS = 1024,
+	// Limits for the remembered output.
+	MAX_TESS_OUTPUTS = 64,
+	MAX_TESS_OUTPUT_BYTES = 8 * 1024 * 1024,
+	MAX_SPLINE_WEIGHT_TABLES = 256,
+};
+
+static float lerp(float a, float b, float x) {
+	return a + x * (b - a);
+}
+
+static void lerpColor(const u8 a[4], const u8 b[4], float x, u8 out[4]) {
+	for (int i = 0; i < 4; i++) {
+		out[i] = (float)a[i] + x * ((float)b[i] - (float)a[i]);
+	}
+}
+
+void BezierPatch::sampleColor(float u, float v, u8 color[4]) const {
+	u *= 3.0f;
+	v *= 3.0f;
+	int iu = (int)floorf(u);
+	int iv = (int)floorf(v);
+	int iu2 = iu + 1;
+	int iv2 = iv + 1;
+	float fracU = u - iu;
+	float fracV = v - iv;
+	if (iu2 > 3) iu2 = 3;
+	if (iv2 > 3) iv2 = 3;
+
+	int tl = iu + 4 * iv;
+	int tr = iu2 + 4 * iv;
+	int bl = iu + 4 * iv2;
+	int br = iu2 + 4 * iv2;
+
+	u8 upperColor[4], lowerColor[4];
+	lerpColor(points[tl]->color, points[tr]->color, fracU, upperColor);
+	lerpColor(points[bl]->color, points[br]->color, fracU, lowerColor);
+	lerpColor(upperColor, lowerColor, fracV, color);
+}
+
+void BezierPatch::sampleTexUV(float u, float v, float &tu, float &tv) const {
+	u *= 3.0f;
+	v *= 3.0f;
+	int iu = (int)floorf(u);
+	int iv = (int)floorf(v);
+	int iu2 = iu + 1;
+	int iv2 = iv + 1;
+	float fracU = u - iu;
+	float fracV = v - iv;
+	if (iu2 > 3) iu2 = 3;
+	if (iv2 > 3) iv2 = 3;
+
+	int tl = iu + 4 * iv;
+	int tr = iu2 + 4 * iv;
+	int bl = iu + 4 * iv2;
+	int br = iu2 + 4 * iv2;
+
+	float upperTU = lerp(points[tl]->uv[0], points[tr]->uv[0], fracU);
+	float upperTV = lerp(points[tl]->uv[1], points[tr]->uv[1], fracU);
+	float lowerTU = lerp(points[bl]->uv[0], points[br]->uv[0], fracU);
+	float lowerTV = lerp(points[bl]->uv[1], points[br]->uv[1], fracU);
+	tu = lerp(upperTU, lowerTU, fracV);
+	tv = lerp(upperTV, lowerTV, fracV);
+}
+
+static void CopyQuad(u8 *&dest, const SimpleVertex *v1, const SimpleVertex *v2, const SimpleVertex* v3, const SimpleVertex *v4) {
+	int vertexSize = sizeof(SimpleVertex);
+	memcpy(dest, v1, vertexSize);
+	dest += vertexSize;
+	memcpy(dest, v2, vertexSize);
+	dest += vertexSize;
+	memcpy(dest, v3, vertexSize);
+	dest += vertexSize;
+	memcpy(dest, v4, vertexSize);
+	dest += vertexSize;
+}
+
+#undef b2
+
+// Bernstein basis functions
+inline float bern0(float x) { return (1 - x) * (1 - x) * (1 - x); }
+inline float bern1(float x) { return 3 * x * (1 - x) * (1 - x); }
+inline float bern2(float x) { return 3 * x * x * (1 - x); }
+inline float bern3(float x) { return x * x * x; }
+
+inline float bern0deriv(float x) { return -3 * (x - 1) * (x - 1); }
+inline float bern1deriv(float x) { return 9 * x * x - 12 * x + 3; }
+inline float bern2deriv(float x) { return 3 * (2 - 3 * x) * x; }
+inline float bern3deriv(float x) { return 3 * x * x; }
+
+// http://en.wikipedia.org/wiki/Bernstein_polynomial
+// The weights are the four basis functions (or their derivatives) at the sample point.
+static inline Vec3f Bernstein3D(const Vec3f &p0, const Vec3f &p1, const Vec3f &p2, const Vec3f &p3, const float w[4]) {
+	return p0 * w[0] + p1 * w[1] + p2 * w[2] + p3 * w[3];
+}
+
+// Basis weights at i / tess for i = 0..tess, four per sample.
+struct BezierWeights {
+	std::vector<float> basis;
+	std::vector<float> deriv;
+};
+
+void spline_n_4(int i, float t, float *knot, float *splineVal) {
+	knot += i + 1;
+
+	float t0 = (t - knot[0]);
+	float t1 = (t - knot[1]);
+	float t2 = (t - knot[2]);
+	float f30 = t0/(knot[3]-knot[0]);
+	float f41 = t1/(knot[4]-knot[1]);
+	float f52 = t2/(knot[5]-knot[2]);
+	float f31 = t1/(knot[3]-knot[1]);
+	float f42 = t2/(knot[4]-knot[2]);
+	float f32 = t2/(knot[3]-knot[2]);
+	float a = (1-f30)*(1-f31);
+	float b = (f31*f41);
+	float c = (1-f41)*(1-f42);
+	float d = (f42*f52);
+
+	splineVal[0] = a-(a*f32);
+	splineVal[1] = 1-a-b+((a+b+c-1)*f32);
+	splineVal[2] = b+((1-b-c-d)*f32);
+	splineVal[3] = d*f32;
+}
+
+// knot should be an array sized n + 5  (n + 1 + 1 + degree (cubic))
+void spline_knot(int n, int type, float *knot) {
+	memset(knot, 0, sizeof(float) * (n + 5));
+	for (int i = 0; i < n - 1; ++i)
+		knot[i + 3] = i;
+
+	if ((type & 1) == 0) {
+		knot[0] = -3;
+		knot[1] = -2;
+		knot[2] = -1;
+	}
+	if ((type & 2) == 0) {
+		knot[n + 2] = n - 1;
+		knot[n + 3] = n;
+		knot[n + 4] = n + 1;
+	} else {
+		knot[n + 2] = n - 2;
+		knot[n + 3] = n - 2;
+		knot[n + 4] = n - 2;
+	}
+}
+
+// The first control point and four B-spline weights for one row or column of the tesselation.
+struct SplineWeight {
+	int index;
+	float weights[4];
+};
+
+// Both kinds of table only depend on the tesselation level (and for splines, the knots), so they're
+// built once and kept. Only touched from the GPU thread, before any work is handed out.
+static std::map<int, BezierWeights> bezierWeights;
+static std::map<u32, std::vector<SplineWeight> > splineWeights;
+
+static const BezierWeights &GetBezierWeights(int tess) {
+	std::map<int, BezierWeights>::iterator iter = bezierWeights.find(tess);
+	if (iter != bezierWeights.end())
+		return iter->second;
+
+	BezierWeights &w = bezierWeights[tess];
+	w.basis.resize((tess + 1) * 4);
+	w.deriv.resize((tess + 1) * 4);
+	for (int i = 0; i < tess + 1; i++) {
+		float x = ((float)i / (float)tess);
+		w.basis[i * 4 + 0] = bern0(x);
+		w.basis[i * 4 + 1] = bern1(x);
+		w.basis[i * 4 + 2] = bern2(x);
+		w.basis[i * 4 + 3] = bern3(x);
+		w.deriv[i * 4 + 0] = bern0deriv(x);
+		w.deriv[i * 4 + 1] = bern1deriv(x);
+		w.deriv[i * 4 + 2] = bern2deriv(x);
+		w.deriv[i * 4 + 3] = bern3deriv(x);
+	}
+	return w;
+}
+
+// count is the number of control points along the direction, type its open/closed flags.
+// The returned table stays valid until the next TrimSplineWeights().
+static const SplineWeight *GetSplineWeights(int count, int type, int patch_div) {
+	const u32 key = (u32)count | ((u32)type << 16) | ((u32)patch_div << 18);
+	std::map<u32, std::vector<SplineWeight> >::iterator iter = splineWeights.find(key);
+	if (iter != splineWeights.end())
+		return &iter->second[0];
+
+	const int n = count - 1;
+	float *knot = new float[n + 5];
+	spline_knot(n, type, knot);
+
+	std::vector<SplineWeight> &table = splineWeights[key];
+	table.resize(patch_div + 1);
+	for (int tile = 0; tile < patch_div + 1; tile++) {
+		float t = ((float)tile * (float)(n - 2) / (float)(patch_div + 0.00001f));  // epsilon to prevent division by 0 in spline_s
+		table[tile].index = (int)t;
+		spline_n_4(table[tile].index, t, knot, table[tile].weights);
+	}
+
+	delete [] knot;
+	return &table[0];
+}
+
+static void TrimSplineWeights() {
+	if (splineWeights.size() >= MAX_SPLINE_WEIGHT_TABLES)
+		splineWeights.clear();
+}
+
+static bool ShouldTesselateInParallel(int numVerts) {
+	return numVerts >= MIN_PARALLEL_TESS_VERTS && g_Config.iNumWorkerThreads > 1;
+}
+
+// Output of recent tesselations, found by a hash of everything the output depends on.
+// The full key is kept and compared, so a hash collision is just a miss.
+struct TesselationOutput {
+	std::vector<u8> key;
+	std::vector<u8> verts;
+	int count;
+	u32 lastUse;
+};
+
+static std::map<u32, TesselationOutput> tessOutputs;
+static size_t tessOutputBytes;
+static u32 tessUseCounter;
+static std::vector<u8> tessKey;
+
+static void StartTesselationKey(bool bezier, u32 origVertType) {
+	const int header[5] = {
+		bezier ? 1 : 0,
+		(int)(origVertType & (GE_VTYPE_TC_MASK | GE_VTYPE_COL_MASK | GE_VTYPE_NRM_MASK)),
+		g_Config.bLowQualitySplineBezier ? 1 : 0,
+		gstate.isLightingEnabled() ? 1 : 0,
+		(int)(gstate.patchfacing & 1),
+	};
+	tessKey.assign((const u8 *)header, (const u8 *)header + sizeof(header));
+}
+
+static void AddToTesselationKey(const void *data, size_t size) {
+	tessKey.insert(tessKey.end(), (const u8 *)data, (const u8 *)data + size);
+}
+
+static bool LookupTesselation(u8 *&dest, int &count) {
+	const u32 hash = XXH32(&tessKey[0], (int)tessKey.size(), 0x5F11E);
+	std::map<u32, TesselationOutput>::iterator iter = tessOutputs.find(hash);
+	if (iter == tessOutputs.end() || iter->second.key != tessKey)
+		return false;
+
+	TesselationOutput &out = iter->second;
+	if (!out.verts.empty())
+		memcpy(dest, &out.verts[0], out.verts.size());
+	dest += out.verts.size();
+	count += out.count;
+	out.lastUse = ++tessUseCounter;
+	return true;
+}
+
+static void RememberTesselation(const u8 *start, const u8 *end, int count) {
+	const size_t size = end - start;
+	if (size > MAX_TESS_OUTPUT_BYTES / 4)
+		return;
+
+	const u32 hash = XXH32(&tessKey[0], (int)tessKey.size(), 0x5F11E);
+	std::map<u32, TesselationOutput>::iterator existing = tessOutputs.find(hash);
+	if (existing != tessOutputs.end()) {
+		tessOutputBytes -= existing->second.verts.size();
+		tessOutputs.erase(existing);
+	}
+
+	// Throw out the least recently used until there's room.
+	while (!tessOutputs.empty() && (tessOutputs.size() >= MAX_TESS_OUTPUTS || tessOutputBytes + size > MAX_TESS_OUTPUT_BYTES)) {
+		std::map<u32, TesselationOutput>::iterator oldest = tessOutputs.begin();
+		for (std::map<u32, TesselationOutput>::iterator iter = tessOutputs.begin(); iter != tessOutputs.end(); ++iter) {
+			if (iter->second.lastUse < oldest->second.lastUse)
+				oldest = iter;
+		}
+		tessOutputBytes -= oldest->second.verts.size();
+		tessOutputs.erase(oldest);
+	}
+
+	TesselationOutput &out = tessOutputs[hash];
+	out.key = tessKey;
+	out.verts.assign(start, end);
+	out.count = count;
+	out.lastUse = ++tessUseCounter;
+	tessOutputBytes += size;
+}
+
+void ClearSplineCaches() {
+	tessOutputs.clear();
+	tessOutputBytes = 0;
+	bezierWeights.clear();
+	splineWeights.clear();
+}
+
+struct SplineTesselation {
+	const SplinePatch *spatch;
+	u32 origVertType;
+	SimpleVertex *vertices;
+	const SplineWeight *uWeights;
+	const SplineWeight *vWeights;
+	int patch_div_s;
+	int patch_div_t;
+	float tu_width;
+	float tv_height;
+};
+
+static void TesselateSplineRows(const SplineTesselation *tess, int lower, int upper) {
+	const SplinePatch &spatch = *tess->spatch;
+	const u32 origVertType = tess->origVertType;
+	const int patch_div_s = tess->patch_div_s;
+	const int patch_div_t = tess->patch_div_t;
+
+	for (int tile_v = lower; tile_v < upper; tile_v++) {
+		const SplineWeight &vw = tess->vWeights[tile_v];
+		for (int tile_u = 0; tile_u < patch_div_s + 1; tile_u++) {
+			const SplineWeight &uw = tess->uWeights[tile_u];
+
+			SimpleVertex *vert = &tess->vertices[tile_v * (patch_div_s + 1) + tile_u];
+			vert->pos.SetZero();
+			if (origVertType & GE_VTYPE_NRM_MASK) {
+				vert->nrm.SetZero();
+			} else {
+				vert->nrm.SetZero();
+				vert->nrm.z = 1.0f;
+			}
+			if (origVertType & GE_VTYPE_COL_MASK) {
+				memset(vert->color, 0, 4);
+			} else {
+				memcpy(vert->color, spatch.points[0]->color, 4);
+			}
+			if (origVertType & GE_VTYPE_TC_MASK) {
+				vert->uv[0] = 0.0f;
+				vert->uv[1] = 0.0f;
+			} else {
+				vert->uv[0] = tess->tu_width * ((float)tile_u / (float)patch_div_s);
+				vert->uv[1] = tess->tv_height * ((float)tile_v / (float)patch_div_t);
+			}
+
+			// Collect influences from surrounding control points.
+			const int iu = uw.index;
+			const int iv = vw.index;
+			for (int ii = 0; ii < 4; ++ii) {
+				for (int jj = 0; jj < 4; ++jj) {
+					float u_spline = uw.weights[ii];
+					float v_spline = vw.weights[jj];
+					float f = u_spline * v_spline;
+
+					if (f > 0.0f) {
+						SimpleVertex *a = spatch.points[spatch.count_u * (iv + jj) + (iu + ii)];
+						vert->pos += a->pos * f;
+						if (origVertType & GE_VTYPE_TC_MASK) {
+							vert->uv[0] += a->uv[0] * f;
+							vert->uv[1] += a->uv[1] * f;
+						}
+						if (origVertType & GE_VTYPE_COL_MASK) {
+							vert->color[0] += a->color[0] * f;
+							vert->color[1] += a->color[1] * f;
+							vert->color[2] += a->color[2] * f;
+							vert->color[3] += a->color[3] * f;
+						}
+						if (origVertType & GE_VTYPE_NRM_MASK) {
+							vert->nrm += a->nrm * f;
+						}
+					}
+				}
+			}
+			if (origVertType & GE_VTYPE_NRM_MASK) {
+				vert->nrm.Normalize();
+			}
+		}
+	}
+}
+
+// Hacky normal generation through central difference. Needs all the positions first.
+static void GenerateSplineNormalRows(const SplineTesselation *tess, int lower, int upper) {
+	const int patch_div_s = tess->patch_div_s;
+	const int patch_div_t = tess->patch_div_t;
+	SimpleVertex *vertices = tess->vertices;
+
+	for (int v = lower; v < upper; v++) {
+		for (int u = 0; u < patch_div_s + 1; u++) {
+			int l = std::max(0, u - 1);
+			int t = std::max(0, v - 1);
+			int r = std::min(patch_div_s, u + 1);
+			int b = std::min(patch_div_t, v + 1);
+
+			const Vec3f &right = vertices[v * (patch_div_s + 1) + r].pos - vertices[v * (patch_div_s + 1) + l].pos;
+			const Vec3f &down = vertices[b * (patch_div_s + 1) + u].pos - vertices[t * (patch_div_s + 1) + u].pos;
+
+			vertices[v * (patch_div_s + 1) + u].nrm = Cross(right, down).Normalized();
+			if (gstate.patchfacing & 1) {
+				vertices[v * (patch_div_s + 1) + u].nrm *= -1.0f;
+			}
+		}
+	}
+}
+
+static void TesselateSplinePatchLowQuality(u8 *&dest, int &count, const SplinePatch &spatch, u32 origVertType) {
+	const float third = 1.0f / 3.0f;
+
+	// Fast and easy way - just draw the control points, generate some very basic normal vector substitutes.
+	// Very inaccurate but okay for Loco Roco. Maybe should keep it as an option because it's fast.
+
+	const int tile_min_u = (spatch.type_u & START_OPEN) ? 0 : 1;
+	const int tile_min_v = (spatch.type_v & START_OPEN) ? 0 : 1;
+	const int tile_max_u = (spatch.type_u & END_OPEN) ? spatch.count_u - 1 : spatch.count_u - 2;
+	const int tile_max_v = (spatch.type_v & END_OPEN) ? spatch.count_v - 1 : spatch.count_v - 2;
+
+	for (int tile_v = tile_min_v; tile_v < tile_max_v; ++tile_v) {
+		for (int tile_u = tile_min_u; tile_u < tile_max_u; ++tile_u) {
+			int point_index = tile_u + tile_v * spatch.count_u;
+
+			SimpleVertex v0 = *spatch.points[point_index];
+			SimpleVertex v1 = *spatch.points[point_index+1];
+			SimpleVertex v2 = *spatch.points[point_index+spatch.count_u];
+			SimpleVertex v3 = *spatch.points[point_index+spatch.count_u+1];
+
+			// Generate UV. TODO: Do this even if UV specified in control points?
+			if ((origVertType & GE_VTYPE_TC_MASK) == 0) {
+				float u = tile_u * third;
+				float v = tile_v * third;
+				v0.uv[0] = u;
+				v0.uv[1] = v;
+				v1.uv[0] = u + third;
+				v1.uv[1] = v;
+				v2.uv[0] = u;
+				v2.uv[1] = v + third;
+				v3.uv[0] = u + third;
+				v3.uv[1] = v + third;
+			}
+
+			// Generate normal if lighting is enabled (otherwise there's no point).
+			// This is a really poor quality algorithm, we get facet normals.
+			if (gstate.isLightingEnabled()) {
+				Vec3f norm = Cross(v1.pos - v0.pos, v2.pos - v0.pos);
+				norm.Normalize();
+				if (gstate.patchfacing & 1)
+					norm *= -1.0f;
+				v0.nrm = norm;
+				v1.nrm = norm;
+				v2.nrm = norm;
+				v3.nrm = norm;
+			}
+
+			CopyQuad(dest, &v0, &v1, &v2, &v3);
+			count += 6;
+		}
+	}
+}
+
+void TesselateSplinePatch(u8 *&dest, int &count, const SplinePatch &spatch, u32 origVertType) {
+	int patch_div_s = gstate.getPatchDivisionU();
+	int patch_div_t = gstate.getPatchDivisionV();
+
+	StartTesselationKey(false, origVertType);
+	const int params[6] = { spatch.count_u, spatch.count_v, spatch.type_u, spatch.type_v, patch_div_s, patch_div_t };
+	AddToTesselationKey(params, sizeof(params));
+	for (int i = 0; i < spatch.count_u * spatch.count_v; i++)
+		AddToTesselationKey(spatch.points[i], sizeof(SimpleVertex));
+	if (LookupTesselation(dest, count))
+		return;
+
+	u8 *const start = dest;
+	const int startCount = count;
+
+	if (g_Config.bLowQualitySplineBezier) {
+		TesselateSplinePatchLowQuality(dest, count, spatch, origVertType);
+		RememberTesselation(start, dest, count - startCount);
+		return;
+	}
+
+	// Full correct tessellation of spline patches.
+	// Does not yet generate normals and is atrociously slow (see spline_s...)
+
+	// Increase tesselation based on the size. Should be approximately right?
+	// JPCSP is wrong at least because their method results in square loco roco.
+	patch_div_s = (spatch.count_u - 3) * patch_div_s / 3;
+	patch_div_t = (spatch.count_v - 3) * patch_div_t / 3;
+	if (patch_div_s == 0) patch_div_s = 1;
+	if (patch_div_t == 0) patch_div_t = 1;
+
+	// TODO: Remove this cap when spline_s has been optimized.
+	if (patch_div_s > 64) patch_div_s = 64;
+	if (patch_div_t > 64) patch_div_t = 64;
+
+	// First compute all the vertices and put them in an array
+	SimpleVertex *vertices = new SimpleVertex[(patch_div_s + 1) * (patch_div_t + 1)];
+
+	SplineTesselation tess;
+	tess.spatch = &spatch;
+	tess.origVertType = origVertType;
+	tess.vertices = vertices;
+	TrimSplineWeights();
+	tess.uWeights = GetSplineWeights(spatch.count_u, spatch.type_u, patch_div_s);
+	tess.vWeights = GetSplineWeights(spatch.count_v, spatch.type_v, patch_div_t);
+	tess.patch_div_s = patch_div_s;
+	tess.patch_div_t = patch_div_t;
+	tess.tu_width = 1.0f + (spatch.count_u - 4) * 1.0f/3.0f;
+	tess.tv_height = 1.0f + (spatch.count_v - 4) * 1.0f/3.0f;
+
+	// Every row of vertices can be worked out on its own.
+	const bool parallel = ShouldTesselateInParallel((patch_div_s + 1) * (patch_div_t + 1));
+	if (parallel)
+		GlobalThreadPool::Loop(std::bind(&TesselateSplineRows, &tess, placeholder::_1, placeholder::_2), 0, patch_div_t + 1);
+	else
+		TesselateSplineRows(&tess, 0, patch_div_t + 1);
+
+	if (gstate.isLightingEnabled() && (origVertType & GE_VTYPE_NRM_MASK) == 0) {
+		if (parallel)
+			GlobalThreadPool::Loop(std::bind(&GenerateSplineNormalRows, &tess, placeholder::_1, placeholder::_2), 0, patch_div_t + 1);
+		else
+			GenerateSplineNormalRows(&tess, 0, patch_div_t + 1);
+	}
+
+	// Tesselate. TODO: Use indices so we only need to emit 4 vertices per pair of triangles instead of six.
+	for (int tile_v = 0; tile_v < patch_div_t; ++tile_v) {
+		for (int tile_u = 0; tile_u < patch_div_s; ++tile_u) {
+			SimpleVertex *v0 = &vertices[tile_v * (patch_div_s + 1) + tile_u];
+			SimpleVertex *v1 = &vertices[tile_v * (patch_div_s + 1) + tile_u + 1];
+			SimpleVertex *v2 = &vertices[(tile_v + 1) * (patch_div_s + 1) + tile_u];
+			SimpleVertex *v3 = &vertices[(tile_v + 1) * (patch_div_s + 1) + tile_u + 1];
+
+			CopyQuad(dest, v0, v1, v2, v3);
+			count += 6;
+		}
+	}
+
+	delete [] vertices;
+	RememberTesselation(start, dest, count - startCount);
+}
+
+static void TesselateBezierPatchLowQuality(u8 *&dest, const BezierPatch &patch, u32 origVertType) {
+	const float third = 1.0f / 3.0f;
+
+	// Fast and easy way - just draw the control points, generate some very basic normal vector subsitutes.
+	// Very inaccurate though but okay for Loco Roco. Maybe should keep it as an option.
+
+	float u_base = patch.u_index / 3.0f;
+	float v_base = patch.v_index / 3.0f;
+
+	for (int tile_v = 0; tile_v < 3; tile_v++) {
+		for (int tile_u = 0; tile_u < 3; tile_u++) {
+			int point_index = tile_u + tile_v * 4;
+
+			SimpleVertex v0 = *patch.points[point_index];
+			SimpleVertex v1 = *patch.points[point_index+1];
+			SimpleVertex v2 = *patch.points[point_index+4];
+			SimpleVertex v3 = *patch.points[point_index+5];
+
+			// Generate UV. TODO: Do this even if UV specified in control points?
+			if ((origVertType & GE_VTYPE_TC_MASK) == 0) {
+				float u = u_base + tile_u * third;
+				float v = v_base + tile_v * third;
+				v0.uv[0] = u;
+				v0.uv[1] = v;
+				v1.uv[0] = u + third;
+				v1.uv[1] = v;
+				v2.uv[0] = u;
+				v2.uv[1] = v + third;
+				v3.uv[0] = u + third;
+				v3.uv[1] = v + third;
+			}
+
+			// Generate normal if lighting is enabled (otherwise there's no point).
+			// This is a really poor quality algorithm, we get facet normals.
+			if (gstate.isLightingEnabled()) {
+				Vec3f norm = Cross(v1.pos - v0.pos, v2.pos - v0.pos);
+				norm.Normalize();
+				if (gstate.patchfacing & 1)
+					norm *= -1.0f;
+				v0.nrm = norm;
+				v1.nrm = norm;
+				v2.nrm = norm;
+				v3.nrm = norm;
+			}
+
+			CopyQuad(dest, &v0, &v1, &v2, &v3);
+		}
+	}
+}
+
+static void TesselateBezierPatch(u8 *&dest, int tess_u, int tess_v, const BezierPatch &patch, u32 origVertType, const BezierWeights &uWeights, const BezierWeights &vWeights) {
+	const float third = 1.0f / 3.0f;
+
+	// Full correct tesselation of bezier patches.
+	// Note: Does not handle splines correctly.
+
+	// First compute all the vertices and put them in an array
+	SimpleVertex *vertices = new SimpleVertex[(tess_u + 1) * (tess_v + 1)];
+
+	// Precompute the horizontal curves (and their derivatives) so we only have to evaluate the vertical ones.
+	Vec3f *horiz = new Vec3f[(tess_u + 1) * 8];
+	Vec3f *derivU = horiz + (tess_u + 1) * 4;
+	for (int i = 0; i < tess_u + 1; i++) {
+		const float *basis = &uWeights.basis[i * 4];
+		const float *deriv = &uWeights.deriv[i * 4];
+		for (int row = 0; row < 4; row++) {
+			const SimpleVertex *const *p = &patch.points[row * 4];
+			horiz[row * (tess_u + 1) + i] = Bernstein3D(p[0]->pos, p[1]->pos, p[2]->pos, p[3]->pos, basis);
+			derivU[row * (tess_u + 1) + i] = Bernstein3D(p[0]->pos, p[1]->pos, p[2]->pos, p[3]->pos, deriv);
+		}
+	}
+
+	bool computeNormals = gstate.isLightingEnabled();
+
+	for (int tile_v = 0; tile_v < tess_v + 1; ++tile_v) {
+		const float *vBasis = &vWeights.basis[tile_v * 4];
+		const float *vDeriv = &vWeights.deriv[tile_v * 4];
+		for (int tile_u = 0; tile_u < tess_u + 1; ++tile_u) {
+			float u = ((float)tile_u / (float)tess_u);
+			float v = ((float)tile_v / (float)tess_v);
+
+			const Vec3f &pos1 = horiz[tile_u];
+			const Vec3f &pos2 = horiz[(tess_u + 1) * 1 + tile_u];
+			const Vec3f &pos3 = horiz[(tess_u + 1) * 2 + tile_u];
+			const Vec3f &pos4 = horiz[(tess_u + 1) * 3 + tile_u];
+
+			SimpleVertex &vert = vertices[tile_v * (tess_u + 1) + tile_u];
+
+			if (computeNormals) {
+				const Vec3f &derivU1 = derivU[tile_u];
+				const Vec3f &derivU2 = derivU[(tess_u + 1) * 1 + tile_u];
+				const Vec3f &derivU3 = derivU[(tess_u + 1) * 2 + tile_u];
+				const Vec3f &derivU4 = derivU[(tess_u + 1) * 3 + tile_u];
+				Vec3f derivUV = Bernstein3D(derivU1, derivU2, derivU3, derivU4, vBasis);
+				Vec3f derivV = Bernstein3D(pos1, pos2, pos3, pos4, vDeriv);
+
+				// TODO: Interpolate normals instead of generating them, if available?
+				vert.nrm = Cross(derivUV, derivV).Normalized();
+				if (gstate.patchfacing & 1)
+					vert.nrm *= -1.0f;
+			} else {
+				vert.nrm.SetZero();
+			}
+
+			vert.pos = Bernstein3D(pos1, pos2, pos3, pos4, vBasis);
+
+			if ((origVertType & GE_VTYPE_TC_MASK) == 0) {
+				// Generate texcoord
+				vert.uv[0] = u + patch.u_index * third;
+				vert.uv[1] = v + patch.v_index * third;
+			} else {
+				// Sample UV from control points
+				patch.sampleTexUV(u, v, vert.uv[0], vert.uv[1]);
+			}
+
+			if (origVertType & GE_VTYPE_COL_MASK) {
+				patch.sampleColor(u, v, vert.color);
+			} else {
+				memcpy(vert.color, patch.points[0]->color, 4);
+			}
+		}
+	}
+	delete [] horiz;
+
+	// Tesselate. TODO: Use indices so we only need to emit 4 vertices per pair of triangles instead of six.
+	for (int tile_v = 0; tile_v < tess_v; ++tile_v) {
+		for (int tile_u = 0; tile_u < tess_u; ++tile_u) {
+			const SimpleVertex *v0 = &vertices[tile_v * (tess_u + 1) + tile_u];
+			const SimpleVertex *v1 = &vertices[tile_v * (tess_u + 1) + tile_u + 1];
+			const SimpleVertex *v2 = &vertices[(tile_v + 1) * (tess_u + 1) + tile_u];
+			const SimpleVertex *v3 = &vertices[(tile_v + 1) * (tess_u + 1) + tile_u + 1];
+
+			CopyQuad(dest, v0, v1, v2, v3);
+		}
+	}
+
+	delete [] vertices;
+}
+
+struct BezierTesselation {
+	u8 *dest;
+	int patchBytes;
+	int tess_u;
+	int tess_v;
+	const BezierPatch *patches;
+	u32 origVertType;
+	const BezierWeights *uWeights;
+	const BezierWeights *vWeights;
+};
+
+// Every patch writes the same number of quads, so each knows where its output goes.
+static void TesselateBezierPatchRange(const BezierTesselation *tess, int lower, int upper) {
+	for (int i = lower; i < upper; i++) {
+		u8 *dest = tess->dest + i * tess->patchBytes;
+		if (g_Config.bLowQualitySplineBezier)
+			TesselateBezierPatchLowQuality(dest, tess->patches[i], tess->origVertType);
+		else
+			TesselateBezierPatch(dest, tess->tess_u, tess->tess_v, tess->patches[i], tess->origVertType, *tess->uWeights, *tess->vWeights);
+	}
+}
+
+void TesselateBezierPatches(u8 *&dest, int &count, int tess_u, int tess_v, const BezierPatch *patches, int numPatches, u32 origVertType) {
+	StartTesselationKey(true, origVertType);
+	const int params[3] = { tess_u, tess_v, numPatches };
+	AddToTesselationKey(params, sizeof(params));
+	for (int i = 0; i < numPatches; i++) {
+		const int indices[2] = { patches[i].u_index, patches[i].v_index };
+		AddToTesselationKey(indices, sizeof(indices));
+		for (int point = 0; point < 16; point++)
+			AddToTesselationKey(patches[i].points[point], sizeof(SimpleVertex));
+	}
+	if (LookupTesselation(dest, count))
+		return;
+
+	const int quadsPerPatch = g_Config.bLowQualitySplineBezier ? 3 * 3 : tess_u * tess_v;
+
+	BezierTesselation tess;
+	tess.dest = dest;
+	tess.patchBytes = quadsPerPatch * 4 * sizeof(SimpleVertex);
+	tess.tess_u = tess_u;
+	tess.tess_v = tess_v;
+	tess.patches = patches;
+	tess.origVertType = origVertType;
+	// Look these up here, the tables aren't safe to fill from the workers.
+	tess.uWeights = &GetBezierWeights(tess_u);
+	tess.vWeights = &GetBezierWeights(tess_v);
+
+	if (numPatches > 1 && ShouldTesselateInParallel(numPatches * quadsPerPatch * 4))
+		GlobalThreadPool::Loop(std::bind(&TesselateBezierPatchRange, &tess, placeholder::_1, placeholder::_2), 0, numPatches);
+	else
+		TesselateBezierPatchRange(&tess, 0, numPatches);
+
+	u8 *const start = dest;
+	dest += numPatches * tess.patchBytes;
+	count += numPatches * quadsPerPatch * 6;
+	RememberTesselation(start, dest, numPatches * quadsPerPatch * 6);
+}
@@ -19,6 +19,7 @@
 
 #include "Common/CommonTypes.h"
 #include "GPU/Math3D.h"
+#include "GPU/Common/VertexDecoderCommon.h"
 
 // PSP compatible format so we can use the end of the pipeline in beziers etc
 struct SimpleVertex {
@@ -27,3 +28,37 @@ struct SimpleVertex {
 	Vec3f nrm;
 	Vec3f pos;
 };
+
+// We decode all vertices into a common format for easy interpolation and stuff.
+// Not fast but can be optimized later.
+struct BezierPatch {
+	SimpleVertex *points[16];
+
+	// These are used to generate UVs.
+	int u_index, v_index;
+
+	// Interpolate colors between control points (bilinear, should be good enough).
+	void sampleColor(float u, float v, u8 color[4]) const;
+	void sampleTexUV(float u, float v, float &tu, float &tv) const;
+};
+
+struct SplinePatch {
+	SimpleVertex **points;
+	int count_u;
+	int count_v;
+	int type_u;
+	int type_v;
+};
+
+// Turns decoded vertices (morphing already applied by the decoder) into SimpleVertex, doing software
+// skinning if the decoder didn't. Returns the vertex type of the SimpleVertex data, keeping the index bits.
+u32 NormalizeDecodedVertices(SimpleVertex *sverts, u8 *decoded, const DecVtxFormat &decFmt, int lowerBound, int upperBound, u32 vertType);
+
+// These write quads of four SimpleVertex to dest (draw them with quad indices) and add six to count per quad.
+// Large patches are split across the worker threads, and the output for control points and state
+// seen recently is copied instead of tesselated again.
+void TesselateSplinePatch(u8 *&dest, int &count, const SplinePatch &spatch, u32 origVertType);
+void TesselateBezierPatches(u8 *&dest, int &count, int tess_u, int tess_v, const BezierPatch *patches, int numPatches, u32 origVertType);
+
+// Drops the remembered output and basis tables.
+void ClearSplineCaches();
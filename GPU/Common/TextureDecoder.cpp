@@ -19,11 +19,13 @@
 #include "GPU/Common/TextureDecoder.h"
 // NEON is in a separate file so that it can be compiled with a runtime check.
 #include "GPU/Common/TextureDecoderNEON.h"
+// So is SSSE3, since GCC only enables it for the whole file with -mssse3.
+#include "GPU/Common/TextureDecoderSSSE3.h"
 
 // TODO: Move some common things into here.
 
 #ifdef _M_SSE
-#include <xmmintrin.h>
+#include <emmintrin.h>
 
 static u32 QuickTexHashSSE2(const void *checkp, u32 size) {
 	u32 check = 0;
@@ -57,6 +59,103 @@ static u32 QuickTexHashSSE2(const void *checkp, u32 size) {
 
 	return check;
 }
+
+static void UnswizzleTex16SSE2(u32 *ydestp, const u8 *texptr, int bxc, int byc, u32 pitch) {
+	const __m128i *src = (const __m128i *)texptr;
+	for (int by = 0; by < byc; by++) {
+		u32 *xdest = ydestp;
+		for (int bx = 0; bx < bxc; bx++) {
+			// Read the whole block first, the stores go to eight different lines.
+			const __m128i n0 = _mm_loadu_si128(src + 0);
+			const __m128i n1 = _mm_loadu_si128(src + 1);
+			const __m128i n2 = _mm_loadu_si128(src + 2);
+			const __m128i n3 = _mm_loadu_si128(src + 3);
+			const __m128i n4 = _mm_loadu_si128(src + 4);
+			const __m128i n5 = _mm_loadu_si128(src + 5);
+			const __m128i n6 = _mm_loadu_si128(src + 6);
+			const __m128i n7 = _mm_loadu_si128(src + 7);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 0), n0);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 1), n1);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 2), n2);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 3), n3);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 4), n4);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 5), n5);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 6), n6);
+			_mm_storeu_si128((__m128i *)(xdest + pitch * 7), n7);
+			src += 8;
+			xdest += 4;
+		}
+		ydestp += pitch * 8;
+	}
+}
+
+// Interleaves two vectors of 16-bit (low byte, high byte) pairs into RGBA8888.
+static inline void Store8888SSE2(u32 *dst, __m128i rg, __m128i ba) {
+	_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(rg, ba));
+	_mm_storeu_si128((__m128i *)(dst + 4), _mm_unpackhi_epi16(rg, ba));
+}
+
+static void Convert4444To8888Basic(u32 *dst, const u16 *src, int numPixels);
+static void Convert565To8888Basic(u32 *dst, const u16 *src, int numPixels);
+static void Convert5551To8888Basic(u32 *dst, const u16 *src, int numPixels);
+
+static void Convert4444To8888SSE2(u32 *dst, const u16 *src, int numPixels) {
+	const __m128i maskG = _mm_set1_epi16(0x0F00);
+	const __m128i mask4 = _mm_set1_epi16(0x000F);
+
+	const int sseChunks = numPixels / 8;
+	for (int i = 0; i < sseChunks; ++i) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(src + i * 8));
+		// Each byte gets one nibble, then it's copied into the top half.
+		__m128i rg = _mm_or_si128(_mm_srli_epi16(c, 12), _mm_and_si128(c, maskG));
+		__m128i ba = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(c, 4), mask4), _mm_slli_epi16(_mm_and_si128(c, mask4), 8));
+		rg = _mm_or_si128(rg, _mm_slli_epi16(rg, 4));
+		ba = _mm_or_si128(ba, _mm_slli_epi16(ba, 4));
+		Store8888SSE2(dst + i * 8, rg, ba);
+	}
+	Convert4444To8888Basic(dst + sseChunks * 8, src + sseChunks * 8, numPixels - sseChunks * 8);
+}
+
+static void Convert565To8888SSE2(u32 *dst, const u16 *src, int numPixels) {
+	const __m128i mask5 = _mm_set1_epi16(0x001F);
+	const __m128i mask6 = _mm_set1_epi16(0x003F);
+	const __m128i alpha = _mm_set1_epi16((short)0xFF00);
+
+	const int sseChunks = numPixels / 8;
+	for (int i = 0; i < sseChunks; ++i) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(src + i * 8));
+		const __m128i r = _mm_srli_epi16(c, 11);
+		const __m128i g = _mm_and_si128(_mm_srli_epi16(c, 5), mask6);
+		const __m128i b = _mm_and_si128(c, mask5);
+		// Same as Convert5To8 / Convert6To8.
+		const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g, 2), _mm_srli_epi16(g, 4));
+		const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+		Store8888SSE2(dst + i * 8, _mm_or_si128(r8, _mm_slli_epi16(g8, 8)), _mm_or_si128(b8, alpha));
+	}
+	Convert565To8888Basic(dst + sseChunks * 8, src + sseChunks * 8, numPixels - sseChunks * 8);
+}
+
+static void Convert5551To8888SSE2(u32 *dst, const u16 *src, int numPixels) {
+	const __m128i mask5 = _mm_set1_epi16(0x001F);
+	const __m128i mask1 = _mm_set1_epi16(0x0001);
+	const __m128i alphaMask = _mm_set1_epi16((short)0xFF00);
+
+	const int sseChunks = numPixels / 8;
+	for (int i = 0; i < sseChunks; ++i) {
+		const __m128i c = _mm_loadu_si128((const __m128i *)(src + i * 8));
+		const __m128i r = _mm_srli_epi16(c, 11);
+		const __m128i g = _mm_and_si128(_mm_srli_epi16(c, 6), mask5);
+		const __m128i b = _mm_and_si128(_mm_srli_epi16(c, 1), mask5);
+		// 0 - 1 gives all bits set.
+		const __m128i a = _mm_and_si128(_mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(c, mask1)), alphaMask);
+		const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r, 3), _mm_srli_epi16(r, 2));
+		const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g, 3), _mm_srli_epi16(g, 2));
+		const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b, 3), _mm_srli_epi16(b, 2));
+		Store8888SSE2(dst + i * 8, _mm_or_si128(r8, _mm_slli_epi16(g8, 8)), _mm_or_si128(b8, a));
+	}
+	Convert5551To8888Basic(dst + sseChunks * 8, src + sseChunks * 8, numPixels - sseChunks * 8);
+}
 #endif
 
 static u32 QuickTexHashBasic(const void *checkp, u32 size) {
@@ -101,16 +200,111 @@ static u32 QuickTexHashBasic(const void *checkp, u32 size) {
 	return check;
 }
 
+static void UnswizzleTex16Basic(u32 *ydestp, const u8 *texptr, int bxc, int byc, u32 pitch) {
+	const u32 *src = (const u32 *)texptr;
+	for (int by = 0; by < byc; by++) {
+		u32 *xdest = ydestp;
+		for (int bx = 0; bx < bxc; bx++) {
+			u32 *dest = xdest;
+			for (int n = 0; n < 8; n++) {
+				memcpy(dest, src, 16);
+				dest += pitch;
+				src += 4;
+			}
+			xdest += 4;
+		}
+		ydestp += pitch * 8;
+	}
+}
+
+static void Convert4444To8888Basic(u32 *dst, const u16 *src, int numPixels) {
+	for (int x = 0; x < numPixels; ++x) {
+		u32 val = src[x];
+		u32 r = ((val>>12) & 0xF) * 17;
+		u32 g = ((val>> 8) & 0xF) * 17;
+		u32 b = ((val>> 4) & 0xF) * 17;
+		u32 a = ((val>> 0) & 0xF) * 17;
+		dst[x] = (a << 24) | (b << 16) | (g << 8) | r;
+	}
+}
+
+static void Convert565To8888Basic(u32 *dst, const u16 *src, int numPixels) {
+	for (int x = 0; x < numPixels; ++x) {
+		u32 val = src[x];
+		u32 r = Convert5To8((val>>11) & 0x1F);
+		u32 g = Convert6To8((val>> 5) & 0x3F);
+		u32 b = Convert5To8((val    ) & 0x1F);
+		dst[x] = (0xFF << 24) | (b << 16) | (g << 8) | r;
+	}
+}
+
+static void Convert5551To8888Basic(u32 *dst, const u16 *src, int numPixels) {
+	for (int x = 0; x < numPixels; ++x) {
+		u32 val = src[x];
+		u32 r = Convert5To8((val>>11) & 0x1F);
+		u32 g = Convert5To8((val>> 6) & 0x1F);
+		u32 b = Convert5To8((val>> 1) & 0x1F);
+		u32 a = (val & 0x1) * 255;
+		dst[x] = (a << 24) | (b << 16) | (g << 8) | r;
+	}
+}
+
+template <typename ClutT>
+static void DeIndexTexture4Basic(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
+	for (int i = 0; i < length; i += 2) {
+		u8 index = *indexed++;
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+static void WriteDXT1LinesBasic(u32 *dst, const u32 colors[4], const u8 *lines, int pitch) {
+	for (int y = 0; y < 4; y++) {
+		int val = lines[y];
+		for (int x = 0; x < 4; x++) {
+			dst[x] = colors[val & 3];
+			val >>= 2;
+		}
+		dst += pitch;
+	}
+}
+
+typedef void (*WriteDXT1LinesFunc)(u32 *dst, const u32 colors[4], const u8 *lines, int pitch);
+
 QuickTexHashFunc DoQuickTexHash = &QuickTexHashBasic;
+UnswizzleFunc DoUnswizzleTex16 = &UnswizzleTex16Basic;
+Convert16To8888Func DoConvert4444To8888 = &Convert4444To8888Basic;
+Convert16To8888Func DoConvert565To8888 = &Convert565To8888Basic;
+Convert16To8888Func DoConvert5551To8888 = &Convert5551To8888Basic;
+DeIndexTexture4Func16 DoDeIndexTexture4_16 = &DeIndexTexture4Basic<u16>;
+DeIndexTexture4Func32 DoDeIndexTexture4_32 = &DeIndexTexture4Basic<u32>;
+static WriteDXT1LinesFunc DoWriteDXT1Lines = &WriteDXT1LinesBasic;
 
 // This has to be done after CPUDetect has done its magic.
-void SetupQuickTexHash() {
+void SetupTextureDecoder() {
 #ifdef ARMV7
-	if (cpu_info.bNEON)
+	if (cpu_info.bNEON) {
 		DoQuickTexHash = &QuickTexHashNEON;
+		DoUnswizzleTex16 = &UnswizzleTex16NEON;
+		DoConvert4444To8888 = &Convert4444To8888NEON;
+		DoConvert565To8888 = &Convert565To8888NEON;
+		DoConvert5551To8888 = &Convert5551To8888NEON;
+		DoDeIndexTexture4_16 = &DeIndexTexture4_16NEON;
+		DoDeIndexTexture4_32 = &DeIndexTexture4_32NEON;
+	}
 #elif _M_SSE
-	if (cpu_info.bSSE2)
+	if (cpu_info.bSSE2) {
 		DoQuickTexHash = &QuickTexHashSSE2;
+		DoUnswizzleTex16 = &UnswizzleTex16SSE2;
+		DoConvert4444To8888 = &Convert4444To8888SSE2;
+		DoConvert565To8888 = &Convert565To8888SSE2;
+		DoConvert5551To8888 = &Convert5551To8888SSE2;
+	}
+	if (cpu_info.bSSSE3) {
+		DoDeIndexTexture4_16 = &DeIndexTexture4_16SSSE3;
+		DoDeIndexTexture4_32 = &DeIndexTexture4_32SSSE3;
+		DoWriteDXT1Lines = &WriteDXT1LinesSSSE3;
+	}
 #endif
 }
 
@@ -118,7 +312,6 @@ static inline u32 makecol(int r, int g, int b, int a) {
 	return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
-// This could probably be done faster by decoding two or four blocks at a time with SSE/NEON.
 void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, bool ignore1bitAlpha) {
 	// S3TC Decoder
 	// Needs more speed and debugging.
@@ -147,20 +340,31 @@ void DecodeDXT1Block(u32 *dst, const DXT1Block *src, int pitch, bool ignore1bitA
 		colors[3] = makecol(red2, green2, blue2, 0);	// Color2 but transparent
 	}
 
-	for (int y = 0; y < 4; y++) {
-		int val = src->lines[y];
-		for (int x = 0; x < 4; x++) {
-			dst[x] = colors[val & 3];
-			val >>= 2;
-		}
-		dst += pitch;
-	}
+	DoWriteDXT1Lines(dst, colors, src->lines, pitch);
 }
 
 void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch)
 {
 	DecodeDXT1Block(dst, &src->color, pitch, true);
 
+#ifdef _M_SSE
+	// All 16 alpha nibbles at once, in pixel order.
+	const __m128i mask4 = _mm_set1_epi8(0x0F);
+	const __m128i nibbles = _mm_loadl_epi64((const __m128i *)src->alphaLines);
+	__m128i alpha = _mm_unpacklo_epi8(_mm_and_si128(nibbles, mask4), _mm_and_si128(_mm_srli_epi16(nibbles, 4), mask4));
+	alpha = _mm_or_si128(alpha, _mm_slli_epi16(alpha, 4));
+
+	// Move each alpha to the top byte of its pixel.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i alpha16[2] = { _mm_unpacklo_epi8(zero, alpha), _mm_unpackhi_epi8(zero, alpha) };
+	const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+	for (int y = 0; y < 4; y++) {
+		const __m128i lineAlpha = (y & 1) ? _mm_unpackhi_epi16(zero, alpha16[y >> 1]) : _mm_unpacklo_epi16(zero, alpha16[y >> 1]);
+		__m128i *line = (__m128i *)dst;
+		_mm_storeu_si128(line, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(line), colorMask), lineAlpha));
+		dst += pitch;
+	}
+#else
 	for (int y = 0; y < 4; y++) {
 		u32 line = src->alphaLines[y];
 		for (int x = 0; x < 4; x++) {
@@ -170,6 +374,7 @@ void DecodeDXT3Block(u32 *dst, const DXT3Block *src, int pitch)
 		}
 		dst += pitch;
 	}
+#endif
 }
 
 static inline u8 lerp8(const DXT5Block *src, int n) {
@@ -22,10 +22,28 @@
 #include "GPU/ge_constants.h"
 #include "GPU/GPUState.h"
 
-void SetupQuickTexHash();
+// Picks the fastest kernels below for this CPU. This has to be done after CPUDetect has done its magic.
+void SetupTextureDecoder();
+
 typedef u32 (*QuickTexHashFunc)(const void *checkp, u32 size);
 extern QuickTexHashFunc DoQuickTexHash;
 
+// Copies byc rows of bxc swizzled 16x8 byte blocks from src into linear rows pitch u32s apart.
+typedef void (*UnswizzleFunc)(u32 *dest, const u8 *src, int bxc, int byc, u32 pitch);
+extern UnswizzleFunc DoUnswizzleTex16;
+
+// Expands 16-bit GL order colors (red in the top bits) to RGBA8888.
+typedef void (*Convert16To8888Func)(u32 *dst, const u16 *src, int numPixels);
+extern Convert16To8888Func DoConvert4444To8888;
+extern Convert16To8888Func DoConvert565To8888;
+extern Convert16To8888Func DoConvert5551To8888;
+
+// CLUT4 lookups when the index has no shift, mask or offset. length is in pixels.
+typedef void (*DeIndexTexture4Func16)(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+typedef void (*DeIndexTexture4Func32)(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+extern DeIndexTexture4Func16 DoDeIndexTexture4_16;
+extern DeIndexTexture4Func32 DoDeIndexTexture4_32;
+
 // All these DXT structs are in the reverse order, as compared to PC.
 // On PC, alpha comes before color, and interpolants are before the tile data.
 
@@ -131,17 +149,21 @@ inline void DeIndexTexture(ClutT *dest, const u32 texaddr, int length, const Clu
 	DeIndexTexture(dest, indexed, length, clut);
 }
 
+inline void DeIndexTexture4Simple(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	DoDeIndexTexture4_16(dest, indexed, length, clut);
+}
+
+inline void DeIndexTexture4Simple(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	DoDeIndexTexture4_32(dest, indexed, length, clut);
+}
+
 template <typename ClutT>
 inline void DeIndexTexture4(ClutT *dest, const u8 *indexed, int length, const ClutT *clut) {
 	// Usually, there is no special offset, mask, or shift.
 	const bool nakedIndex = gstate.isClutIndexSimple();
 
 	if (nakedIndex) {
-		for (int i = 0; i < length; i += 2) {
-			u8 index = *indexed++;
-			dest[i + 0] = clut[(index >> 0) & 0xf];
-			dest[i + 1] = clut[(index >> 4) & 0xf];
-		}
+		DeIndexTexture4Simple(dest, indexed, length, clut);
 	} else {
 		for (int i = 0; i < length; i += 2) {
 			u8 index = *indexed++;
@@ -118,3 +118,183 @@ u32 QuickTexHashNEON(const void *checkp, u32 size) {
 
 	return check;
 }
+
+void UnswizzleTex16NEON(u32 *ydestp, const u8 *texptr, int bxc, int byc, u32 pitch) {
+	const u32 *src = (const u32 *)texptr;
+	for (int by = 0; by < byc; by++) {
+		u32 *xdest = ydestp;
+		for (int bx = 0; bx < bxc; bx++) {
+			const uint32x4_t n0 = vld1q_u32(src + 0);
+			const uint32x4_t n1 = vld1q_u32(src + 4);
+			const uint32x4_t n2 = vld1q_u32(src + 8);
+			const uint32x4_t n3 = vld1q_u32(src + 12);
+			const uint32x4_t n4 = vld1q_u32(src + 16);
+			const uint32x4_t n5 = vld1q_u32(src + 20);
+			const uint32x4_t n6 = vld1q_u32(src + 24);
+			const uint32x4_t n7 = vld1q_u32(src + 28);
+			vst1q_u32(xdest + pitch * 0, n0);
+			vst1q_u32(xdest + pitch * 1, n1);
+			vst1q_u32(xdest + pitch * 2, n2);
+			vst1q_u32(xdest + pitch * 3, n3);
+			vst1q_u32(xdest + pitch * 4, n4);
+			vst1q_u32(xdest + pitch * 5, n5);
+			vst1q_u32(xdest + pitch * 6, n6);
+			vst1q_u32(xdest + pitch * 7, n7);
+			src += 32;
+			xdest += 4;
+		}
+		ydestp += pitch * 8;
+	}
+}
+
+// vst4 interleaves the four channels straight into RGBA8888.
+static inline void Store8888NEON(u32 *dst, uint8x8_t r, uint8x8_t g, uint8x8_t b, uint8x8_t a) {
+	uint8x8x4_t rgba;
+	rgba.val[0] = r;
+	rgba.val[1] = g;
+	rgba.val[2] = b;
+	rgba.val[3] = a;
+	vst4_u8((u8 *)dst, rgba);
+}
+
+void Convert4444To8888NEON(u32 *dst, const u16 *src, int numPixels) {
+	const uint16x8_t mask4 = vdupq_n_u16(0x000F);
+	int i = 0;
+	for (; i + 8 <= numPixels; i += 8) {
+		const uint16x8_t c = vld1q_u16(src + i);
+		const uint8x8_t r = vmovn_u16(vshrq_n_u16(c, 12));
+		const uint8x8_t g = vmovn_u16(vandq_u16(vshrq_n_u16(c, 8), mask4));
+		const uint8x8_t b = vmovn_u16(vandq_u16(vshrq_n_u16(c, 4), mask4));
+		const uint8x8_t a = vmovn_u16(vandq_u16(c, mask4));
+		Store8888NEON(dst + i, vorr_u8(r, vshl_n_u8(r, 4)), vorr_u8(g, vshl_n_u8(g, 4)), vorr_u8(b, vshl_n_u8(b, 4)), vorr_u8(a, vshl_n_u8(a, 4)));
+	}
+	for (; i < numPixels; ++i) {
+		u32 val = src[i];
+		u32 r = ((val>>12) & 0xF) * 17;
+		u32 g = ((val>> 8) & 0xF) * 17;
+		u32 b = ((val>> 4) & 0xF) * 17;
+		u32 a = ((val>> 0) & 0xF) * 17;
+		dst[i] = (a << 24) | (b << 16) | (g << 8) | r;
+	}
+}
+
+void Convert565To8888NEON(u32 *dst, const u16 *src, int numPixels) {
+	const uint16x8_t mask5 = vdupq_n_u16(0x001F);
+	const uint16x8_t mask6 = vdupq_n_u16(0x003F);
+	const uint8x8_t alpha = vdup_n_u8(0xFF);
+	int i = 0;
+	for (; i + 8 <= numPixels; i += 8) {
+		const uint16x8_t c = vld1q_u16(src + i);
+		const uint8x8_t r = vmovn_u16(vshrq_n_u16(c, 11));
+		const uint8x8_t g = vmovn_u16(vandq_u16(vshrq_n_u16(c, 5), mask6));
+		const uint8x8_t b = vmovn_u16(vandq_u16(c, mask5));
+		// Same as Convert5To8 / Convert6To8.
+		const uint8x8_t r8 = vorr_u8(vshl_n_u8(r, 3), vshr_n_u8(r, 2));
+		const uint8x8_t g8 = vorr_u8(vshl_n_u8(g, 2), vshr_n_u8(g, 4));
+		const uint8x8_t b8 = vorr_u8(vshl_n_u8(b, 3), vshr_n_u8(b, 2));
+		Store8888NEON(dst + i, r8, g8, b8, alpha);
+	}
+	for (; i < numPixels; ++i) {
+		u32 val = src[i];
+		u32 r = Convert5To8((val>>11) & 0x1F);
+		u32 g = Convert6To8((val>> 5) & 0x3F);
+		u32 b = Convert5To8((val    ) & 0x1F);
+		dst[i] = (0xFF << 24) | (b << 16) | (g << 8) | r;
+	}
+}
+
+void Convert5551To8888NEON(u32 *dst, const u16 *src, int numPixels) {
+	const uint16x8_t mask5 = vdupq_n_u16(0x001F);
+	const uint16x8_t mask1 = vdupq_n_u16(0x0001);
+	int i = 0;
+	for (; i + 8 <= numPixels; i += 8) {
+		const uint16x8_t c = vld1q_u16(src + i);
+		const uint8x8_t r = vmovn_u16(vshrq_n_u16(c, 11));
+		const uint8x8_t g = vmovn_u16(vandq_u16(vshrq_n_u16(c, 6), mask5));
+		const uint8x8_t b = vmovn_u16(vandq_u16(vshrq_n_u16(c, 1), mask5));
+		const uint8x8_t a = vmovn_u16(vandq_u16(c, mask1));
+		const uint8x8_t r8 = vorr_u8(vshl_n_u8(r, 3), vshr_n_u8(r, 2));
+		const uint8x8_t g8 = vorr_u8(vshl_n_u8(g, 3), vshr_n_u8(g, 2));
+		const uint8x8_t b8 = vorr_u8(vshl_n_u8(b, 3), vshr_n_u8(b, 2));
+		// All bits set where the alpha bit is.
+		Store8888NEON(dst + i, r8, g8, b8, vtst_u8(a, a));
+	}
+	for (; i < numPixels; ++i) {
+		u32 val = src[i];
+		u32 r = Convert5To8((val>>11) & 0x1F);
+		u32 g = Convert5To8((val>> 6) & 0x1F);
+		u32 b = Convert5To8((val>> 1) & 0x1F);
+		u32 a = (val & 0x1) * 255;
+		dst[i] = (a << 24) | (b << 16) | (g << 8) | r;
+	}
+}
+
+// Each byte of the 16 CLUT entries is a 16 byte table for vtbl2.
+static inline uint8x8x2_t ClutByteTableNEON(const u8 *bytes) {
+	uint8x8x2_t table;
+	table.val[0] = vld1_u8(bytes);
+	table.val[1] = vld1_u8(bytes + 8);
+	return table;
+}
+
+// Eight bytes of indices are 16 pixels, low nibble first.
+static inline uint8x8x2_t SplitNibblesNEON(const u8 *indexed) {
+	const uint8x8_t in = vld1_u8(indexed);
+	return vzip_u8(vand_u8(in, vdup_n_u8(0x0F)), vshr_n_u8(in, 4));
+}
+
+void DeIndexTexture4_16NEON(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	u8 bytes[2][16];
+	for (int i = 0; i < 16; ++i) {
+		bytes[0][i] = (u8)clut[i];
+		bytes[1][i] = (u8)(clut[i] >> 8);
+	}
+	const uint8x8x2_t clutLo = ClutByteTableNEON(bytes[0]);
+	const uint8x8x2_t clutHi = ClutByteTableNEON(bytes[1]);
+
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x8x2_t idx = SplitNibblesNEON(indexed + i / 2);
+		for (int j = 0; j < 2; ++j) {
+			uint8x8x2_t color;
+			color.val[0] = vtbl2_u8(clutLo, idx.val[j]);
+			color.val[1] = vtbl2_u8(clutHi, idx.val[j]);
+			vst2_u8((u8 *)(dest + i + j * 8), color);
+		}
+	}
+	for (; i < length; i += 2) {
+		u8 index = indexed[i / 2];
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture4_32NEON(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	u8 bytes[4][16];
+	for (int i = 0; i < 16; ++i) {
+		for (int b = 0; b < 4; ++b)
+			bytes[b][i] = (u8)(clut[i] >> (b * 8));
+	}
+	const uint8x8x2_t clut0 = ClutByteTableNEON(bytes[0]);
+	const uint8x8x2_t clut1 = ClutByteTableNEON(bytes[1]);
+	const uint8x8x2_t clut2 = ClutByteTableNEON(bytes[2]);
+	const uint8x8x2_t clut3 = ClutByteTableNEON(bytes[3]);
+
+	int i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const uint8x8x2_t idx = SplitNibblesNEON(indexed + i / 2);
+		for (int j = 0; j < 2; ++j) {
+			uint8x8x4_t color;
+			color.val[0] = vtbl2_u8(clut0, idx.val[j]);
+			color.val[1] = vtbl2_u8(clut1, idx.val[j]);
+			color.val[2] = vtbl2_u8(clut2, idx.val[j]);
+			color.val[3] = vtbl2_u8(clut3, idx.val[j]);
+			vst4_u8((u8 *)(dest + i + j * 8), color);
+		}
+	}
+	for (; i < length; i += 2) {
+		u8 index = indexed[i / 2];
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
@@ -17,4 +17,10 @@
 
 #include "GPU/Common/TextureDecoder.h"
 
-u32 QuickTexHashNEON(const void *checkp, u32 size);
\ No newline at end of file
+u32 QuickTexHashNEON(const void *checkp, u32 size);
+void UnswizzleTex16NEON(u32 *dest, const u8 *src, int bxc, int byc, u32 pitch);
+void Convert4444To8888NEON(u32 *dst, const u16 *src, int numPixels);
+void Convert565To8888NEON(u32 *dst, const u16 *src, int numPixels);
+void Convert5551To8888NEON(u32 *dst, const u16 *src, int numPixels);
+void DeIndexTexture4_16NEON(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4_32NEON(u32 *dest, const u8 *indexed, int length, const u32 *clut);
\ No newline at end of file
@@ -0,0 +1,115 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+#include <tmmintrin.h>
+#include "GPU/Common/TextureDecoder.h"
+
+#if !defined(_M_SSE) || _M_SSE < 0x301
+#error Should be compiled with SSSE3 enabled.
+#endif
+
+// Splits 16 indices per byte of input into pixel order (low nibble first) in two vectors.
+static inline void SplitNibblesSSSE3(const u8 *indexed, __m128i &first, __m128i &second) {
+	const __m128i mask4 = _mm_set1_epi8(0x0F);
+	const __m128i in = _mm_loadu_si128((const __m128i *)indexed);
+	const __m128i lo = _mm_and_si128(in, mask4);
+	const __m128i hi = _mm_and_si128(_mm_srli_epi16(in, 4), mask4);
+	first = _mm_unpacklo_epi8(lo, hi);
+	second = _mm_unpackhi_epi8(lo, hi);
+}
+
+// With only 16 entries, each byte of the CLUT fits in one register and pshufb does the lookups.
+void DeIndexTexture4_16SSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut) {
+	u8 MEMORY_ALIGNED16(bytes[2][16]);
+	for (int i = 0; i < 16; ++i) {
+		bytes[0][i] = (u8)clut[i];
+		bytes[1][i] = (u8)(clut[i] >> 8);
+	}
+	const __m128i clutLo = _mm_load_si128((const __m128i *)bytes[0]);
+	const __m128i clutHi = _mm_load_si128((const __m128i *)bytes[1]);
+
+	const int sseChunks = length / 32;
+	for (int i = 0; i < sseChunks; ++i) {
+		__m128i idx[2];
+		SplitNibblesSSSE3(indexed + i * 16, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i lo = _mm_shuffle_epi8(clutLo, idx[j]);
+			const __m128i hi = _mm_shuffle_epi8(clutHi, idx[j]);
+			_mm_storeu_si128((__m128i *)(dest + i * 32 + j * 16), _mm_unpacklo_epi8(lo, hi));
+			_mm_storeu_si128((__m128i *)(dest + i * 32 + j * 16 + 8), _mm_unpackhi_epi8(lo, hi));
+		}
+	}
+	for (int i = sseChunks * 32; i < length; i += 2) {
+		u8 index = indexed[i / 2];
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+void DeIndexTexture4_32SSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut) {
+	u8 MEMORY_ALIGNED16(bytes[4][16]);
+	for (int i = 0; i < 16; ++i) {
+		for (int b = 0; b < 4; ++b)
+			bytes[b][i] = (u8)(clut[i] >> (b * 8));
+	}
+	const __m128i clut0 = _mm_load_si128((const __m128i *)bytes[0]);
+	const __m128i clut1 = _mm_load_si128((const __m128i *)bytes[1]);
+	const __m128i clut2 = _mm_load_si128((const __m128i *)bytes[2]);
+	const __m128i clut3 = _mm_load_si128((const __m128i *)bytes[3]);
+
+	const int sseChunks = length / 32;
+	for (int i = 0; i < sseChunks; ++i) {
+		__m128i idx[2];
+		SplitNibblesSSSE3(indexed + i * 16, idx[0], idx[1]);
+		for (int j = 0; j < 2; ++j) {
+			const __m128i b0 = _mm_shuffle_epi8(clut0, idx[j]);
+			const __m128i b1 = _mm_shuffle_epi8(clut1, idx[j]);
+			const __m128i b2 = _mm_shuffle_epi8(clut2, idx[j]);
+			const __m128i b3 = _mm_shuffle_epi8(clut3, idx[j]);
+			const __m128i lo01 = _mm_unpacklo_epi8(b0, b1);
+			const __m128i lo23 = _mm_unpacklo_epi8(b2, b3);
+			const __m128i hi01 = _mm_unpackhi_epi8(b0, b1);
+			const __m128i hi23 = _mm_unpackhi_epi8(b2, b3);
+			u32 *d = dest + i * 32 + j * 16;
+			_mm_storeu_si128((__m128i *)(d + 0), _mm_unpacklo_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)(d + 4), _mm_unpackhi_epi16(lo01, lo23));
+			_mm_storeu_si128((__m128i *)(d + 8), _mm_unpacklo_epi16(hi01, hi23));
+			_mm_storeu_si128((__m128i *)(d + 12), _mm_unpackhi_epi16(hi01, hi23));
+		}
+	}
+	for (int i = sseChunks * 32; i < length; i += 2) {
+		u8 index = indexed[i / 2];
+		dest[i + 0] = clut[(index >> 0) & 0xf];
+		dest[i + 1] = clut[(index >> 4) & 0xf];
+	}
+}
+
+// One line of a DXT1 block is a byte of four 2-bit indices, which become a byte shuffle of the palette.
+void WriteDXT1LinesSSSE3(u32 *dst, const u32 colors[4], const u8 *lines, int pitch) {
+	const __m128i palette = _mm_loadu_si128((const __m128i *)colors);
+	// Shifts pixel x's index to the top of the low byte: 6, 4, 2, 0 bits left, two lanes per pixel.
+	const __m128i shifts = _mm_set_epi16(1, 1, 4, 4, 16, 16, 64, 64);
+	const __m128i mask2 = _mm_set1_epi16(3);
+	const __m128i byteOffsets = _mm_set_epi16(0x0302, 0x0100, 0x0302, 0x0100, 0x0302, 0x0100, 0x0302, 0x0100);
+	for (int y = 0; y < 4; y++) {
+		__m128i idx = _mm_mullo_epi16(_mm_set1_epi16(lines[y]), shifts);
+		idx = _mm_and_si128(_mm_srli_epi16(idx, 6), mask2);
+		// Byte index of the color, in both bytes of each lane, plus which byte of the color.
+		const __m128i shuffle = _mm_add_epi16(_mm_mullo_epi16(idx, _mm_set1_epi16(0x0404)), byteOffsets);
+		_mm_storeu_si128((__m128i *)dst, _mm_shuffle_epi8(palette, shuffle));
+		dst += pitch;
+	}
+}
@@ -0,0 +1,21 @@
+// Copyright (c) 2012- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+#include "GPU/Common/TextureDecoder.h"
+
+void DeIndexTexture4_16SSSE3(u16 *dest, const u8 *indexed, int length, const u16 *clut);
+void DeIndexTexture4_32SSSE3(u32 *dest, const u8 *indexed, int length, const u32 *clut);
+void WriteDXT1LinesSSSE3(u32 *dst, const u32 colors[4], const u8 *lines, int pitch);
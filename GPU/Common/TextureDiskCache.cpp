@@ -0,0 +1,264 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include "Common/Log.h"
+#include "GPU/Common/TextureDiskCache.h"
+#include "ext/snappy/snappy-c.h"
+#include "ext/xxhash.h"
+
+static const u32 TEXTURE_DISK_CACHE_MAGIC = 0x48435854;  // TXCH
+static const u32 TEXTURE_DISK_CACHE_VERSION = 2;
+
+// Decompressed textures kept around, least recently used dropped first.
+#ifdef USING_GLES2
+static const size_t TEXTURE_DISK_CACHE_MEMORY = 16 * 1024 * 1024;
+#else
+static const size_t TEXTURE_DISK_CACHE_MEMORY = 64 * 1024 * 1024;
+#endif
+// Nothing more is appended once the file reaches this size.
+static const u64 TEXTURE_DISK_CACHE_MAX_FILE = 512 * 1024 * 1024;
+
+struct TextureDiskCacheHeader {
+	u32 magic;
+	u32 version;
+};
+
+// Followed by compressedSize bytes of snappy compressed 8888 data.
+struct TextureDiskCacheRecord {
+	u64 contenthash;
+	u32 compressedSize;
+	// Of the uncompressed data.
+	u32 hash;
+	u16 dim;
+	u16 width;
+	u16 height;
+	u16 pad;
+	u8 format;
+	u8 factor;
+	u8 type;
+	u8 deposterize;
+};
+
+bool ScaledTextureKey::operator <(const ScaledTextureKey &other) const {
+	if (contenthash != other.contenthash)
+		return contenthash < other.contenthash;
+	if (dim != other.dim)
+		return dim < other.dim;
+	if (format != other.format)
+		return format < other.format;
+	if (factor != other.factor)
+		return factor < other.factor;
+	if (type != other.type)
+		return type < other.type;
+	return deposterize < other.deposterize;
+}
+
+TextureDiskCache::TextureDiskCache() : fileEnd_(0), loadedBytes_(0), tick_(0) {
+}
+
+TextureDiskCache::~TextureDiskCache() {
+	Close();
+}
+
+bool TextureDiskCache::Open(const std::string &filename) {
+	lock_guard guard(lock_);
+	Close();
+	filename_ = filename;
+
+	if (!file_.Open(filename, "r+b"))
+		return Reset();
+
+	TextureDiskCacheHeader header;
+	if (!file_.ReadArray(&header, 1) || header.magic != TEXTURE_DISK_CACHE_MAGIC || header.version != TEXTURE_DISK_CACHE_VERSION) {
+		WARN_LOG(G3D, "Discarding invalid or outdated texture cache %s", filename.c_str());
+		return Reset();
+	}
+
+	const u64 size = file_.GetSize();
+	u64 pos = sizeof(header);
+	TextureDiskCacheRecord record;
+	while (pos + sizeof(record) <= size && file_.ReadArray(&record, 1)) {
+		const u64 dataPos = pos + sizeof(record);
+		const u32 bytes = record.width * record.height * 4;
+		// A partly written record at the end, most likely.
+		if (bytes == 0 || record.compressedSize > snappy_max_compressed_length(bytes) || dataPos + record.compressedSize > size)
+			break;
+
+		ScaledTextureKey key;
+		key.contenthash = record.contenthash;
+		key.dim = record.dim;
+		key.format = record.format;
+		key.factor = record.factor;
+		key.type = record.type;
+		key.deposterize = record.deposterize != 0;
+
+		IndexEntry &entry = index_[key];
+		entry.offset = dataPos;
+		entry.compressedSize = record.compressedSize;
+		entry.hash = record.hash;
+		entry.width = record.width;
+		entry.height = record.height;
+
+		pos = dataPos + record.compressedSize;
+		if (!file_.Seek(pos, SEEK_SET))
+			break;
+	}
+
+	file_.Clear();
+	fileEnd_ = pos;
+	if (pos != size)
+		file_.Resize(pos);
+
+	INFO_LOG(G3D, "Texture cache %s: %d textures", filename.c_str(), (int)index_.size());
+	return true;
+}
+
+// Starts over with an empty file.
+bool TextureDiskCache::Reset() {
+	file_.Close();
+	index_.clear();
+	if (!file_.Open(filename_, "w+b")) {
+		ERROR_LOG(G3D, "Unable to create texture cache %s", filename_.c_str());
+		return false;
+	}
+
+	TextureDiskCacheHeader header = { TEXTURE_DISK_CACHE_MAGIC, TEXTURE_DISK_CACHE_VERSION };
+	file_.WriteArray(&header, 1);
+	fileEnd_ = sizeof(header);
+	return file_.IsGood();
+}
+
+void TextureDiskCache::Close() {
+	lock_guard guard(lock_);
+	file_.Close();
+	index_.clear();
+	loaded_.clear();
+	loadedBytes_ = 0;
+}
+
+bool TextureDiskCache::Lookup(const ScaledTextureKey &key, const u32 **data, int *width, int *height) {
+	lock_guard guard(lock_);
+	auto loaded = loaded_.find(key);
+	if (loaded != loaded_.end()) {
+		LoadedEntry &entry = loaded->second;
+		entry.lastUsed = ++tick_;
+		*data = &entry.data[0];
+		*width = entry.width;
+		*height = entry.height;
+		return true;
+	}
+
+	auto indexed = index_.find(key);
+	if (indexed == index_.end() || !file_.IsOpen())
+		return false;
+
+	const IndexEntry info = indexed->second;
+	const size_t bytes = info.width * info.height * 4;
+	std::vector<char> compressed(info.compressedSize);
+	std::vector<u32> decoded(bytes / 4);
+	size_t decodedSize = bytes;
+	bool valid = file_.Seek(info.offset, SEEK_SET) && file_.ReadBytes(&compressed[0], compressed.size());
+	valid = valid && snappy_uncompress(&compressed[0], compressed.size(), (char *)&decoded[0], &decodedSize) == SNAPPY_OK;
+	valid = valid && decodedSize == bytes && XXH32(&decoded[0], (int)bytes, 0) == info.hash;
+	if (!valid) {
+		WARN_LOG(G3D, "Bad texture in cache %s at offset %lld", filename_.c_str(), (long long)info.offset);
+		file_.Clear();
+		index_.erase(indexed);
+		return false;
+	}
+
+	Evict(bytes);
+	LoadedEntry &entry = loaded_[key];
+	entry.data.swap(decoded);
+	entry.width = info.width;
+	entry.height = info.height;
+	entry.lastUsed = ++tick_;
+	loadedBytes_ += bytes;
+
+	*data = &entry.data[0];
+	*width = entry.width;
+	*height = entry.height;
+	return true;
+}
+
+void TextureDiskCache::Store(const ScaledTextureKey &key, const u32 *data, int width, int height) {
+	if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF)
+		return;
+
+	{
+		lock_guard guard(lock_);
+		if (!file_.IsOpen() || index_.find(key) != index_.end() || fileEnd_ >= TEXTURE_DISK_CACHE_MAX_FILE)
+			return;
+	}
+
+	// Compressing can take a while, so don't block Lookup meanwhile.
+	const size_t bytes = width * height * 4;
+	std::vector<char> compressed(snappy_max_compressed_length(bytes));
+	size_t compressedSize = compressed.size();
+	if (snappy_compress((const char *)data, bytes, &compressed[0], &compressedSize) != SNAPPY_OK)
+		return;
+
+	TextureDiskCacheRecord record;
+	record.contenthash = key.contenthash;
+	record.compressedSize = (u32)compressedSize;
+	record.hash = XXH32(data, (int)bytes, 0);
+	record.dim = key.dim;
+	record.width = (u16)width;
+	record.height = (u16)height;
+	record.pad = 0;
+	record.format = key.format;
+	record.factor = key.factor;
+	record.type = key.type;
+	record.deposterize = key.deposterize ? 1 : 0;
+
+	lock_guard guard(lock_);
+	// Could have been stored or closed meanwhile.
+	if (!file_.IsOpen() || index_.find(key) != index_.end())
+		return;
+
+	file_.Seek(fileEnd_, SEEK_SET);
+	file_.WriteArray(&record, 1);
+	file_.WriteBytes(&compressed[0], compressedSize);
+	file_.Flush();
+	if (!file_.IsGood()) {
+		ERROR_LOG(G3D, "Unable to write to texture cache %s", filename_.c_str());
+		// Drop the partial record, so the next one lands where the index expects.
+		file_.Clear();
+		file_.Resize(fileEnd_);
+		return;
+	}
+
+	IndexEntry &entry = index_[key];
+	entry.offset = fileEnd_ + sizeof(record);
+	entry.compressedSize = (u32)compressedSize;
+	entry.hash = record.hash;
+	entry.width = width;
+	entry.height = height;
+	fileEnd_ = entry.offset + compressedSize;
+}
+
+void TextureDiskCache::Evict(size_t incoming) {
+	while (!loaded_.empty() && loadedBytes_ + incoming > TEXTURE_DISK_CACHE_MEMORY) {
+		auto oldest = loaded_.begin();
+		for (auto iter = loaded_.begin(); iter != loaded_.end(); ++iter) {
+			if (iter->second.lastUsed < oldest->second.lastUsed)
+				oldest = iter;
+		}
+		loadedBytes_ -= oldest->second.data.size() * sizeof(u32);
+		loaded_.erase(oldest);
+	}
+}
@@ -0,0 +1,90 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+#include "Common/FileUtil.h"
+#include "base/mutex.h"
+
+// Identifies a scaled texture by content and scaler settings, not by address.
+struct ScaledTextureKey {
+	// 64-bit hash of the source texels and CLUT.
+	u64 contenthash;
+	u16 dim;
+	u8 format;
+	u8 factor;
+	u8 type;
+	bool deposterize;
+
+	bool operator <(const ScaledTextureKey &other) const;
+};
+
+// Keeps scaled 8888 textures in a per-game file, so that later sessions can skip both
+// decoding and scaling. Only the index is read by Open(). Texture data is read and
+// decompressed on first use, and kept in memory (up to a budget) after that.
+// Store() may be called from another thread than Lookup().
+class TextureDiskCache {
+public:
+	TextureDiskCache();
+	~TextureDiskCache();
+
+	bool Open(const std::string &filename);
+	void Close();
+	bool IsOpen() {
+		return file_.IsOpen();
+	}
+
+	// Returns false if the texture isn't cached. The pointer stays valid until the next
+	// call to Lookup or Close.
+	bool Lookup(const ScaledTextureKey &key, const u32 **data, int *width, int *height);
+	// Appends the texture to the file, unless it's already there. Doesn't keep it in memory,
+	// since whoever scaled it already has it.
+	void Store(const ScaledTextureKey &key, const u32 *data, int width, int height);
+
+private:
+	struct IndexEntry {
+		u64 offset;
+		u32 compressedSize;
+		u32 hash;
+		int width;
+		int height;
+	};
+
+	struct LoadedEntry {
+		std::vector<u32> data;
+		int width;
+		int height;
+		u32 lastUsed;
+	};
+
+	bool Reset();
+	void Evict(size_t incoming);
+
+	File::IOFile file_;
+	std::string filename_;
+	u64 fileEnd_;
+	std::map<ScaledTextureKey, IndexEntry> index_;
+	std::map<ScaledTextureKey, LoadedEntry> loaded_;
+	size_t loadedBytes_;
+	u32 tick_;
+	recursive_mutex lock_;
+};
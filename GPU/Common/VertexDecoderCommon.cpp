@@ -16,8 +16,15 @@
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
 #include <stdio.h>
+#include <algorithm>
 #include "GPU/Common/VertexDecoderCommon.h"
 
+const u8 tcsize[4] = {0,2,4,8}, tcalign[4] = {0,1,2,4};
+const u8 colsize[8] = {0,0,0,0,2,2,2,4}, colalign[8] = {0,0,0,0,2,2,2,4};
+const u8 nrmsize[4] = {0,3,6,12}, nrmalign[4] = {0,1,2,4};
+const u8 possize[4] = {0,3,6,12}, posalign[4] = {0,1,2,4};
+const u8 wtsize[4] = {0,1,2,4}, wtalign[4] = {0,1,2,4};
+
 int DecFmtSize(u8 fmt) {
 	switch (fmt) {
 	case DEC_NONE: return 0;
@@ -42,6 +49,45 @@ int DecFmtSize(u8 fmt) {
 	}
 }
 
+static inline int AlignSize(int n, int align) {
+	return align <= 1 ? n : (n + (align - 1)) & ~(align - 1);
+}
+
+// Same layout as VertexDecoder::SetVertexType.
+int VertexTypeSize(u32 vertType) {
+	const int tc = (vertType & GE_VTYPE_TC_MASK) >> GE_VTYPE_TC_SHIFT;
+	const int col = (vertType & GE_VTYPE_COL_MASK) >> GE_VTYPE_COL_SHIFT;
+	const int nrm = (vertType & GE_VTYPE_NRM_MASK) >> GE_VTYPE_NRM_SHIFT;
+	const int pos = (vertType & GE_VTYPE_POS_MASK) >> GE_VTYPE_POS_SHIFT;
+	const int weighttype = (vertType & GE_VTYPE_WEIGHT_MASK) >> GE_VTYPE_WEIGHT_SHIFT;
+	const int nweights = ((vertType & GE_VTYPE_WEIGHTCOUNT_MASK) >> GE_VTYPE_WEIGHTCOUNT_SHIFT) + 1;
+	const int morphcount = ((vertType & GE_VTYPE_MORPHCOUNT_MASK) >> GE_VTYPE_MORPHCOUNT_SHIFT) + 1;
+
+	int size = 0;
+	int biggest = 0;
+	if (weighttype) {
+		size += wtsize[weighttype] * nweights;
+		biggest = std::max(biggest, (int)wtalign[weighttype]);
+	}
+	if (tc) {
+		size = AlignSize(size, tcalign[tc]) + tcsize[tc];
+		biggest = std::max(biggest, (int)tcalign[tc]);
+	}
+	if (col) {
+		size = AlignSize(size, colalign[col]) + colsize[col];
+		biggest = std::max(biggest, (int)colalign[col]);
+	}
+	if (nrm) {
+		size = AlignSize(size, nrmalign[nrm]) + nrmsize[nrm];
+		biggest = std::max(biggest, (int)nrmalign[nrm]);
+	}
+	if (pos) {
+		size = AlignSize(size, posalign[pos]) + possize[pos];
+		biggest = std::max(biggest, (int)posalign[pos]);
+	}
+	return AlignSize(size, biggest) * morphcount;
+}
+
 void GetIndexBounds(const void *inds, int count, u32 vertType, u16 *indexLowerBound, u16 *indexUpperBound) {
 	// Find index bounds. Could cache this in display lists.
 	// Also, this could be greatly sped up with SSE2/NEON, although rarely a bottleneck.
@@ -51,6 +51,16 @@ enum {
 
 int DecFmtSize(u8 fmt);
 
+// Sizes and alignments of each PSP vertex component, indexed by its format bits.
+extern const u8 tcsize[4], tcalign[4];
+extern const u8 colsize[8], colalign[8];
+extern const u8 nrmsize[4], nrmalign[4];
+extern const u8 possize[4], posalign[4];
+extern const u8 wtsize[4], wtalign[4];
+
+// Size in bytes of one vertex in PSP memory, including all morph frames.
+int VertexTypeSize(u32 vertType);
+
 struct DecVtxFormat {
 	u8 w0fmt; u8 w0off;  // first 4 weights
 	u8 w1fmt; u8 w1off;  // second 4 weights
@@ -0,0 +1,553 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#include <algorithm>
+#include <map>
+#include <string.h>
+
+#include "Common/FileUtil.h"
+#include "Common/Log.h"
+#include "Common/StringUtils.h"
+#include "Core/Config.h"
+#include "Core/MemMap.h"
+#include "Core/System.h"
+#include "Core/ELF/ParamSFO.h"
+#include "Core/HLE/sceGe.h"
+#include "GPU/GPUInterface.h"
+#include "GPU/GPUState.h"
+#include "GPU/ge_constants.h"
+#include "GPU/Common/TextureDecoder.h"
+#include "GPU/Common/VertexDecoderCommon.h"
+#include "GPU/Debugger/Record.h"
+#include "ext/snappy/snappy-c.h"
+#include "ext/xxhash.h"
+
+namespace GPURecord {
+
+static const u32 GE_DUMP_MAGIC = 0x504d4447;  // GDMP
+static const u32 GE_DUMP_VERSION = 1;
+
+// Captures stop early past this, before compression.
+static const size_t MAX_CAPTURE_BYTES = 256 * 1024 * 1024;
+// Words in a register context, as saved by sceGeSaveContext.
+static const int CONTEXT_WORDS = 512;
+
+// Followed by size bytes of snappy compressed commands.
+struct DumpHeader {
+	u32 magic;
+	u32 version;
+	u32 size;
+};
+
+enum CommandType {
+	// CONTEXT_WORDS words from GPUgstate::Save.
+	COMMAND_REGISTERS = 1,
+	// The address, then the bytes to write there.
+	COMMAND_MEMORY = 2,
+	// Commands to append to the current list. Ends it if the last one is an END.
+	COMMAND_DISPLAYLIST = 3,
+	COMMAND_FRAME = 4,
+};
+
+// Followed by size bytes of data, padded to 4.
+struct CommandHeader {
+	u32 type;
+	u32 size;
+};
+
+struct CapturedRange {
+	u32 size;
+	u32 hash;
+};
+
+static bool active = false;
+static int framesLeft = 0;
+static volatile int pendingFrames = 0;
+static std::vector<u8> pushbuf;
+static std::vector<u32> ops;
+// What the replay will have in memory, without overlaps. Used to skip unchanged data.
+static std::map<u32, CapturedRange> captured;
+static std::string lastFilename;
+
+static inline u32 AlignUp(u32 value, u32 alignment) {
+	return alignment <= 1 ? value : (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void WriteCommand(CommandType type, const void *data, u32 size, const void *extra = NULL, u32 extraSize = 0) {
+	CommandHeader header = { (u32)type, size + extraSize };
+	const size_t start = pushbuf.size();
+	pushbuf.resize(start + sizeof(header) + AlignUp(header.size, 4), 0);
+	u8 *dest = &pushbuf[start];
+	memcpy(dest, &header, sizeof(header));
+	if (size != 0)
+		memcpy(dest + sizeof(header), data, size);
+	if (extraSize != 0)
+		memcpy(dest + sizeof(header) + size, extra, extraSize);
+}
+
+static void FlushOps() {
+	if (ops.empty())
+		return;
+	WriteCommand(COMMAND_DISPLAYLIST, &ops[0], (u32)ops.size() * 4);
+	ops.clear();
+}
+
+static void WriteRegisters() {
+	FlushOps();
+	u32_le context[CONTEXT_WORDS];
+	memset(context, 0, sizeof(context));
+	gstate.Save(context);
+	WriteCommand(COMMAND_REGISTERS, context, sizeof(context));
+}
+
+static void CaptureMemory(u32 addr, u32 size) {
+	addr &= 0x0FFFFFFF;
+	if (size == 0 || !Memory::IsValidAddress(addr))
+		return;
+	if (!Memory::IsValidAddress(addr + size - 1)) {
+		// Runs off the end of RAM or VRAM, keep what's there.
+		u32 lo = 0, hi = size - 1;
+		while (lo < hi) {
+			const u32 mid = lo + (hi - lo + 1) / 2;
+			if (Memory::IsValidAddress(addr + mid))
+				lo = mid;
+			else
+				hi = mid - 1;
+		}
+		size = lo + 1;
+	}
+
+	const u8 *data = Memory::GetPointer(addr);
+	const u32 hash = XXH32(data, size, 0);
+	auto iter = captured.find(addr);
+	if (iter != captured.end() && iter->second.size == size && iter->second.hash == hash)
+		return;
+
+	// Writing this changes any overlapping range, so those must be written again next time.
+	iter = captured.lower_bound(addr);
+	if (iter != captured.begin()) {
+		auto prev = iter;
+		--prev;
+		if (prev->first + prev->second.size > addr)
+			iter = prev;
+	}
+	while (iter != captured.end() && iter->first < addr + size)
+		captured.erase(iter++);
+	CapturedRange &range = captured[addr];
+	range.size = size;
+	range.hash = hash;
+
+	FlushOps();
+	const u32_le addrLE = addr;
+	WriteCommand(COMMAND_MEMORY, &addrLE, sizeof(addrLE), data, size);
+}
+
+static void CaptureVertices(u32 count) {
+	if (count == 0)
+		return;
+
+	const u32 vertType = gstate.vertType;
+	const u32 vertexSize = VertexTypeSize(vertType);
+	u32 lower = 0;
+	u32 upper = count;
+	const u32 indexType = vertType & GE_VTYPE_IDX_MASK;
+	if (indexType != GE_VTYPE_IDX_NONE) {
+		const u32 indexAddr = gstate_c.indexAddr;
+		const u32 indexSize = indexType == GE_VTYPE_IDX_8BIT ? 1 : 2;
+		if (!Memory::IsValidAddress(indexAddr) || !Memory::IsValidAddress(indexAddr + count * indexSize - 1))
+			return;
+		CaptureMemory(indexAddr, count * indexSize);
+
+		// Only the vertices between the smallest and largest index are read.
+		u16 indexLower, indexUpper;
+		GetIndexBounds(Memory::GetPointer(indexAddr), count, vertType, &indexLower, &indexUpper);
+		lower = indexLower;
+		upper = indexUpper + 1;
+	}
+
+	CaptureMemory(gstate_c.vertexAddr + lower * vertexSize, (upper - lower) * vertexSize);
+}
+
+static void CaptureTextures() {
+	if (!gstate.isTextureMapEnabled() || gstate.isModeClear())
+		return;
+
+	const GETextureFormat format = gstate.getTextureFormat();
+	const u32 bitsPerPixel = textureBitsPerPixel[format];
+	const int maxLevel = (gstate.texmode >> 16) & 7;
+	for (int level = 0; level <= maxLevel; ++level) {
+		const u32 addr = gstate.getTextureAddress(level);
+		const u32 bufw = GetTextureBufw(level, addr, format);
+		u32 h = gstate.getTextureHeight(level);
+		// DXT is stored in 4x4 blocks.
+		if (format >= GE_TFMT_DXT1)
+			h = AlignUp(h, 4);
+		CaptureMemory(addr, bufw * h * bitsPerPixel / 8);
+	}
+}
+
+static void CaptureTransfer() {
+	const u32 stride = gstate.getTransferSrcStride();
+	const u32 bpp = gstate.getTransferBpp();
+	const u32 start = gstate.getTransferSrcAddress() + (gstate.getTransferSrcY() * stride + gstate.getTransferSrcX()) * bpp;
+	const u32 bytes = ((gstate.getTransferHeight() - 1) * stride + gstate.getTransferWidth()) * bpp;
+	CaptureMemory(start, bytes);
+}
+
+// The replay has no offset or jumps to be relative to, so addresses are set in full.
+static void EmitAddress(u32 cmd, u32 addr) {
+	ops.push_back((GE_CMD_BASE << 24) | ((addr >> 8) & 0x000F0000));
+	ops.push_back((cmd << 24) | (addr & 0x00FFFFFF));
+	ops.push_back(gstate.cmdmem[GE_CMD_BASE]);
+}
+
+static bool IsBoneMatrixCall(u32 target) {
+	if (!Memory::IsValidAddress(target) || !Memory::IsValidAddress(target + 12 * 4))
+		return false;
+	return (Memory::ReadUnchecked_U32(target) >> 24) == GE_CMD_BONEMATRIXDATA &&
+		(Memory::ReadUnchecked_U32(target + 11 * 4) >> 24) == GE_CMD_BONEMATRIXDATA &&
+		(Memory::ReadUnchecked_U32(target + 12 * 4) >> 24) == GE_CMD_RET;
+}
+
+static void Begin(int frames) {
+	active = true;
+	framesLeft = frames;
+	pushbuf.clear();
+	ops.clear();
+	captured.clear();
+
+	WriteRegisters();
+	// The CLUT was loaded before the capture started, so load it again.
+	if (gstate.getClutLoadBytes() != 0) {
+		CaptureMemory(gstate.getClutAddress(), gstate.getClutLoadBytes());
+		ops.push_back(gstate.cmdmem[GE_CMD_LOADCLUT]);
+	}
+	NOTICE_LOG(G3D, "Recording %d frames of GE commands", frames);
+}
+
+static std::string GetDumpFilename() {
+	const std::string dir = GetSysDirectory(DIRECTORY_SYSTEM) + "DUMP/";
+	File::CreateFullPath(dir);
+
+	std::string prefix = g_paramSFO.GetValueString("DISC_ID");
+	if (prefix.empty())
+		prefix = "GE";
+	for (int i = 1; ; ++i) {
+		const std::string filename = dir + StringFromFormat("%s_%04d.ppdmp", prefix.c_str(), i);
+		if (!File::Exists(filename))
+			return filename;
+	}
+}
+
+static void Finish() {
+	FlushOps();
+	active = false;
+
+	size_t compressedSize = snappy_max_compressed_length(pushbuf.size());
+	std::vector<char> compressed(compressedSize);
+	snappy_compress((const char *)&pushbuf[0], pushbuf.size(), &compressed[0], &compressedSize);
+
+	const std::string filename = GetDumpFilename();
+	DumpHeader header = { GE_DUMP_MAGIC, GE_DUMP_VERSION, (u32)pushbuf.size() };
+	File::IOFile file(filename, "wb");
+	if (!file.WriteArray(&header, 1) || !file.WriteBytes(&compressed[0], compressedSize)) {
+		ERROR_LOG(G3D, "Unable to write GE dump %s", filename.c_str());
+		lastFilename.clear();
+	} else {
+		NOTICE_LOG(G3D, "Wrote GE dump %s, %d bytes (%d uncompressed)", filename.c_str(), (int)compressedSize, (int)pushbuf.size());
+		lastFilename = filename;
+	}
+
+	pushbuf.clear();
+	captured.clear();
+}
+
+void Activate(int frames) {
+	pendingFrames = frames;
+}
+
+bool IsActive() {
+	return active;
+}
+
+void NotifyCommand(u32 pc, u32 op) {
+	if (!active)
+		return;
+
+	const u32 cmd = op >> 24;
+	const u32 data = op & 0x00FFFFFF;
+	switch (cmd) {
+	case GE_CMD_NOP:
+	case GE_CMD_OFFSETADDR:
+	case GE_CMD_ORIGIN:
+	case GE_CMD_JUMP:
+	case GE_CMD_BJUMP:
+	case GE_CMD_RET:
+	case GE_CMD_SIGNAL:
+	case GE_CMD_FINISH:
+		// Already followed, or only used for relative addresses.
+		return;
+
+	case GE_CMD_END:
+		// Otherwise it ends a signal, which was already followed too.
+		if (Memory::IsValidAddress(pc - 4) && (Memory::ReadUnchecked_U32(pc - 4) >> 24) == GE_CMD_FINISH) {
+			ops.push_back(GE_CMD_FINISH << 24);
+			ops.push_back(GE_CMD_END << 24);
+			FlushOps();
+		}
+		return;
+
+	case GE_CMD_CALL:
+		{
+			// ExecuteOp loads these directly instead of calling, so they won't come through here.
+			const u32 target = gstate_c.getRelativeAddress(data);
+			if (g_Config.bSoftwareSkinning && IsBoneMatrixCall(target)) {
+				for (u32 i = 0; i < 12; ++i)
+					ops.push_back(Memory::ReadUnchecked_U32(target + i * 4));
+			}
+		}
+		return;
+
+	case GE_CMD_VADDR:
+	case GE_CMD_IADDR:
+		EmitAddress(cmd, gstate_c.getRelativeAddress(data));
+		return;
+
+	case GE_CMD_PRIM:
+		CaptureVertices(data & 0xFFFF);
+		CaptureTextures();
+		break;
+
+	case GE_CMD_BEZIER:
+	case GE_CMD_SPLINE:
+		CaptureVertices((data & 0xFF) * ((data >> 8) & 0xFF));
+		CaptureTextures();
+		break;
+
+	case GE_CMD_BOUNDINGBOX:
+		CaptureVertices(data);
+		break;
+
+	case GE_CMD_LOADCLUT:
+		CaptureMemory(gstate.getClutAddress(), gstate.getClutLoadBytes());
+		break;
+
+	case GE_CMD_TRANSFERSTART:
+		CaptureTransfer();
+		break;
+	}
+
+	ops.push_back(op);
+}
+
+void NotifyRegisters() {
+	if (active)
+		WriteRegisters();
+}
+
+void NotifyFrame() {
+	if (!active && pendingFrames == 0)
+		return;
+
+	// Lists from this frame may still be running on the GPU thread.
+	gpu->SyncThread();
+	if (active) {
+		FlushOps();
+		WriteCommand(COMMAND_FRAME, NULL, 0);
+		if (--framesLeft <= 0 || pushbuf.size() >= MAX_CAPTURE_BYTES)
+			Finish();
+	} else {
+		Begin(pendingFrames);
+		pendingFrames = 0;
+	}
+}
+
+std::string GetLastDumpFilename() {
+	return lastFilename;
+}
+
+Replayer::Replayer() : listAddr_(0), listPos_(0), listID_(-1) {
+}
+
+bool Replayer::Load(const std::string &filename, std::string *error) {
+	data_.clear();
+	frames_.clear();
+
+	File::IOFile file(filename, "rb");
+	DumpHeader header;
+	if (!file.IsOpen() || !file.ReadArray(&header, 1)) {
+		*error = "Unable to read " + filename;
+		return false;
+	}
+	if (header.magic != GE_DUMP_MAGIC || header.version != GE_DUMP_VERSION) {
+		*error = "Not a GE dump, or from a different version";
+		return false;
+	}
+
+	std::vector<char> compressed((size_t)file.GetSize() - sizeof(header));
+	size_t size = header.size;
+	data_.resize(size);
+	bool valid = !compressed.empty() && file.ReadBytes(&compressed[0], compressed.size());
+	valid = valid && snappy_uncompress(&compressed[0], compressed.size(), (char *)&data_[0], &size) == SNAPPY_OK;
+	if (!valid || size != header.size) {
+		*error = "Corrupt GE dump";
+		return false;
+	}
+	return Parse(error);
+}
+
+// Finds the frames, and a place for the list that the captured memory doesn't use.
+bool Replayer::Parse(std::string *error) {
+	std::vector<std::pair<u32, u32> > ranges;
+	u32 listBytes = 0;
+	u32 maxListBytes = 0;
+
+	size_t pos = 0;
+	size_t frameStart = 0;
+	while (pos + sizeof(CommandHeader) <= data_.size()) {
+		CommandHeader header;
+		memcpy(&header, &data_[pos], sizeof(header));
+		const size_t dataPos = pos + sizeof(header);
+		if (dataPos + header.size > data_.size())
+			break;
+
+		switch (header.type) {
+		case COMMAND_REGISTERS:
+			if (header.size != CONTEXT_WORDS * 4) {
+				*error = "Bad register state in GE dump";
+				return false;
+			}
+			break;
+		case COMMAND_MEMORY:
+			if (header.size >= 4) {
+				u32 addr;
+				memcpy(&addr, &data_[dataPos], 4);
+				ranges.push_back(std::make_pair(addr, addr + header.size - 4));
+			}
+			break;
+		case COMMAND_DISPLAYLIST:
+			listBytes += header.size;
+			break;
+		case COMMAND_FRAME:
+			frames_.push_back(frameStart);
+			frameStart = dataPos;
+			// Room for a FINISH and END, if the frame ended in the middle of a list.
+			maxListBytes = std::max(maxListBytes, listBytes + 8);
+			listBytes = 0;
+			break;
+		default:
+			*error = "Unknown command in GE dump";
+			return false;
+		}
+		pos = dataPos + AlignUp(header.size, 4);
+	}
+	if (frames_.empty()) {
+		*error = "No complete frames in GE dump";
+		return false;
+	}
+
+	std::sort(ranges.begin(), ranges.end());
+	u32 addr = PSP_GetUserMemoryBase();
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		if (ranges[i].second <= addr)
+			continue;
+		if (ranges[i].first >= addr + maxListBytes)
+			break;
+		addr = AlignUp(ranges[i].second, 16);
+	}
+	if (addr + maxListBytes > PSP_GetUserMemoryEnd()) {
+		*error = "No free memory for the display list";
+		return false;
+	}
+	listAddr_ = addr;
+	return true;
+}
+
+void Replayer::EndList() {
+	Memory::Write_U32(GE_CMD_FINISH << 24, listPos_);
+	Memory::Write_U32(GE_CMD_END << 24, listPos_ + 4);
+	listPos_ += 8;
+	gpu->UpdateStall(listID_, listPos_);
+	listID_ = -1;
+}
+
+void Replayer::RunFrame(int frame) {
+	// Completed lists are only freed as time passes, which it doesn't here.
+	gpu->Reinitialize();
+	gpu->EnableInterrupts(false);
+	listPos_ = listAddr_;
+	listID_ = -1;
+	u32 listStart = listPos_;
+
+	size_t pos = frames_[frame];
+	while (pos + sizeof(CommandHeader) <= data_.size()) {
+		CommandHeader header;
+		memcpy(&header, &data_[pos], sizeof(header));
+		const u8 *data = &data_[pos + sizeof(header)];
+		pos += sizeof(header) + AlignUp(header.size, 4);
+
+		switch (header.type) {
+		case COMMAND_REGISTERS:
+			gstate.Restore((u32_le *)data);
+			gpu->ReapplyGfxState();
+			break;
+
+		case COMMAND_MEMORY:
+			{
+				u32 addr;
+				memcpy(&addr, data, 4);
+				const u32 size = header.size - 4;
+				if (header.size > 4 && Memory::IsValidAddress(addr) && Memory::IsValidAddress(addr + size - 1))
+					memcpy(Memory::GetPointer(addr), data + 4, size);
+			}
+			break;
+
+		case COMMAND_DISPLAYLIST:
+			{
+				memcpy(Memory::GetPointer(listPos_), data, header.size);
+				listPos_ += header.size;
+				if (listID_ < 0) {
+					PSPPointer<PspGeListArgs> args;
+					args.ptr = 0;
+					const int id = (int)gpu->EnqueueList(listStart, listPos_, -1, args, false);
+					if (id < 0) {
+						ERROR_LOG(G3D, "Unable to enqueue replayed list: %08x", id);
+						return;
+					}
+					listID_ = id;
+				} else {
+					gpu->UpdateStall(listID_, listPos_);
+				}
+
+				const u32 last = Memory::ReadUnchecked_U32(listPos_ - 4);
+				if ((last >> 24) == GE_CMD_END) {
+					listID_ = -1;
+					listStart = listPos_;
+				}
+			}
+			break;
+
+		case COMMAND_FRAME:
+			if (listID_ >= 0)
+				EndList();
+			gpu->SyncThread();
+			return;
+		}
+	}
+}
+
+};
@@ -0,0 +1,70 @@
+// Copyright (c) 2013- PPSSPP Project.
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, version 2.0 or later versions.
+
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License 2.0 for more details.
+
+// A copy of the GPL 2.0 should have been included with the program.
+// If not, see http://www.gnu.org/licenses/
+
+// Official git repository and contact information can be found at
+// https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Common/CommonTypes.h"
+
+// Captures what the GE runs over a few frames, so it can be replayed without the CPU emulation.
+//
+// A capture starts with the register state, and then holds the commands that were run in
+// order with jumps, calls and returns already followed, and vertex/index addresses made
+// absolute. Before each command that reads memory (vertices, indices, textures, CLUTs and
+// block transfers) comes the memory it reads, unless it was captured unchanged before.
+namespace GPURecord {
+
+// Captures the next frames to a file in the DUMP directory.
+void Activate(int frames);
+// True while frames are being captured. The GPU must run lists through SlowRunLoop then.
+bool IsActive();
+
+// Called with each command before it is executed, after cmdmem has been updated.
+void NotifyCommand(u32 pc, u32 op);
+// Called when the registers were replaced at once, from a context restore.
+void NotifyRegisters();
+// Called on the CPU thread after each flip.
+void NotifyFrame();
+// The file the last capture was written to, or empty if it couldn't be written.
+std::string GetLastDumpFilename();
+
+class Replayer {
+public:
+	Replayer();
+
+	// The replay needs the double (64 MB) RAM size, since a capture can come from either model.
+	bool Load(const std::string &filename, std::string *error);
+	int GetNumFrames() const {
+		return (int)frames_.size();
+	}
+	// Runs one frame through gpu, which must be idle. Frames can be replayed again in order.
+	void RunFrame(int frame);
+
+private:
+	bool Parse(std::string *error);
+	void EndList();
+
+	std::vector<u8> data_;
+	std::vector<size_t> frames_;
+	u32 listAddr_;
+	u32 listPos_;
+	int listID_;
+};
+
+};
@@ -32,12 +32,6 @@ namespace DX9 {
 #define USE_TC_HACK
 #define USE_PPC_VTX_JIT 1
 
-static const u8 tcsize[4] = {0,2,4,8}, tcalign[4] = {0,1,2,4};
-static const u8 colsize[8] = {0,0,0,0,2,2,2,4}, colalign[8] = {0,0,0,0,2,2,2,4};
-static const u8 nrmsize[4] = {0,3,6,12}, nrmalign[4] = {0,1,2,4};
-static const u8 possize[4] = {0,3,6,12}, posalign[4] = {0,1,2,4};
-static const u8 wtsize[4] = {0,1,2,4}, wtalign[4] = {0,1,2,4};
-
 inline int align(int n, int align) {
 	return (n + (align - 1)) & ~(align - 1);
 }
@@ -1586,6 +1586,9 @@ void GLES_GPU::InvalidateCacheInternal(u32 addr, int size, GPUInvalidationType t
 	else
 		textureCache_.InvalidateAll(type);
 
+	if (size > 0 && type != GPU_INVALIDATE_ALL)
+		transformDraw_.NotifyMemoryWrite(addr, size);
+
 	if (type != GPU_INVALIDATE_ALL)
 		framebufferManager_.UpdateFromMemory(addr, size, type == GPU_INVALIDATE_SAFE);
 }
@@ -18,8 +18,11 @@
 #include <map>
 #include <algorithm>
 
+#include "Common/FileUtil.h"
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
+#include "Core/System.h"
+#include "Core/ELF/ParamSFO.h"
 #include "GPU/ge_constants.h"
 #include "GPU/GPUState.h"
 #include "GPU/GLES/TextureCache.h"
@@ -28,6 +31,7 @@
 #include "Core/Config.h"
 
 #include "ext/xxhash.h"
+#include "ext/cityhash/city.h"
 #include "math/math_util.h"
 #include "native/gfx_es2/gl_state.h"
 
@@ -58,7 +62,7 @@
 
 extern int g_iNumVideos;
 
-TextureCache::TextureCache() : clearCacheNextFrame_(false), lowMemoryMode_(false), clutBuf_(NULL) {
+TextureCache::TextureCache() : clearCacheNextFrame_(false), lowMemoryMode_(false), diskCacheTried_(false), clutBuf_(NULL) {
 	lastBoundTexture = -1;
 	decimationCounter_ = TEXCACHE_DECIMATION_INTERVAL;
 	// This is 5MB of temporary storage. Might be possible to shrink it.
@@ -68,7 +72,7 @@ TextureCache::TextureCache() : clearCacheNextFrame_(false), lowMemoryMode_(false
 	clutBufConverted_ = (u32 *)AllocateAlignedMemory(4096 * sizeof(u32), 16);  // 16KB
 	clutBufRaw_ = (u32 *)AllocateAlignedMemory(4096 * sizeof(u32), 16);  // 16KB
 	glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &maxAnisotropyLevel);
-	SetupQuickTexHash();
+	SetupTextureDecoder();
 }
 
 TextureCache::~TextureCache() {
@@ -89,6 +93,9 @@ void TextureCache::Clear(bool delete_them) {
 			glDeleteTextures(1, &iter->second.texture);
 		}
 	}
+	if (delete_them) {
+		asyncScaler_.Clear();
+	}
 	if (cache.size() + secondCache.size()) {
 		INFO_LOG(G3D, "Texture cached cleared from %i textures", (int)(cache.size() + secondCache.size()));
 		cache.clear();
@@ -285,21 +292,7 @@ void *TextureCache::UnswizzleFromMem(u32 texaddr, u32 bufw, u32 bytesPerPixel, u
 
 	u32 ydest = 0;
 	if (rowWidth >= 16) {
-		const u32 *src = (u32 *) Memory::GetPointer(texaddr);
-		u32 *ydestp = tmpTexBuf32.data();
-		for (int by = 0; by < byc; by++) {
-			u32 *xdest = ydestp;
-			for (int bx = 0; bx < bxc; bx++) {
-				u32 *dest = xdest;
-				for (int n = 0; n < 8; n++) {
-					memcpy(dest, src, 16);
-					dest += pitch;
-					src += 4;
-				}
-				xdest += 4;
-			}
-			ydestp += (rowWidth * 8) / 4;
-		}
+		DoUnswizzleTex16(tmpTexBuf32.data(), Memory::GetPointer(texaddr), bxc, byc, pitch);
 	} else if (rowWidth == 8) {
 		const u32 *src = (u32 *) Memory::GetPointer(texaddr);
 		for (int by = 0; by < byc; by++) {
@@ -1007,6 +1000,9 @@ void TextureCache::SetTexture(bool force) {
 			// TODO: Mark the entry reliable if it's been safe for long enough?
 			//got one!
 			entry->lastFrame = gpuStats.numFlips;
+			if (entry->scalePending) {
+				UpdateAsyncScaled(*entry);
+			}
 			if (entry->texture != lastBoundTexture) {
 				glBindTexture(GL_TEXTURE_2D, entry->texture);
 				lastBoundTexture = entry->texture;
@@ -1068,6 +1064,8 @@ void TextureCache::SetTexture(bool force) {
 	entry->cluthash = cluthash;
 
 	entry->status &= ~TexCacheEntry::STATUS_ALPHA_MASK;
+	entry->scalePending = false;
+	entry->contenthash = 0;
 
 	gstate_c.curTextureWidth = w;
 	gstate_c.curTextureHeight = h;
@@ -1493,45 +1491,69 @@ void TextureCache::LoadTextureLevel(TexCacheEntry &entry, int level, bool replac
 
 	// TODO: Look into using BGRA for 32-bit textures when the GL_EXT_texture_format_BGRA8888 extension is available, as it's faster than RGBA on some chips.
 
-	GEPaletteFormat clutformat = gstate.getClutPaletteFormat();
-	int bufw;
-	void *finalBuf = DecodeTextureLevel(GETextureFormat(entry.format), clutformat, level, texByteAlign, dstFmt, &bufw);
-	if (finalBuf == NULL) {
-		return;
-	}
-
 	int w = gstate.getTextureWidth(level);
 	int h = gstate.getTextureHeight(level);
 
-	gpuStats.numTexturesDecoded++;
+	int scaleFactor = GetScaleFactor(entry);
+	const bool scale = scaleFactor > 1 && entry.numInvalidated == 0;
+	// Only level 0 is loaded, the rest are generated.
+	TextureDiskCache *diskCache = scale && level == 0 ? GetDiskCache() : NULL;
+	if (scale && level == 0)
+		entry.contenthash = HashTextureContents(entry);
 
-	// Can restore these and remove the fixup at the end of DecodeTextureLevel on desktop GL and GLES 3.
+	u32 *pixelData;
+	const u32 *cachedData;
 	bool useUnpack = false;
-	if ((g_Config.iTexScalingLevel == 1 && gl_extensions.EXT_unpack_subimage) && w != bufw) {
-		glPixelStorei(GL_UNPACK_ROW_LENGTH, bufw);
-		useUnpack = true;
-	}
+	if (diskCache && diskCache->Lookup(GetScaleKey(entry, scaleFactor), &cachedData, &w, &h)) {
+		// Scaled in an earlier session, so there's nothing to decode.
+		pixelData = (u32 *)cachedData;
+		dstFmt = GL_UNSIGNED_BYTE;
+	} else {
+		GEPaletteFormat clutformat = gstate.getClutPaletteFormat();
+		int bufw;
+		void *finalBuf = DecodeTextureLevel(GETextureFormat(entry.format), clutformat, level, texByteAlign, dstFmt, &bufw);
+		if (finalBuf == NULL) {
+			return;
+		}
 
-	glPixelStorei(GL_UNPACK_ALIGNMENT, texByteAlign);
+		gpuStats.numTexturesDecoded++;
 
-	int scaleFactor;
-	//Auto-texture scale upto 5x rendering resolution
-	if (g_Config.iTexScalingLevel == 0)
-#ifndef USING_GLES2
-		scaleFactor = std::min(5, g_Config.iInternalResolution);
-#else
-		scaleFactor = std::min(3, g_Config.iInternalResolution);
-#endif
-	else
-		scaleFactor = g_Config.iTexScalingLevel;
+		// Can restore these and remove the fixup at the end of DecodeTextureLevel on desktop GL and GLES 3.
+		if ((g_Config.iTexScalingLevel == 1 && gl_extensions.EXT_unpack_subimage) && w != bufw) {
+			glPixelStorei(GL_UNPACK_ROW_LENGTH, bufw);
+			useUnpack = true;
+		}
 
-	// Don't scale the PPGe texture.
-	if (entry.addr > 0x05000000 && entry.addr < 0x08800000)
-		scaleFactor = 1;
+		pixelData = (u32 *)finalBuf;
+		if (scale) {
+			if (g_Config.bTexScalingAsync && level == 0) {
+				// Use a finished result if we have one, otherwise upload unscaled for now.
+				const AsyncTextureScaler::Key key = GetScaleKey(entry, scaleFactor);
+				const u32 *scaledData;
+				int scaledW, scaledH;
+				if (asyncScaler_.Poll(key, &scaledData, &scaledW, &scaledH)) {
+					if (scaledData) {
+						pixelData = (u32 *)scaledData;
+						dstFmt = GL_UNSIGNED_BYTE;
+						w = scaledW;
+						h = scaledH;
+					}
+				} else {
+					// The scaler stores the result in the disk cache when it's done.
+					asyncScaler_.SetDiskCache(diskCache);
+					asyncScaler_.Queue(key, pixelData, dstFmt, w, h);
+					entry.scalePending = true;
+				}
+			} else {
+				scaler.Scale(pixelData, dstFmt, w, h, scaleFactor);
+				if (diskCache && pixelData != finalBuf)
+					diskCache->Store(GetScaleKey(entry, scaleFactor), pixelData, w, h);
+			}
+		}
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, texByteAlign);
 
-	u32 *pixelData = (u32 *)finalBuf;
-	if (scaleFactor > 1 && entry.numInvalidated == 0)
-		scaler.Scale(pixelData, dstFmt, w, h, scaleFactor);
 	// Or always?
 	if (entry.numInvalidated == 0)
 		CheckAlpha(entry, pixelData, dstFmt, w, h);
@@ -1558,6 +1580,101 @@ void TextureCache::LoadTextureLevel(TexCacheEntry &entry, int level, bool replac
 	}
 }
 
+// Opened on first use, since the game ID isn't necessarily known when the GPU starts.
+TextureDiskCache *TextureCache::GetDiskCache() {
+	if (!g_Config.bTextureDiskCache)
+		return NULL;
+	if (!diskCacheTried_) {
+		const std::string discID = g_paramSFO.GetValueString("DISC_ID");
+		if (discID.empty())
+			return NULL;
+		diskCacheTried_ = true;
+		const std::string cacheDir = GetSysDirectory(DIRECTORY_SYSTEM) + "CACHE/";
+		File::CreateFullPath(cacheDir);
+		diskCache_.Open(cacheDir + discID + ".texcache");
+	}
+	return diskCache_.IsOpen() ? &diskCache_ : NULL;
+}
+
+int TextureCache::GetScaleFactor(const TexCacheEntry &entry) const {
+	int scaleFactor;
+	//Auto-texture scale upto 5x rendering resolution
+	if (g_Config.iTexScalingLevel == 0)
+#ifndef USING_GLES2
+		scaleFactor = std::min(5, g_Config.iInternalResolution);
+#else
+		scaleFactor = std::min(3, g_Config.iInternalResolution);
+#endif
+	else
+		scaleFactor = g_Config.iTexScalingLevel;
+
+	// Don't scale the PPGe texture.
+	if (entry.addr > 0x05000000 && entry.addr < 0x08800000)
+		scaleFactor = 1;
+	return scaleFactor;
+}
+
+// The scaled texture keys outlive the session in the disk cache, so QuickTexHash (a quick
+// checksum, which also differs between its SSE2 and plain versions) isn't enough here.
+u64 TextureCache::HashTextureContents(const TexCacheEntry &entry) {
+	const GETextureFormat format = (GETextureFormat)entry.format;
+	int h = gstate.getTextureHeight(0);
+	// DXT is stored in 4x4 blocks.
+	if (format >= GE_TFMT_DXT1)
+		h = (h + 3) & ~3;
+	const u32 bytes = (textureBitsPerPixel[format] * GetTextureBufw(0, entry.addr, format) * h) / 8;
+	if (bytes == 0 || !Memory::IsValidAddress(entry.addr) || !Memory::IsValidAddress(entry.addr + bytes - 1))
+		return 0;
+
+	u64 hash = CityHash64WithSeed((const char *)Memory::GetPointer(entry.addr), bytes, gstate.isTextureSwizzled() ? 1 : 0);
+	if (gstate.isTextureFormatIndexed())
+		hash = CityHash64WithSeed((const char *)clutBufRaw_, clutTotalBytes_, hash ^ gstate.clutformat);
+	return hash;
+}
+
+AsyncTextureScaler::Key TextureCache::GetScaleKey(const TexCacheEntry &entry, int scaleFactor) const {
+	AsyncTextureScaler::Key key;
+	key.contenthash = entry.contenthash;
+	key.dim = entry.dim;
+	key.format = entry.format;
+	key.factor = (u8)scaleFactor;
+	key.type = (u8)g_Config.iTexScalingType;
+	key.deposterize = g_Config.bTexDeposterize;
+	return key;
+}
+
+// Swaps in the scaled level 0 once the background scaler is done with it.
+void TextureCache::UpdateAsyncScaled(TexCacheEntry &entry) {
+	const int scaleFactor = GetScaleFactor(entry);
+	if (scaleFactor <= 1 || !g_Config.bTexScalingAsync) {
+		// Settings changed meanwhile, keep what we have.
+		entry.scalePending = false;
+		return;
+	}
+
+	const u32 *data;
+	int w, h;
+	if (!asyncScaler_.Poll(GetScaleKey(entry, scaleFactor), &data, &w, &h))
+		return;
+
+	entry.scalePending = false;
+	if (!data)
+		return;
+
+	glBindTexture(GL_TEXTURE_2D, entry.texture);
+	lastBoundTexture = entry.texture;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	if (entry.maxLevel > 0 && g_Config.bMipMap) {
+		glGenerateMipmap(GL_TEXTURE_2D);
+	}
+
+	entry.status &= ~TexCacheEntry::STATUS_ALPHA_MASK;
+	CheckAlpha(entry, (u32 *)data, GL_UNSIGNED_BYTE, w, h);
+	gstate_c.textureFullAlpha = (entry.status & TexCacheEntry::STATUS_ALPHA_MASK) == TexCacheEntry::STATUS_ALPHA_FULL;
+}
+
 // Only used by Qt UI?
 bool TextureCache::DecodeTexture(u8* output, GPUgstate state) {
 	GPUgstate oldState = gstate;
@@ -108,6 +108,10 @@ private:
 		u8 minFilt;
 		bool sClamp;
 		bool tClamp;
+		// Uploaded unscaled, waiting on the background scaler.
+		bool scalePending;
+		// Of the texels and CLUT level 0 was last decoded from, see HashTextureContents.
+		u64 contenthash;
 
 		bool Matches(u16 dim2, u8 format2, int maxLevel2);
 	};
@@ -117,6 +121,11 @@ private:
 	void *ReadIndexedTex(int level, u32 texaddr, int bytesPerIndex, GLuint dstFmt, int bufw);
 	void UpdateSamplingParams(TexCacheEntry &entry, bool force);
 	void LoadTextureLevel(TexCacheEntry &entry, int level, bool replaceImages, GLenum dstFmt);
+	int GetScaleFactor(const TexCacheEntry &entry) const;
+	u64 HashTextureContents(const TexCacheEntry &entry);
+	AsyncTextureScaler::Key GetScaleKey(const TexCacheEntry &entry, int scaleFactor) const;
+	void UpdateAsyncScaled(TexCacheEntry &entry);
+	TextureDiskCache *GetDiskCache();
 	GLenum GetDestFormat(GETextureFormat format, GEPaletteFormat clutFormat) const;
 	void *DecodeTextureLevel(GETextureFormat format, GEPaletteFormat clutformat, int level, u32 &texByteAlign, GLenum dstFmt, int *bufw = 0);
 	void CheckAlpha(TexCacheEntry &entry, u32 *pixelData, GLenum dstFmt, int w, int h);
@@ -138,6 +147,10 @@ private:
 	bool clearCacheNextFrame_;
 	bool lowMemoryMode_;
 	TextureScaler scaler;
+	// Declared before asyncScaler_, whose worker thread may still be storing to it.
+	TextureDiskCache diskCache_;
+	bool diskCacheTried_;
+	AsyncTextureScaler asyncScaler_;
 
 	SimpleBuf<u32> tmpTexBuf32;
 	SimpleBuf<u16> tmpTexBuf16;
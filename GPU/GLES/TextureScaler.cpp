@@ -29,7 +29,9 @@
 #include "Common/CommonFuncs.h"
 #include "Common/ThreadPools.h"
 #include "Common/CPUDetect.h"
+#include "GPU/Common/TextureDecoder.h"
 #include "ext/xbrz/xbrz.h"
+#include "thread/threadutil.h"
 #include <stdlib.h>
 #include <math.h>
 
@@ -51,43 +53,17 @@ namespace {
 
 	// convert 4444 image to 8888, parallelizable
 	void convert4444(u16* data, u32* out, int width, int l, int u) {
-		for(int y = l; y < u; ++y) {
-			for(int x = 0; x < width; ++x) {
-				u32 val = data[y*width + x];
-				u32 r = ((val>>12) & 0xF) * 17;
-				u32 g = ((val>> 8) & 0xF) * 17;
-				u32 b = ((val>> 4) & 0xF) * 17;
-				u32 a = ((val>> 0) & 0xF) * 17;
-				out[y*width + x] = (a << 24) | (b << 16) | (g << 8) | r;
-			}
-		}
+		DoConvert4444To8888(out + l * width, data + l * width, (u - l) * width);
 	}
 
 	// convert 565 image to 8888, parallelizable
 	void convert565(u16* data, u32* out, int width, int l, int u) {
-		for(int y = l; y < u; ++y) {
-			for(int x = 0; x < width; ++x) {
-				u32 val = data[y*width + x];
-				u32 r = Convert5To8((val>>11) & 0x1F);
-				u32 g = Convert6To8((val>> 5) & 0x3F);
-				u32 b = Convert5To8((val    ) & 0x1F);
-				out[y*width + x] = (0xFF << 24) | (b << 16) | (g << 8) | r;
-			}
-		}
+		DoConvert565To8888(out + l * width, data + l * width, (u - l) * width);
 	}
 
 	// convert 5551 image to 8888, parallelizable
 	void convert5551(u16* data, u32* out, int width, int l, int u) {
-		for(int y = l; y < u; ++y) {
-			for(int x = 0; x < width; ++x) {
-				u32 val = data[y*width + x];
-				u32 r = Convert5To8((val>>11) & 0x1F);
-				u32 g = Convert5To8((val>> 6) & 0x1F);
-				u32 b = Convert5To8((val>> 1) & 0x1F);
-				u32 a = (val & 0x1) * 255;
-				out[y*width + x] = (a << 24) | (b << 16) | (g << 8) | r;
-			}
-		}
+		DoConvert5551To8888(out + l * width, data + l * width, (u - l) * width);
 	}
 
 	//////////////////////////////////////////////////////////////////// Various image processing
@@ -525,10 +501,17 @@ namespace {
 
 /////////////////////////////////////// Texture Scaler
 
-TextureScaler::TextureScaler() {
+TextureScaler::TextureScaler(ThreadPool *pool) : pool_(pool) {
 	initBicubicWeights();
 }
 
+void TextureScaler::Loop(const std::function<void(int,int)> &loop, int lower, int upper) {
+	if (pool_)
+		pool_->ParallelLoop(loop, lower, upper);
+	else
+		GlobalThreadPool::Loop(loop, lower, upper);
+}
+
 bool TextureScaler::IsEmptyOrFlat(u32* data, int pixels, GLenum fmt) {
 	int pixelsPerWord = (fmt == GL_UNSIGNED_BYTE) ? 1 : 2;
 	u32 ref = data[0];
@@ -600,22 +583,22 @@ void TextureScaler::Scale(u32* &data, GLenum &dstFmt, int &width, int &height, i
 
 void TextureScaler::ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height) {
 	xbrz::ScalerCfg cfg;
-	GlobalThreadPool::Loop(std::bind(&xbrz::scale, factor, source, dest, width, height, cfg, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&xbrz::scale, factor, source, dest, width, height, cfg, placeholder::_1, placeholder::_2), 0, height);
 }
 
 void TextureScaler::ScaleBilinear(int factor, u32* source, u32* dest, int width, int height) {
 	bufTmp1.resize(width*height*factor);
 	u32 *tmpBuf = bufTmp1.data();
-	GlobalThreadPool::Loop(std::bind(&bilinearH, factor, source, tmpBuf, width, placeholder::_1, placeholder::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&bilinearV, factor, tmpBuf, dest, width, 0, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&bilinearH, factor, source, tmpBuf, width, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&bilinearV, factor, tmpBuf, dest, width, 0, height, placeholder::_1, placeholder::_2), 0, height);
 }
 
 void TextureScaler::ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height) {
-	GlobalThreadPool::Loop(std::bind(&scaleBicubicBSpline, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&scaleBicubicBSpline, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
 }
 
 void TextureScaler::ScaleBicubicMitchell(int factor, u32* source, u32* dest, int width, int height) {
-	GlobalThreadPool::Loop(std::bind(&scaleBicubicMitchell, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&scaleBicubicMitchell, factor, source, dest, width, height, placeholder::_1, placeholder::_2), 0, height);
 }
 
 void TextureScaler::ScaleHybrid(int factor, u32* source, u32* dest, int width, int height, bool bicubic) {
@@ -631,8 +614,8 @@ void TextureScaler::ScaleHybrid(int factor, u32* source, u32* dest, int width, i
 	bufTmp1.resize(width*height);
 	bufTmp2.resize(width*height*factor*factor);
 	bufTmp3.resize(width*height*factor*factor);
-	GlobalThreadPool::Loop(std::bind(&generateDistanceMask, source, bufTmp1.data(), width, height, placeholder::_1, placeholder::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&convolve3x3, bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&generateDistanceMask, source, bufTmp1.data(), width, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&convolve3x3, bufTmp1.data(), bufTmp2.data(), KERNEL_SPLAT, width, height, placeholder::_1, placeholder::_2), 0, height);
 	ScaleBilinear(factor, bufTmp2.data(), bufTmp3.data(), width, height);
 	// mask C is now in bufTmp3
 
@@ -645,15 +628,15 @@ void TextureScaler::ScaleHybrid(int factor, u32* source, u32* dest, int width, i
 
 	// Now we can mix it all together
 	// The factor 8192 was found through practical testing on a variety of textures
-	GlobalThreadPool::Loop(std::bind(&mix, dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, placeholder::_1, placeholder::_2), 0, height*factor);
+	Loop(std::bind(&mix, dest, bufTmp2.data(), bufTmp3.data(), 8192, width*factor, placeholder::_1, placeholder::_2), 0, height*factor);
 }
 
 void TextureScaler::DePosterize(u32* source, u32* dest, int width, int height) {
 	bufTmp3.resize(width*height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeH, source, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeH, dest, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
-	GlobalThreadPool::Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&deposterizeH, source, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&deposterizeH, dest, bufTmp3.data(), width, placeholder::_1, placeholder::_2), 0, height);
+	Loop(std::bind(&deposterizeV, bufTmp3.data(), dest, width, height, placeholder::_1, placeholder::_2), 0, height);
 }
 
 void TextureScaler::ConvertTo8888(GLenum format, u32* source, u32* &dest, int width, int height) {
@@ -663,15 +646,15 @@ void TextureScaler::ConvertTo8888(GLenum format, u32* source, u32* &dest, int wi
 		break;
 
 	case GL_UNSIGNED_SHORT_4_4_4_4:
-		GlobalThreadPool::Loop(std::bind(&convert4444, (u16*)source, dest, width, placeholder::_1, placeholder::_2), 0, height);
+		Loop(std::bind(&convert4444, (u16*)source, dest, width, placeholder::_1, placeholder::_2), 0, height);
 		break;
 
 	case GL_UNSIGNED_SHORT_5_6_5:
-		GlobalThreadPool::Loop(std::bind(&convert565, (u16*)source, dest, width, placeholder::_1, placeholder::_2), 0, height);
+		Loop(std::bind(&convert565, (u16*)source, dest, width, placeholder::_1, placeholder::_2), 0, height);
 		break;
 
 	case GL_UNSIGNED_SHORT_5_5_5_1:
-		GlobalThreadPool::Loop(std::bind(&convert5551, (u16*)source, dest, width, placeholder::_1, placeholder::_2), 0, height);
+		Loop(std::bind(&convert5551, (u16*)source, dest, width, placeholder::_1, placeholder::_2), 0, height);
 		break;
 
 	default:
@@ -679,3 +662,146 @@ void TextureScaler::ConvertTo8888(GLenum format, u32* source, u32* &dest, int wi
 		ERROR_LOG(G3D, "iXBRZTexScaling: unsupported texture format");
 	}
 }
+
+/////////////////////////////////////// Async Texture Scaler
+
+// Scaled textures kept around for reuse. Anything over this is dropped, least recently used first.
+#ifdef USING_GLES2
+static const size_t ASYNC_SCALER_BUDGET = 32 * 1024 * 1024;
+#else
+static const size_t ASYNC_SCALER_BUDGET = 128 * 1024 * 1024;
+#endif
+// Threads for the async scaler's own pool, one of them being the worker itself.
+static const int ASYNC_SCALER_THREADS = 2;
+
+AsyncTextureScaler::AsyncTextureScaler() : pool_(ASYNC_SCALER_THREADS), scaler_(&pool_), thread_(NULL), exit_(false), diskCache_(NULL), usedBytes_(0), tick_(0) {
+}
+
+AsyncTextureScaler::~AsyncTextureScaler() {
+	if (thread_) {
+		{
+			lock_guard guard(lock_);
+			exit_ = true;
+			cond_.notify_one();
+		}
+		thread_->join();
+		delete thread_;
+	}
+}
+
+void AsyncTextureScaler::Queue(const Key &key, const u32 *data, GLenum dstFmt, int width, int height) {
+	lock_guard guard(lock_);
+	if (results_.find(key) != results_.end())
+		return;
+
+	Evict();
+
+	const size_t bytes = width * height * (dstFmt == GL_UNSIGNED_BYTE ? 4 : 2);
+	Result &result = results_[key];
+	result.done = false;
+	result.dstFmt = dstFmt;
+	result.width = width;
+	result.height = height;
+	result.data.assign(data, data + (bytes + 3) / 4);
+	result.lastUsed = ++tick_;
+	usedBytes_ += result.data.size() * sizeof(u32);
+	queue_.push_back(key);
+
+	if (!thread_)
+		thread_ = new std::thread(std::bind(&AsyncTextureScaler::WorkerFunc, this));
+	cond_.notify_one();
+}
+
+bool AsyncTextureScaler::Poll(const Key &key, const u32 **data, int *width, int *height) {
+	lock_guard guard(lock_);
+	auto iter = results_.find(key);
+	if (iter == results_.end() || !iter->second.done)
+		return false;
+
+	Result &result = iter->second;
+	result.lastUsed = ++tick_;
+	*data = result.data.empty() ? NULL : &result.data[0];
+	*width = result.width;
+	*height = result.height;
+	return true;
+}
+
+void AsyncTextureScaler::Clear() {
+	lock_guard guard(lock_);
+	// Whatever the worker is on will be dropped when it finishes, since it won't find its entry.
+	queue_.clear();
+	results_.clear();
+	usedBytes_ = 0;
+}
+
+void AsyncTextureScaler::SetDiskCache(TextureDiskCache *diskCache) {
+	lock_guard guard(lock_);
+	diskCache_ = diskCache;
+}
+
+void AsyncTextureScaler::Evict() {
+	while (usedBytes_ > ASYNC_SCALER_BUDGET) {
+		auto oldest = results_.end();
+		for (auto iter = results_.begin(); iter != results_.end(); ++iter) {
+			if (iter->second.done && (oldest == results_.end() || iter->second.lastUsed < oldest->second.lastUsed))
+				oldest = iter;
+		}
+		// Everything left is still queued.
+		if (oldest == results_.end())
+			break;
+		usedBytes_ -= oldest->second.data.size() * sizeof(u32);
+		results_.erase(oldest);
+	}
+}
+
+void AsyncTextureScaler::WorkerFunc() {
+	setCurrentThreadName("TextureScaler");
+
+	std::vector<u32> input;
+	lock_guard guard(lock_);
+	while (!exit_) {
+		if (queue_.empty()) {
+			cond_.wait(lock_);
+			continue;
+		}
+
+		const Key key = queue_.front();
+		queue_.pop_front();
+		auto iter = results_.find(key);
+		if (iter == results_.end() || iter->second.done)
+			continue;
+
+		GLenum dstFmt = iter->second.dstFmt;
+		int width = iter->second.width;
+		int height = iter->second.height;
+		// Leaves the entry empty, so it isn't mistaken for a result if this isn't scaled.
+		input.clear();
+		input.swap(iter->second.data);
+
+		TextureDiskCache *diskCache = diskCache_;
+		lock_.unlock();
+		u32 *data = &input[0];
+		scaler_.Scale(data, dstFmt, width, height, key.factor);
+		const bool scaled = data != &input[0];
+		if (scaled && diskCache)
+			diskCache->Store(key, data, width, height);
+		lock_.lock();
+
+		// Might have been cleared meanwhile.
+		iter = results_.find(key);
+		if (iter == results_.end())
+			continue;
+
+		Result &result = iter->second;
+		usedBytes_ -= input.size() * sizeof(u32);
+		if (scaled) {
+			result.data.assign(data, data + width * height);
+			result.width = width;
+			result.height = height;
+			usedBytes_ += result.data.size() * sizeof(u32);
+		} else {
+			result.data.clear();
+		}
+		result.done = true;
+	}
+}
@@ -18,21 +18,29 @@
 #pragma once
 
 #include "Common/MemoryUtil.h"
+#include "GPU/Common/TextureDiskCache.h"
 #include "../Globals.h"
+#include "base/mutex.h"
 #include "gfx/gl_common.h"
+#include "thread/thread.h"
+#include "thread/threadpool.h"
 
+#include <deque>
+#include <map>
 #include <vector>
 
 
 class TextureScaler {
 public:
-	TextureScaler();
+	// Loops run on pool, or on the global thread pool if NULL.
+	explicit TextureScaler(ThreadPool *pool = NULL);
 
 	void Scale(u32* &data, GLenum &dstfmt, int &width, int &height, int factor);
 
 	enum { XBRZ= 0, HYBRID = 1, BICUBIC = 2, HYBRID_BICUBIC = 3 };
 
 private:
+	void Loop(const std::function<void(int,int)> &loop, int lower, int upper);
 	void ScaleXBRZ(int factor, u32* source, u32* dest, int width, int height);
 	void ScaleBilinear(int factor, u32* source, u32* dest, int width, int height);
 	void ScaleBicubicBSpline(int factor, u32* source, u32* dest, int width, int height);
@@ -48,4 +56,54 @@ private:
 	// maximum is (100 MB total for a 512 by 512 texture with scaling factor 5 and hybrid scaling)
 	// of course, scaling factor 5 is totally silly anyway
 	SimpleBuf<u32> bufInput, bufDeposter, bufOutput, bufTmp1, bufTmp2, bufTmp3;
+	ThreadPool *pool_;
+};
+
+// Runs a TextureScaler on a background thread, so the texture cache can upload the
+// unscaled texture right away and swap in the scaled one on a later frame.
+// Results are kept by content hash (up to a memory budget), so a texture that gets
+// decoded again, even at another address, is scaled without waiting.
+class AsyncTextureScaler {
+public:
+	AsyncTextureScaler();
+	~AsyncTextureScaler();
+
+	typedef ScaledTextureKey Key;
+
+	// Queues a copy of data for scaling, unless it's already queued or done.
+	void Queue(const Key &key, const u32 *data, GLenum dstFmt, int width, int height);
+	// Returns true once the key is done. data is NULL if it wasn't worth scaling.
+	// The pointer stays valid until the next call to Queue or Clear.
+	bool Poll(const Key &key, const u32 **data, int *width, int *height);
+	void Clear();
+	// Finished results are also stored here, if set.
+	void SetDiskCache(TextureDiskCache *diskCache);
+
+private:
+	struct Result {
+		bool done;
+		GLenum dstFmt;
+		int width;
+		int height;
+		// Unscaled while queued, scaled 8888 when done (or empty if left unscaled.)
+		std::vector<u32> data;
+		u32 lastUsed;
+	};
+
+	void WorkerFunc();
+	void Evict();
+
+	// Its own pool, so scaling doesn't hold up loops on the global pool that the GPU thread waits for.
+	ThreadPool pool_;
+	TextureScaler scaler_;
+	std::thread *thread_;
+	recursive_mutex lock_;
+	condition_variable cond_;
+	bool exit_;
+
+	std::map<Key, Result> results_;
+	std::deque<Key> queue_;
+	TextureDiskCache *diskCache_;
+	size_t usedBytes_;
+	u32 tick_;
 };
@@ -160,6 +160,7 @@ TransformDrawEngine::~TransformDrawEngine() {
 	FreeMemoryPages(transformed, TRANSFORMED_VERTEX_BUFFER_SIZE);
 	FreeMemoryPages(transformedExpanded, 3 * TRANSFORMED_VERTEX_BUFFER_SIZE);
 	delete [] quadIndices_;
+	ClearSplineCaches();
 
 	unregister_gl_resource_holder(this);
 	delete decJitCache_;
@@ -371,7 +372,7 @@ void TransformDrawEngine::DecodeVertsStep() {
 	void *inds = dc.inds;
 	if (indexType == GE_VTYPE_IDX_NONE >> GE_VTYPE_IDX_SHIFT) {
 		// Decode the verts and apply morphing. Simple.
-		dec_->DecodeVerts(decoded + collectedVerts * (int)dec_->GetDecVtxFmt().stride,
+		dec_->DecodeVertsParallel(decoded + collectedVerts * (int)dec_->GetDecVtxFmt().stride,
 			dc.verts, indexLowerBound, indexUpperBound);
 		collectedVerts += indexUpperBound - indexLowerBound + 1;
 		indexGen.AddPrim(dc.prim, dc.vertexCount);
@@ -411,7 +412,7 @@ void TransformDrawEngine::DecodeVertsStep() {
 
 		int vertexCount = indexUpperBound - indexLowerBound + 1;
 		// 3. Decode that range of vertex data.
-		dec_->DecodeVerts(decoded + collectedVerts * (int)dec_->GetDecVtxFmt().stride,
+		dec_->DecodeVertsParallel(decoded + collectedVerts * (int)dec_->GetDecVtxFmt().stride,
 			dc.verts, indexLowerBound, indexUpperBound);
 		collectedVerts += vertexCount;
 
@@ -421,8 +422,9 @@ void TransformDrawEngine::DecodeVertsStep() {
 	}
 }
 
-u32 TransformDrawEngine::ComputeHash() {
-	u32 fullhash = 0;
+// The vertex and index data read by the deferred draw calls, as ranges to hash.
+int TransformDrawEngine::CollectHashRanges(HashRange *ranges) {
+	int numRanges = 0;
 	int vertexSize = dec_->GetDecVtxFmt().stride;
 
 	// TODO: Add some caps both for numDrawCalls and num verts to check?
@@ -430,7 +432,10 @@ u32 TransformDrawEngine::ComputeHash() {
 	for (int i = 0; i < numDrawCalls; i++) {
 		const DeferredDrawCall &dc = drawCalls[i];
 		if (!dc.inds) {
-			fullhash += XXH32((const char *)dc.verts, vertexSize * dc.vertexCount, 0x1DE8CAC4);
+			HashRange &r = ranges[numRanges++];
+			r.data = (const u8 *)dc.verts;
+			r.size = vertexSize * dc.vertexCount;
+			r.seed = 0x1DE8CAC4;
 		} else {
 			int indexLowerBound = dc.indexLowerBound, indexUpperBound = dc.indexUpperBound;
 			int j = i + 1;
@@ -445,21 +450,116 @@ u32 TransformDrawEngine::ComputeHash() {
 			}
 			// This could get seriously expensive with sparse indices. Need to combine hashing ranges the same way
 			// we do when drawing.
-			fullhash += XXH32((const char *)dc.verts + vertexSize * indexLowerBound,
-				vertexSize * (indexUpperBound - indexLowerBound), 0x029F3EE1);
+			HashRange &verts = ranges[numRanges++];
+			verts.data = (const u8 *)dc.verts + vertexSize * indexLowerBound;
+			verts.size = vertexSize * (indexUpperBound - indexLowerBound);
+			verts.seed = 0x029F3EE1;
 			int indexSize = (dec_->VertexType() & GE_VTYPE_IDX_MASK) == GE_VTYPE_IDX_16BIT ? 2 : 1;
 			// Hm, we will miss some indices when combining above, but meh, it should be fine.
-			fullhash += XXH32((const char *)dc.inds, indexSize * dc.vertexCount, 0x955FD1CA);
+			HashRange &inds = ranges[numRanges++];
+			inds.data = (const u8 *)dc.inds;
+			inds.size = indexSize * dc.vertexCount;
+			inds.seed = 0x955FD1CA;
 			i = lastMatch;
 		}
 	}
+	return numRanges;
+}
+
+u32 ComputeSampledHash(const u8 *data, int size, u32 seed) {
+	if (size <= VERTEX_HASH_SAMPLE_SIZE * VERTEX_HASH_SAMPLE_COUNT)
+		return XXH32((const char *)data, size, seed);
+
+	u8 samples[VERTEX_HASH_SAMPLE_SIZE * VERTEX_HASH_SAMPLE_COUNT];
+	const int spacing = (size - VERTEX_HASH_SAMPLE_SIZE) / (VERTEX_HASH_SAMPLE_COUNT - 1);
+	for (int j = 0; j < VERTEX_HASH_SAMPLE_COUNT - 1; j++)
+		memcpy(samples + j * VERTEX_HASH_SAMPLE_SIZE, data + j * spacing, VERTEX_HASH_SAMPLE_SIZE);
+	memcpy(samples + (VERTEX_HASH_SAMPLE_COUNT - 1) * VERTEX_HASH_SAMPLE_SIZE, data + size - VERTEX_HASH_SAMPLE_SIZE, VERTEX_HASH_SAMPLE_SIZE);
+	return XXH32((const char *)samples, sizeof(samples), seed);
+}
+
+u32 TransformDrawEngine::ComputeHash(bool sampled) {
+	HashRange ranges[MAX_DEFERRED_DRAW_CALLS * 2];
+	const int numRanges = CollectHashRanges(ranges);
+
+	u32 fullhash = 0;
+	int bytesHashed = 0;
+	for (int i = 0; i < numRanges; i++) {
+		const HashRange &r = ranges[i];
+		if (!sampled) {
+			fullhash += XXH32((const char *)r.data, r.size, r.seed);
+			bytesHashed += r.size;
+		} else {
+			fullhash += ComputeSampledHash(r.data, r.size, r.seed);
+			bytesHashed += std::min(r.size, (int)(VERTEX_HASH_SAMPLE_SIZE * VERTEX_HASH_SAMPLE_COUNT));
+		}
+	}
 	if (uvScale) {
 		fullhash += XXH32(&uvScale[0], sizeof(uvScale[0]) * numDrawCalls, 0x0123e658);
 	}
 
+	gpuStats.numVertexBytesHashed += bytesHashed;
 	return fullhash;
 }
 
+// Physical address of a pointer from Memory::GetPointerUnchecked, the same for every mirror.
+static inline u32 PointerToPhysical(const u8 *ptr) {
+	return (u32)(ptr - Memory::base) & 0x0FFFFFFF;
+}
+
+MemoryWriteTracker::MemoryWriteTracker() : generation_(0) {
+	pageGeneration_.resize((TRACK_END - TRACK_BASE) >> PAGE_SHIFT, 0);
+}
+
+void MemoryWriteTracker::NotifyWrite(u32 addr, int size) {
+	if (size <= 0)
+		return;
+	const u32 start = addr & 0x0FFFFFFF;
+	const u32 end = start + size;
+	if (start >= TRACK_END || end <= TRACK_BASE)
+		return;
+
+	++generation_;
+	const u32 firstPage = (std::max(start, (u32)TRACK_BASE) - TRACK_BASE) >> PAGE_SHIFT;
+	const u32 lastPage = (std::min(end, (u32)TRACK_END) - 1 - TRACK_BASE) >> PAGE_SHIFT;
+	for (u32 page = firstPage; page <= lastPage; ++page)
+		pageGeneration_[page] = generation_;
+}
+
+bool MemoryWriteTracker::WrittenSince(u32 addr, int size, u32 generation) const {
+	if (generation == generation_ || size <= 0)
+		return false;
+	const u32 start = addr & 0x0FFFFFFF;
+	const u32 end = start + size;
+	if (start < TRACK_BASE || end > TRACK_END)
+		return false;
+
+	const u32 lastPage = (end - 1 - TRACK_BASE) >> PAGE_SHIFT;
+	for (u32 page = (start - TRACK_BASE) >> PAGE_SHIFT; page <= lastPage; ++page) {
+		// Generations only grow, so anything newer means written.
+		if (pageGeneration_[page] > generation)
+			return true;
+	}
+	return false;
+}
+
+void TransformDrawEngine::NotifyMemoryWrite(u32 addr, int size) {
+	writeTracker_.NotifyWrite(addr, size);
+}
+
+bool TransformDrawEngine::WrittenSince(u32 generation) {
+	if (generation == writeTracker_.Generation())
+		return false;
+
+	HashRange ranges[MAX_DEFERRED_DRAW_CALLS * 2];
+	const int numRanges = CollectHashRanges(ranges);
+	for (int i = 0; i < numRanges; i++) {
+		if (writeTracker_.WrittenSince(PointerToPhysical(ranges[i].data), ranges[i].size, generation))
+			return true;
+	}
+	return false;
+}
+
 u32 TransformDrawEngine::ComputeFastDCID() {
 	u32 hash = 0;
 	for (int i = 0; i < numDrawCalls; i++) {
@@ -521,6 +621,19 @@ VertexArrayInfo::~VertexArrayInfo() {
 		glDeleteBuffers(1, &ebo);
 }
 
+bool VertexArrayInfo::NeedsSampledFullHash(bool written, bool sampleChanged) {
+	if (written || sampleChanged)
+		return true;
+	if (drawsUntilNextFullHash != 0)
+		return false;
+	if (fullHashesSkipped < MAX_SKIPPED_FULL_HASHES) {
+		fullHashesSkipped++;
+		drawsUntilNextFullHash = numVerts > 100 ? std::min(24, numFrames) : 0;
+		return false;
+	}
+	return true;
+}
+
 void TransformDrawEngine::DoFlush() {
 	gpuStats.numFlushes++;
 	
@@ -547,6 +660,7 @@ void TransformDrawEngine::DoFlush() {
 			useCache = false;
 
 		if (useCache) {
+			gpuStats.numVertexCacheLookups++;
 			u32 id = ComputeFastDCID();
 			auto iter = vai_.find(id);
 			VertexArrayInfo *vai;
@@ -562,8 +676,12 @@ void TransformDrawEngine::DoFlush() {
 			case VertexArrayInfo::VAI_NEW:
 				{
 					// Haven't seen this one before.
-					u32 dataHash = ComputeHash();
+					u32 dataHash = ComputeHash(false);
 					vai->hash = dataHash;
+					if (g_Config.bVertexCacheSampledHash) {
+						vai->sampledHash = ComputeHash(true);
+						vai->writeGeneration = writeTracker_.Generation();
+					}
 					vai->status = VertexArrayInfo::VAI_HASHING;
 					vai->drawsUntilNextFullHash = 0;
 					DecodeVerts(); // writes to indexGen
@@ -581,8 +699,17 @@ void TransformDrawEngine::DoFlush() {
 					if (vai->lastFrame != gpuStats.numFlips) {
 						vai->numFrames++;
 					}
-					if (vai->drawsUntilNextFullHash == 0) {
-						u32 newHash = ComputeHash();
+					const bool fullHashDue = vai->drawsUntilNextFullHash == 0;
+					bool fullHash = fullHashDue;
+					if (g_Config.bVertexCacheSampledHash) {
+						// Check a sample every time, unless the game told us it wrote some of this data.
+						// Either of those changing means hashing everything now.
+						const bool written = WrittenSince(vai->writeGeneration);
+						const bool sampleChanged = !written && ComputeHash(true) != vai->sampledHash;
+						fullHash = vai->NeedsSampledFullHash(written, sampleChanged);
+					}
+					if (fullHash) {
+						u32 newHash = ComputeHash(false);
 						if (newHash != vai->hash) {
 							vai->status = VertexArrayInfo::VAI_UNRELIABLE;
 							if (vai->vbo) {
@@ -596,6 +723,11 @@ void TransformDrawEngine::DoFlush() {
 							DecodeVerts();
 							goto rotateVBO;
 						}
+						if (g_Config.bVertexCacheSampledHash) {
+							vai->sampledHash = ComputeHash(true);
+							vai->writeGeneration = writeTracker_.Generation();
+							vai->fullHashesSkipped = 0;
+						}
 						if (vai->numVerts > 100) {
 							// exponential backoff up to 16 draws, then every 24
 							vai->drawsUntilNextFullHash = std::min(24, vai->numFrames);
@@ -607,9 +739,8 @@ void TransformDrawEngine::DoFlush() {
 						//if (vai->numFrames > 1000) {
 						//	vai->status = VertexArrayInfo::VAI_RELIABLE;
 						//}
-					} else {
+					} else if (!fullHashDue) {
 						vai->drawsUntilNextFullHash--;
-						// TODO: "mini-hashing" the first 32 bytes of the vertex/index data or something.
 					}
 
 					if (vai->vbo == 0) {
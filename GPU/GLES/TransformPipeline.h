@@ -18,6 +18,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 
 #include "GPU/Common/GPUDebugInterface.h"
 #include "GPU/Common/IndexGenerator.h"
@@ -32,6 +33,38 @@ class FramebufferManager;
 
 struct DecVtxFormat;
 
+// A sampled hash reads VERTEX_HASH_SAMPLE_COUNT chunks of VERTEX_HASH_SAMPLE_SIZE bytes spread evenly
+// over the range, including both ends. Ranges this small or smaller are hashed whole, so it's exact for them.
+enum {
+	VERTEX_HASH_SAMPLE_SIZE = 16,
+	VERTEX_HASH_SAMPLE_COUNT = 16,
+};
+
+u32 ComputeSampledHash(const u8 *data, int size, u32 seed);
+
+// Which pages of main RAM (physical) the game said it wrote, by dcache writeback or DMA.
+class MemoryWriteTracker {
+public:
+	MemoryWriteTracker();
+
+	void NotifyWrite(u32 addr, int size);
+	// Goes up with each tracked write.
+	u32 Generation() const {
+		return generation_;
+	}
+	// Whether a page under the range was written after generation. Ranges outside RAM never are.
+	bool WrittenSince(u32 addr, int size, u32 generation) const;
+
+private:
+	enum {
+		TRACK_BASE = 0x08000000,
+		TRACK_END = 0x0C000000,
+		PAGE_SHIFT = 12,
+	};
+	u32 generation_;
+	std::vector<u32> pageGeneration_;
+};
+
 // States transitions:
 // On creation: DRAWN_NEW
 // DRAWN_NEW -> DRAWN_HASHING
@@ -57,9 +90,16 @@ public:
 		lastFrame = gpuStats.numFlips;
 		numVerts = 0;
 		drawsUntilNextFullHash = 0;
+		sampledHash = 0;
+		writeGeneration = 0;
+		fullHashesSkipped = 0;
 	}
 	~VertexArrayInfo();
 
+	// With sampled hashing, whether this draw needs a full hash. Always if the data was written or the
+	// sample changed, otherwise only when one is scheduled and enough have been skipped in a row.
+	bool NeedsSampledFullHash(bool written, bool sampleChanged);
+
 	enum Status {
 		VAI_NEW,
 		VAI_HASHING,
@@ -67,7 +107,14 @@ public:
 		VAI_UNRELIABLE,  // never cache
 	};
 
+	// With sampled hashing, still do every Nth scheduled full hash.
+	enum { MAX_SKIPPED_FULL_HASHES = 4 };
+
 	u32 hash;
+	// Hash of a strided sample of the same data, checked every draw when sampled hashing is on.
+	u32 sampledHash;
+	// The write tracker's generation when hash was last computed.
+	u32 writeGeneration;
 
 	Status status;
 
@@ -85,6 +132,7 @@ public:
 	int numFrames;
 	int lastFrame;  // So that we can forget.
 	u16 drawsUntilNextFullHash;
+	u8 fullHashesSkipped;
 };
 
 // Handles transform, lighting and drawing.
@@ -132,6 +180,9 @@ public:
 		return decJitCache_->IsInSpace(ptr);
 	}
 
+	// The game wrote this range (dcache writeback, DMA), so vertex arrays in it get fully rehashed.
+	void NotifyMemoryWrite(u32 addr, int size);
+
 private:
 	void DecodeVerts();
 	void DecodeVertsStep();
@@ -143,9 +194,17 @@ private:
 	// Preprocessing for spline/bezier
 	u32 NormalizeVertices(u8 *outPtr, u8 *bufPtr, const u8 *inPtr, int lowerBound, int upperBound, u32 vertType);
 
+	struct HashRange {
+		const u8 *data;
+		int size;
+		u32 seed;
+	};
+
 	// drawcall ID
 	u32 ComputeFastDCID();
-	u32 ComputeHash();  // Reads deferred vertex data.
+	int CollectHashRanges(HashRange *ranges);
+	u32 ComputeHash(bool sampled);  // Reads deferred vertex data.
+	bool WrittenSince(u32 generation);
 
 	VertexDecoder *GetVertexDecoder(u32 vtype);
 
@@ -206,6 +265,8 @@ private:
 	int decodeCounter_;
 
 	UVScale *uvScale;
+
+	MemoryWriteTracker writeTracker_;
 };
 
 // Only used by SW transform
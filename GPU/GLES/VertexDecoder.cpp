@@ -19,6 +19,7 @@
 #include "base/logging.h"
 
 #include "Common/CPUDetect.h"
+#include "Common/ThreadPools.h"
 #include "Core/Config.h"
 #include "Core/MemMap.h"
 #include "GPU/ge_constants.h"
@@ -27,21 +28,14 @@
 #include "VertexDecoder.h"
 #include "VertexShaderGenerator.h"
 
-static const u8 tcsize[4] = {0,2,4,8}, tcalign[4] = {0,1,2,4};
-static const u8 colsize[8] = {0,0,0,0,2,2,2,4}, colalign[8] = {0,0,0,0,2,2,2,4};
-static const u8 nrmsize[4] = {0,3,6,12}, nrmalign[4] = {0,1,2,4};
-static const u8 possize[4] = {0,3,6,12}, posalign[4] = {0,1,2,4};
-static const u8 wtsize[4] = {0,1,2,4}, wtalign[4] = {0,1,2,4};
-
-// When software skinning. This array is only used when non-jitted - when jitted, the matrix
-// is kept in registers.
-static float MEMORY_ALIGNED16(skinMatrix[12]);
+// Below this many vertices, DecodeVertsParallel doesn't bother with the worker threads.
+enum { PARALLEL_DECODE_MIN_VERTS = 1024 };
 
 inline int align(int n, int align) {
 	return (n + (align - 1)) & ~(align - 1);
 }
 
-VertexDecoder::VertexDecoder() : coloff(0), nrmoff(0), posoff(0), jitted_(0) {
+VertexDecoder::VertexDecoder() : coloff(0), nrmoff(0), posoff(0), skinInDecode_(false), jitted_(0) {
 	memset(stats_, 0, sizeof(stats_));
 }
 
@@ -84,7 +78,7 @@ void VertexDecoder::Step_WeightsFloat() const
 
 void VertexDecoder::Step_WeightsU8Skin() const
 {
-	memset(skinMatrix, 0, sizeof(skinMatrix));
+	memset(skinMatrix_, 0, sizeof(skinMatrix_));
 	u8 *wt = (u8 *)(decoded_ + decFmt.w0off);
 	const u8 *wdata = (const u8*)(ptr_);
 	for (int j = 0; j < nweights; j++) {
@@ -92,7 +86,7 @@ void VertexDecoder::Step_WeightsU8Skin() const
 		if (wdata[j] != 0) {
 			float weight = wdata[j] / 128.0f;
 			for (int i = 0; i < 12; i++) {
-				skinMatrix[i] += weight * bone[i];
+				skinMatrix_[i] += weight * bone[i];
 			}
 		}
 	}
@@ -100,7 +94,7 @@ void VertexDecoder::Step_WeightsU8Skin() const
 
 void VertexDecoder::Step_WeightsU16Skin() const
 {
-	memset(skinMatrix, 0, sizeof(skinMatrix));
+	memset(skinMatrix_, 0, sizeof(skinMatrix_));
 	u16 *wt = (u16 *)(decoded_ + decFmt.w0off);
 	const u16 *wdata = (const u16*)(ptr_);
 	for (int j = 0; j < nweights; j++) {
@@ -108,7 +102,7 @@ void VertexDecoder::Step_WeightsU16Skin() const
 		if (wdata[j] != 0) {
 			float weight = wdata[j] / 32768.0f;
 			for (int i = 0; i < 12; i++) {
-				skinMatrix[i] += weight * bone[i];
+				skinMatrix_[i] += weight * bone[i];
 			}
 		}
 	}
@@ -119,15 +113,15 @@ void VertexDecoder::Step_WeightsU16Skin() const
 // (PSP uses 0.0-2.0 fixed point numbers for weights)
 void VertexDecoder::Step_WeightsFloatSkin() const
 {
-	memset(skinMatrix, 0, sizeof(skinMatrix));
+	memset(skinMatrix_, 0, sizeof(skinMatrix_));
 	float *wt = (float *)(decoded_ + decFmt.w0off);
 	const float *wdata = (const float*)(ptr_);
 	for (int j = 0; j < nweights; j++) {
 		const float *bone = &gstate.boneMatrix[j * 12];
 		float weight = wdata[j];
-		if (weight > 0.0) {
+		if (weight != 0.0f) {
 			for (int i = 0; i < 12; i++) {
-				skinMatrix[i] += weight * bone[i];
+				skinMatrix_[i] += weight * bone[i];
 			}
 		}
 	}
@@ -344,7 +338,7 @@ void VertexDecoder::Step_NormalS8Skin() const
 	float *normal = (float *)(decoded_ + decFmt.nrmoff);
 	const s8 *sv = (const s8*)(ptr_ + nrmoff);
 	const float fn[3] = { sv[0] / 128.0f, sv[1] / 128.0f, sv[2] / 128.0f };
-	Norm3ByMatrix43(normal, fn, skinMatrix);
+	Norm3ByMatrix43(normal, fn, skinMatrix_);
 }
 
 void VertexDecoder::Step_NormalS16Skin() const
@@ -352,14 +346,14 @@ void VertexDecoder::Step_NormalS16Skin() const
 	float *normal = (float *)(decoded_ + decFmt.nrmoff);
 	const s16 *sv = (const s16*)(ptr_ + nrmoff);
 	const float fn[3] = { sv[0] / 32768.0f, sv[1] / 32768.0f, sv[2] / 32768.0f };
-	Norm3ByMatrix43(normal, fn, skinMatrix);
+	Norm3ByMatrix43(normal, fn, skinMatrix_);
 }
 
 void VertexDecoder::Step_NormalFloatSkin() const
 {
 	float *normal = (float *)(decoded_ + decFmt.nrmoff);
 	const float *fn = (const float *)(ptr_ + nrmoff);
-	Norm3ByMatrix43(normal, fn, skinMatrix);
+	Norm3ByMatrix43(normal, fn, skinMatrix_);
 }
 
 void VertexDecoder::Step_NormalS8Morph() const
@@ -431,7 +425,7 @@ void VertexDecoder::Step_PosS8Skin() const
 	float *pos = (float *)(decoded_ + decFmt.posoff);
 	const s8 *sv = (const s8*)(ptr_ + posoff);
 	const float fn[3] = { sv[0] / 128.0f, sv[1] / 128.0f, sv[2] / 128.0f };
-	Vec3ByMatrix43(pos, fn, skinMatrix);
+	Vec3ByMatrix43(pos, fn, skinMatrix_);
 }
 
 void VertexDecoder::Step_PosS16Skin() const
@@ -439,14 +433,14 @@ void VertexDecoder::Step_PosS16Skin() const
 	float *pos = (float *)(decoded_ + decFmt.posoff);
 	const s16 *sv = (const s16*)(ptr_ + posoff);
 	const float fn[3] = { sv[0] / 32768.0f, sv[1] / 32768.0f, sv[2] / 32768.0f };
-	Vec3ByMatrix43(pos, fn, skinMatrix);
+	Vec3ByMatrix43(pos, fn, skinMatrix_);
 }
 
 void VertexDecoder::Step_PosFloatSkin() const
 {
 	float *pos = (float *)(decoded_ + decFmt.posoff);
 	const float *fn = (const float *)(ptr_ + posoff);
-	Vec3ByMatrix43(pos, fn, skinMatrix);
+	Vec3ByMatrix43(pos, fn, skinMatrix_);
 }
 
 void VertexDecoder::Step_PosS8Through() const
@@ -653,6 +647,7 @@ void VertexDecoder::SetVertexType(u32 fmt, VertexDecoderJitCache *jitCache) {
 	}
 
 	bool skinInDecode = weighttype != 0 && g_Config.bSoftwareSkinning && morphcount == 1;
+	skinInDecode_ = skinInDecode;
 
 	if (weighttype) { // && nweights?
 		weightoff = size;
@@ -826,7 +821,19 @@ void VertexDecoder::SetVertexType(u32 fmt, VertexDecoderJitCache *jitCache) {
 	}
 }
 
+void VertexDecoder::PrepareJitSkinning() const {
+#ifndef ARM
+	if (jitted_ && skinInDecode_)
+		VertexDecoderJitCache::PrepareBones();
+#endif
+}
+
 void VertexDecoder::DecodeVerts(u8 *decodedptr, const void *verts, int indexLowerBound, int indexUpperBound) const {
+	PrepareJitSkinning();
+	DecodeVertsPrepared(decodedptr, verts, indexLowerBound, indexUpperBound);
+}
+
+void VertexDecoder::DecodeVertsPrepared(u8 *decodedptr, const void *verts, int indexLowerBound, int indexUpperBound) const {
 	// Decode the vertices within the found bounds, once each
 	// decoded_ and ptr_ are used in the steps, so can't be turned into locals for speed.
 	decoded_ = decodedptr;
@@ -849,6 +856,34 @@ void VertexDecoder::DecodeVerts(u8 *decodedptr, const void *verts, int indexLowe
 	}
 }
 
+bool VertexDecoder::CanDecodeInParallel() const {
+#ifdef ARM
+	// The ARM jit keeps the skinning matrix in static memory.
+	if (jitted_ && skinInDecode_)
+		return false;
+#endif
+	// The x86 jit reads the bones from static memory, which is filled once before the threads start.
+	return true;
+}
+
+void VertexDecoder::DecodeVertsChunk(const VertexDecoder *dec, u8 *decoded, const void *verts, int indexLowerBound, int lower, int upper) {
+	// The decoder keeps its position (and skinning matrix) in mutable members, so each chunk gets a copy.
+	VertexDecoder local(*dec);
+	local.DecodeVertsPrepared(decoded + (lower - indexLowerBound) * dec->decFmt.stride, verts, lower, upper - 1);
+}
+
+void VertexDecoder::DecodeVertsParallel(u8 *decodedptr, const void *verts, int indexLowerBound, int indexUpperBound) const {
+	const int count = indexUpperBound - indexLowerBound + 1;
+	if (count < PARALLEL_DECODE_MIN_VERTS || g_Config.iNumWorkerThreads <= 1 || !CanDecodeInParallel()) {
+		DecodeVerts(decodedptr, verts, indexLowerBound, indexUpperBound);
+		return;
+	}
+
+	// Each vertex decodes on its own, so the split doesn't change the output.
+	PrepareJitSkinning();
+	GlobalThreadPool::Loop(std::bind(&DecodeVertsChunk, this, decodedptr, verts, indexLowerBound, placeholder::_1, placeholder::_2), indexLowerBound, indexUpperBound + 1);
+}
+
 int VertexDecoder::ToString(char *output) const {
 	char * start = output;
 	output += sprintf(output, "P: %i ", pos);
@@ -60,6 +60,10 @@ public:
 	const DecVtxFormat &GetDecVtxFmt() { return decFmt; }
 
 	void DecodeVerts(u8 *decoded, const void *verts, int indexLowerBound, int indexUpperBound) const;
+	// Same output as DecodeVerts, but large ranges are split across the worker threads,
+	// each writing its own part of decoded.
+	void DecodeVertsParallel(u8 *decoded, const void *verts, int indexLowerBound, int indexUpperBound) const;
+	bool CanDecodeInParallel() const;
 
 	bool hasColor() const { return col != 0; }
 	bool hasTexcoord() const { return tc != 0; }
@@ -140,6 +144,8 @@ public:
 	// Mutable decoder state
 	mutable u8 *decoded_;
 	mutable const u8 *ptr_;
+	// When software skinning. Only used when non-jitted - when jitted, the matrix is kept in registers.
+	mutable float skinMatrix_[12];
 
 	// "Immutable" state, set at startup
 
@@ -169,11 +175,17 @@ public:
 	int idx;
 	int morphcount;
 	int nweights;
+	bool skinInDecode_;
 
 	int stats_[NUM_VERTEX_DECODER_STATS];
 
 	JittedVertexDecoder jitted_;
 
+	// Decodes without preparing the jit's skinning state, which must already be set up.
+	void DecodeVertsPrepared(u8 *decoded, const void *verts, int indexLowerBound, int indexUpperBound) const;
+	void PrepareJitSkinning() const;
+	static void DecodeVertsChunk(const VertexDecoder *dec, u8 *decoded, const void *verts, int indexLowerBound, int lower, int upper);
+
 	friend class VertexDecoderJitCache;
 };
 
@@ -199,6 +211,11 @@ public:
 
 	// Returns a pointer to the code to run.
 	JittedVertexDecoder Compile(const VertexDecoder &dec);
+#ifndef ARM
+	// Converts the bone matrices to the 4x4 form the skinning steps read. Must run before
+	// the jitted code, and not concurrently with it.
+	static void PrepareBones();
+#endif
 
 	void Jit_WeightsU8();
 	void Jit_WeightsU16();
@@ -249,5 +266,8 @@ private:
 	bool CompileStep(const VertexDecoder &dec, int i);
 	void Jit_ApplyWeights();
 	void Jit_WriteMatrixMul(int outOff, bool pos);
+#ifndef ARM
+	void Jit_WriteFloat3(int outOff, Gen::X64Reg src);
+#endif
 	const VertexDecoder *dec_;
 };
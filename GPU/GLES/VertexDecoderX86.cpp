@@ -37,8 +37,6 @@ static const float MEMORY_ALIGNED16( by32768[4] ) = {
 	1.0f / 32768.0f, 1.0f / 32768.0f, 1.0f / 32768.0f, 1.0f / 32768.0f,
 };
 
-static const u32 MEMORY_ALIGNED16( threeMasks[4] ) = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0};
-static const u32 MEMORY_ALIGNED16( aOne[4] ) = {0, 0, 0, 0x3F800000};
 
 #ifdef _M_X64
 #ifdef _WIN32
@@ -134,6 +132,17 @@ static const JitLookup jitLookup[] = {
 #define PTRBITS 32
 #endif
 
+void VertexDecoderJitCache::PrepareBones() {
+	const __m128 threeMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+	for (int i = 0; i < 8; i++) {
+		const float *m = gstate.boneMatrix + 12 * i;
+		_mm_store_ps(bones + 16 * i, _mm_and_ps(_mm_loadu_ps(m), threeMask));
+		_mm_store_ps(bones + 16 * i + 4, _mm_and_ps(_mm_loadu_ps(m + 3), threeMask));
+		_mm_store_ps(bones + 16 * i + 8, _mm_and_ps(_mm_loadu_ps(m + 3 * 2), threeMask));
+		_mm_store_ps(bones + 16 * i + 12, _mm_setr_ps(m[9], m[10], m[11], 1.0f));
+	}
+}
+
 JittedVertexDecoder VertexDecoderJitCache::Compile(const VertexDecoder &dec) {
 	dec_ = &dec;
 	const u8 *start = this->GetCodePtr();
@@ -171,28 +180,6 @@ JittedVertexDecoder VertexDecoderJitCache::Compile(const VertexDecoder &dec) {
 		}
 	}
 
-	// Add code to convert matrices to 4x4.
-	// Later we might want to do this when the matrices are loaded instead.
-	// This is mostly proof of concept.
-	int boneCount = 0;
-	if (dec.weighttype && g_Config.bSoftwareSkinning) {
-		for (int i = 0; i < 8; i++) {
-			MOVUPS(XMM0, M((void *)(gstate.boneMatrix + 12 * i)));
-			MOVUPS(XMM1, M((void *)(gstate.boneMatrix + 12 * i + 3)));
-			MOVUPS(XMM2, M((void *)(gstate.boneMatrix + 12 * i + 3 * 2)));
-			MOVUPS(XMM3, M((void *)(gstate.boneMatrix + 12 * i + 3 * 3)));
-			ANDPS(XMM0, M((void *)&threeMasks));
-			ANDPS(XMM1, M((void *)&threeMasks));
-			ANDPS(XMM2, M((void *)&threeMasks));
-			ANDPS(XMM3, M((void *)&threeMasks));
-			ORPS(XMM3, M((void *)&aOne));
-			MOVAPS(M((void *)(bones + 16 * i)), XMM0);
-			MOVAPS(M((void *)(bones + 16 * i + 4)), XMM1);
-			MOVAPS(M((void *)(bones + 16 * i + 8)), XMM2);
-			MOVAPS(M((void *)(bones + 16 * i + 12)), XMM3);
-		}
-	}
-
 	// Keep the scale/offset in a few fp registers if we need it.
 	if (prescaleStep) {
 #ifdef _M_X64
@@ -720,8 +707,18 @@ void VertexDecoderJitCache::Jit_WriteMatrixMul(int outOff, bool pos) {
 	ADDPS(XMM1, R(XMM3));
 	if (pos) {
 		ADDPS(XMM1, R(XMM7));
+		Jit_WriteFloat3(outOff, XMM1);
+	} else {
+		MOVUPS(MDisp(dstReg, outOff), XMM1);
 	}
-	MOVUPS(MDisp(dstReg, outOff), XMM1);
+}
+
+// The position is last in the decoded vertex, so it can't be written with a 16 byte store:
+// the extra float would land in the next vertex, which another thread may be decoding.
+void VertexDecoderJitCache::Jit_WriteFloat3(int outOff, X64Reg src) {
+	MOVQ_xmm(MDisp(dstReg, outOff), src);
+	UNPCKHPS(src, R(src));
+	MOVSS(MDisp(dstReg, outOff + 8), src);
 }
 
 void VertexDecoderJitCache::Jit_NormalS8Skin() {
@@ -771,7 +768,7 @@ void VertexDecoderJitCache::Jit_PosS16Through() {
 	PSLLD(XMM1, 16);
 	PSRAD(XMM1, 16); // Ugly sign extension, can be done faster in SSE4
 	CVTDQ2PS(XMM3, R(XMM1));
-	MOVUPS(MDisp(dstReg, dec_->decFmt.posoff), XMM3);
+	Jit_WriteFloat3(dec_->decFmt.posoff, XMM3);
 }
 
 // Copy 3 bytes and then a zero. Might as well copy four.
@@ -4,6 +4,7 @@
 #include "GeDisasm.h"
 #include "GPUCommon.h"
 #include "GPUState.h"
+#include "GPU/Debugger/Record.h"
 #include "ChunkFile.h"
 #include "Core/Config.h"
 #include "Core/CoreTiming.h"
@@ -484,7 +485,7 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 	guard.unlock();
 
 	const bool useDebugger = host->GPUDebuggingActive();
-	const bool useFastRunLoop = !dumpThisFrame_ && !useDebugger;
+	const bool useFastRunLoop = !dumpThisFrame_ && !useDebugger && !GPURecord::IsActive();
 	while (gpuState == GPUSTATE_RUNNING) {
 		{
 			easy_guard innerGuard(listLock);
@@ -528,6 +529,7 @@ bool GPUCommon::InterpretList(DisplayList &list) {
 void GPUCommon::SlowRunLoop(DisplayList &list)
 {
 	const bool dumpThisFrame = dumpThisFrame_;
+	const bool recording = GPURecord::IsActive();
 	while (downcount > 0)
 	{
 		host->GPUNotifyCommand(list.pc);
@@ -548,6 +550,8 @@ void GPUCommon::SlowRunLoop(DisplayList &list)
 			NOTICE_LOG(G3D, "%s", temp);
 		}
 		gstate.cmdmem[cmd] = op;
+		if (recording)
+			GPURecord::NotifyCommand(list.pc, op);
 
 		ExecuteOp(op, diff);
 
@@ -916,6 +920,7 @@ void GPUCommon::ExecuteOp(u32 op, u32 diff) {
 					if (currentList->started && currentList->context.IsValid()) {
 						gstate.Restore(currentList->context);
 						ReapplyGfxStateInternal();
+						GPURecord::NotifyRegisters();
 					}
 				}
 				break;
@@ -1011,6 +1016,7 @@ void GPUCommon::InterruptEnd(int listid) {
 		if (dl.started && dl.context.IsValid()) {
 			gstate.Restore(dl.context);
 			ReapplyGfxState();
+			GPURecord::NotifyRegisters();
 		}
 		dl.waitTicks = 0;
 		__GeTriggerWait(WAITTYPE_GELISTSYNC, listid);
@@ -473,6 +473,8 @@ struct GPUStatistics {
 	void ResetFrame() {
 		numDrawCalls = 0;
 		numCachedDrawCalls = 0;
+		numVertexCacheLookups = 0;
+		numVertexBytesHashed = 0;
 		numVertsSubmitted = 0;
 		numCachedVertsDrawn = 0;
 		numUncachedVertsDrawn = 0;
@@ -493,6 +495,8 @@ struct GPUStatistics {
 	// Per frame statistics
 	int numDrawCalls;
 	int numCachedDrawCalls;
+	int numVertexCacheLookups;
+	int numVertexBytesHashed;
 	int numFlushes;
 	int numVertsSubmitted;
 	int numCachedVertsDrawn;
@@ -15,6 +15,7 @@
 // Official git repository and contact information can be found at
 // https://github.com/hrydgard/ppsspp and http://www.ppsspp.org/.
 
+#include "Common/ThreadPools.h"
 #include "Core/MemMap.h"
 #include "Core/Reporting.h"
 #include "GPU/GPUState.h"
@@ -25,6 +26,11 @@
 #include "GPU/Software/Colors.h"
 
 #include <algorithm>
+#include <vector>
+
+#ifdef _M_SSE
+#include <emmintrin.h>
+#endif
 
 extern FormatBuffer fb;
 extern FormatBuffer depthbuf;
@@ -33,6 +39,14 @@ extern u32 clut[4096];
 
 namespace Rasterizer {
 
+// When set, always use the plain one pixel at a time loop. Used to check the SIMD path against it.
+static bool scalarReference = false;
+
+void SetScalarReference(bool enable)
+{
+	scalarReference = enable;
+}
+
 //static inline int orient2d(const DrawingCoords& v0, const DrawingCoords& v1, const DrawingCoords& v2)
 static inline int orient2d(const ScreenCoords& v0, const ScreenCoords& v1, const ScreenCoords& v2)
 {
@@ -785,21 +799,13 @@ static inline Vec3<int> AlphaBlendingResult(const Vec3<int>& source_rgb, int sou
 	}
 }
 
-// Draws triangle, vertices specified in counter-clockwise direction
-void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2)
+// Screen space bounds of a triangle after scissoring, on the 16 subpixel grid we sample at.
+static inline void GetTriangleBounds(const VertexData& v0, const VertexData& v1, const VertexData& v2, int &minX, int &minY, int &maxX, int &maxY)
 {
-	Vec2<int> d01((int)v0.screenpos.x - (int)v1.screenpos.x, (int)v0.screenpos.y - (int)v1.screenpos.y);
-	Vec2<int> d02((int)v0.screenpos.x - (int)v2.screenpos.x, (int)v0.screenpos.y - (int)v2.screenpos.y);
-	Vec2<int> d12((int)v1.screenpos.x - (int)v2.screenpos.x, (int)v1.screenpos.y - (int)v2.screenpos.y);
-
-	// Drop primitives which are not in CCW order by checking the cross product
-	if (d01.x * d02.y - d01.y * d02.x < 0)
-		return;
-
-	int minX = std::min(std::min(v0.screenpos.x, v1.screenpos.x), v2.screenpos.x) / 16 * 16;
-	int minY = std::min(std::min(v0.screenpos.y, v1.screenpos.y), v2.screenpos.y) / 16 * 16;
-	int maxX = std::max(std::max(v0.screenpos.x, v1.screenpos.x), v2.screenpos.x) / 16 * 16;
-	int maxY = std::max(std::max(v0.screenpos.y, v1.screenpos.y), v2.screenpos.y) / 16 * 16;
+	minX = std::min(std::min(v0.screenpos.x, v1.screenpos.x), v2.screenpos.x) / 16 * 16;
+	minY = std::min(std::min(v0.screenpos.y, v1.screenpos.y), v2.screenpos.y) / 16 * 16;
+	maxX = std::max(std::max(v0.screenpos.x, v1.screenpos.x), v2.screenpos.x) / 16 * 16;
+	maxY = std::max(std::max(v0.screenpos.y, v1.screenpos.y), v2.screenpos.y) / 16 * 16;
 
 	DrawingCoords scissorTL(gstate.getScissorX1(), gstate.getScissorY1(), 0);
 	DrawingCoords scissorBR(gstate.getScissorX2(), gstate.getScissorY2(), 0);
@@ -807,6 +813,629 @@ void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData&
 	maxX = std::min(maxX, (int)TransformUnit::DrawingToScreen(scissorBR).x);
 	minY = std::max(minY, (int)TransformUnit::DrawingToScreen(scissorTL).y);
 	maxY = std::min(maxY, (int)TransformUnit::DrawingToScreen(scissorBR).y);
+}
+
+// Shades and writes one covered pixel. w0-w2 are its (unnormalized) barycentric weights.
+static inline void DrawPixel(const VertexData& v0, const VertexData& v1, const VertexData& v2, const ScreenCoords &pprime, int w0, int w1, int w2, int texlevel, u8 *texptr, int texbufwidthbits)
+{
+	DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
+
+	// TODO: Check if this check is still necessary
+	if (w0 == 0 && w1 == 0 && w2 == 0)
+		return;
+
+	float wsum = 1.0f / (w0 + w1 + w2);
+
+	Vec3<int> prim_color_rgb(0, 0, 0);
+	int prim_color_a = 0;
+	Vec3<int> sec_color(0, 0, 0);
+	if (gstate.getShadeMode() == GE_SHADE_GOURAUD) {
+		// NOTE: When not casting color0 and color1 to float vectors, this code suffers from severe overflow issues.
+		// Not sure if that should be regarded as a bug or if casting to float is a valid fix.
+		// TODO: Is that the correct way to interpolate?
+		prim_color_rgb = ((v0.color0.rgb().Cast<float>() * w0 +
+						v1.color0.rgb().Cast<float>() * w1 +
+						v2.color0.rgb().Cast<float>() * w2) * wsum).Cast<int>();
+		prim_color_a = (int)(((float)v0.color0.a() * w0 + (float)v1.color0.a() * w1 + (float)v2.color0.a() * w2) * wsum);
+		sec_color = ((v0.color1.Cast<float>() * w0 +
+						v1.color1.Cast<float>() * w1 +
+						v2.color1.Cast<float>() * w2) * wsum).Cast<int>();
+	} else {
+		prim_color_rgb = v2.color0.rgb();
+		prim_color_a = v2.color0.a();
+		sec_color = v2.color1;
+	}
+
+	if (gstate.isTextureMapEnabled() && !gstate.isModeClear()) {
+		unsigned int u = 0, v = 0;
+		if (gstate.isModeThrough()) {
+			// TODO: Is it really this simple?
+			float s = ((v0.texturecoords.s() * w0 + v1.texturecoords.s() * w1 + v2.texturecoords.s() * w2) * wsum);
+			float t = ((v0.texturecoords.t() * w0 + v1.texturecoords.t() * w1 + v2.texturecoords.t() * w2) * wsum);
+			GetTexelCoordinatesThrough(0, s, t, u, v);
+		} else {
+			float s = 0, t = 0;
+			GetTextureCoordinates(v0, v1, v2, w0, w1, w2, s, t);
+			GetTexelCoordinates(0, s, t, u, v);
+		}
+
+		Vec4<int> texcolor = Vec4<int>::FromRGBA(SampleNearest(texlevel, u, v, texptr, texbufwidthbits));
+		Vec4<int> out = GetTextureFunctionOutput(prim_color_rgb, prim_color_a, texcolor);
+		prim_color_rgb = out.rgb();
+		prim_color_a = out.a();
+	}
+
+	if (gstate.isColorDoublingEnabled()) {
+		// TODO: Do we need to clamp here?
+		prim_color_rgb *= 2;
+		sec_color *= 2;
+	}
+
+	prim_color_rgb += sec_color;
+
+	// TODO: Fogging
+
+	// TODO: Is that the correct way to interpolate?
+	// Without the (u32), this causes an ICE in some versions of gcc.
+	u16 z = (u16)(u32)(((float)v0.screenpos.z * w0 + (float)v1.screenpos.z * w1 + (float)v2.screenpos.z * w2) * wsum);
+
+	// Depth range test
+	if (!gstate.isModeThrough())
+		if (z < gstate.getDepthRangeMin() || z > gstate.getDepthRangeMax())
+			return;
+
+	if (gstate.isColorTestEnabled() && !gstate.isModeClear())
+		if (!ColorTestPassed(prim_color_rgb))
+			return;
+
+	// TODO: Does a need to be clamped?
+	if (gstate.isAlphaTestEnabled() && !gstate.isModeClear())
+		if (!AlphaTestPassed(prim_color_a))
+			return;
+
+	u8 stencil = GetPixelStencil(p.x, p.y);
+	// TODO: Is it safe to ignore gstate.isDepthTestEnabled() when clear mode is enabled?
+	if (!gstate.isModeClear() && (gstate.isStencilTestEnabled() || gstate.isDepthTestEnabled())) {
+		if (gstate.isStencilTestEnabled() && !StencilTestPassed(stencil)) {
+			stencil = ApplyStencilOp(gstate.getStencilOpSFail(), p.x, p.y);
+			SetPixelStencil(p.x, p.y, stencil);
+			return;
+		}
+
+		// Also apply depth at the same time.  If disabled, same as passing.
+		if (gstate.isDepthTestEnabled() && !DepthTestPassed(p.x, p.y, z)) {
+			if (gstate.isStencilTestEnabled()) {
+				stencil = ApplyStencilOp(gstate.getStencilOpZFail(), p.x, p.y);
+				SetPixelStencil(p.x, p.y, stencil);
+			}
+			return;
+		} else if (gstate.isStencilTestEnabled()) {
+			stencil = ApplyStencilOp(gstate.getStencilOpZPass(), p.x, p.y);
+		}
+
+		if (gstate.isDepthTestEnabled() && gstate.isDepthWriteEnabled()) {
+			SetPixelDepth(p.x, p.y, z);
+		}
+	} else if (gstate.isModeClear() && gstate.isClearModeDepthWriteEnabled()) {
+		SetPixelDepth(p.x, p.y, z);
+	}
+
+	if (gstate.isAlphaBlendEnabled() && !gstate.isModeClear()) {
+		Vec4<int> dst = Vec4<int>::FromRGBA(GetPixelColor(p.x, p.y));
+		prim_color_rgb = AlphaBlendingResult(prim_color_rgb, prim_color_a, dst);
+	}
+	prim_color_rgb = prim_color_rgb.Clamp(0, 255);
+
+	u32 new_color = Vec4<int>(prim_color_rgb.r(), prim_color_rgb.g(), prim_color_rgb.b(), stencil).ToRGBA();
+	u32 old_color = GetPixelColor(p.x, p.y);
+
+	// TODO: Is alpha blending still performed if logic ops are enabled?
+	if (gstate.isLogicOpEnabled() && !gstate.isModeClear()) {
+		// Logic ops don't affect stencil.
+		new_color = (stencil << 24) | (ApplyLogicOp(gstate.getLogicOp(), old_color, new_color) & 0x00FFFFFF);
+	}
+
+	if (gstate.isModeClear()) {
+		new_color = (new_color & ~gstate.getClearModeColorMask()) | (old_color & gstate.getClearModeColorMask());
+	} else {
+		new_color = (new_color & ~gstate.getColorMask()) | (old_color & gstate.getColorMask());
+	}
+
+	SetPixelColor(p.x, p.y, new_color);
+}
+
+#ifdef _M_SSE
+// The state DrawQuad handles: everything but the stencil test, logic ops, texture matrix mapping
+// and invalid texture or blend functions. Those go through DrawPixel one pixel at a time.
+static inline bool CanShadeQuads()
+{
+	if (gstate.isModeClear())
+		return true;
+	if (gstate.isStencilTestEnabled() || gstate.isLogicOpEnabled())
+		return false;
+	if (gstate.isTextureMapEnabled()) {
+		if (gstate.getUVGenMode() == GE_TEXMAP_TEXTURE_MATRIX || gstate.getTextureFunction() > GE_TEXFUNC_ADD)
+			return false;
+	}
+	if (gstate.isAlphaBlendEnabled()) {
+		if (gstate.getBlendFuncA() > GE_SRCBLEND_FIXA || gstate.getBlendFuncB() > GE_DSTBLEND_FIXB || gstate.getBlendEq() > GE_BLENDMODE_ABSDIFF)
+			return false;
+	}
+	return true;
+}
+
+// Four pixels of color, one per lane.
+struct QuadColor {
+	__m128i rgb[3];
+	__m128i a;
+};
+
+static inline QuadColor UnpackQuadColor(__m128i rgba)
+{
+	const __m128i mask = _mm_set1_epi32(0xFF);
+	QuadColor c;
+	c.rgb[0] = _mm_and_si128(rgba, mask);
+	c.rgb[1] = _mm_and_si128(_mm_srli_epi32(rgba, 8), mask);
+	c.rgb[2] = _mm_and_si128(_mm_srli_epi32(rgba, 16), mask);
+	c.a = _mm_srli_epi32(rgba, 24);
+	return c;
+}
+
+// Same operations in the same order as DrawPixel, so the results match bit for bit.
+static inline __m128 InterpolateQuadFloat(float c0, float c1, float c2, __m128 w0, __m128 w1, __m128 w2, __m128 wsum)
+{
+	__m128 sum = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c0), w0), _mm_mul_ps(_mm_set1_ps(c1), w1));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(c2), w2));
+	return _mm_mul_ps(sum, wsum);
+}
+
+static inline __m128i InterpolateQuad(float c0, float c1, float c2, __m128 w0, __m128 w1, __m128 w2, __m128 wsum)
+{
+	return _mm_cvttps_epi32(InterpolateQuadFloat(c0, c1, c2, w0, w1, w2, wsum));
+}
+
+// Clamps to [0, 255] using the saturating packs.
+static inline __m128i ClampQuadTo255(__m128i v)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v, v), zero);
+	return _mm_unpacklo_epi16(_mm_unpacklo_epi8(packed, zero), zero);
+}
+
+// SSE2 has no 32-bit multiply, but pmaddwd gives the full product as long as a is in
+// [0, 32767] and b fits in 16 bits signed. Colors and blend factors always do.
+static inline __m128i MulQuad(__m128i a, __m128i b)
+{
+	return _mm_madd_epi16(a, b);
+}
+
+// Integer division by 255, rounding toward zero. The quotients are small enough that the
+// truncated float division is always exact.
+static inline __m128i DivideQuadBy255(__m128i v)
+{
+	return _mm_cvttps_epi32(_mm_div_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(255.0f)));
+}
+
+static inline __m128i SelectQuad(__m128i cond, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(cond, a), _mm_andnot_si128(cond, b));
+}
+
+static inline __m128i MinQuad(__m128i a, __m128i b)
+{
+	return SelectQuad(_mm_cmplt_epi32(a, b), a, b);
+}
+
+static inline __m128i MaxQuad(__m128i a, __m128i b)
+{
+	return SelectQuad(_mm_cmpgt_epi32(a, b), a, b);
+}
+
+// All ones in the lanes where "a func b" holds, like DepthTestPassed() and AlphaTestPassed().
+static inline __m128i CompareQuad(GEComparison func, __m128i a, __m128i b)
+{
+	const __m128i ones = _mm_set1_epi32(-1);
+	switch (func) {
+	case GE_COMP_NEVER:
+		return _mm_setzero_si128();
+	case GE_COMP_ALWAYS:
+		return ones;
+	case GE_COMP_EQUAL:
+		return _mm_cmpeq_epi32(a, b);
+	case GE_COMP_NOTEQUAL:
+		return _mm_xor_si128(_mm_cmpeq_epi32(a, b), ones);
+	case GE_COMP_LESS:
+		return _mm_cmplt_epi32(a, b);
+	case GE_COMP_LEQUAL:
+		return _mm_xor_si128(_mm_cmpgt_epi32(a, b), ones);
+	case GE_COMP_GREATER:
+		return _mm_cmpgt_epi32(a, b);
+	case GE_COMP_GEQUAL:
+		return _mm_xor_si128(_mm_cmplt_epi32(a, b), ones);
+	}
+	return ones;
+}
+
+// s - floor(s), for wrapped texture coordinates.
+static inline __m128 FractionQuad(__m128 s)
+{
+	__m128 floored = _mm_cvtepi32_ps(_mm_cvttps_epi32(s));
+	floored = _mm_sub_ps(floored, _mm_and_ps(_mm_cmpgt_ps(floored, s), _mm_set1_ps(1.0f)));
+	// From 2^23 up every float is whole, and the conversion above only works up to 2^31.
+	const __m128 whole = _mm_cmpge_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), s), _mm_set1_ps(8388608.0f));
+	return _mm_andnot_ps(whole, _mm_sub_ps(s, floored));
+}
+
+// GetTextureCoordinates() and GetTexelCoordinates(Through)() for four pixels.
+static inline void GetTexelCoordinatesQuad(const VertexData& v0, const VertexData& v1, const VertexData& v2, __m128 w0, __m128 w1, __m128 w2, __m128 wsum, __m128i &u, __m128i &v)
+{
+	const int width = 1 << (gstate.texsize[0] & 0xf);
+	const int height = 1 << ((gstate.texsize[0]>>8) & 0xf);
+
+	if (gstate.isModeThrough()) {
+		const __m128 s = InterpolateQuadFloat(v0.texturecoords.s(), v1.texturecoords.s(), v2.texturecoords.s(), w0, w1, w2, wsum);
+		const __m128 t = InterpolateQuadFloat(v0.texturecoords.t(), v1.texturecoords.t(), v2.texturecoords.t(), w0, w1, w2, wsum);
+		u = _mm_and_si128(_mm_cvttps_epi32(s), _mm_set1_epi32(width - 1));
+		v = _mm_and_si128(_mm_cvttps_epi32(t), _mm_set1_epi32(height - 1));
+		return;
+	}
+
+	// Perspective correct, in the same order as GetTextureCoordinates().
+	const float q0 = 1.f / v0.clippos.w;
+	const float q1 = 1.f / v1.clippos.w;
+	const float q2 = 1.f / v2.clippos.w;
+	const __m128 q = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(q0), w0), _mm_mul_ps(_mm_set1_ps(q1), w1)), _mm_mul_ps(_mm_set1_ps(q2), w2));
+	__m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v0.texturecoords.s() * q0), w0), _mm_mul_ps(_mm_set1_ps(v1.texturecoords.s() * q1), w1));
+	s = _mm_div_ps(_mm_add_ps(s, _mm_mul_ps(_mm_set1_ps(v2.texturecoords.s() * q2), w2)), q);
+	__m128 t = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v0.texturecoords.t() * q0), w0), _mm_mul_ps(_mm_set1_ps(v1.texturecoords.t() * q1), w1));
+	t = _mm_div_ps(_mm_add_ps(t, _mm_mul_ps(_mm_set1_ps(v2.texturecoords.t() * q2), w2)), q);
+
+	s = _mm_add_ps(_mm_mul_ps(s, _mm_set1_ps(getFloat24(gstate.texscaleu))), _mm_set1_ps(getFloat24(gstate.texoffsetu)));
+	t = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(getFloat24(gstate.texscalev))), _mm_set1_ps(getFloat24(gstate.texoffsetv)));
+	if (gstate.isTexCoordClampedS())
+		s = _mm_max_ps(_mm_min_ps(s, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+	else
+		s = FractionQuad(s);
+	if (gstate.isTexCoordClampedT())
+		t = _mm_max_ps(_mm_min_ps(t, _mm_set1_ps(1.0f)), _mm_setzero_ps());
+	else
+		t = FractionQuad(t);
+
+	u = _mm_cvttps_epi32(_mm_mul_ps(s, _mm_set1_ps((float)width)));
+	v = _mm_cvttps_epi32(_mm_mul_ps(t, _mm_set1_ps((float)height)));
+}
+
+static inline __m128i Expand5To8Quad(__m128i v)
+{
+	return _mm_or_si128(_mm_slli_epi32(v, 3), _mm_srli_epi32(v, 2));
+}
+
+// DecodeRGBA4444(), DecodeRGBA5551() and DecodeRGB565() for the texel in the low 16 bits of each lane.
+static inline __m128i Decode16BitTexelsQuad(GETextureFormat texfmt, __m128i texels)
+{
+	const __m128i mask5 = _mm_set1_epi32(0x1F);
+	switch (texfmt) {
+	case GE_TFMT_4444:
+		{
+			// One nibble per byte, then copied into the top half of its byte.
+			const __m128i mask4 = _mm_set1_epi32(0xF);
+			__m128i c = _mm_and_si128(texels, mask4);
+			c = _mm_or_si128(c, _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(texels, 4), mask4), 8));
+			c = _mm_or_si128(c, _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(texels, 8), mask4), 16));
+			c = _mm_or_si128(c, _mm_slli_epi32(_mm_srli_epi32(texels, 12), 24));
+			return _mm_or_si128(c, _mm_slli_epi32(c, 4));
+		}
+
+	case GE_TFMT_5551:
+		{
+			const __m128i r = Expand5To8Quad(_mm_and_si128(texels, mask5));
+			const __m128i g = Expand5To8Quad(_mm_and_si128(_mm_srli_epi32(texels, 5), mask5));
+			const __m128i b = Expand5To8Quad(_mm_and_si128(_mm_srli_epi32(texels, 10), mask5));
+			// Bit 15 spread over the whole lane, then shifted into the alpha byte.
+			const __m128i a = _mm_slli_epi32(_mm_srai_epi32(_mm_slli_epi32(texels, 16), 31), 24);
+			return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), a));
+		}
+
+	default:
+		{
+			const __m128i r = Expand5To8Quad(_mm_and_si128(texels, mask5));
+			const __m128i g6 = _mm_and_si128(_mm_srli_epi32(texels, 5), _mm_set1_epi32(0x3F));
+			const __m128i g = _mm_or_si128(_mm_slli_epi32(g6, 2), _mm_srli_epi32(g6, 4));
+			const __m128i b = Expand5To8Quad(_mm_srli_epi32(texels, 11));
+			const __m128i a = _mm_set1_epi32(0xFF000000);
+			return _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), a));
+		}
+	}
+}
+
+// SampleNearest() for the lanes in mask. Unswizzled direct color textures are fetched with
+// plain loads and decoded four at a time, other formats one texel at a time.
+static inline __m128i SampleNearestQuad(int level, __m128i u, __m128i v, u8 *srcptr, int texbufwidthbits, int mask)
+{
+	u32 us[4], vs[4];
+	u32 texels[4] = { 0, 0, 0, 0 };
+	_mm_storeu_si128((__m128i *)us, u);
+	_mm_storeu_si128((__m128i *)vs, v);
+
+	const GETextureFormat texfmt = gstate.getTextureFormat();
+	if (!srcptr || gstate.isTextureSwizzled() || texfmt > GE_TFMT_8888) {
+		for (int lane = 0; lane < 4; ++lane) {
+			if (mask & (1 << lane))
+				texels[lane] = SampleNearest(level, us[lane], vs[lane], srcptr, texbufwidthbits);
+		}
+		return _mm_loadu_si128((const __m128i *)texels);
+	}
+
+	const int texelBits = texfmt == GE_TFMT_8888 ? 32 : 16;
+	for (int lane = 0; lane < 4; ++lane) {
+		if (mask & (1 << lane)) {
+			const u8 *texel = srcptr + GetPixelDataOffset(texelBits, texbufwidthbits, us[lane], vs[lane]);
+			texels[lane] = texelBits == 32 ? *(const u32 *)texel : *(const u16 *)texel;
+		}
+	}
+	const __m128i raw = _mm_loadu_si128((const __m128i *)texels);
+	return texfmt == GE_TFMT_8888 ? raw : Decode16BitTexelsQuad(texfmt, raw);
+}
+
+// GetTextureFunctionOutput() for four pixels.
+static inline QuadColor TextureFunctionQuad(const QuadColor &prim, const QuadColor &tex)
+{
+	const __m128i c255 = _mm_set1_epi32(255);
+	const bool rgba = gstate.isTextureAlphaUsed();
+
+	QuadColor out;
+	switch (gstate.getTextureFunction()) {
+	case GE_TEXFUNC_MODULATE:
+		for (int i = 0; i < 3; ++i)
+			out.rgb[i] = DivideQuadBy255(MulQuad(prim.rgb[i], tex.rgb[i]));
+		out.a = rgba ? DivideQuadBy255(MulQuad(prim.a, tex.a)) : prim.a;
+		break;
+
+	case GE_TEXFUNC_DECAL:
+		{
+			const __m128i t = rgba ? tex.a : c255;
+			const __m128i invt = rgba ? _mm_sub_epi32(c255, t) : _mm_setzero_si128();
+			for (int i = 0; i < 3; ++i)
+				out.rgb[i] = DivideQuadBy255(_mm_add_epi32(MulQuad(prim.rgb[i], invt), MulQuad(tex.rgb[i], t)));
+			out.a = prim.a;
+		}
+		break;
+
+	case GE_TEXFUNC_BLEND:
+		{
+			const int texenv[3] = { gstate.getTextureEnvColR(), gstate.getTextureEnvColG(), gstate.getTextureEnvColB() };
+			for (int i = 0; i < 3; ++i)
+				out.rgb[i] = DivideQuadBy255(_mm_add_epi32(MulQuad(_mm_sub_epi32(c255, tex.rgb[i]), prim.rgb[i]), MulQuad(tex.rgb[i], _mm_set1_epi32(texenv[i]))));
+			out.a = DivideQuadBy255(MulQuad(prim.a, rgba ? tex.a : c255));
+		}
+		break;
+
+	case GE_TEXFUNC_REPLACE:
+		for (int i = 0; i < 3; ++i)
+			out.rgb[i] = tex.rgb[i];
+		out.a = rgba ? tex.a : prim.a;
+		break;
+
+	default:
+		// GE_TEXFUNC_ADD, CanShadeQuads() rules out the rest.
+		for (int i = 0; i < 3; ++i)
+			out.rgb[i] = MinQuad(_mm_add_epi32(prim.rgb[i], tex.rgb[i]), c255);
+		out.a = DivideQuadBy255(MulQuad(prim.a, rgba ? tex.a : c255));
+		break;
+	}
+	return out;
+}
+
+// GetSourceFactor() and GetDestFactor() for four pixels. Both enums list the same factors, except
+// that the first two use the other side's color and the last is the fixed color.
+static inline void BlendFactorQuad(int factor, const QuadColor &other, const __m128i &src_a, const __m128i &dst_a, u32 fix, __m128i out[3])
+{
+	const __m128i c255 = _mm_set1_epi32(255);
+	__m128i f;
+	switch (factor) {
+	case GE_SRCBLEND_DSTCOLOR:
+		for (int i = 0; i < 3; ++i)
+			out[i] = other.rgb[i];
+		return;
+	case GE_SRCBLEND_INVDSTCOLOR:
+		for (int i = 0; i < 3; ++i)
+			out[i] = _mm_sub_epi32(c255, other.rgb[i]);
+		return;
+	case GE_SRCBLEND_FIXA:
+		for (int i = 0; i < 3; ++i)
+			out[i] = _mm_set1_epi32((fix >> (i * 8)) & 0xFF);
+		return;
+
+	case GE_SRCBLEND_SRCALPHA: f = src_a; break;
+	case GE_SRCBLEND_INVSRCALPHA: f = _mm_sub_epi32(c255, src_a); break;
+	case GE_SRCBLEND_DSTALPHA: f = dst_a; break;
+	case GE_SRCBLEND_INVDSTALPHA: f = _mm_sub_epi32(c255, dst_a); break;
+	case GE_SRCBLEND_DOUBLESRCALPHA: f = _mm_add_epi32(src_a, src_a); break;
+	case GE_SRCBLEND_DOUBLEINVSRCALPHA: f = _mm_sub_epi32(c255, _mm_add_epi32(src_a, src_a)); break;
+	case GE_SRCBLEND_DOUBLEDSTALPHA: f = _mm_add_epi32(dst_a, dst_a); break;
+	default: f = _mm_sub_epi32(c255, _mm_add_epi32(dst_a, dst_a)); break;
+	}
+	out[0] = out[1] = out[2] = f;
+}
+
+// AlphaBlendingResult() for four pixels, into rgb.
+static inline void AlphaBlendQuad(const QuadColor &src, const QuadColor &dst, __m128i rgb[3])
+{
+	__m128i srcfactor[3], dstfactor[3];
+	BlendFactorQuad(gstate.getBlendFuncA(), dst, src.a, dst.a, gstate.getFixA(), srcfactor);
+	BlendFactorQuad(gstate.getBlendFuncB(), src, src.a, dst.a, gstate.getFixB(), dstfactor);
+
+	const GEBlendMode eq = gstate.getBlendEq();
+	for (int i = 0; i < 3; ++i) {
+		const __m128i s = src.rgb[i];
+		const __m128i d = dst.rgb[i];
+		switch (eq) {
+		case GE_BLENDMODE_MUL_AND_ADD:
+			rgb[i] = DivideQuadBy255(_mm_add_epi32(MulQuad(s, srcfactor[i]), MulQuad(d, dstfactor[i])));
+			break;
+		case GE_BLENDMODE_MUL_AND_SUBTRACT:
+			rgb[i] = DivideQuadBy255(_mm_sub_epi32(MulQuad(s, srcfactor[i]), MulQuad(d, dstfactor[i])));
+			break;
+		case GE_BLENDMODE_MUL_AND_SUBTRACT_REVERSE:
+			rgb[i] = DivideQuadBy255(_mm_sub_epi32(MulQuad(d, dstfactor[i]), MulQuad(s, srcfactor[i])));
+			break;
+		case GE_BLENDMODE_MIN:
+			rgb[i] = MinQuad(s, d);
+			break;
+		case GE_BLENDMODE_MAX:
+			rgb[i] = MaxQuad(s, d);
+			break;
+		default:
+			{
+				// GE_BLENDMODE_ABSDIFF.
+				const __m128i diff = _mm_sub_epi32(s, d);
+				const __m128i sign = _mm_srai_epi32(diff, 31);
+				rgb[i] = _mm_sub_epi32(_mm_xor_si128(diff, sign), sign);
+			}
+			break;
+		}
+	}
+}
+
+// Shades the covered pixels of a quad of four horizontally adjacent pixels starting at pprime,
+// the same way DrawPixel does one at a time. Only valid when CanShadeQuads() is true.
+static inline void DrawQuad(const VertexData& v0, const VertexData& v1, const VertexData& v2, const ScreenCoords &pprime, __m128i w0, __m128i w1, __m128i w2, int mask, int texlevel, u8 *texptr, int texbufwidthbits)
+{
+	const __m128i wsumInt = _mm_add_epi32(_mm_add_epi32(w0, w1), w2);
+	// Covered pixels have no negative weights, so a zero sum means all three are zero.
+	mask &= ~_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(wsumInt, _mm_setzero_si128())));
+	if (mask == 0)
+		return;
+
+	const __m128 fw0 = _mm_cvtepi32_ps(w0);
+	const __m128 fw1 = _mm_cvtepi32_ps(w1);
+	const __m128 fw2 = _mm_cvtepi32_ps(w2);
+	const __m128 wsum = _mm_div_ps(_mm_set1_ps(1.0f), _mm_cvtepi32_ps(wsumInt));
+
+	const int *prim0 = v0.color0.AsArray(), *prim1 = v1.color0.AsArray(), *prim2 = v2.color0.AsArray();
+	const int *sec0 = v0.color1.AsArray(), *sec1 = v1.color1.AsArray(), *sec2 = v2.color1.AsArray();
+	QuadColor prim;
+	__m128i sec[3];
+	if (gstate.getShadeMode() == GE_SHADE_GOURAUD) {
+		for (int i = 0; i < 3; ++i) {
+			prim.rgb[i] = InterpolateQuad((float)prim0[i], (float)prim1[i], (float)prim2[i], fw0, fw1, fw2, wsum);
+			sec[i] = InterpolateQuad((float)sec0[i], (float)sec1[i], (float)sec2[i], fw0, fw1, fw2, wsum);
+		}
+		prim.a = InterpolateQuad((float)prim0[3], (float)prim1[3], (float)prim2[3], fw0, fw1, fw2, wsum);
+	} else {
+		for (int i = 0; i < 3; ++i) {
+			prim.rgb[i] = _mm_set1_epi32(prim2[i]);
+			sec[i] = _mm_set1_epi32(sec2[i]);
+		}
+		prim.a = _mm_set1_epi32(prim2[3]);
+	}
+
+	const bool clearMode = gstate.isModeClear();
+	if (gstate.isTextureMapEnabled() && !clearMode) {
+		__m128i u, v;
+		GetTexelCoordinatesQuad(v0, v1, v2, fw0, fw1, fw2, wsum, u, v);
+		const QuadColor texcolor = UnpackQuadColor(SampleNearestQuad(texlevel, u, v, texptr, texbufwidthbits, mask));
+		prim = TextureFunctionQuad(prim, texcolor);
+	}
+
+	for (int i = 0; i < 3; ++i) {
+		if (gstate.isColorDoublingEnabled()) {
+			prim.rgb[i] = _mm_add_epi32(prim.rgb[i], prim.rgb[i]);
+			sec[i] = _mm_add_epi32(sec[i], sec[i]);
+		}
+		prim.rgb[i] = _mm_add_epi32(prim.rgb[i], sec[i]);
+	}
+
+	// As in DrawPixel, cast to u16 without clamping.
+	const __m128i z = _mm_and_si128(InterpolateQuad((float)v0.screenpos.z, (float)v1.screenpos.z, (float)v2.screenpos.z, fw0, fw1, fw2, wsum), _mm_set1_epi32(0xFFFF));
+	__m128i pass = _mm_set1_epi32(-1);
+	if (!gstate.isModeThrough()) {
+		const __m128i outside = _mm_or_si128(_mm_cmplt_epi32(z, _mm_set1_epi32(gstate.getDepthRangeMin())), _mm_cmpgt_epi32(z, _mm_set1_epi32(gstate.getDepthRangeMax())));
+		pass = _mm_andnot_si128(outside, pass);
+	}
+
+	if (gstate.isColorTestEnabled() && !clearMode) {
+		const __m128i colorMask = _mm_set1_epi32(gstate.getColorTestMask());
+		const __m128i byteMask = _mm_set1_epi32(0xFF);
+		__m128i c = _mm_and_si128(prim.rgb[0], byteMask);
+		c = _mm_or_si128(c, _mm_slli_epi32(_mm_and_si128(prim.rgb[1], byteMask), 8));
+		c = _mm_or_si128(c, _mm_slli_epi32(_mm_and_si128(prim.rgb[2], byteMask), 16));
+		const __m128i ref = _mm_set1_epi32(gstate.getColorTestRef() & gstate.getColorTestMask());
+		pass = _mm_and_si128(pass, CompareQuad(gstate.getColorTestFunction(), _mm_and_si128(c, colorMask), ref));
+	}
+
+	if (gstate.isAlphaTestEnabled() && !clearMode) {
+		const int alphaMask = gstate.getAlphaTestMask() & 0xFF;
+		const __m128i alpha = _mm_and_si128(prim.a, _mm_set1_epi32(alphaMask));
+		pass = _mm_and_si128(pass, CompareQuad(gstate.getAlphaTestFunction(), alpha, _mm_set1_epi32(gstate.getAlphaTestRef() & alphaMask)));
+	}
+
+	const DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
+	int x[4];
+	for (int lane = 0; lane < 4; ++lane)
+		x[lane] = (p.x + lane) & 0x3ff;
+
+	const bool depthTest = gstate.isDepthTestEnabled() && !clearMode;
+	if (depthTest) {
+		u32 reference_z[4] = { 0, 0, 0, 0 };
+		for (int lane = 0; lane < 4; ++lane) {
+			if (mask & (1 << lane))
+				reference_z[lane] = GetPixelDepth(x[lane], p.y);
+		}
+		pass = _mm_and_si128(pass, CompareQuad(gstate.getDepthTestFunction(), z, _mm_loadu_si128((const __m128i *)reference_z)));
+	}
+
+	mask &= _mm_movemask_ps(_mm_castsi128_ps(pass));
+	if (mask == 0)
+		return;
+
+	__m128i rgb[3] = { prim.rgb[0], prim.rgb[1], prim.rgb[2] };
+	if (gstate.isAlphaBlendEnabled() && !clearMode) {
+		u32 dst[4] = { 0, 0, 0, 0 };
+		for (int lane = 0; lane < 4; ++lane) {
+			if (mask & (1 << lane))
+				dst[lane] = GetPixelColor(x[lane], p.y);
+		}
+		AlphaBlendQuad(prim, UnpackQuadColor(_mm_loadu_si128((const __m128i *)dst)), rgb);
+	}
+
+	u32 colors[4], depths[4];
+	const __m128i packed = _mm_or_si128(ClampQuadTo255(rgb[0]), _mm_slli_epi32(ClampQuadTo255(rgb[1]), 8));
+	_mm_storeu_si128((__m128i *)colors, _mm_or_si128(packed, _mm_slli_epi32(ClampQuadTo255(rgb[2]), 16)));
+	_mm_storeu_si128((__m128i *)depths, z);
+
+	const bool depthWrite = clearMode ? gstate.isClearModeDepthWriteEnabled() : depthTest && gstate.isDepthWriteEnabled();
+	const u32 colorMask = clearMode ? gstate.getClearModeColorMask() : gstate.getColorMask();
+	for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+		if ((mask & 1) == 0)
+			continue;
+		// No stencil test here, so the stencil is kept, as in DrawPixel.
+		const u8 stencil = GetPixelStencil(x[lane], p.y);
+		if (depthWrite)
+			SetPixelDepth(x[lane], p.y, (u16)depths[lane]);
+
+		const u32 old_color = GetPixelColor(x[lane], p.y);
+		u32 new_color = colors[lane] | ((u32)stencil << 24);
+		new_color = (new_color & ~colorMask) | (old_color & colorMask);
+		SetPixelColor(x[lane], p.y, new_color);
+	}
+}
+#endif
+
+// Rasterizes the part of a triangle inside [clipMinX, clipMaxX] x [clipMinY, clipMaxY] (screen coords.)
+// Vertices specified in counter-clockwise direction.
+static void DrawTriangleSlice(const VertexData& v0, const VertexData& v1, const VertexData& v2, int clipMinX, int clipMinY, int clipMaxX, int clipMaxY)
+{
+	Vec2<int> d01((int)v0.screenpos.x - (int)v1.screenpos.x, (int)v0.screenpos.y - (int)v1.screenpos.y);
+	Vec2<int> d02((int)v0.screenpos.x - (int)v2.screenpos.x, (int)v0.screenpos.y - (int)v2.screenpos.y);
+	Vec2<int> d12((int)v1.screenpos.x - (int)v2.screenpos.x, (int)v1.screenpos.y - (int)v2.screenpos.y);
+
+	int minX, minY, maxX, maxY;
+	GetTriangleBounds(v0, v1, v2, minX, minY, maxX, maxY);
+	minX = std::max(minX, clipMinX);
+	maxX = std::min(maxX, clipMaxX);
+	minY = std::max(minY, clipMinY);
+	maxY = std::min(maxY, clipMaxY);
 
 	int bias0 = IsRightSideOrFlatBottomLine(v0.screenpos.xy(), v1.screenpos.xy(), v2.screenpos.xy()) ? -1 : 0;
 	int bias1 = IsRightSideOrFlatBottomLine(v1.screenpos.xy(), v2.screenpos.xy(), v0.screenpos.xy()) ? -1 : 0;
@@ -823,6 +1452,16 @@ void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData&
 		texptr = Memory::GetPointer(texaddr);
 	}
 
+#ifdef _M_SSE
+	const int step0 = orient2dIncX(d12.y)*16;
+	const int step1 = orient2dIncX(-d02.y)*16;
+	const int step2 = orient2dIncX(d01.y)*16;
+	const __m128i quadStep0 = _mm_set_epi32(step0 * 3, step0 * 2, step0, 0);
+	const __m128i quadStep1 = _mm_set_epi32(step1 * 3, step1 * 2, step1, 0);
+	const __m128i quadStep2 = _mm_set_epi32(step2 * 3, step2 * 2, step2, 0);
+	const bool shadeQuads = CanShadeQuads();
+#endif
+
 	ScreenCoords pprime(minX, minY, 0);
 	int w0_base = orient2d(v1.screenpos, v2.screenpos, pprime);
 	int w1_base = orient2d(v2.screenpos, v0.screenpos, pprime);
@@ -835,140 +1474,139 @@ void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData&
 		int w0 = w0_base;
 		int w1 = w1_base;
 		int w2 = w2_base;
-		for (pprime.x = minX; pprime.x <= maxX; pprime.x +=16,
+		pprime.x = minX;
+#ifdef _M_SSE
+		if (!scalarReference) {
+			// Four pixels at a time. The edge tests for the whole quad are one compare each,
+			// and only covered pixels get shaded, so empty quads along the edges are cheap.
+			const __m128i zero = _mm_setzero_si128();
+			for (; pprime.x <= maxX; pprime.x += 64, w0 += step0 * 4, w1 += step1 * 4, w2 += step2 * 4) {
+				const __m128i quadW0 = _mm_add_epi32(_mm_set1_epi32(w0), quadStep0);
+				const __m128i quadW1 = _mm_add_epi32(_mm_set1_epi32(w1), quadStep1);
+				const __m128i quadW2 = _mm_add_epi32(_mm_set1_epi32(w2), quadStep2);
+				const __m128i e0 = _mm_add_epi32(quadW0, _mm_set1_epi32(bias0));
+				const __m128i e1 = _mm_add_epi32(quadW1, _mm_set1_epi32(bias1));
+				const __m128i e2 = _mm_add_epi32(quadW2, _mm_set1_epi32(bias2));
+				const __m128i outside = _mm_or_si128(_mm_or_si128(_mm_cmplt_epi32(e0, zero), _mm_cmplt_epi32(e1, zero)), _mm_cmplt_epi32(e2, zero));
+				int mask = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+
+				const int remaining = (maxX - pprime.x) / 16 + 1;
+				if (remaining < 4)
+					mask &= (1 << remaining) - 1;
+				if (mask == 0)
+					continue;
+
+				if (shadeQuads) {
+					DrawQuad(v0, v1, v2, pprime, quadW0, quadW1, quadW2, mask, texlevel, texptr, texbufwidthbits);
+					continue;
+				}
+				for (int lane = 0; mask != 0; ++lane, mask >>= 1) {
+					if (mask & 1) {
+						ScreenCoords lanepos(pprime.x + lane * 16, pprime.y, 0);
+						DrawPixel(v0, v1, v2, lanepos, w0 + lane * step0, w1 + lane * step1, w2 + lane * step2, texlevel, texptr, texbufwidthbits);
+					}
+				}
+			}
+			continue;
+		}
+#endif
+		for (; pprime.x <= maxX; pprime.x +=16,
 											w0 += orient2dIncX(d12.y)*16,
 											w1 += orient2dIncX(-d02.y)*16,
 											w2 += orient2dIncX(d01.y)*16) {
-			DrawingCoords p = TransformUnit::ScreenToDrawing(pprime);
-
 			// If p is on or inside all edges, render pixel
 			// TODO: Should we render if the pixel is both on the left and the right side? (i.e. degenerated triangle)
 			if (w0 + bias0 >=0 && w1 + bias1 >= 0 && w2 + bias2 >= 0) {
-				// TODO: Check if this check is still necessary
-				if (w0 == 0 && w1 == 0 && w2 == 0)
-					continue;
-
-				float wsum = 1.0f / (w0 + w1 + w2);
-
-				Vec3<int> prim_color_rgb(0, 0, 0);
-				int prim_color_a = 0;
-				Vec3<int> sec_color(0, 0, 0);
-				if (gstate.getShadeMode() == GE_SHADE_GOURAUD) {
-					// NOTE: When not casting color0 and color1 to float vectors, this code suffers from severe overflow issues.
-					// Not sure if that should be regarded as a bug or if casting to float is a valid fix.
-					// TODO: Is that the correct way to interpolate?
-					prim_color_rgb = ((v0.color0.rgb().Cast<float>() * w0 +
-									v1.color0.rgb().Cast<float>() * w1 +
-									v2.color0.rgb().Cast<float>() * w2) * wsum).Cast<int>();
-					prim_color_a = (int)(((float)v0.color0.a() * w0 + (float)v1.color0.a() * w1 + (float)v2.color0.a() * w2) * wsum);
-					sec_color = ((v0.color1.Cast<float>() * w0 +
-									v1.color1.Cast<float>() * w1 +
-									v2.color1.Cast<float>() * w2) * wsum).Cast<int>();
-				} else {
-					prim_color_rgb = v2.color0.rgb();
-					prim_color_a = v2.color0.a();
-					sec_color = v2.color1;
-				}
-
-				if (gstate.isTextureMapEnabled() && !gstate.isModeClear()) {
-					unsigned int u = 0, v = 0;
-					if (gstate.isModeThrough()) {
-						// TODO: Is it really this simple?
-						float s = ((v0.texturecoords.s() * w0 + v1.texturecoords.s() * w1 + v2.texturecoords.s() * w2) * wsum);
-						float t = ((v0.texturecoords.t() * w0 + v1.texturecoords.t() * w1 + v2.texturecoords.t() * w2) * wsum);
-						GetTexelCoordinatesThrough(0, s, t, u, v);
-					} else {
-						float s = 0, t = 0;
-						GetTextureCoordinates(v0, v1, v2, w0, w1, w2, s, t);
-						GetTexelCoordinates(0, s, t, u, v);
-					}
-
-					Vec4<int> texcolor = Vec4<int>::FromRGBA(SampleNearest(texlevel, u, v, texptr, texbufwidthbits));
-					Vec4<int> out = GetTextureFunctionOutput(prim_color_rgb, prim_color_a, texcolor);
-					prim_color_rgb = out.rgb();
-					prim_color_a = out.a();
-				}
-
-				if (gstate.isColorDoublingEnabled()) {
-					// TODO: Do we need to clamp here?
-					prim_color_rgb *= 2;
-					sec_color *= 2;
-				}
-
-				prim_color_rgb += sec_color;
-
-				// TODO: Fogging
-
-				// TODO: Is that the correct way to interpolate?
-				// Without the (u32), this causes an ICE in some versions of gcc.
-				u16 z = (u16)(u32)(((float)v0.screenpos.z * w0 + (float)v1.screenpos.z * w1 + (float)v2.screenpos.z * w2) * wsum);
-
-				// Depth range test
-				if (!gstate.isModeThrough())
-					if (z < gstate.getDepthRangeMin() || z > gstate.getDepthRangeMax())
-						continue;
-
-				if (gstate.isColorTestEnabled() && !gstate.isModeClear())
-					if (!ColorTestPassed(prim_color_rgb))
-						continue;
-
-				// TODO: Does a need to be clamped?
-				if (gstate.isAlphaTestEnabled() && !gstate.isModeClear())
-					if (!AlphaTestPassed(prim_color_a))
-						continue;
+				DrawPixel(v0, v1, v2, pprime, w0, w1, w2, texlevel, texptr, texbufwidthbits);
+			}
+		}
+	}
+}
 
-				u8 stencil = GetPixelStencil(p.x, p.y);
-				// TODO: Is it safe to ignore gstate.isDepthTestEnabled() when clear mode is enabled?
-				if (!gstate.isModeClear() && (gstate.isStencilTestEnabled() || gstate.isDepthTestEnabled())) {
-					if (gstate.isStencilTestEnabled() && !StencilTestPassed(stencil)) {
-						stencil = ApplyStencilOp(gstate.getStencilOpSFail(), p.x, p.y);
-						SetPixelStencil(p.x, p.y, stencil);
-						continue;
-					}
+// Binning. Triangles from one primitive are sorted into screen tiles, and then the tiles are
+// rasterized in parallel. Each tile only touches its own pixels, and draws its triangles in
+// submission order, so the result is the same as drawing them one at a time.
+// gstate can't change until Flush(), which is why bins never outlive a primitive.
+
+enum {
+	// In pixels. Screen coords are 12.4 fixed point, so 4096 pixels covers all of them.
+	TILE_SIZE = 32,
+	TILE_SCREEN_SIZE = TILE_SIZE * 16,
+	TILES_PER_ROW = 4096 / TILE_SIZE,
+};
+
+struct BinnedTriangle {
+	VertexData v[3];
+};
+
+static std::vector<BinnedTriangle> binnedTriangles;
+// Triangle indices per tile, indexed by tileY * TILES_PER_ROW + tileX.
+static std::vector<std::vector<int> > bins;
+// Tiles with anything in them, in no particular order.
+static std::vector<int> activeBins;
+
+static void RasterizeBins(int lower, int upper)
+{
+	for (int i = lower; i < upper; ++i) {
+		const int tile = activeBins[i];
+		const int clipMinX = (tile % TILES_PER_ROW) * TILE_SCREEN_SIZE;
+		const int clipMinY = (tile / TILES_PER_ROW) * TILE_SCREEN_SIZE;
+		const int clipMaxX = clipMinX + TILE_SCREEN_SIZE - 16;
+		const int clipMaxY = clipMinY + TILE_SCREEN_SIZE - 16;
+
+		const std::vector<int> &bin = bins[tile];
+		for (size_t j = 0; j < bin.size(); ++j) {
+			const BinnedTriangle &tri = binnedTriangles[bin[j]];
+			DrawTriangleSlice(tri.v[0], tri.v[1], tri.v[2], clipMinX, clipMinY, clipMaxX, clipMaxY);
+		}
+	}
+}
 
-					// Also apply depth at the same time.  If disabled, same as passing.
-					if (gstate.isDepthTestEnabled() && !DepthTestPassed(p.x, p.y, z)) {
-						if (gstate.isStencilTestEnabled()) {
-							stencil = ApplyStencilOp(gstate.getStencilOpZFail(), p.x, p.y);
-							SetPixelStencil(p.x, p.y, stencil);
-						}
-						continue;
-					} else if (gstate.isStencilTestEnabled()) {
-						stencil = ApplyStencilOp(gstate.getStencilOpZPass(), p.x, p.y);
-					}
+void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2)
+{
+	Vec2<int> d01((int)v0.screenpos.x - (int)v1.screenpos.x, (int)v0.screenpos.y - (int)v1.screenpos.y);
+	Vec2<int> d02((int)v0.screenpos.x - (int)v2.screenpos.x, (int)v0.screenpos.y - (int)v2.screenpos.y);
 
-					if (gstate.isDepthTestEnabled() && gstate.isDepthWriteEnabled()) {
-						SetPixelDepth(p.x, p.y, z);
-					}
-				} else if (gstate.isModeClear() && gstate.isClearModeDepthWriteEnabled()) {
-					SetPixelDepth(p.x, p.y, z);
-				}
+	// Drop primitives which are not in CCW order by checking the cross product
+	if (d01.x * d02.y - d01.y * d02.x < 0)
+		return;
 
-				if (gstate.isAlphaBlendEnabled() && !gstate.isModeClear()) {
-					Vec4<int> dst = Vec4<int>::FromRGBA(GetPixelColor(p.x, p.y));
-					prim_color_rgb = AlphaBlendingResult(prim_color_rgb, prim_color_a, dst);
-				}
-				prim_color_rgb = prim_color_rgb.Clamp(0, 255);
+	int minX, minY, maxX, maxY;
+	GetTriangleBounds(v0, v1, v2, minX, minY, maxX, maxY);
+	if (minX > maxX || minY > maxY)
+		return;
 
-				u32 new_color = Vec4<int>(prim_color_rgb.r(), prim_color_rgb.g(), prim_color_rgb.b(), stencil).ToRGBA();
-				u32 old_color = GetPixelColor(p.x, p.y);
+	if (bins.empty())
+		bins.resize(TILES_PER_ROW * TILES_PER_ROW);
+
+	const int index = (int)binnedTriangles.size();
+	binnedTriangles.push_back(BinnedTriangle());
+	BinnedTriangle &tri = binnedTriangles.back();
+	tri.v[0] = v0;
+	tri.v[1] = v1;
+	tri.v[2] = v2;
+
+	for (int ty = minY / TILE_SCREEN_SIZE; ty <= maxY / TILE_SCREEN_SIZE; ++ty) {
+		for (int tx = minX / TILE_SCREEN_SIZE; tx <= maxX / TILE_SCREEN_SIZE; ++tx) {
+			const int tile = ty * TILES_PER_ROW + tx;
+			if (bins[tile].empty())
+				activeBins.push_back(tile);
+			bins[tile].push_back(index);
+		}
+	}
+}
 
-				// TODO: Is alpha blending still performed if logic ops are enabled?
-				if (gstate.isLogicOpEnabled() && !gstate.isModeClear()) {
-					// Logic ops don't affect stencil.
-					new_color = (stencil << 24) | (ApplyLogicOp(gstate.getLogicOp(), old_color, new_color) & 0x00FFFFFF);
-				}
+void Flush()
+{
+	if (binnedTriangles.empty())
+		return;
 
-				if (gstate.isModeClear()) {
-					new_color = (new_color & ~gstate.getClearModeColorMask()) | (old_color & gstate.getClearModeColorMask());
-				} else {
-					new_color = (new_color & ~gstate.getColorMask()) | (old_color & gstate.getColorMask());
-				}
+	GlobalThreadPool::Loop(std::bind(&RasterizeBins, placeholder::_1, placeholder::_2), 0, (int)activeBins.size());
 
-				SetPixelColor(p.x, p.y, new_color);
-			}
-		}
-	}
+	for (size_t i = 0; i < activeBins.size(); ++i)
+		bins[activeBins[i]].clear();
+	activeBins.clear();
+	binnedTriangles.clear();
 }
 
 bool GetCurrentStencilbuffer(GPUDebugBuffer &buffer)
@@ -23,8 +23,13 @@ struct GPUDebugBuffer;
 
 namespace Rasterizer {
 
-// Draws a triangle if its vertices are specified in counter-clockwise order
+// Queues a triangle if its vertices are specified in counter-clockwise order.
+// Nothing is drawn until Flush(), and gstate must stay the same until then.
 void DrawTriangle(const VertexData& v0, const VertexData& v1, const VertexData& v2);
+// Rasterizes everything queued, in parallel over screen tiles.
+void Flush();
+// Draws with the scalar per-pixel loop instead of SIMD quads, for testing.
+void SetScalarReference(bool enable);
 
 bool GetCurrentStencilbuffer(GPUDebugBuffer &buffer);
 bool GetCurrentTexture(GPUDebugBuffer &buffer);
@@ -21,6 +21,7 @@
 
 #include "TransformUnit.h"
 #include "Clipper.h"
+#include "Rasterizer.h"
 #include "Lighting.h"
 
 WorldCoords TransformUnit::ModelToWorld(const ModelCoords& coords)
@@ -413,5 +414,6 @@ void TransformUnit::SubmitPrimitive(void* vertices, void* indices, u32 prim_type
 		}
 	}
 
+	Rasterizer::Flush();
 	host->GPUNotifyDraw();
 }
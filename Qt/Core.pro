@@ -61,14 +61,30 @@ SOURCES += $$P/Core/*.cpp \ # Core
 	$$P/GPU/Software/*.cpp \
 	$$P/GPU/Common/IndexGenerator.cpp \
 	$$P/GPU/Common/TextureDecoder.cpp \
+	$$P/GPU/Common/TextureDiskCache.cpp \
 	$$P/GPU/Common/VertexDecoderCommon.cpp \
 	$$P/GPU/Common/PostShader.cpp \
+	$$P/GPU/Common/SplineCommon.cpp \
+	$$P/GPU/Debugger/Record.cpp \
 	$$P/ext/libkirk/*.c \ # Kirk
 	$$P/ext/xxhash.c \ # xxHash
 	$$P/ext/xbrz/*.cpp # XBRZ
 
 !x86:!symbian: SOURCES += $$P/GPU/Common/TextureDecoderNEON.cpp
 
+# GCC only allows SSSE3 intrinsics when the whole file is built with it.
+x86 {
+	win32-msvc*: SOURCES += $$P/GPU/Common/TextureDecoderSSSE3.cpp
+	else {
+		SSSE3_SOURCES += $$P/GPU/Common/TextureDecoderSSSE3.cpp
+		ssse3.input = SSSE3_SOURCES
+		ssse3.output = ${QMAKE_VAR_OBJECTS_DIR}${QMAKE_FILE_BASE}$${first(QMAKE_EXT_OBJ)}
+		ssse3.commands = $${QMAKE_CXX} $(CXXFLAGS) -mssse3 $(INCPATH) -c ${QMAKE_FILE_IN} -o ${QMAKE_FILE_OUT}
+		ssse3.variable_out = OBJECTS
+		QMAKE_EXTRA_COMPILERS += ssse3
+	}
+}
+
 arm: SOURCES += $$P/GPU/GLES/VertexDecoderArm.cpp
 else:SOURCES += $$P/GPU/GLES/VertexDecoderX86.cpp
 
@@ -86,6 +102,7 @@ HEADERS += $$P/Core/*.h \
 	$$P/GPU/GLES/*.h \
 	$$P/GPU/Software/*.h \
 	$$P/GPU/Common/*.h \
+	$$P/GPU/Debugger/Record.h \
 	$$P/GPU/*.h \
 	$$P/ext/libkirk/*.h \
 	$$P/ext/xbrz/*.h
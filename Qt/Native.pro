@@ -17,6 +17,12 @@ x86:!mobile_platform: {
 	HEADERS += $$P/native/base/backtrace.h
 }
 
+# CityHash
+
+SOURCES += $$P/native/ext/cityhash/city.cpp
+HEADERS += $$P/native/ext/cityhash/city.h
+INCLUDEPATH += $$P/native/ext/cityhash
+
 # RG_ETC1
 
 SOURCES += $$P/native/ext/rg_etc1/rg_etc1.cpp
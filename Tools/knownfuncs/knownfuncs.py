@@ -0,0 +1,561 @@
+#!/usr/bin/env python3
+# Generates Core/HLE/KnownFunctionHashes.h from PSP executables (ELF or unencrypted PRX.)
+#
+# Every leaf function called with jal is run in a small MIPS interpreter against test cases
+# for each function that has a native replacement (see Core/HLE/ReplaceTables.cpp.) The
+# ones that behave exactly like one of them on every case are written out by hash and size.
+#
+#   python3 Tools/knownfuncs/knownfuncs.py [--merge] -o Core/HLE/KnownFunctionHashes.h files...
+#
+# With --merge, entries already in the output file are kept.
+
+import argparse
+import os
+import random
+import re
+import struct
+import sys
+
+# Bump when the hash, the test cases, or the meaning of a name changes.
+VERSION = 1
+
+MAX_FUNC_SIZE = 0x400
+MAX_STEPS = 30000
+
+# Test buffers live here, anything else the function touches means it's not a match.
+BUF_BASE = 0x08900000
+BUF_SIZE = 0x4000
+STACK_TOP = BUF_BASE + 4 * BUF_SIZE
+RETURN_ADDR = 0x08A00000
+
+
+# ---- XXH32, same as ext/xxhash.c (over little endian words.)
+
+P1, P2, P3, P4, P5 = 2654435761, 2246822519, 3266489917, 668265263, 374761393
+M32 = 0xFFFFFFFF
+
+
+def rotl(x, r):
+    return ((x << r) | (x >> (32 - r))) & M32
+
+
+def xxh32(data, seed=0):
+    n = len(data)
+    p = 0
+    if n >= 16:
+        v = [(seed + P1 + P2) & M32, (seed + P2) & M32, seed, (seed - P1) & M32]
+        while p <= n - 16:
+            for i in range(4):
+                w = struct.unpack_from('<I', data, p)[0]
+                v[i] = (rotl((v[i] + w * P2) & M32, 13) * P1) & M32
+                p += 4
+        h = (rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18)) & M32
+    else:
+        h = (seed + P5) & M32
+    h = (h + n) & M32
+    while p + 4 <= n:
+        w = struct.unpack_from('<I', data, p)[0]
+        h = (rotl((h + w * P3) & M32, 17) * P4) & M32
+        p += 4
+    while p < n:
+        h = (rotl((h + data[p] * P5) & M32, 11) * P1) & M32
+        p += 1
+    h ^= h >> 15
+    h = (h * P2) & M32
+    h ^= h >> 13
+    h = (h * P3) & M32
+    h ^= h >> 16
+    return h
+
+
+def hash_function(words):
+    # Jump targets are relocated, so they're left out, like in ReplaceTables.cpp.
+    masked = []
+    for w in words:
+        op = w >> 26
+        if op == 2 or op == 3:
+            w &= 0xFC000000
+        masked.append(w)
+    return xxh32(struct.pack('<%dI' % len(masked), *masked))
+
+
+# ---- ELF
+
+def read_text(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'\x7fELF':
+        return None
+    shoff, = struct.unpack_from('<I', data, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from('<HHH', data, 0x2E)
+    sections = []
+    for i in range(shnum):
+        sections.append(struct.unpack_from('<IIIIIIIIII', data, shoff + i * shentsize))
+    names = sections[shstrndx]
+    for sec in sections:
+        name_off = names[4] + sec[0]
+        name = data[name_off:data.index(b'\0', name_off)]
+        if name == b'.text':
+            addr, off, size = sec[3], sec[4], sec[5]
+            return addr, list(struct.unpack_from('<%dI' % (size // 4), data, off))
+    return None
+
+
+# ---- Finding leaf functions
+
+def branch_target(pc, w):
+    op = w >> 26
+    imm = w & 0xFFFF
+    if imm & 0x8000:
+        imm -= 0x10000
+    if op in (4, 5, 6, 7, 20, 21, 22, 23) or (op == 1 and ((w >> 16) & 0x1F) in (0, 1, 2, 3)):
+        return (pc + 4 + imm * 4) & M32
+    if op == 2:
+        return ((pc + 4) & 0xF0000000) | ((w & 0x03FFFFFF) << 2)
+    return None
+
+
+def find_leaf(text_addr, words, entry):
+    """Returns the size of the leaf function at entry, or None."""
+    furthest = entry
+    pc = entry
+    end = text_addr + len(words) * 4
+    while pc < end and pc - entry < MAX_FUNC_SIZE:
+        w = words[(pc - text_addr) // 4]
+        op = w >> 26
+        if op == 3 or (op == 0 and (w & 0x3F) in (0x09, 0x0C)):
+            # Calls and syscalls: not a simple leaf.
+            return None
+        if op == 0 and (w & 0x3F) == 0x08:
+            if w != 0x03E00008:
+                return None
+            if pc >= furthest:
+                return pc + 8 - entry
+        target = branch_target(pc, w)
+        if target is not None:
+            # Branches back to the first two instructions would hit the patch.
+            if target < entry + 8 or target >= entry + MAX_FUNC_SIZE:
+                return None
+            furthest = max(furthest, target)
+        pc += 4
+    return None
+
+
+# ---- A small Allegrex interpreter, integer ops only.
+
+class Unsupported(Exception):
+    pass
+
+
+class Fault(Exception):
+    pass
+
+
+def s32(x):
+    return x - 0x100000000 if x & 0x80000000 else x
+
+
+def sext16(x):
+    return x - 0x10000 if x & 0x8000 else x
+
+
+class Cpu(object):
+    def __init__(self, text_addr, words):
+        self.text_addr = text_addr
+        self.words = words
+        self.mem = bytearray(BUF_SIZE * 4)
+        self.r = [0] * 32
+        self.hi = self.lo = 0
+
+    def addr(self, a, size):
+        a &= 0x3FFFFFFF
+        if a < BUF_BASE or a + size > BUF_BASE + len(self.mem):
+            raise Fault()
+        return a - BUF_BASE
+
+    def load(self, a, size, signed):
+        o = self.addr(a, size)
+        v = int.from_bytes(bytes(self.mem[o:o + size]), 'little')
+        if signed and v & (1 << (size * 8 - 1)):
+            v -= 1 << (size * 8)
+        return v & M32
+
+    def store(self, a, size, v):
+        o = self.addr(a, size)
+        self.mem[o:o + size] = (v & ((1 << (size * 8)) - 1)).to_bytes(size, 'little')
+
+    def set(self, rd, v):
+        if rd != 0:
+            self.r[rd] = v & M32
+
+    def call(self, entry, args):
+        r = self.r
+        for i in range(32):
+            r[i] = 0
+        for i, a in enumerate(args):
+            r[4 + i] = a & M32
+        r[29] = STACK_TOP - 0x100
+        r[31] = RETURN_ADDR
+        pc = entry
+        delay = None
+        for _ in range(MAX_STEPS):
+            if pc == RETURN_ADDR:
+                return r[2]
+            idx = (pc - self.text_addr) // 4
+            if idx < 0 or idx >= len(self.words):
+                raise Fault()
+            next_pc = delay if delay is not None else pc + 4
+            delay = None
+            target = self.step(pc, self.words[idx])
+            if target is not None:
+                if target == 'likely':
+                    next_pc = pc + 8
+                else:
+                    # Run the delay slot first.
+                    delay = target
+            pc = next_pc
+        raise Fault()
+
+    def step(self, pc, w):
+        r = self.r
+        op = w >> 26
+        rs = (w >> 21) & 0x1F
+        rt = (w >> 16) & 0x1F
+        rd = (w >> 11) & 0x1F
+        sa = (w >> 6) & 0x1F
+        imm = w & 0xFFFF
+        simm = sext16(imm)
+        if op == 0:
+            fn = w & 0x3F
+            a, b = r[rs], r[rt]
+            if fn == 0x00: self.set(rd, b << sa)
+            elif fn == 0x02:
+                if rs == 1: self.set(rd, (b >> sa) | (b << (32 - sa)))
+                else: self.set(rd, b >> sa)
+            elif fn == 0x03: self.set(rd, s32(b) >> sa)
+            elif fn == 0x04: self.set(rd, b << (a & 31))
+            elif fn == 0x06: self.set(rd, b >> (a & 31))
+            elif fn == 0x07: self.set(rd, s32(b) >> (a & 31))
+            elif fn == 0x08: return a
+            elif fn == 0x0A:
+                if b == 0: self.set(rd, a)
+            elif fn == 0x0B:
+                if b != 0: self.set(rd, a)
+            elif fn == 0x10: self.set(rd, self.hi)
+            elif fn == 0x12: self.set(rd, self.lo)
+            elif fn == 0x16: self.set(rd, 32 - a.bit_length())
+            elif fn == 0x17: self.set(rd, 32 - (~a & M32).bit_length())
+            elif fn == 0x18:
+                p = s32(a) * s32(b)
+                self.lo, self.hi = p & M32, (p >> 32) & M32
+            elif fn == 0x19:
+                p = a * b
+                self.lo, self.hi = p & M32, (p >> 32) & M32
+            elif fn == 0x1A:
+                if b == 0: raise Unsupported()
+                q = abs(s32(a)) // abs(s32(b))
+                if (s32(a) < 0) != (s32(b) < 0): q = -q
+                self.lo, self.hi = q & M32, (s32(a) - q * s32(b)) & M32
+            elif fn == 0x1B:
+                if b == 0: raise Unsupported()
+                self.lo, self.hi = a // b, a % b
+            elif fn == 0x0D: raise Fault()
+            elif fn in (0x20, 0x21): self.set(rd, a + b)
+            elif fn in (0x22, 0x23): self.set(rd, a - b)
+            elif fn == 0x24: self.set(rd, a & b)
+            elif fn == 0x25: self.set(rd, a | b)
+            elif fn == 0x26: self.set(rd, a ^ b)
+            elif fn == 0x27: self.set(rd, ~(a | b))
+            elif fn == 0x2A: self.set(rd, 1 if s32(a) < s32(b) else 0)
+            elif fn == 0x2B: self.set(rd, 1 if a < b else 0)
+            elif fn == 0x2C: self.set(rd, a if s32(a) > s32(b) else b)
+            elif fn == 0x2D: self.set(rd, a if s32(a) < s32(b) else b)
+            else: raise Unsupported()
+            return None
+        if op == 1:
+            a = s32(r[rs])
+            if rt == 0: taken = a < 0
+            elif rt == 1: taken = a >= 0
+            elif rt == 2: taken = a < 0
+            elif rt == 3: taken = a >= 0
+            else: raise Unsupported()
+            if taken:
+                return branch_target(pc, w)
+            return 'likely' if rt in (2, 3) else None
+        if op in (4, 5, 6, 7, 20, 21, 22, 23):
+            a, b = s32(r[rs]), s32(r[rt])
+            kind = op & 3
+            taken = [a == b, a != b, a <= 0, a > 0][kind]
+            if taken:
+                return branch_target(pc, w)
+            return 'likely' if op >= 20 else None
+        if op == 2:
+            return branch_target(pc, w)
+        if op in (8, 9): self.set(rt, r[rs] + simm)
+        elif op == 10: self.set(rt, 1 if s32(r[rs]) < simm else 0)
+        elif op == 11: self.set(rt, 1 if r[rs] < (simm & M32) else 0)
+        elif op == 12: self.set(rt, r[rs] & imm)
+        elif op == 13: self.set(rt, r[rs] | imm)
+        elif op == 14: self.set(rt, r[rs] ^ imm)
+        elif op == 15: self.set(rt, imm << 16)
+        elif op == 31:
+            fn = w & 0x3F
+            if fn == 0:  # ext
+                self.set(rt, (r[rs] >> sa) & ((1 << (rd + 1)) - 1))
+            elif fn == 4:  # ins
+                mask = ((1 << (rd - sa + 1)) - 1) << sa
+                self.set(rt, (r[rt] & ~mask) | ((r[rs] << sa) & mask))
+            elif fn == 0x20 and sa == 0x10:  # seb
+                v = r[rt] & 0xFF
+                self.set(rd, v - 0x100 if v & 0x80 else v)
+            elif fn == 0x20 and sa == 0x18:  # seh
+                self.set(rd, sext16(r[rt] & 0xFFFF))
+            else:
+                raise Unsupported()
+        elif op in (32, 33, 35, 36, 37):
+            size = {32: 1, 33: 2, 35: 4, 36: 1, 37: 2}[op]
+            self.set(rt, self.load(r[rs] + simm, size, op in (32, 33)))
+        elif op in (40, 41, 43):
+            size = {40: 1, 41: 2, 43: 4}[op]
+            self.store(r[rs] + simm, size, r[rt])
+        elif op in (34, 38):  # lwl, lwr
+            a = (r[rs] + simm) & M32
+            shift = a & 3
+            word = self.load(a & ~3, 4, False)
+            if op == 34:
+                mask = [0x00FFFFFF, 0x0000FFFF, 0x000000FF, 0x00000000][shift]
+                self.set(rt, (r[rt] & mask) | ((word << (24 - shift * 8)) & M32))
+            else:
+                mask = [0x00000000, 0xFF000000, 0xFFFF0000, 0xFFFFFF00][shift]
+                self.set(rt, (r[rt] & mask) | (word >> (shift * 8)))
+        elif op in (42, 46):  # swl, swr
+            a = (r[rs] + simm) & M32
+            shift = a & 3
+            word = self.load(a & ~3, 4, False)
+            if op == 42:
+                mask = [0xFFFFFF00, 0xFFFF0000, 0xFF000000, 0x00000000][shift]
+                word = (word & mask) | (r[rt] >> (24 - shift * 8))
+            else:
+                mask = [0x00000000, 0x000000FF, 0x0000FFFF, 0x00FFFFFF][shift]
+                word = (word & mask) | ((r[rt] << (shift * 8)) & M32)
+            self.store(a & ~3, 4, word)
+        else:
+            raise Unsupported()
+        return None
+
+
+# ---- Test cases, one checker per replacement.
+
+DST = BUF_BASE + 0x100
+SRC = BUF_BASE + 0x2100
+
+
+def fill(cpu, rng):
+    # No zero bytes, so that stray string terminators don't make a wrong function pass.
+    cpu.mem[:] = rng.randbytes(len(cpu.mem)).replace(b'\0', b'\x01')
+
+
+def cstring(cpu, addr, length, rng):
+    o = cpu.addr(addr, length + 1)
+    for i in range(length):
+        cpu.mem[o + i] = rng.randrange(1, 256)
+    cpu.mem[o + length] = 0
+
+
+SIZES = [0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 255, 256, 1000]
+
+
+def check_memcpy(cpu, entry, rng, overlap=False):
+    for n in SIZES:
+        for da in range(4):
+            for sa in range(4):
+                fill(cpu, rng)
+                if overlap:
+                    src = SRC + sa
+                    dst = src + rng.choice([-1, 1]) * (1 + rng.randrange(max(n, 1)))
+                    dst += da
+                else:
+                    dst, src = DST + da, SRC + sa
+                before = bytearray(cpu.mem)
+                so = src - BUF_BASE
+                expected = bytearray(before)
+                expected[dst - BUF_BASE:dst - BUF_BASE + n] = before[so:so + n]
+                if cpu.call(entry, [dst, src, n]) != dst or cpu.mem != expected:
+                    return False
+    return True
+
+
+def check_memmove(cpu, entry, rng):
+    return check_memcpy(cpu, entry, rng) and check_memcpy(cpu, entry, rng, True)
+
+
+def check_memset(cpu, entry, rng):
+    for n in SIZES:
+        for da in range(4):
+            for c in (0, 0x7F, 0xFF, 0x1234A5):
+                fill(cpu, rng)
+                expected = bytearray(cpu.mem)
+                o = DST + da - BUF_BASE
+                expected[o:o + n] = bytes([c & 0xFF]) * n
+                if cpu.call(entry, [DST + da, c, n]) != DST + da or cpu.mem != expected:
+                    return False
+    return True
+
+
+def check_strlen(cpu, entry, rng):
+    for n in list(range(0, 70)) + [255, 1000]:
+        for a in range(4):
+            fill(cpu, rng)
+            cstring(cpu, SRC + a, n, rng)
+            if cpu.call(entry, [SRC + a]) != n:
+                return False
+    return True
+
+
+def check_strcmp(cpu, entry, rng, limited=False):
+    for n in list(range(0, 40)) + [100, 255]:
+        for a in range(4):
+            for b in range(4):
+                for mode in range(4):
+                    fill(cpu, rng)
+                    cstring(cpu, SRC + a, n, rng)
+                    so = SRC + a - BUF_BASE
+                    do = DST + b - BUF_BASE
+                    s1 = bytes(cpu.mem[so:so + n + 1])
+                    s2 = bytearray(s1)
+                    if mode == 1 and n > 0:
+                        s2[rng.randrange(n)] = rng.randrange(1, 256)
+                    elif mode == 2:
+                        s2 = s2[:rng.randrange(n + 1)] + b'\0'
+                    elif mode == 3:
+                        s2 = s2[:n] + bytes([rng.randrange(1, 256)]) + b'\0'
+                    cpu.mem[do:do + len(s2)] = s2
+                    limit = rng.randrange(n + 3) if limited else 0x7FFFFFFF
+                    expected = 0
+                    for i in range(min(limit, max(len(s1), len(s2)))):
+                        c1 = s1[i] if i < len(s1) else 0
+                        c2 = s2[i] if i < len(s2) else 0
+                        if c1 != c2 or c1 == 0:
+                            expected = c1 - c2
+                            break
+                    args = [SRC + a, DST + b, limit] if limited else [SRC + a, DST + b]
+                    if s32(cpu.call(entry, args)) != expected:
+                        return False
+    return True
+
+
+def check_strncmp(cpu, entry, rng):
+    return check_strcmp(cpu, entry, rng, True)
+
+
+def check_strcpy(cpu, entry, rng):
+    for n in list(range(0, 40)) + [100, 255, 1000]:
+        for da in range(4):
+            for sa in range(4):
+                fill(cpu, rng)
+                cstring(cpu, SRC + sa, n, rng)
+                expected = bytearray(cpu.mem)
+                so = SRC + sa - BUF_BASE
+                expected[DST + da - BUF_BASE:DST + da - BUF_BASE + n + 1] = expected[so:so + n + 1]
+                if cpu.call(entry, [DST + da, SRC + sa]) != DST + da or cpu.mem != expected:
+                    return False
+    return True
+
+
+# memmove first: anything that passes it also passes memcpy, and is better named memmove.
+CHECKS = [
+    ('memmove', check_memmove),
+    ('memcpy', check_memcpy),
+    ('memset', check_memset),
+    ('strlen', check_strlen),
+    ('strcmp', check_strcmp),
+    ('strncmp', check_strncmp),
+    ('strcpy', check_strcpy),
+]
+
+
+def classify(text_addr, words, entry):
+    cpu = Cpu(text_addr, words)
+    for name, check in CHECKS:
+        rng = random.Random(entry)
+        try:
+            if check(cpu, entry, rng):
+                return name
+        except (Fault, Unsupported):
+            pass
+    return None
+
+
+classified = {}
+
+
+def scan(path):
+    text = read_text(path)
+    if text is None:
+        return []
+    text_addr, words = text
+    end = text_addr + len(words) * 4
+    entries = set()
+    for i, w in enumerate(words):
+        if w >> 26 == 3:
+            target = ((text_addr + i * 4) & 0xF0000000) | ((w & 0x03FFFFFF) << 2)
+            if text_addr <= target < end:
+                entries.add(target)
+    found = []
+    for entry in sorted(entries):
+        size = find_leaf(text_addr, words, entry)
+        if size is None:
+            continue
+        func = words[(entry - text_addr) // 4:(entry - text_addr + size) // 4]
+        key = (hash_function(func), size)
+        # Most executables link the same library, so this saves a lot of time.
+        if key not in classified:
+            classified[key] = classify(text_addr, words, entry)
+        if classified[key] is not None:
+            found.append((key[0], size, classified[key]))
+    return found
+
+
+ENTRY_RE = re.compile(r'\{\s*0x([0-9a-fA-F]+),\s*(\d+),\s*"(\w+)"\s*\}')
+
+
+def write_header(path, entries):
+    with open(path, 'w') as f:
+        f.write('// Generated by Tools/knownfuncs/knownfuncs.py, do not edit.\n')
+        f.write('// Hash (XXH32, jump targets masked), size in bytes, and the replacement in ReplaceTables.cpp.\n\n')
+        f.write('#pragma once\n\n')
+        f.write('#define KNOWN_FUNCTION_HASHES_VERSION %d\n\n' % VERSION)
+        f.write('static const KnownFunctionHash knownFunctionHashes[] = {\n')
+        for h, size, name in sorted(entries, key=lambda e: (e[2], e[1], e[0])):
+            f.write('\t{ 0x%08x, %d, "%s" },\n' % (h, size, name))
+        f.write('};\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('-o', '--output', required=True)
+    parser.add_argument('--merge', action='store_true')
+    parser.add_argument('files', nargs='+')
+    args = parser.parse_args()
+
+    entries = {}
+    if args.merge and os.path.exists(args.output):
+        with open(args.output) as f:
+            for m in ENTRY_RE.finditer(f.read()):
+                entries[(int(m.group(1), 16), int(m.group(2)))] = m.group(3)
+
+    for path in args.files:
+        for h, size, name in scan(path):
+            old = entries.get((h, size))
+            if old is not None and old != name:
+                print('%s: %08x/%d is both %s and %s, dropping' % (path, h, size, old, name), file=sys.stderr)
+                entries[(h, size)] = None
+            elif old is None and (h, size) not in entries:
+                print('%s: %s %08x/%d' % (path, name, h, size))
+                entries[(h, size)] = name
+
+    write_header(args.output, [(h, size, name) for (h, size), name in entries.items() if name is not None])
+
+
+if __name__ == '__main__':
+    main()
@@ -34,6 +34,7 @@
 #include "Core/MIPS/JitCommon/JitCommon.h"
 #include "GPU/GPUInterface.h"
 #include "GPU/GPUState.h"
+#include "GPU/Debugger/Record.h"
 #include "ext/disarm.h"
 #include "Common/CPUDetect.h"
 
@@ -54,6 +55,7 @@ void DevMenu::CreatePopupContents(UI::ViewGroup *parent) {
 	parent->Add(new Choice("Jit Compare"))->OnClick.Handle(this, &DevMenu::OnJitCompare);
 	parent->Add(new Choice("Toggle Freeze"))->OnClick.Handle(this, &DevMenu::OnFreezeFrame);
 	parent->Add(new Choice("Dump Frame GPU Commands"))->OnClick.Handle(this, &DevMenu::OnDumpFrame);
+	parent->Add(new Choice("Record GE Dump"))->OnClick.Handle(this, &DevMenu::OnRecordDump);
 }
 
 UI::EventReturn DevMenu::OnLogConfig(UI::EventParams &e) {
@@ -85,6 +87,12 @@ UI::EventReturn DevMenu::OnDumpFrame(UI::EventParams &e) {
 	return UI::EVENT_DONE;
 }
 
+UI::EventReturn DevMenu::OnRecordDump(UI::EventParams &e) {
+	// Replay with headless --gedump.
+	GPURecord::Activate(10);
+	return UI::EVENT_DONE;
+}
+
 void DevMenu::dialogFinished(const Screen *dialog, DialogResult result) {
 	// Close when a subscreen got closed.
 	// TODO: a bug in screenmanager causes this not to work here.
@@ -40,6 +40,7 @@ protected:
 	UI::EventReturn OnJitCompare(UI::EventParams &e);
 	UI::EventReturn OnFreezeFrame(UI::EventParams &e);
 	UI::EventReturn OnDumpFrame(UI::EventParams &e);
+	UI::EventReturn OnRecordDump(UI::EventParams &e);
 	UI::EventReturn OnDeveloperTools(UI::EventParams &e);
 };
 
@@ -2,6 +2,7 @@
 // See headless.txt.
 // To build on non-windows systems, just run CMake in the SDL directory, it will build both a normal ppsspp and the headless version.
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <limits>
@@ -13,6 +14,11 @@
 #include "Core/System.h"
 #include "Core/HLE/sceUtility.h"
 #include "Core/Host.h"
+#include "Core/MemMap.h"
+#include "Core/MIPS/MIPS.h"
+#include "GPU/GPUInterface.h"
+#include "GPU/GPUState.h"
+#include "GPU/Debugger/Record.h"
 #include "Log.h"
 #include "LogManager.h"
 #include "base/NativeApp.h"
@@ -95,6 +101,8 @@ void printUsage(const char *progname, const char *reason)
 	}
 #endif
 	fprintf(stderr, "  --timeout=SECONDS     abort test it if takes longer than SECONDS\n");
+	fprintf(stderr, "  --gedump=FILE         replay a recorded GE dump and print frame timings\n");
+	fprintf(stderr, "  --loops=N             replay the GE dump N times (default 1)\n");
 
 	fprintf(stderr, "  -v, --verbose         show the full passed/failed result\n");
 	fprintf(stderr, "  -i                    use the interpreter\n");
@@ -183,6 +191,60 @@ bool RunAutoTest(HeadlessHost *headlessHost, CoreParameter &coreParameter, bool
 	return passed;
 }
 
+// Runs only the GPU, without any of the CPU or HLE emulation.
+bool RunGEDump(CoreParameter &coreParameter, const char *filename, int loops)
+{
+	GPURecord::Replayer replayer;
+	std::string error_string;
+
+	PSP_CoreParameter() = coreParameter;
+	// Lists must be done when RunFrame returns.
+	g_Config.bSeparateCPUThread = false;
+	// Captures may come from either model, so always have the most memory.
+	Memory::g_MemorySize = Memory::RAM_DOUBLE_SIZE;
+	Memory::Init();
+	currentMIPS = &mipsr4k;
+	CoreTiming::Init();
+	coreState = CORE_RUNNING;
+
+	bool success = replayer.Load(filename, &error_string) && GPU_Init();
+	if (!success) {
+		if (error_string.empty())
+			error_string = "Unable to initialize rendering engine.";
+		fprintf(stderr, "Failed to replay %s. Error: %s\n", filename, error_string.c_str());
+		printf("TESTERROR\n");
+	} else {
+		const int frames = replayer.GetNumFrames();
+		double minMs = std::numeric_limits<double>::infinity();
+		double maxMs = 0.0;
+		double totalMs = 0.0;
+		for (int loop = 0; loop < loops; ++loop) {
+			for (int frame = 0; frame < frames; ++frame) {
+				const double start = real_time_now();
+				replayer.RunFrame(frame);
+				const double ms = (real_time_now() - start) * 1000.0;
+
+				// Nothing will run the sync and interrupt events, so don't let them pile up.
+				CoreTiming::MoveEvents();
+				CoreTiming::ClearPendingEvents();
+
+				if (loops == 1)
+					printf("Frame %d: %0.3f ms\n", frame, ms);
+				minMs = std::min(minMs, ms);
+				maxMs = std::max(maxMs, ms);
+				totalMs += ms;
+			}
+		}
+		printf("%d frames: min %0.3f ms, avg %0.3f ms, max %0.3f ms\n", frames * loops, minMs, totalMs / (frames * loops), maxMs);
+	}
+
+	GPU_Shutdown();
+	CoreTiming::Shutdown();
+	Memory::Shutdown();
+	coreState = CORE_POWERDOWN;
+	return success;
+}
+
 int main(int argc, const char* argv[])
 {
 #ifdef ANDROID_NDK_PROFILER
@@ -200,6 +262,8 @@ int main(int argc, const char* argv[])
 	std::vector<std::string> testFilenames;
 	const char *mountIso = 0;
 	const char *screenshotFilename = 0;
+	const char *geDumpFilename = 0;
+	int geDumpLoops = 1;
 	bool readMount = false;
 	float timeout = std::numeric_limits<float>::infinity();
 
@@ -247,6 +311,10 @@ int main(int argc, const char* argv[])
 			screenshotFilename = argv[i] + strlen("--screenshot=");
 		else if (!strncmp(argv[i], "--timeout=", strlen("--timeout=")) && strlen(argv[i]) > strlen("--timeout="))
 			timeout = strtod(argv[i] + strlen("--timeout="), NULL);
+		else if (!strncmp(argv[i], "--gedump=", strlen("--gedump=")) && strlen(argv[i]) > strlen("--gedump="))
+			geDumpFilename = argv[i] + strlen("--gedump=");
+		else if (!strncmp(argv[i], "--loops=", strlen("--loops=")) && strlen(argv[i]) > strlen("--loops="))
+			geDumpLoops = std::max(1, atoi(argv[i] + strlen("--loops=")));
 		else if (!strcmp(argv[i], "--teamcity"))
 			teamCityMode = true;
 		else if (!strcmp(argv[i], "--help") || !strcmp(argv[i], "-h"))
@@ -274,7 +342,7 @@ int main(int argc, const char* argv[])
 		printUsage(argv[0], "Missing argument after -m");
 		return 1;
 	}
-	if (testFilenames.empty())
+	if (testFilenames.empty() && geDumpFilename == 0)
 	{
 		printUsage(argv[0], argc <= 1 ? NULL : "No executables specified");
 		return 1;
@@ -365,6 +433,10 @@ int main(int argc, const char* argv[])
 	if (screenshotFilename != 0)
 		headlessHost->SetComparisonScreenshot(screenshotFilename);
 
+	bool geDumpPassed = true;
+	if (geDumpFilename != 0)
+		geDumpPassed = RunGEDump(coreParameter, geDumpFilename, geDumpLoops);
+
 	std::vector<std::string> failedTests;
 	std::vector<std::string> passedTests;
 	for (size_t i = 0; i < testFilenames.size(); ++i)
@@ -407,5 +479,5 @@ int main(int argc, const char* argv[])
 	moncleanup();
 #endif
 
-	return 0;
+	return geDumpPassed ? 0 : 1;
 }
@@ -31,9 +31,39 @@
 #include <string>
 
 #include "base/NativeApp.h"
+#include "base/functional.h"
+#include "base/timeutil.h"
 #include "Common/ArmEmitter.h"
+#include "Common/FileUtil.h"
+#include "Common/FixedSizeQueue.h"
+#include "Core/Config.h"
+#include "Core/CoreTiming.h"
+#include "Core/CwCheat.h"
+#include "Core/Host.h"
+#include "Core/FileSystems/BlockDevices.h"
+#include "Core/FileSystems/ISOFileSystem.h"
+#include "Core/HLE/HLE.h"
+#include "Core/HLE/HLETables.h"
+#include "Core/MIPS/MIPS.h"
+#include "Core/MIPS/MIPSCodeUtils.h"
+#include "Core/MIPS/MIPSTables.h"
+#include "Core/MIPS/JitCommon/JitBlockCache.h"
+#include "Core/MIPS/JitCommon/JitCommon.h"
+#include "Core/MIPS/JitCommon/JitIR.h"
+#include "Core/MemMap.h"
+#include "Core/System.h"
+#include "GPU/GPUState.h"
+#include "GPU/ge_constants.h"
+#include "GPU/Common/IndexGenerator.h"
+#include "GPU/Common/TextureDecoder.h"
+#include "GPU/Debugger/Record.h"
+#include "GPU/GLES/TransformPipeline.h"
+#include "GPU/GLES/VertexDecoder.h"
+#include "GPU/Software/Rasterizer.h"
+#include "GPU/Software/SoftGpu.h"
 #include "ext/disarm.h"
 #include "math/math_util.h"
+#include "thread/thread.h"
 #include "util/text/parsers.h"
 
 #define EXPECT_TRUE(a) if (!(a)) { printf(__FUNCTION__ ":%i: Test Fail\n", __LINE__); return false; }
@@ -43,6 +73,32 @@
 
 #define RET(a) if (!(a)) { return false; }
 
+// A small LCG for test data, so every run sees the same input.
+static u32 NextRandom(u32 &seed) {
+	seed = seed * 1103515245 + 12345;
+	return seed;
+}
+
+static void FillRandom(u8 *dest, size_t size, u32 &seed) {
+	for (size_t i = 0; i < size; i++)
+		dest[i] = (u8)(NextRandom(seed) >> 16);
+}
+
+// Checks that two arrays match, printing the first element that doesn't.
+template <typename T>
+static bool ArraysMatch(const char *what, const T *actual, const T *expected, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		if (actual[i] != expected[i]) {
+			printf("%s: differs at %i: %08x, expected %08x\n", what, (int)i, (u32)actual[i], (u32)expected[i]);
+			return false;
+		}
+	}
+	return true;
+}
+
+// "UnitTest benchmark" also prints the timings of the tests that have them.
+static bool benchmark = false;
+
 std::string System_GetProperty(SystemProperty prop) { return ""; }
 
 #define M_PI_2     1.57079632679489661923
@@ -312,12 +368,1436 @@ bool TestParsers() {
 	return true;
 }
 
+struct TestBlockRange {
+	u32 start;
+	u32 size;
+	// Index of the range this block's only exit jumps to.
+	int exitTarget;
+	// The block most recently compiled for this range.
+	int blockNum;
+	bool alive;
+};
+
+// Adds a block for the range to the cache without compiling any guest code, leaving room
+// for DestroyBlock to patch its entry and for LinkBlockExits to patch its exit.
+static int AddTestBlock(JitBlockCache *cache, const std::vector<TestBlockRange> &ranges, int i) {
+	const int blockNum = cache->AllocateBlock(ranges[i].start);
+	JitBlock *b = cache->GetBlock(blockNum);
+	MIPSComp::jit->AlignCode16();
+	b->checkedEntry = MIPSComp::jit->GetCodePtr();
+	b->normalEntry = b->checkedEntry;
+	MIPSComp::jit->ReserveCodeSpace(32);
+	b->exitAddress[0] = ranges[ranges[i].exitTarget].start;
+	b->exitPtrs[0] = MIPSComp::jit->GetWritableCodePtr();
+	MIPSComp::jit->ReserveCodeSpace(16);
+	b->originalSize = ranges[i].size / 4;
+	b->codeSize = 48;
+	cache->FinalizeBlock(blockNum, true);
+	return blockNum;
+}
+
+// Checks that exactly the live ranges have a block, and that an exit is linked exactly
+// when the block it jumps to is alive.
+static bool CheckTestBlocks(JitBlockCache *cache, const std::vector<TestBlockRange> &ranges) {
+	for (size_t i = 0; i < ranges.size(); i++) {
+		const TestBlockRange &r = ranges[i];
+		const JitBlock *b = cache->GetBlock(r.blockNum);
+		EXPECT_TRUE(b->invalid == !r.alive);
+		if (!r.alive) {
+			// The original opcode is back.
+			EXPECT_TRUE(Memory::Read_U32(r.start) == 0);
+			continue;
+		}
+		EXPECT_TRUE(cache->GetBlockNumberFromStartAddress(r.start) == r.blockNum);
+		EXPECT_TRUE(b->linkStatus[0] == ranges[r.exitTarget].alive);
+	}
+	return true;
+}
+
+// Replays an invalidation trace through JitBlockCache::InvalidateICache and checks it destroys
+// exactly what a brute force scan would, unlinking the exits into what it destroyed. The trace
+// mimics what games do: stub/relocation patches of a few bytes, memcpy'd overlays of a few KB,
+// and the odd full module unload. Recompiling the destroyed blocks must then relink every exit.
+bool TestJitPageIndex() {
+	const int numBlocks = 2000;
+	const int numInvalidations = 5000;
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	MIPSComp::jit = new MIPSComp::Jit(&mipsr4k);
+	JitBlockCache *cache = MIPSComp::jit->GetBlockCache();
+
+	// One block starting in each 4KB of an 8MB module, some long enough to span pages.
+	std::vector<TestBlockRange> ranges(numBlocks);
+	u32 seed = 0x1234;
+	for (int i = 0; i < numBlocks; i++) {
+		const u32 r = NextRandom(seed);
+		ranges[i].start = 0x08804000 + i * 0x1000 + ((r >> 8) & 0xFFC);
+		ranges[i].size = (i % 16) == 15 ? 0x1800 : 4 * (2 + ((r >> 4) & 0x3F));
+		ranges[i].exitTarget = (r >> 20) % numBlocks;
+		ranges[i].alive = true;
+	}
+	// Exits into blocks compiled later are linked by LinkBlock, the rest by LinkBlockExits.
+	for (int i = 0; i < numBlocks; i++)
+		ranges[i].blockNum = AddTestBlock(cache, ranges, i);
+	EXPECT_TRUE(CheckTestBlocks(cache, ranges));
+
+	std::vector<std::pair<u32, u32> > trace(numInvalidations);
+	for (int i = 0; i < numInvalidations; i++) {
+		u32 len = (i % 1000) == 999 ? 0x100000 : ((i % 10) == 9 ? 0x2000 : 8);
+		trace[i] = std::make_pair(0x08804000 + ((NextRandom(seed) >> 8) & 0x7FFFFC), len);
+	}
+
+	double start = real_time_now();
+	for (int i = 0; i < numInvalidations; i++)
+		cache->InvalidateICache(trace[i].first, trace[i].second);
+	double elapsed = real_time_now() - start;
+
+	// Brute force replay of the same trace must kill the same set of blocks.
+	int found = 0;
+	for (int i = 0; i < numInvalidations; i++) {
+		const u32 addr = trace[i].first, end = trace[i].first + trace[i].second;
+		for (int j = 0; j < numBlocks; j++) {
+			if (ranges[j].alive && ranges[j].start < end && ranges[j].start + ranges[j].size > addr) {
+				ranges[j].alive = false;
+				found++;
+			}
+		}
+	}
+	if (benchmark)
+		printf("JitPageIndex: %d invalidations, %d blocks hit, %0.0f lookups/s\n", numInvalidations, found, numInvalidations / elapsed);
+	EXPECT_TRUE(found > 0 && found < numBlocks);
+	EXPECT_TRUE(CheckTestBlocks(cache, ranges));
+
+	for (int i = 0; i < numBlocks; i++) {
+		if (!ranges[i].alive) {
+			ranges[i].blockNum = AddTestBlock(cache, ranges, i);
+			ranges[i].alive = true;
+		}
+	}
+	EXPECT_TRUE(CheckTestBlocks(cache, ranges));
+
+	delete MIPSComp::jit;
+	MIPSComp::jit = 0;
+	Memory::Shutdown();
+	return true;
+}
+
+static s64 lastEventTime;
+static int eventsFired;
+static bool eventsInOrder;
+
+static void TestTimingCallback(u64 userdata, int cyclesLate) {
+	const s64 now = (s64)CoreTiming::GetTicks() - cyclesLate;
+	if (now < lastEventTime)
+		eventsInOrder = false;
+	lastEventTime = now;
+	eventsFired++;
+}
+
+// Schedules and cancels 10k events the way alarms and vtimers do, then lets the rest fire.
+bool TestCoreTiming() {
+	const int numEvents = 10000;
+
+	currentMIPS = &mipsr4k;
+	CoreTiming::Init();
+	int eventType = CoreTiming::RegisterEvent("TestEvent", &TestTimingCallback);
+
+	u32 seed = 0x5678;
+	double start = real_time_now();
+	for (int i = 0; i < numEvents; i++) {
+		CoreTiming::ScheduleEvent(1000 + ((NextRandom(seed) >> 8) & 0xFFFFF), eventType, i);
+	}
+	double scheduled = real_time_now();
+	s64 cancelledTotal = 0;
+	for (int i = 0; i < numEvents; i += 2) {
+		cancelledTotal += CoreTiming::UnscheduleEvent(eventType, i);
+	}
+	double cancelled = real_time_now();
+	if (benchmark)
+		printf("CoreTiming: scheduled %d events in %0.3f ms, cancelled %d in %0.3f ms\n", numEvents, (scheduled - start) * 1000.0, numEvents / 2, (cancelled - scheduled) * 1000.0);
+	EXPECT_TRUE(cancelledTotal > 0);
+
+	lastEventTime = 0;
+	eventsFired = 0;
+	eventsInOrder = true;
+	while (CoreTiming::IsScheduled(eventType)) {
+		currentMIPS->downcount = -1;
+		CoreTiming::Advance();
+	}
+	EXPECT_TRUE(eventsFired == numEvents / 2);
+	EXPECT_TRUE(eventsInOrder);
+
+	CoreTiming::Shutdown();
+	return true;
+}
+
+extern FormatBuffer fb;
+extern FormatBuffer depthbuf;
+extern u32 clut[4096];
+
+// Where TestSoftwareRasterizer puts its random 256x256 texture.
+static const u32 RASTERIZER_TEXTURE_ADDR = 0x08900000;
+
+static const char *rasterizerStateNames[] = {
+	"gouraud",
+	"flat doubled 565",
+	"8888 modulate",
+	"4444 decal depth",
+	"5551 blend clamped",
+	"565 replace tests",
+	"add depth range 4444",
+	"clut8 swizzled",
+	"clear",
+	"stencil",
+};
+
+// Sets up one of the states in rasterizerStateNames. Between them they cover every path
+// through DrawQuad, and the per pixel fallback for what it doesn't handle.
+static void SetRasterizerState(int state) {
+	memset(&gstate, 0, sizeof(gstate));
+	gstate.fbwidth = 512;
+	gstate.zbwidth = 512;
+	gstate.framebufpixformat = GE_FORMAT_8888;
+	gstate.scissor2 = (271 << 10) | 479;
+	gstate.shademodel = GE_SHADE_GOURAUD;
+	gstate.vertType = GE_VTYPE_THROUGH;
+	gstate.maxz = 0xFFFF;
+	// Everything but the alpha channel is written.
+	gstate.pmska = 0xFF;
+	gstate.texaddr[0] = RASTERIZER_TEXTURE_ADDR & 0xFFFFF0;
+	gstate.texbufwidth[0] = ((RASTERIZER_TEXTURE_ADDR & 0x0F000000) >> 8) | 256;
+	gstate.texsize[0] = (8 << 8) | 8;
+	gstate.texscaleu = toFloat24(1.0f);
+	gstate.texscalev = toFloat24(1.0f);
+	gstate.texenvcolor = 0x4080C0;
+
+	switch (state) {
+	case 1:
+		gstate.shademodel = GE_SHADE_FLAT;
+		gstate.framebufpixformat = GE_FORMAT_565;
+		gstate.texfunc = 0x10000;
+		break;
+	case 2:
+		gstate.textureMapEnable = 1;
+		gstate.texformat = GE_TFMT_8888;
+		gstate.texfunc = GE_TEXFUNC_MODULATE | 0x100;
+		break;
+	case 3:
+		gstate.vertType = 0;
+		gstate.textureMapEnable = 1;
+		gstate.texformat = GE_TFMT_4444;
+		gstate.texfunc = GE_TEXFUNC_DECAL | 0x100;
+		gstate.texoffsetu = toFloat24(0.25f);
+		gstate.zTestEnable = 1;
+		gstate.ztestfunc = GE_COMP_GEQUAL;
+		break;
+	case 4:
+		gstate.vertType = 0;
+		gstate.textureMapEnable = 1;
+		gstate.texformat = GE_TFMT_5551;
+		gstate.texwrap = 0x101;
+		gstate.texfunc = GE_TEXFUNC_BLEND | 0x100;
+		gstate.alphaBlendEnable = 1;
+		gstate.blend = (GE_BLENDMODE_MUL_AND_ADD << 8) | (GE_DSTBLEND_INVSRCALPHA << 4) | GE_SRCBLEND_SRCALPHA;
+		gstate.framebufpixformat = GE_FORMAT_5551;
+		break;
+	case 5:
+		gstate.textureMapEnable = 1;
+		gstate.texformat = GE_TFMT_5650;
+		gstate.texfunc = GE_TEXFUNC_REPLACE;
+		gstate.alphaTestEnable = 1;
+		gstate.alphatest = (0xF0 << 16) | (0x80 << 8) | GE_COMP_LESS;
+		gstate.colorTestEnable = 1;
+		gstate.colortest = GE_COMP_NOTEQUAL;
+		gstate.colorref = 0x000080;
+		gstate.colormask = 0x0000C0;
+		gstate.alphaBlendEnable = 1;
+		gstate.blend = (GE_BLENDMODE_MUL_AND_SUBTRACT_REVERSE << 8) | (GE_DSTBLEND_DOUBLEINVSRCALPHA << 4) | GE_SRCBLEND_FIXA;
+		gstate.blendfixa = 0x20A0F0;
+		gstate.pmskc = 0x00FF00;
+		break;
+	case 6:
+		gstate.vertType = 0;
+		gstate.textureMapEnable = 1;
+		gstate.texformat = GE_TFMT_4444;
+		gstate.texwrap = 0x100;
+		gstate.texfunc = GE_TEXFUNC_ADD | 0x100 | 0x10000;
+		gstate.minz = 0x2000;
+		gstate.maxz = 0xD000;
+		gstate.zTestEnable = 1;
+		gstate.ztestfunc = GE_COMP_LESS;
+		gstate.alphaBlendEnable = 1;
+		gstate.blend = (GE_BLENDMODE_ABSDIFF << 8) | (GE_DSTBLEND_FIXB << 4) | GE_SRCBLEND_DSTCOLOR;
+		gstate.framebufpixformat = GE_FORMAT_4444;
+		break;
+	case 7:
+		gstate.textureMapEnable = 1;
+		gstate.texformat = GE_TFMT_CLUT8;
+		gstate.texmode = 1;
+		gstate.clutformat = 0xC500FF00 | GE_CMODE_32BIT_ABGR8888;
+		gstate.texfunc = GE_TEXFUNC_MODULATE;
+		gstate.zTestEnable = 1;
+		gstate.ztestfunc = GE_COMP_GREATER;
+		gstate.zmsk = 1;
+		gstate.alphaBlendEnable = 1;
+		gstate.blend = (GE_BLENDMODE_MAX << 8) | (GE_DSTBLEND_DSTALPHA << 4) | GE_SRCBLEND_INVDSTCOLOR;
+		break;
+	case 8:
+		gstate.vertType = 0;
+		gstate.clearmode = 1 | 0x100 | 0x400;
+		gstate.textureMapEnable = 1;
+		gstate.zTestEnable = 1;
+		gstate.ztestfunc = GE_COMP_NEVER;
+		break;
+	case 9:
+		gstate.stencilTestEnable = 1;
+		gstate.stenciltest = (0xFF << 16) | (0x40 << 8) | GE_COMP_LESS;
+		gstate.stencilop = (GE_STENCILOP_INCR << 16) | (GE_STENCILOP_ZERO << 8) | GE_STENCILOP_INVERT;
+		gstate.zTestEnable = 1;
+		gstate.ztestfunc = GE_COMP_LEQUAL;
+		break;
+	}
+}
+
+// Draws random triangles over random color and depth buffers, flushing the bins every batchSize
+// triangles. Returns the time taken, and the number of pixels covered in pixels.
+static double DrawRasterizerScene(u32 *target, u16 *depth, int numTriangles, int batchSize, double &pixels) {
+	u32 bufferSeed = 0x4321;
+	FillRandom((u8 *)target, 512 * 272 * 4, bufferSeed);
+	FillRandom((u8 *)depth, 512 * 272 * 2, bufferSeed);
+	fb.as32 = target;
+	depthbuf.as16 = depth;
+
+	const bool through = gstate.isModeThrough();
+	u32 seed = 0x1234;
+	pixels = 0.0;
+	double start = real_time_now();
+	for (int i = 0; i < numTriangles; i++) {
+		VertexData v[3];
+		memset(v, 0, sizeof(v));
+		for (int j = 0; j < 3; j++) {
+			const u32 r = NextRandom(seed);
+			const u32 color = NextRandom(seed);
+			const u32 attr = NextRandom(seed);
+			const u32 tex = NextRandom(seed);
+			v[j].screenpos = ScreenCoords((fixed16)(((r >> 4) % 480) * 16 + (r & 15)), (fixed16)(((r >> 16) % 272) * 16), (u16)attr);
+			v[j].color0 = Vec4<int>(color & 0xFF, (color >> 8) & 0xFF, (color >> 16) & 0xFF, color >> 24);
+			v[j].color1 = Vec3<int>((attr >> 16) & 0x3F, (attr >> 22) & 0x3F, attr >> 26);
+			v[j].clippos.w = 0.5f + (tex >> 24) / 128.0f;
+			// Texels in through mode, from 0 to 2 times the texture size otherwise.
+			if (through)
+				v[j].texturecoords = Vec2<float>((float)(tex & 0x1FF), (float)((tex >> 9) & 0x1FF));
+			else
+				v[j].texturecoords = Vec2<float>((tex & 0xFFF) / 1024.0f - 1.0f, ((tex >> 12) & 0xFFF) / 1024.0f - 1.0f);
+		}
+		// The rasterizer only draws counter-clockwise triangles.
+		const int cross = ((int)v[0].screenpos.x - (int)v[1].screenpos.x) * ((int)v[0].screenpos.y - (int)v[2].screenpos.y) - ((int)v[0].screenpos.y - (int)v[1].screenpos.y) * ((int)v[0].screenpos.x - (int)v[2].screenpos.x);
+		if (cross < 0)
+			std::swap(v[1], v[2]);
+		// Screen coords have 4 bits of subpixel precision.
+		pixels += abs(cross) / 2.0 / 256.0;
+		Rasterizer::DrawTriangle(v[0], v[1], v[2]);
+		if ((i % batchSize) == batchSize - 1)
+			Rasterizer::Flush();
+	}
+	Rasterizer::Flush();
+	return real_time_now() - start;
+}
+
+// Draws a fixed scene of random triangles in a range of states with both the SIMD and scalar paths,
+// and checks the color and depth buffers match. Also checks that binning a batch of triangles draws
+// the same thing as drawing them one at a time.
+bool TestSoftwareRasterizer() {
+	const int numTriangles = 2048;
+	// About the size of a real draw call.
+	const int batchSize = 256;
+
+	g_Config.iNumWorkerThreads = 4;
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	u32 seed = 0x5678;
+	// Twice the texture, since clamped coordinates can reach one past the last texel.
+	FillRandom(Memory::GetPointer(RASTERIZER_TEXTURE_ADDR), 256 * 256 * 4 * 2, seed);
+	FillRandom((u8 *)clut, sizeof(clut), seed);
+
+	std::vector<u32> simd(512 * 272), scalar(512 * 272), unbatched(512 * 272);
+	std::vector<u16> simdDepth(512 * 272), scalarDepth(512 * 272), unbatchedDepth(512 * 272);
+
+	bool success = true;
+	for (int state = 0; state < (int)ARRAY_SIZE(rasterizerStateNames); state++) {
+		SetRasterizerState(state);
+
+		double pixels;
+		Rasterizer::SetScalarReference(true);
+		double scalarTime = DrawRasterizerScene(&scalar[0], &scalarDepth[0], numTriangles, batchSize, pixels);
+		Rasterizer::SetScalarReference(false);
+		double simdTime = DrawRasterizerScene(&simd[0], &simdDepth[0], numTriangles, batchSize, pixels);
+		DrawRasterizerScene(&unbatched[0], &unbatchedDepth[0], numTriangles, 1, pixels);
+
+		if (benchmark)
+			printf("Software rasterizer %s: scalar %0.1f, SIMD %0.1f Mpixels/s\n", rasterizerStateNames[state], pixels / scalarTime / 1000000.0, pixels / simdTime / 1000000.0);
+		if (!ArraysMatch(rasterizerStateNames[state], &simd[0], &scalar[0], simd.size()) || !ArraysMatch(rasterizerStateNames[state], &simdDepth[0], &scalarDepth[0], simdDepth.size()))
+			success = false;
+		if (!ArraysMatch("Software rasterizer batched", &simd[0], &unbatched[0], simd.size()) || !ArraysMatch("Software rasterizer batched", &simdDepth[0], &unbatchedDepth[0], simdDepth.size()))
+			success = false;
+	}
+
+	Memory::Shutdown();
+	return success;
+}
+
+// The GPU only asks the host whether its debugger is active.
+class GERecordTestHost : public Host {
+public:
+	virtual bool InitGL(std::string *error_string) { return true; }
+	virtual void ShutdownGL() {}
+	virtual void InitSound(PMixer *mixer) {}
+	virtual void ShutdownSound() {}
+};
+
+// Records a frame that draws a triangle, then replays it on the null GPU after clobbering the
+// vertices and registers, and checks the replay put them back.
+bool TestGERecord() {
+	const u32 listAddr = 0x08810000;
+	const u32 vertAddr = 0x08820000;
+	const float verts[] = { 0.0f, 0.0f, 0.0f, 480.0f, 0.0f, 0.0f, 0.0f, 272.0f, 0.0f };
+	const u32 list[] = {
+		(GE_CMD_BASE << 24) | ((vertAddr >> 8) & 0x000F0000),
+		(GE_CMD_VADDR << 24) | (vertAddr & 0x00FFFFFF),
+		(GE_CMD_VERTEXTYPE << 24) | GE_VTYPE_POS_FLOAT,
+		(GE_CMD_AMBIENTCOLOR << 24) | 0x123456,
+		(GE_CMD_PRIM << 24) | (GE_PRIM_TRIANGLES << 16) | 3,
+		GE_CMD_FINISH << 24,
+		GE_CMD_END << 24,
+	};
+
+	// The same setup as the headless replay.
+	GERecordTestHost testHost;
+	host = &testHost;
+	g_Config.bSeparateCPUThread = false;
+	PSP_CoreParameter().gpuCore = GPU_NULL;
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	currentMIPS = &mipsr4k;
+	CoreTiming::Init();
+	coreState = CORE_RUNNING;
+	memset(gstate.cmdmem, 0, sizeof(gstate.cmdmem));
+	gstate_c.vertexAddr = 0;
+	bool success = GPU_Init();
+
+	memcpy(Memory::GetPointer(vertAddr), verts, sizeof(verts));
+	for (size_t i = 0; i < ARRAY_SIZE(list); i++)
+		Memory::Write_U32(list[i], listAddr + i * 4);
+
+	// Report the list the way the run loop would, with cmdmem already updated.
+	GPURecord::Activate(1);
+	GPURecord::NotifyFrame();
+	success = success && GPURecord::IsActive();
+	for (size_t i = 0; i < ARRAY_SIZE(list); i++) {
+		gstate.cmdmem[list[i] >> 24] = list[i];
+		if ((list[i] >> 24) == GE_CMD_VADDR)
+			gstate_c.vertexAddr = gstate_c.getRelativeAddress(list[i] & 0x00FFFFFF);
+		GPURecord::NotifyCommand(listAddr + (u32)i * 4, list[i]);
+	}
+	GPURecord::NotifyFrame();
+	const std::string filename = GPURecord::GetLastDumpFilename();
+	success = success && !GPURecord::IsActive() && !filename.empty();
+
+	memset(Memory::GetPointer(vertAddr), 0, sizeof(verts));
+	memset(gstate.cmdmem, 0, sizeof(gstate.cmdmem));
+	gstate_c.vertexAddr = 0;
+
+	GPURecord::Replayer replayer;
+	std::string error;
+	success = success && replayer.Load(filename, &error) && replayer.GetNumFrames() == 1;
+	if (success) {
+		replayer.RunFrame(0);
+		success = memcmp(Memory::GetPointer(vertAddr), verts, sizeof(verts)) == 0;
+		success = success && gstate_c.vertexAddr == vertAddr && (gstate.cmdmem[GE_CMD_AMBIENTCOLOR] & 0x00FFFFFF) == 0x123456;
+	} else if (!error.empty()) {
+		printf("GE record: %s\n", error.c_str());
+	}
+
+	if (!filename.empty())
+		File::Delete(filename);
+	GPU_Shutdown();
+	CoreTiming::Shutdown();
+	Memory::Shutdown();
+	coreState = CORE_POWERDOWN;
+	host = NULL;
+
+	EXPECT_TRUE(success);
+	return true;
+}
+
+class MemoryBlockDevice : public BlockDevice {
+public:
+	MemoryBlockDevice(const std::vector<u8> &image) : image_(image) {}
+	bool ReadBlock(int blockNumber, u8 *outPtr) {
+		memcpy(outPtr, &image_[blockNumber * 2048], 2048);
+		return true;
+	}
+	u32 GetNumBlocks() { return (u32)(image_.size() / 2048); }
+
+private:
+	std::vector<u8> image_;
+};
+
+// Appends an ISO 9660 directory record at sector/offset, moving to the next sector when it doesn't fit.
+static void AddIsoRecord(std::vector<u8> &image, u32 &sector, int &offset, const char *name, u32 extent, u32 size, bool dir) {
+	const int nameLen = name[0] == 0 || name[0] == 1 ? 1 : (int)strlen(name);
+	const int recordSize = (33 + nameLen + 1) & ~1;
+	if (offset + recordSize > 2048) {
+		sector++;
+		offset = 0;
+	}
+	u8 *r = &image[sector * 2048 + offset];
+	r[0] = recordSize;
+	memcpy(r + 2, &extent, 4);
+	memcpy(r + 10, &size, 4);
+	r[25] = dir ? 2 : 0;
+	r[32] = nameLen;
+	memcpy(r + 33, name, nameLen);
+	offset += recordSize;
+}
+
+// Read-ahead has to pick up again after seeking back to an earlier file.
+bool TestCSOReadAhead() {
+	const u32 numBlocks = 1024;
+	const u32 dataStart = 0x18 + (numBlocks + 1) * 4;
+	FILE *f = tmpfile();
+	EXPECT_TRUE(f != NULL);
+
+	// A header, the index, then each block stored uncompressed and filled with its number.
+	u8 header[0x18] = { 'C', 'I', 'S', 'O' };
+	*(u32_le *)&header[0x04] = 0x18;
+	*(u64_le *)&header[0x08] = (u64)numBlocks * 2048;
+	*(u32_le *)&header[0x10] = 2048;
+	header[0x14] = 1;
+	fwrite(header, 1, sizeof(header), f);
+	for (u32 i = 0; i <= numBlocks; ++i) {
+		u32_le entry = 0x80000000 | (dataStart + i * 2048);
+		fwrite(&entry, 4, 1, f);
+	}
+	std::vector<u8> block(2048);
+	for (u32 i = 0; i < numBlocks; ++i) {
+		memset(&block[0], (u8)i, block.size());
+		fwrite(&block[0], 1, block.size(), f);
+	}
+
+	rewind(f);
+	CISOFileBlockDevice device(f);
+	for (u32 i = 600; i < 700; ++i) {
+		EXPECT_TRUE(device.ReadBlock(i, &block[0]) && block[0] == (u8)i && block[2047] == (u8)i);
+	}
+	CISOFileBlockDevice::Stats stats;
+	device.WaitForReadAhead();
+	device.GetStats(&stats);
+	const u64 firstRun = stats.readAheadBlocks;
+	EXPECT_TRUE(firstRun != 0);
+
+	for (u32 i = 0; i < 100; ++i) {
+		EXPECT_TRUE(device.ReadBlock(i, &block[0]) && block[0] == (u8)i && block[2047] == (u8)i);
+	}
+	device.WaitForReadAhead();
+	device.GetStats(&stats);
+	EXPECT_TRUE(stats.readAheadBlocks > firstRun);
+	// Blocks 100 and up should now be waiting in the cache.
+	const u64 hits = stats.cacheHits;
+	std::vector<u8> blocks(8 * 2048);
+	EXPECT_TRUE(device.ReadBlocks(100, 8, &blocks[0]) && blocks[0] == 100 && blocks[7 * 2048] == 107);
+	device.GetStats(&stats);
+	EXPECT_TRUE(stats.cacheHits == hits + 8);
+	return true;
+}
+
+// Resolves paths in a synthetic ISO of 50 directories with 1000 files each.
+bool TestISOFileSystem() {
+	const int numDirs = 50;
+	const int filesPerDir = 1000;
+	const u32 rootSector = 18;
+	const u32 dirSectors = 24;
+
+	std::vector<u8> image((rootSector + 1 + numDirs * dirSectors) * 2048);
+	memcpy(&image[16 * 2048 + 1], "CD001", 5);
+	u32 sector = 16;
+	int offset = 156;
+	AddIsoRecord(image, sector, offset, "", rootSector, 2048, true);
+
+	char name[32];
+	sector = rootSector;
+	offset = 0;
+	AddIsoRecord(image, sector, offset, "", rootSector, 2048, true);
+	AddIsoRecord(image, sector, offset, "\x01", rootSector, 2048, true);
+	for (int i = 0; i < numDirs; i++) {
+		sprintf(name, "DIR%02d", i);
+		AddIsoRecord(image, sector, offset, name, rootSector + 1 + i * dirSectors, dirSectors * 2048, true);
+	}
+	for (int i = 0; i < numDirs; i++) {
+		const u32 dirSector = rootSector + 1 + i * dirSectors;
+		sector = dirSector;
+		offset = 0;
+		AddIsoRecord(image, sector, offset, "", dirSector, dirSectors * 2048, true);
+		AddIsoRecord(image, sector, offset, "\x01", rootSector, 2048, true);
+		for (int j = 0; j < filesPerDir; j++) {
+			sprintf(name, "FILE%04d.BIN", j);
+			AddIsoRecord(image, sector, offset, name, 100000 + i * filesPerDir + j, 2048, false);
+		}
+	}
+
+	SequentialHandleAllocator handles;
+	double start = real_time_now();
+	ISOFileSystem iso(&handles, new MemoryBlockDevice(image));
+	double built = real_time_now();
+
+	const int numLookups = 100000;
+	u32 seed = 0x9abc;
+	int found = 0;
+	for (int i = 0; i < numLookups; i++) {
+		const u32 r = NextRandom(seed);
+		const int dir = (r >> 8) % numDirs;
+		const int file = (r >> 16) % filesPerDir;
+		sprintf(name, (i & 1) ? "/dir%02d/file%04d.bin" : "/DIR%02d//FILE%04d.BIN", dir, file);
+		PSPFileInfo info = iso.GetFileInfo(name);
+		if (info.exists && info.startSector == (u32)(100000 + dir * filesPerDir + file))
+			found++;
+	}
+	double looked = real_time_now();
+	if (benchmark)
+		printf("ISOFileSystem: indexed %d entries in %0.3f ms, %d lookups in %0.3f ms\n", numDirs * (filesPerDir + 2), (built - start) * 1000.0, numLookups, (looked - built) * 1000.0);
+	EXPECT_TRUE(found == numLookups);
+
+	EXPECT_TRUE(iso.GetFileInfo("/DIR07").type == FILETYPE_DIRECTORY);
+	EXPECT_TRUE(iso.GetFileInfo("dir07/").exists);
+	EXPECT_TRUE(!iso.GetFileInfo("/DIR07/FILE1000.BIN").exists);
+	EXPECT_TRUE(!iso.GetFileInfo("/DIR07/FILE0001.BIN/X").exists);
+	EXPECT_TRUE(!iso.GetFileInfo("/FILE0001.BIN").exists);
+	EXPECT_TRUE(iso.GetDirListing("/DIR49").size() == filesPerDir);
+	return true;
+}
+
+// Decodes a long stream of skinned vertices on one thread and on the worker threads, with
+// both the step interpreter and the jit.
+bool TestParallelVertexDecode() {
+	const int numVerts = 65536;
+	const u32 vtype = GE_VTYPE_WEIGHT_8BIT | (3 << GE_VTYPE_WEIGHTCOUNT_SHIFT) | GE_VTYPE_TC_16BIT | GE_VTYPE_COL_8888 | GE_VTYPE_NRM_8BIT | GE_VTYPE_POS_16BIT;
+
+	g_Config.bSoftwareSkinning = true;
+	g_Config.bVertexDecoderJit = true;
+	g_Config.iNumWorkerThreads = 4;
+	memset(&gstate, 0, sizeof(gstate));
+	for (int i = 0; i < 8 * 12; i++)
+		gstate.boneMatrix[i] = (float)((i * 7) % 13) / 13.0f;
+	gstate_c.uv.uScale = 1.0f;
+	gstate_c.uv.vScale = 1.0f;
+
+	VertexDecoderJitCache jitCache;
+	std::vector<u8> verts, serial, parallel;
+	u32 seed = 0x4321;
+	for (int useJit = 0; useJit < 2; useJit++) {
+		VertexDecoder dec;
+		dec.SetVertexType(vtype, useJit ? &jitCache : 0);
+		EXPECT_TRUE(dec.CanDecodeInParallel());
+
+		verts.resize(numVerts * dec.VertexSize());
+		FillRandom(&verts[0], verts.size(), seed);
+
+		const int stride = dec.GetDecVtxFmt().stride;
+		// Warm up, so the worker threads are already running when timed.
+		parallel.resize(numVerts * stride);
+		dec.DecodeVertsParallel(&parallel[0], &verts[0], 0, numVerts - 1);
+		serial.assign(numVerts * stride, 0);
+		parallel.assign(numVerts * stride, 0);
+		double start = real_time_now();
+		dec.DecodeVerts(&serial[0], &verts[0], 0, numVerts - 1);
+		double serialTime = real_time_now() - start;
+		start = real_time_now();
+		dec.DecodeVertsParallel(&parallel[0], &verts[0], 0, numVerts - 1);
+		double parallelTime = real_time_now() - start;
+
+		if (benchmark)
+			printf("Vertex decode (skinned, %s): serial %0.1f Mverts/s, parallel %0.1f Mverts/s\n", useJit ? "jit" : "step", numVerts / serialTime / 1000000.0, numVerts / parallelTime / 1000000.0);
+		EXPECT_TRUE(ArraysMatch("Parallel vertex decode", &parallel[0], &serial[0], serial.size()));
+	}
+	return true;
+}
+
+static void FillVertexFloats(std::vector<u8> &verts, const VertexDecoder &dec, int numVerts, u32 &seed) {
+	// Random bytes make poor floats (NaNs, denormals), so float fields get values in [-2, 2).
+	for (int v = 0; v < numVerts; v++) {
+		for (int m = 0; m < dec.morphcount; m++) {
+			u8 *base = &verts[v * dec.VertexSize() + m * dec.onesize_];
+			int offsets[4] = { dec.weightoff, dec.tcoff, dec.nrmoff, dec.posoff };
+			int counts[4] = { dec.weighttype == 3 ? dec.nweights : 0, dec.tc == 3 ? 2 : 0, dec.nrm == 3 ? 3 : 0, dec.pos == 3 ? 3 : 0 };
+			for (int f = 0; f < 4; f++) {
+				for (int i = 0; i < counts[f]; i++) {
+					float value = (float)((NextRandom(seed) >> 8) & 0xFFFF) / 16384.0f - 2.0f;
+					memcpy(base + offsets[f] + i * 4, &value, 4);
+				}
+			}
+		}
+	}
+}
+
+// Float fields only need to compare equal, since skipping a zero weight leaves +0 where the jit has -0.
+static bool DecodedVertsMatch(const DecVtxFormat &fmt, const u8 *a, const u8 *b, int numVerts) {
+	const u8 fields[][2] = {
+		{ fmt.w0fmt, fmt.w0off }, { fmt.w1fmt, fmt.w1off }, { fmt.uvfmt, fmt.uvoff }, { fmt.c0fmt, fmt.c0off },
+		{ fmt.c1fmt, fmt.c1off }, { fmt.nrmfmt, fmt.nrmoff }, { fmt.posfmt, fmt.posoff },
+	};
+	for (int v = 0; v < numVerts; v++, a += fmt.stride, b += fmt.stride) {
+		for (size_t f = 0; f < ARRAY_SIZE(fields); f++) {
+			const u8 type = fields[f][0], off = fields[f][1];
+			if (type >= DEC_FLOAT_1 && type <= DEC_FLOAT_4) {
+				for (int i = 0; i < type - DEC_FLOAT_1 + 1; i++) {
+					float fa, fb;
+					memcpy(&fa, a + off + i * 4, 4);
+					memcpy(&fb, b + off + i * 4, 4);
+					if (fa != fb)
+						return false;
+				}
+			} else if (type != DEC_NONE && memcmp(a + off, b + off, DecFmtSize(type)) != 0) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Decodes synthetic vertices of many formats with both the step interpreter and the jit.
+// The output must match. In benchmark mode, prints the speed of each mode, and with verbose,
+// of each format.
+bool TestVertexDecoderJit(bool verbose) {
+	const int numVerts = 1024;
+	const int reps = 8;
+
+	struct Mode {
+		const char *name;
+		u32 flags;
+		bool skinning;
+		bool prescale;
+	};
+	static const Mode modes[] = {
+		{ "plain", 0, false, false },
+		{ "prescale", 0, false, true },
+		{ "through", GE_VTYPE_THROUGH, false, false },
+		{ "weights", GE_VTYPE_WEIGHT_8BIT | (2 << GE_VTYPE_WEIGHTCOUNT_SHIFT), false, false },
+		{ "skin u8x1", GE_VTYPE_WEIGHT_8BIT | (0 << GE_VTYPE_WEIGHTCOUNT_SHIFT), true, false },
+		{ "skin u16x4", GE_VTYPE_WEIGHT_16BIT | (3 << GE_VTYPE_WEIGHTCOUNT_SHIFT), true, false },
+		{ "skin floatx8", GE_VTYPE_WEIGHT_FLOAT | (7 << GE_VTYPE_WEIGHTCOUNT_SHIFT), true, false },
+		{ "morph x2", 1 << GE_VTYPE_MORPHCOUNT_SHIFT, false, false },
+	};
+	static const u32 colors[] = { GE_VTYPE_COL_NONE, GE_VTYPE_COL_565, GE_VTYPE_COL_5551, GE_VTYPE_COL_4444, GE_VTYPE_COL_8888 };
+
+	const bool oldSkinning = g_Config.bSoftwareSkinning;
+	const bool oldPrescale = g_Config.bPrescaleUV;
+	const bool oldJit = g_Config.bVertexDecoderJit;
+	g_Config.bVertexDecoderJit = true;
+
+	memset(&gstate, 0, sizeof(gstate));
+	for (int i = 0; i < 8 * 12; i++)
+		gstate.boneMatrix[i] = (float)((i * 7) % 13) / 13.0f - 0.5f;
+	gstate_c.uv.uScale = 0.5f;
+	gstate_c.uv.vScale = 2.0f;
+	gstate_c.uv.uOff = 0.25f;
+	gstate_c.uv.vOff = -0.125f;
+	gstate_c.morphWeights[0] = 0.75f;
+	gstate_c.morphWeights[1] = 0.25f;
+
+	VertexDecoderJitCache *jitCache = new VertexDecoderJitCache();
+	std::vector<u8> verts, interpOut, jitOut;
+	u32 seed = 0x1234;
+	int formats = 0, jitted = 0, mismatches = 0;
+
+	for (size_t m = 0; m < ARRAY_SIZE(modes); m++) {
+		g_Config.bSoftwareSkinning = modes[m].skinning;
+		g_Config.bPrescaleUV = modes[m].prescale;
+		double interpTotal = 0.0, jitTotal = 0.0;
+		int modeFormats = 0;
+
+		for (u32 tc = 0; tc < 4; tc++)
+		for (size_t c = 0; c < ARRAY_SIZE(colors); c++)
+		for (u32 nrm = 0; nrm < 4; nrm++)
+		for (u32 pos = 1; pos < 4; pos++) {
+			const u32 vtype = modes[m].flags | (tc << GE_VTYPE_TC_SHIFT) | colors[c] | (nrm << GE_VTYPE_NRM_SHIFT) | (pos << GE_VTYPE_POS_SHIFT);
+
+			// Clear the jit every so often rather than letting it fill up.
+			if (jitCache->GetSpaceLeft() < 16384)
+				jitCache->ClearCodeSpace();
+
+			VertexDecoder interp, jit;
+			interp.SetVertexType(vtype);
+			jit.SetVertexType(vtype, jitCache);
+			formats++;
+			modeFormats++;
+
+			verts.resize(numVerts * interp.VertexSize());
+			FillRandom(&verts[0], verts.size(), seed);
+			FillVertexFloats(verts, interp, numVerts, seed);
+
+			const int stride = interp.GetDecVtxFmt().stride;
+			interpOut.assign(numVerts * stride, 0);
+			jitOut.assign(numVerts * stride, 0);
+
+			double start = real_time_now();
+			for (int r = 0; r < reps; r++)
+				interp.DecodeVerts(&interpOut[0], &verts[0], 0, numVerts - 1);
+			const double interpTime = real_time_now() - start;
+			start = real_time_now();
+			for (int r = 0; r < reps; r++)
+				jit.DecodeVerts(&jitOut[0], &verts[0], 0, numVerts - 1);
+			const double jitTime = real_time_now() - start;
+			interpTotal += interpTime;
+			jitTotal += jitTime;
+
+			// Without a compiled decoder, the "jit" decoder just ran the steps again.
+			const bool isJitted = jit.jitted_ != 0;
+			if (isJitted)
+				jitted++;
+			if (!DecodedVertsMatch(interp.GetDecVtxFmt(), &interpOut[0], &jitOut[0], numVerts)) {
+				printf("%s: vtype %08x (%s): jit output differs\n", __FUNCTION__, vtype, modes[m].name);
+				mismatches++;
+			}
+
+			if (verbose) {
+				printf("  %-12s %08x T:%i C:%i N:%i P:%i size %2i  interp %6.1f  jit %6.1f Mverts/s%s\n",
+					modes[m].name, vtype, tc, colors[c] >> GE_VTYPE_COL_SHIFT, nrm, pos, interp.VertexSize(),
+					numVerts * reps / interpTime / 1000000.0, numVerts * reps / jitTime / 1000000.0, isJitted ? "" : " (not jitted)");
+			}
+		}
+
+		if (benchmark || verbose) {
+			printf("Vertex decoder %-12s %3i formats: interp %6.1f Mverts/s, jit %6.1f Mverts/s\n", modes[m].name, modeFormats,
+				modeFormats * numVerts * reps / interpTotal / 1000000.0, modeFormats * numVerts * reps / jitTotal / 1000000.0);
+		}
+	}
+
+	delete jitCache;
+	g_Config.bSoftwareSkinning = oldSkinning;
+	g_Config.bPrescaleUV = oldPrescale;
+	g_Config.bVertexDecoderJit = oldJit;
+
+	if (benchmark || verbose)
+		printf("Vertex decoder: %i formats, %i jitted, %i mismatches\n", formats, jitted, mismatches);
+	EXPECT_TRUE(mismatches == 0);
+	return true;
+}
+
+// Expected IndexGenerator output for a primitive over the (already offset) vertex indices v.
+static void ReferenceIndices(int prim, const std::vector<int> &v, std::vector<u16> &out) {
+	const int n = (int)v.size();
+	out.clear();
+	switch (prim) {
+	case GE_PRIM_POINTS:
+	case GE_PRIM_LINES:
+	case GE_PRIM_TRIANGLES:
+	case GE_PRIM_RECTANGLES:
+		for (int i = 0; i < n; i++)
+			out.push_back(v[i]);
+		break;
+	case GE_PRIM_LINE_STRIP:
+		for (int i = 0; i < n - 1; i++) {
+			out.push_back(v[i]);
+			out.push_back(v[i + 1]);
+		}
+		break;
+	case GE_PRIM_TRIANGLE_STRIP:
+		for (int i = 0; i < n - 2; i++) {
+			out.push_back(v[i]);
+			out.push_back(v[i + 1 + (i & 1)]);
+			out.push_back(v[i + 2 - (i & 1)]);
+		}
+		break;
+	case GE_PRIM_TRIANGLE_FAN:
+		for (int i = 0; i < n - 2; i++) {
+			out.push_back(v[0]);
+			out.push_back(v[i + 1]);
+			out.push_back(v[i + 2]);
+		}
+		break;
+	}
+}
+
+// Checks every primitive type and index width against ReferenceIndices, and times them in benchmark mode.
+bool TestIndexGenerator() {
+	static const char *primNames[] = { "points", "lines", "line strip", "triangles", "tri strip", "tri fan", "rectangles" };
+	static const int primGroups[] = { 1, 2, 1, 3, 1, 1, 2 };
+	const int maxVerts = 6000;
+	const int reps = 2000;
+
+	std::vector<u16> outBuf(3 * maxVerts + 64), expected;
+	std::vector<u8> inds8(maxVerts);
+	std::vector<u16> inds16(maxVerts);
+	std::vector<int> verts;
+	u32 seed = 0x5678;
+	for (int i = 0; i < maxVerts; i++) {
+		const u32 r = NextRandom(seed);
+		inds8[i] = (u8)(r >> 16);
+		inds16[i] = (u16)(r >> 12);
+	}
+
+	IndexGenerator gen;
+	gen.Setup(&outBuf[0]);
+	const int startIndex = 1000, indexOffset = 300;
+
+	for (int prim = GE_PRIM_POINTS; prim <= GE_PRIM_RECTANGLES; prim++) {
+		// Odd sizes cover the scalar tails. Lists only come in whole primitives.
+		for (int sizeIndex = 0; sizeIndex <= 41; sizeIndex++) {
+			const int size = sizeIndex <= 40 ? sizeIndex : maxVerts;
+			const int n = size / primGroups[prim] * primGroups[prim];
+			for (int mode = 0; mode < 3; mode++) {
+				gen.Reset();
+				gen.SetIndex(startIndex);
+				verts.resize(n);
+				if (mode == 0) {
+					gen.AddPrim(prim, n);
+					for (int i = 0; i < n; i++)
+						verts[i] = startIndex + i;
+				} else if (mode == 1) {
+					gen.TranslatePrim(prim, n, &inds8[0], indexOffset);
+					for (int i = 0; i < n; i++)
+						verts[i] = startIndex - indexOffset + inds8[i];
+				} else {
+					gen.TranslatePrim(prim, n, &inds16[0], indexOffset);
+					for (int i = 0; i < n; i++)
+						verts[i] = (u16)(startIndex - indexOffset + inds16[i]);
+				}
+				ReferenceIndices(prim, verts, expected);
+				if (!ArraysMatch(primNames[prim], &outBuf[0], &expected[0], expected.size())) {
+					printf("%s: mode %i, %i verts\n", __FUNCTION__, mode, n);
+					return false;
+				}
+			}
+		}
+
+		if (!benchmark)
+			continue;
+		double times[3];
+		const int n = maxVerts / primGroups[prim] * primGroups[prim];
+		for (int mode = 0; mode < 3; mode++) {
+			const double start = real_time_now();
+			for (int r = 0; r < reps; r++) {
+				gen.Reset();
+				if (mode == 0)
+					gen.AddPrim(prim, n);
+				else if (mode == 1)
+					gen.TranslatePrim(prim, n, &inds8[0], indexOffset);
+				else
+					gen.TranslatePrim(prim, n, &inds16[0], indexOffset);
+			}
+			times[mode] = real_time_now() - start;
+		}
+		printf("IndexGenerator %-10s: add %7.1f, u8 %7.1f, u16 %7.1f Mverts/s\n", primNames[prim],
+			n * reps / times[0] / 1000000.0, n * reps / times[1] / 1000000.0, n * reps / times[2] / 1000000.0);
+	}
+	return true;
+}
+
+// Checks what makes the sampled vertex cache check hash everything again: any change to a small
+// array, a change in one of the sampled chunks of a large one, or a write the game told us about.
+// Scheduled full hashes are skipped while none of that happens, but only a few times in a row.
+bool TestVertexCacheSampledHash() {
+	const int size = 4096;
+	const int smallSize = VERTEX_HASH_SAMPLE_SIZE * VERTEX_HASH_SAMPLE_COUNT;
+	// Between the first and second sampled chunks.
+	const int unsampled = VERTEX_HASH_SAMPLE_SIZE + 4;
+	std::vector<u8> data(size);
+	u32 seed = 0x2468;
+	FillRandom(&data[0], data.size(), seed);
+
+	const u32 smallHash = ComputeSampledHash(&data[0], smallSize, 0x1DE8CAC4);
+	const u32 largeHash = ComputeSampledHash(&data[0], size, 0x1DE8CAC4);
+	data[unsampled] ^= 1;
+	EXPECT_TRUE(ComputeSampledHash(&data[0], smallSize, 0x1DE8CAC4) != smallHash);
+	EXPECT_TRUE(ComputeSampledHash(&data[0], size, 0x1DE8CAC4) == largeHash);
+	data[unsampled] ^= 1;
+	data[0] ^= 1;
+	EXPECT_TRUE(ComputeSampledHash(&data[0], size, 0x1DE8CAC4) != largeHash);
+	data[0] ^= 1;
+	data[size - 1] ^= 1;
+	EXPECT_TRUE(ComputeSampledHash(&data[0], size, 0x1DE8CAC4) != largeHash);
+	data[size - 1] ^= 1;
+
+	// Writes count by page, through any mirror, and only after the generation they're checked against.
+	const u32 vertAddr = 0x08804100;
+	MemoryWriteTracker tracker;
+	const u32 generation = tracker.Generation();
+	tracker.NotifyWrite(0x48806000, 16);
+	EXPECT_FALSE(tracker.WrittenSince(vertAddr, size, generation));
+	tracker.NotifyWrite(0x48805FF0, 16);
+	EXPECT_TRUE(tracker.WrittenSince(vertAddr, size, generation));
+	EXPECT_FALSE(tracker.WrittenSince(vertAddr, size, tracker.Generation()));
+	// VRAM isn't tracked.
+	tracker.NotifyWrite(0x04000000, 0x1000);
+	EXPECT_FALSE(tracker.WrittenSince(0x04000000, 16, generation));
+
+	// Small arrays have a full hash scheduled on every draw.
+	VertexArrayInfo vai;
+	vai.numVerts = 50;
+	vai.numFrames = 1;
+	int skipped = 0;
+	while (skipped <= VertexArrayInfo::MAX_SKIPPED_FULL_HASHES && !vai.NeedsSampledFullHash(false, false))
+		skipped++;
+	EXPECT_TRUE(skipped == VertexArrayInfo::MAX_SKIPPED_FULL_HASHES);
+
+	// Between scheduled ones, only a write or a changed sample gets a full hash.
+	vai.fullHashesSkipped = 0;
+	vai.drawsUntilNextFullHash = 5;
+	EXPECT_FALSE(vai.NeedsSampledFullHash(false, false));
+	EXPECT_TRUE(vai.NeedsSampledFullHash(true, false));
+	EXPECT_TRUE(vai.NeedsSampledFullHash(false, true));
+	return true;
+}
+
+static const u32 RING_TEST_COUNT = 4000000;
+
+static void RingBufferProducer(LockFreeRingBuffer<u32, 4096> *ring) {
+	u32 next = 0;
+	u32 chunk[700];
+	while (next < RING_TEST_COUNT) {
+		// Odd chunk sizes, so the wrap lands everywhere.
+		const u32 want = std::min(RING_TEST_COUNT - next, 1 + (next * 7) % 700);
+		if (ring->room() == 0) {
+			std::this_thread::yield();
+		} else if ((next & 1) == 0) {
+			for (u32 i = 0; i < want; i++)
+				chunk[i] = next + i;
+			next += (u32)ring->Push(chunk, want);
+		} else {
+			u32 *dest1, *dest2;
+			size_t sz1, sz2;
+			const size_t n = ring->BeginPush(want, &dest1, &sz1, &dest2, &sz2);
+			for (size_t i = 0; i < sz1; i++)
+				dest1[i] = next + (u32)i;
+			for (size_t i = 0; i < sz2; i++)
+				dest2[i] = next + (u32)(sz1 + i);
+			ring->EndPush(n);
+			next += (u32)n;
+		}
+	}
+}
+
+// One thread pushes a counting sequence while this one pops it and checks nothing is lost,
+// repeated or torn.
+bool TestLockFreeRingBuffer() {
+	LockFreeRingBuffer<u32, 4096> ring;
+	std::thread producer(std::bind(&RingBufferProducer, &ring));
+
+	u32 expected = 0;
+	u32 chunk[500];
+	bool success = true;
+	while (expected < RING_TEST_COUNT) {
+		const size_t want = 1 + (expected * 13) % 500;
+		size_t n;
+		if (ring.size() == 0) {
+			std::this_thread::yield();
+			continue;
+		} else if ((expected & 2) == 0) {
+			n = ring.Pop(chunk, want);
+		} else {
+			const u32 *src1, *src2;
+			size_t sz1, sz2;
+			n = ring.BeginPop(want, &src1, &sz1, &src2, &sz2);
+			memcpy(chunk, src1, sz1 * sizeof(u32));
+			if (sz2 != 0)
+				memcpy(chunk + sz1, src2, sz2 * sizeof(u32));
+			ring.EndPop(n);
+		}
+		for (size_t i = 0; i < n; i++) {
+			if (chunk[i] != expected + i) {
+				printf("%s: got %u, expected %u\n", __FUNCTION__, chunk[i], (u32)(expected + i));
+				success = false;
+				break;
+			}
+		}
+		expected += (u32)n;
+		if (!success) {
+			// Let the producer finish.
+			while (expected < RING_TEST_COUNT)
+				expected += (u32)ring.Pop(chunk, ARRAY_SIZE(chunk));
+		}
+	}
+
+	producer.join();
+	return success && ring.size() == 0;
+}
+
+// Runs each texture decode path with the portable kernels and then with the ones
+// SetupTextureDecoder() picks for this CPU, and checks that they agree.
+// Must run before anything else calls SetupTextureDecoder().
+bool TestTextureDecoders() {
+	static const char *names[] = { "4444", "565", "5551", "swizzle16", "clut4 u16", "clut4 u32", "dxt1", "dxt3", "dxt5" };
+	const int numPaths = ARRAY_SIZE(names);
+	// 512x512 at 32 bits per pixel in, enough for every format.
+	const int width = 512, height = 512;
+	const int reps = benchmark ? 20 : 1;
+
+	std::vector<u8> src(width * height * 4);
+	u32 seed = 0x1234;
+	FillRandom(&src[0], src.size(), seed);
+	u16 clut16[16];
+	u32 clut32[16];
+	for (int i = 0; i < 16; i++) {
+		clut16[i] = (u16)(0x1111 * i + 0x0F03);
+		clut32[i] = 0x01020304 * i + 0x80706050;
+	}
+
+	std::vector<u32> out[2];
+	double times[2][numPaths];
+	const int pixels = width * height;
+	for (int pass = 0; pass < 2; pass++) {
+		if (pass == 1)
+			SetupTextureDecoder();
+		out[pass].assign(numPaths * pixels, 0);
+		for (int path = 0; path < numPaths; path++) {
+			u32 *dst = &out[pass][path * pixels];
+			const double start = real_time_now();
+			for (int r = 0; r < reps; r++) {
+				switch (path) {
+				case 0: DoConvert4444To8888(dst, (const u16 *)&src[0], pixels); break;
+				case 1: DoConvert565To8888(dst, (const u16 *)&src[0], pixels); break;
+				case 2: DoConvert5551To8888(dst, (const u16 *)&src[0], pixels); break;
+				case 3: DoUnswizzleTex16(dst, &src[0], width * 4 / 16, height / 8, width); break;
+				case 4: DeIndexTexture4Simple((u16 *)dst, &src[0], pixels, clut16); break;
+				case 5: DeIndexTexture4Simple(dst, &src[0], pixels, clut32); break;
+				case 6:
+				case 7:
+				case 8:
+					{
+						const int blockSize = path == 6 ? 8 : 16;
+						const u8 *block = &src[0];
+						for (int y = 0; y < height; y += 4) {
+							for (int x = 0; x < width; x += 4, block += blockSize) {
+								if (path == 6)
+									DecodeDXT1Block(dst + y * width + x, (const DXT1Block *)block, width);
+								else if (path == 7)
+									DecodeDXT3Block(dst + y * width + x, (const DXT3Block *)block, width);
+								else
+									DecodeDXT5Block(dst + y * width + x, (const DXT5Block *)block, width);
+							}
+						}
+					}
+					break;
+				}
+			}
+			times[pass][path] = real_time_now() - start;
+		}
+	}
+
+	int srcBytes[numPaths];
+	srcBytes[0] = srcBytes[1] = srcBytes[2] = pixels * 2;
+	srcBytes[3] = pixels * 4;
+	srcBytes[4] = srcBytes[5] = pixels / 2;
+	srcBytes[6] = pixels / 2;
+	srcBytes[7] = srcBytes[8] = pixels;
+
+	bool success = true;
+	for (int path = 0; path < numPaths; path++) {
+		if (!ArraysMatch(names[path], &out[1][path * pixels], &out[0][path * pixels], pixels))
+			success = false;
+		if (benchmark) {
+			const double mb = (double)srcBytes[path] * reps / (1024.0 * 1024.0);
+			printf("TextureDecoder %-9s: basic %8.1f, optimized %8.1f MB/s\n", names[path], mb / times[0][path], mb / times[1][path]);
+		}
+	}
+	return success;
+}
+
+// Resolves every registered NID the way module loading does, and checks the lookup tables
+// against a plain scan of the function tables.
+bool TestHLENidLookup() {
+	RegisterAllModules();
+	const int numModules = GetNumRegisteredModules();
+	std::vector<std::pair<const char *, u32> > imports;
+	for (int i = 0; i < numModules; i++) {
+		const HLEModule *module = GetModuleByIndex(i);
+		for (int j = 0; j < module->numFunctions; j++)
+			imports.push_back(std::make_pair(module->name, module->funcTable[j].ID));
+	}
+
+	// Both checksums add up every rep, so they still match in benchmark mode.
+	const int reps = benchmark ? 20 : 1;
+	u32 checksum = 0;
+	double start = real_time_now();
+	for (int r = 0; r < reps; r++) {
+		for (size_t i = 0; i < imports.size(); i++) {
+			if (FuncImportIsSyscall(imports[i].first, imports[i].second))
+				checksum += GetSyscallOp(imports[i].first, imports[i].second);
+		}
+	}
+	const double hashed = real_time_now() - start;
+
+	// The syscall ops a plain scan of the tables finds, which is also what lookups used to cost.
+	u32 expected = 0;
+	start = real_time_now();
+	for (int r = 0; r < reps; r++) {
+		for (size_t i = 0; i < imports.size(); i++) {
+			int moduleIndex = 0;
+			while (strcmp(GetModuleByIndex(moduleIndex)->name, imports[i].first) != 0)
+				moduleIndex++;
+			const HLEModule *module = GetModuleByIndex(moduleIndex);
+			int funcIndex = 0;
+			while (module->funcTable[funcIndex].ID != imports[i].second)
+				funcIndex++;
+			expected += 0x0000000c | (moduleIndex << 18) | (funcIndex << 6);
+		}
+	}
+	const double linear = real_time_now() - start;
+	if (benchmark)
+		printf("HLE: %d modules, %d NIDs, %0.2f M imports/s, %0.2f M/s scanning\n", numModules, (int)imports.size(), imports.size() * reps / hashed / 1000000.0, imports.size() * reps / linear / 1000000.0);
+
+	const bool unknown = GetModuleIndex("NotARealModule") == -1 && GetFuncIndex(0, 0xFFFFFFFF) == -1;
+	HLEShutdown();
+	EXPECT_TRUE(checksum == expected);
+	EXPECT_TRUE(unknown);
+	return true;
+}
+
+// A 2000 line cheat file: mostly plain writes, plus an increment, a failing test that skips
+// a line, and a code stopper. Compiles it, runs it a few times, and checks the results.
+// In benchmark mode, it runs it many more times and prints how long each step took.
+bool TestCwCheat() {
+	const int numWrites = 1993;
+	char line[64];
+	std::vector<std::string> lines;
+	lines.push_back("_S ULUS-10000");
+	lines.push_back("_G Benchmark");
+	lines.push_back("_C1 Everything");
+	for (int i = 0; i < numWrites; i++) {
+		snprintf(line, sizeof(line), "_L 0x%08X 0x%08X", 0x20000000 | (i * 4), i);
+		lines.push_back(line);
+	}
+	lines.push_back("_L 0x30100001 0x00010000");
+	lines.push_back("_L 0xE0011234 0x00010004");
+	lines.push_back("_L 0x20010008 0xDEADBEEF");
+	lines.push_back("_L 0xC0000000 0x00000000");
+	lines.push_back("_L 0x2001000C 0x00000001");
+	lines.push_back("_L 0xC0000004 0x12345678");
+	lines.push_back("_L 0x20010010 0x00000001");
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	for (u32 addr = 0x08810000; addr < 0x08810014; addr += 4)
+		Memory::Write_U32(0, addr);
+
+	CWCheatEngine engine;
+	double start = real_time_now();
+	engine.CreateCodeList(lines);
+	const double compileTime = real_time_now() - start;
+
+	const int runs = benchmark ? 1000 : 10;
+	start = real_time_now();
+	for (int i = 0; i < runs; i++)
+		engine.Run();
+	const double runTime = real_time_now() - start;
+	if (benchmark)
+		printf("CwCheat: %d lines compiled in %0.2f ms, %0.1f us per run\n", (int)lines.size() - 3, compileTime * 1000.0, runTime * 1000000.0 / runs);
+
+	bool success = engine.GetOperationCount() == numWrites + 7;
+	success = success && Memory::Read_U32(0x08800000 + (numWrites - 1) * 4) == numWrites - 1;
+	success = success && Memory::Read_U8(0x08810000) == (runs & 0xFF);
+	success = success && Memory::Read_U32(0x08810008) == 0;
+	success = success && Memory::Read_U32(0x0881000C) == 1;
+	success = success && Memory::Read_U32(0x08810010) == 0;
+	Memory::Shutdown();
+	if (!success)
+		printf("%s: Test Fail\n", __FUNCTION__);
+	return success;
+}
+
+static u32 MIPS_R(int rs, int rt, int rd, int sa, int funct) {
+	return (rs << 21) | (rt << 16) | (rd << 11) | (sa << 6) | funct;
+}
+
+static u32 MIPS_I(int op, int rs, int rt, int imm) {
+	return (op << 26) | (rs << 21) | (rt << 16) | (imm & 0xFFFF);
+}
+
+// The interpreter loop as it was before it had a decoded block cache.
+static void ReferenceInterpret(MIPSState *mips, u64 globalTicks) {
+	while (true) {
+		CoreTiming::Advance();
+		while (mips->downcount >= 0) {
+			again:
+			MIPSOpcode op = MIPSOpcode(Memory::Read_U32(mips->pc));
+			bool wasInDelaySlot = mips->inDelaySlot;
+			MIPSInterpret(op);
+			if (mips->inDelaySlot) {
+				if (wasInDelaySlot) {
+					mips->pc = mips->nextPC;
+					mips->inDelaySlot = false;
+				}
+				mips->downcount -= 1;
+				goto again;
+			}
+			mips->downcount -= 1;
+			if (CoreTiming::GetTicks() > globalTicks)
+				return;
+		}
+	}
+}
+
+static void InterpreterTestEvent(u64 userdata, int cyclesLate) {
+}
+
+static double RunInterpreter(bool reference, u32 code, u64 ticks, u32 *regs) {
+	memset(mipsr4k.r, 0, sizeof(mipsr4k.r));
+	mipsr4k.pc = code;
+	mipsr4k.inDelaySlot = false;
+	for (u32 i = 0; i < 0x4000; i += 4)
+		Memory::Write_U32(i * 0x9E3779B1, 0x08900000 + i);
+	CoreTiming::Init();
+	// Without any events, CoreTiming doesn't keep its slices consistent.
+	int event = CoreTiming::RegisterEvent("InterpreterTest", &InterpreterTestEvent);
+	CoreTiming::ScheduleEvent(ticks * 2, event, 0);
+
+	double start = real_time_now();
+	if (reference)
+		ReferenceInterpret(&mipsr4k, ticks);
+	else
+		MIPSInterpret_RunUntil(ticks);
+	const double elapsed = real_time_now() - start;
+	CoreTiming::Shutdown();
+
+	memcpy(regs, mipsr4k.r, sizeof(mipsr4k.r));
+	// zero is never written, so use it for a checksum of the buffer.
+	for (u32 i = 0; i < 0x4000; i += 4)
+		regs[0] += Memory::Read_U32(0x08900000 + i);
+	return elapsed;
+}
+
+// Runs a loop of ALU ops, loads, stores, likely branches and calls with both the plain and the
+// block cached interpreter, and checks they end up the same. Also prints MIPS instructions per
+// second in benchmark mode.
+bool TestInterpreter() {
+	enum { T0 = 8, T1, T2, T3, T4, T5, T6, T8 = 24, V0 = 2, V1 = 3 };
+	const u32 code = 0x08804000;
+	const u32 program[] = {
+		MIPS_I(15, 0, T8, 0x0890),                 // lui t8, 0x0890
+		MIPS_I(15, 0, T1, 0x0010),                 // lui t1, 0x0010
+		MIPS_I(9, 0, T0, 0),                       // li t0, 0
+		MIPS_I(9, 0, T2, 1),                       // li t2, 1
+		// loop:
+		MIPS_I(12, T0, T3, 0x3FFC),                // andi t3, t0, 0x3ffc
+		MIPS_R(T3, T8, T3, 0, 0x21),               // addu t3, t3, t8
+		MIPS_I(35, T3, T4, 0),                     // lw t4, 0(t3)
+		MIPS_R(T2, T4, T2, 0, 0x21),               // addu t2, t2, t4
+		MIPS_R(0, T2, T4, 3, 0x00),                // sll t4, t2, 3
+		MIPS_R(T2, T4, T2, 0, 0x26),               // xor t2, t2, t4
+		MIPS_R(0, T2, T4, 7, 0x02),                // srl t4, t2, 7
+		MIPS_R(T2, T4, T2, 0, 0x21),               // addu t2, t2, t4
+		MIPS_I(43, T3, T2, 0),                     // sw t2, 0(t3)
+		MIPS_MAKE_JAL(code + 0x54),                // jal func
+		MIPS_I(9, T0, T0, 4),                      // addiu t0, t0, 4
+		MIPS_I(9, T1, T1, -1),                     // addiu t1, t1, -1
+		MIPS_I(21, T1, 0, (0x10 - 0x44) / 4),      // bnel t1, zero, loop
+		MIPS_MAKE_NOP(),
+		// done: (branching straight back to a branch would never leave RunUntil)
+		MIPS_MAKE_NOP(),
+		MIPS_I(4, 0, 0, -2),                       // b done
+		MIPS_MAKE_NOP(),
+		// func:
+		MIPS_I(12, T2, T5, 0xFF),                  // andi t5, t2, 0xff
+		MIPS_R(T5, T0, T6, 0, 0x2B),               // sltu t6, t5, t0
+		MIPS_R(V0, T5, V0, 0, 0x21),               // addu v0, v0, t5
+		MIPS_MAKE_JR_RA(),
+		MIPS_R(V1, T6, V1, 0, 0x21),               // addu v1, v1, t6
+	};
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	currentMIPS = &mipsr4k;
+	coreState = CORE_RUNNING;
+	for (size_t i = 0; i < ARRAY_SIZE(program); i++)
+		Memory::Write_U32(program[i], code + i * 4);
+
+	// Enough to finish the loop (19 ops per iteration) and spin a bit at the end.
+	const u64 ticks = 0x100000 * 19 + 100000;
+	u32 refRegs[32], regs[32];
+	const double refTime = RunInterpreter(true, code, ticks, refRegs);
+	const double cachedTime = RunInterpreter(false, code, ticks, regs);
+	MIPSInterpret_ClearCache();
+	Memory::Shutdown();
+
+	if (benchmark)
+		printf("Interpreter: plain %0.1f MIPS, block cached %0.1f MIPS\n", ticks / refTime / 1000000.0, ticks / cachedTime / 1000000.0);
+
+	EXPECT_TRUE(ArraysMatch("Interpreter registers", regs, refRegs, ARRAY_SIZE(regs)));
+	EXPECT_TRUE(regs[T1] == 0);
+	return true;
+}
+
+// Runs the IR passes over a short run and checks which instructions they drop: writes that are
+// overwritten before being read go, while anything read later or still live at the block exit stays.
+bool TestJitIR() {
+	enum { A0 = 4, A1, A2, A3, T0 = 8, T1, T2, T3, T4, S0 = 16 };
+	const u32 code = 0x08804000;
+	const u32 program[] = {
+		MIPS_R(A0, A1, T0, 0, 0x21),               // addu t0, a0, a1 (dead, overwritten)
+		MIPS_R(A2, A3, T0, 0, 0x21),               // addu t0, a2, a3
+		MIPS_I(43, S0, T0, 0),                     // sw t0, 0(s0) (dead, stored again)
+		MIPS_R(T0, T0, T1, 0, 0x21),               // addu t1, t0, t0
+		MIPS_I(43, S0, T1, 0),                     // sw t1, 0(s0)
+		MIPS_I(43, S0, T1, 4),                     // sw t1, 4(s0) (the load may read it)
+		MIPS_I(35, S0, T2, 8),                     // lw t2, 8(s0)
+		MIPS_I(9, T2, T3, 1),                      // addiu t3, t2, 1
+		MIPS_I(43, S0, T3, 4),                     // sw t3, 4(s0)
+		MIPS_I(9, T2, T4, 2),                      // addiu t4, t2, 2 (live at the exit)
+		MIPS_MAKE_JR_RA(),
+		MIPS_MAKE_NOP(),
+	};
+	const bool dead[] = { true, false, true, false, false, false, false, false, false, false };
+
+	Memory::g_MemorySize = Memory::RAM_NORMAL_SIZE;
+	Memory::Init();
+	for (size_t i = 0; i < ARRAY_SIZE(program); i++)
+		Memory::Write_U32(program[i], code + i * 4);
+
+	MIPSComp::IRBlock block;
+	block.Build(code);
+	MIPSComp::IROptions options;
+	block.RunPasses(options);
+	bool success = block.NumInstructions() == (int)ARRAY_SIZE(dead) && block.NumDead() == 2;
+	for (size_t i = 0; i < ARRAY_SIZE(dead); i++)
+		success = success && block.IsDead(code + i * 4) == dead[i];
+
+	// With only the register pass, the first store keeps t0 alive.
+	block.Build(code);
+	options.deadStores = false;
+	block.RunPasses(options);
+	success = success && block.NumDead() == 1 && block.IsDead(code) && !block.IsDead(code + 8);
+	Memory::Shutdown();
+
+	EXPECT_TRUE(success);
+	return true;
+}
+
 int main(int argc, const char *argv[])
 {
+	benchmark = argc > 1 && !strcmp(argv[1], "benchmark");
+
 	TestAsin();
 	//TestSinCos();
 	//TestArmEmitter();
 	TestMathUtil();
 	TestParsers();
+	TestJitPageIndex();
+	TestJitIR();
+	TestLockFreeRingBuffer();
+	TestIndexGenerator();
+	TestVertexCacheSampledHash();
+	TestTextureDecoders();
+	TestCwCheat();
+	TestHLENidLookup();
+	TestCoreTiming();
+	TestInterpreter();
+	TestSoftwareRasterizer();
+	TestGERecord();
+	TestISOFileSystem();
+	TestCSOReadAhead();
+	TestParallelVertexDecode();
+	// "UnitTests vertexjit" also prints the decode speed of each format.
+	TestVertexDecoderJit(argc > 1 && !strcmp(argv[1], "vertexjit"));
 	return 0;
 }
\ No newline at end of file